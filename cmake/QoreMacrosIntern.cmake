@@ -162,6 +162,41 @@ unset(CMAKE_REQUIRED_LIBRARIES)
 endmacro()
 
 
+# optional zstd (1.4.0 or later for the advanced API) and lz4 (frame format) compression support
+macro(qore_compression_checks)
+
+find_path(ZSTD_INCLUDE_DIR zstd.h)
+find_library(ZSTD_LIBRARY NAMES zstd libzstd)
+if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+    cmake_push_check_state(RESET)
+    set(CMAKE_REQUIRED_INCLUDES ${ZSTD_INCLUDE_DIR})
+    set(CMAKE_REQUIRED_LIBRARIES ${ZSTD_LIBRARY})
+    check_cxx_symbol_exists(ZSTD_compressStream2 zstd.h HAVE_ZSTD)
+    cmake_pop_check_state()
+    if(HAVE_ZSTD)
+        include_directories(${ZSTD_INCLUDE_DIR})
+        set(LIBQORE_LIBS ${ZSTD_LIBRARY} ${LIBQORE_LIBS})
+    endif()
+endif()
+
+find_path(LZ4_INCLUDE_DIR lz4frame.h)
+find_library(LZ4_LIBRARY NAMES lz4 liblz4)
+if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+    cmake_push_check_state(RESET)
+    set(CMAKE_REQUIRED_INCLUDES ${LZ4_INCLUDE_DIR})
+    set(CMAKE_REQUIRED_LIBRARIES ${LZ4_LIBRARY})
+    set(CMAKE_REQUIRED_DEFINITIONS -DLZ4F_STATIC_LINKING_ONLY)
+    check_cxx_symbol_exists(LZ4F_compressBegin_usingCDict lz4frame.h HAVE_LZ4)
+    cmake_pop_check_state()
+    if(HAVE_LZ4)
+        include_directories(${LZ4_INCLUDE_DIR})
+        set(LIBQORE_LIBS ${LZ4_LIBRARY} ${LIBQORE_LIBS})
+    endif()
+endif()
+
+endmacro()
+
+
 macro(qore_gethost_checks)
 
 check_cxx_symbol_exists(gethostbyaddr_r netdb.h HAVE_GETHOSTBYADDR_R)
@@ -30,6 +30,8 @@
 #cmakedefine HAVE_SYS_SELECT_H
 #cmakedefine HAVE_POLL_H
 #cmakedefine HAVE_GRP_H
+#cmakedefine HAVE_SYS_MMAN_H
+#cmakedefine HAVE_SYS_EPOLL_H
 #cmakedefine HAVE_UMEM_H
 
 /* functions */
@@ -106,8 +108,12 @@
 #cmakedefine HAVE_STRNCASECMP
 #cmakedefine HAVE_SETGROUPS
 #cmakedefine HAVE_GETGROUPS
+#cmakedefine HAVE_POLL
 #cmakedefine HAVE_REALPATH
 #cmakedefine HAVE_MEMMEM
+#cmakedefine HAVE_MMAP
+#cmakedefine HAVE_MADVISE
+#cmakedefine HAVE_EPOLL_CREATE1
 #cmakedefine HAVE_GETHOSTBYADDR_R
 #cmakedefine HAVE_GETHOSTBYNAME_R
 #cmakedefine HAVE_STRTOIMAX
@@ -130,6 +136,10 @@
 #cmakedefine HAVE_MPFR_EXP_T
 #cmakedefine HAVE_RNDN
 
+/* optional compression libraries */
+#cmakedefine HAVE_ZSTD
+#cmakedefine HAVE_LZ4
+
 /* backtrace */
 #cmakedefine Backtrace_FOUND
 #ifdef Backtrace_FOUND
@@ -35,8 +35,13 @@
 
 #include <qore/AbstractQoreNode.h>
 
+class QoreMappedRegion;
+
 //! holds arbitrary binary data
 /** this class is implemented simply as a pointer and a length indicator
+
+    the data may also be a read-only slice of a memory-mapped file, in which case it is copied to private memory
+    the first time it is modified
  */
 class BinaryNode : public SimpleValueQoreNode {
 private:
@@ -44,6 +49,8 @@ private:
    void *ptr;
    //! size of the memory block owned by the object
    qore_size_t len;
+   //! copies the data of a slice to memory owned by the object
+   DLLLOCAL void unshare();
 
    // not yet implemented
    DLLLOCAL BinaryNode(const BinaryNode&);
@@ -57,12 +64,29 @@ protected:
    DLLLOCAL void checkOffset(qore_offset_t& offset, qore_offset_t& num) const;
 
 public:
+   //! allocates the object with the library's per-thread slab allocator
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void* operator new(size_t size);
+
+   //! frees an object allocated with operator new()
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void operator delete(void* p);
+
    //! creates the object
    /** @param p a pointer to the memory, the BinaryNode object takes over ownership of this pointer
        @param size the byte length of the memory
    */
    DLLEXPORT BinaryNode(void *p = 0, qore_size_t size = 0);
 
+   //! creates a read-only slice of a memory mapping without copying the data
+   /** @param m the mapping; a new reference is acquired and held until the object is destroyed or modified
+       @param p a pointer to the start of the slice within the mapping
+       @param size the byte length of the slice
+   */
+   DLLLOCAL BinaryNode(QoreMappedRegion* m, const void* p, qore_size_t size);
+
    //! returns false unless perl-boolean-evaluation is enabled, in which case it returns false only when empty
    /** @return false unless perl-boolean-evaluation is enabled, in which case it returns false only when empty
     */
@@ -120,7 +144,7 @@ public:
 
    //! returns a copy of the object
    /**
-      @return a copy of the current object
+      @return a copy of the current object; copies of memory-mapped slices reference the same mapping
    */
    DLLEXPORT BinaryNode *copy() const;
       
@@ -141,7 +165,7 @@ public:
 
    //! returns the data being managed and leaves this object empty
    /**
-      @return the data being managed (leaves this object empty)
+      @return the data being managed (leaves this object empty); memory-mapped slices are copied first so the pointer returned can always be passed to free()
       @note it would be a grevious error to call this function on an object
       with a reference_count > 1 (i.e. is_unique() is false)
    */
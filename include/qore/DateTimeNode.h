@@ -82,6 +82,16 @@ protected:
    DLLEXPORT virtual ~DateTimeNode();
 
 public:
+   //! allocates the object with the library's per-thread slab allocator
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void* operator new(size_t size);
+
+   //! frees an object allocated with operator new()
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void operator delete(void* p);
+
    //! constructor for an empty object
    /**
       @param r sets the "relative" flag for the object
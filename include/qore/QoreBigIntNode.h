@@ -59,6 +59,16 @@ protected:
    DLLEXPORT QoreBigIntNode(qore_type_t t, int64 v);
 
 public:
+   //! allocates the object with the library's per-thread slab allocator
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void* operator new(size_t size);
+
+   //! frees an object allocated with operator new()
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void operator delete(void* p);
+
    //! value of the integer
    int64 val;
 
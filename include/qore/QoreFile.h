@@ -564,8 +564,32 @@ public:
 #endif
 
    //! get file descriptor
+   /** any data buffered internally for reading but not yet returned is discarded and the descriptor's position is
+       moved back to the logical file position before the descriptor is returned; a memory mapping of the file is released
+   */
    DLLEXPORT int getFD() const;
 
+   //! maps the contents of the open file into memory for reading
+   /** the file size at the time of the call is mapped; reads are then served from the mapping without system calls
+       and readBinary() returns slices of the mapping without copying the data; the logical file position is retained
+       @param advice an madvise() hint for the kernel (ex: MADV_SEQUENTIAL)
+       @param xsink if an error occurs, the Qore-language exception info will be added here
+       @return 0 for OK, -1 for error (exception raised)
+
+       @since %Qore 0.8.13
+   */
+   DLLEXPORT int map(int advice, ExceptionSink* xsink);
+
+   //! releases any memory mapping of the file; slices returned from the mapping remain valid
+   /** @since %Qore 0.8.13
+    */
+   DLLEXPORT void unmap();
+
+   //! returns true if the file is mapped into memory
+   /** @since %Qore 0.8.13
+    */
+   DLLEXPORT bool isMapped() const;
+
    //! returns true if the file is open, false if not
    DLLEXPORT bool isOpen() const;
 
@@ -107,6 +107,16 @@ protected:
    DLLEXPORT virtual ~QoreHashNode();
 
 public:
+   //! allocates the object with the library's per-thread slab allocator
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void* operator new(size_t size);
+
+   //! frees an object allocated with operator new()
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void operator delete(void* p);
+
 
    //! creates an empty hash
    DLLEXPORT QoreHashNode();
@@ -266,6 +276,17 @@ public:
     */
    DLLEXPORT QoreHashNode* copy() const;
 
+   //! returns a new hash with the same keys in the same order as the current hash, but with all values set to NOTHING
+   /** the new hash shares its key layout with the current hash (and all other hashes created from it with this
+       call) until keys are added to or removed from it, so this call is useful for creating many hashes with
+       the same keys, for example for rows returned by DBI drivers
+
+       @return a new hash with the same keys as the current hash and all values set to NOTHING
+
+       @since %Qore 0.8.13
+   */
+   DLLEXPORT QoreHashNode* copyShape() const;
+
    //! returns a pointer to a pointer of the value of the key so the value may be set or changed externally
    /** Converts "key" to the default character encoding (QCS_DEFAULT) if necessary.
        An exception could be thrown if the character encoding conversion fails.
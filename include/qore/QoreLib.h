@@ -437,6 +437,12 @@ DLLEXPORT const char* tz_get_region_name(const AbstractQoreZoneInfo* tz);
 #define QORE_OPT_FUNC_SETSID             "setsid()"
 //! option: is_executable() function available
 #define QORE_OPT_FUNC_IS_EXECUTABLE      "is_executable()"
+//! option: memory-mapped file I/O available
+#define QORE_OPT_FUNC_MMAP               "mmap()"
+//! option: zstd compression available
+#define QORE_OPT_ZSTD                    "zstd"
+//! option: lz4 compression available
+#define QORE_OPT_LZ4                     "lz4"
 
 //! option type feature
 #define QO_OPTION     0
@@ -127,6 +127,16 @@ protected:
    DLLLOCAL virtual double floatEvalImpl(ExceptionSink* xsink) const;
 
 public:
+   //! allocates the object with the library's per-thread slab allocator
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void* operator new(size_t size);
+
+   //! frees an object allocated with operator new()
+   /** @since Qore 0.8.13
+   */
+   DLLEXPORT static void operator delete(void* p);
+
    DLLEXPORT QoreListNode();
 
    //! returns false unless perl-boolean-evaluation is enabled, in which case it returns false only when empty
@@ -36,8 +36,6 @@
 #include <qore/QoreThreadLock.h>
 #include <qore/QoreCondition.h>
 
-class QoreQueueNode;
-
 class qore_queue_private;
 
 class QoreQueue {
@@ -79,6 +77,23 @@ public:
    //! remove a node from the end of the queue
    DLLEXPORT AbstractQoreNode* pop(ExceptionSink* xsink, int timeout_ms = 0, bool* to = 0);
 
+   //! push all elements of the list at the end of the queue in order with a single lock acquisition if possible
+   /** if the queue has a maximum size, elements are queued as space becomes available; elements queued before an
+       error or timeout remain in the queue
+
+       @return the number of elements queued
+
+       @since Qore 0.8.13
+    */
+   DLLEXPORT int pushList(ExceptionSink* xsink, const QoreListNode* l, int timeout_ms = 0, bool* to = 0);
+
+   //! waits for data and then removes up to \a n nodes from the beginning of the queue; \a n must be > 0
+   /** @return a list of the nodes removed or 0 if an error or timeout occurred
+
+       @since Qore 0.8.13
+    */
+   DLLEXPORT QoreListNode* shiftN(ExceptionSink* xsink, int n, int timeout_ms = 0, bool* to = 0);
+
    //! returns true if the queue is empty
    DLLEXPORT bool empty() const;
 
@@ -182,6 +182,8 @@ public:
    DLLEXPORT bool isDataAvailable(ExceptionSink* xsink, int timeout = 0);
    DLLEXPORT bool isWriteFinished(ExceptionSink* xsink, int timeout = 0);
    DLLEXPORT bool isOpen() const;
+   // returns true if received data is buffered internally and therefore cannot be detected by waiting on the descriptor
+   DLLLOCAL bool hasBufferedData() const;
    // c must be already referenced before this call
    DLLEXPORT void setCertificate(QoreSSLCertificate* c);
    // p must be already referenced before this call
@@ -39,11 +39,32 @@ public:
    static constexpr const char *ALG_ZLIB = "zlib";
    static constexpr const char *ALG_GZIP = "gzip";
    static constexpr const char *ALG_BZIP2 = "bzip2";
+   static constexpr const char *ALG_ZSTD = "zstd";
+   static constexpr const char *ALG_LZ4 = "lz4";
 
    static constexpr int64 LEVEL_DEFAULT = -1;
+   static constexpr int64 ZSTD_LEVEL_DEFAULT = 3;
+   static constexpr int64 LZ4_LEVEL_DEFAULT = 0;
+   static constexpr int64 ZSTD_DICT_SIZE_DEFAULT = 112640;
 
-   static Transform *getCompressor(const QoreStringNode *alg, int64 level, ExceptionSink *xsink);
-   static Transform *getDecompressor(const QoreStringNode *alg, ExceptionSink *xsink);
+   static constexpr int64 PARALLEL_BLOCK_SIZE_DEFAULT = 128 * 1024;
+   static constexpr int64 PARALLEL_BLOCK_SIZE_MIN = 4096;
+   static constexpr int64 PARALLEL_THREADS_MAX = 256;
+
+   // the dictionary is optional and only supported by zstd and lz4
+   static Transform *getCompressor(const QoreStringNode *alg, int64 level, const BinaryNode *dict, ExceptionSink *xsink);
+   static Transform *getParallelCompressor(const QoreStringNode *alg, int64 level, int64 block_size, int64 threads,
+                                           ExceptionSink *xsink);
+   static Transform *getDecompressor(const QoreStringNode *alg, const BinaryNode *dict, ExceptionSink *xsink);
+
+   // one-shot zstd and lz4 compression and decompression with an optional dictionary
+   static BinaryNode *compress(const char *alg, const void *ptr, size_t len, int64 level, const BinaryNode *dict,
+                               ExceptionSink *xsink);
+   static BinaryNode *decompress(const char *alg, const void *ptr, size_t len, const BinaryNode *dict,
+                                 ExceptionSink *xsink);
+
+   // returns a zstd dictionary trained from the given list of string and binary samples
+   static BinaryNode *trainZstdDictionary(const QoreListNode *samples, int64 max_size, ExceptionSink *xsink);
 };
 
 #endif // _QORE_COMPRESSIONTRANSFORMS_H
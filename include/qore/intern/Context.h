@@ -64,6 +64,8 @@ public:
    struct node_row_list_s *group_values;
    Context *next;
    int sub;
+   // empty hash with the keys of "value" used to create rows sharing the same key layout; created on demand
+   QoreHashNode *row_shape;
    
    DLLLOCAL Context(char *nme, ExceptionSink *xsinkx, AbstractQoreNode *exp,
 		    AbstractQoreNode *cond = NULL,
@@ -42,12 +42,11 @@
 #include "qore/intern/DatasourceStatementHelper.h"
 #include "qore/intern/QoreSQLStatement.h"
 
-#include <map>
-#include <deque>
+#include <atomic>
 #include <string>
 
-typedef std::map<int, int> thread_use_t;   // for marking a datasource in use
-typedef std::deque<int> free_list_t;       // for the free list
+// number of buckets in the connection wait and hold time histograms; bucket n counts times less than 2^n microseconds
+#define DSP_HIST_BUCKETS 24
 
 // class holding datasource configuration params
 class DatasourceConfig {
@@ -166,21 +165,31 @@ class DatasourcePool : public AbstractThreadResource, public QoreCondition, publ
    friend class DatasourcePoolActionHelper;
 protected:
    Datasource** pool;
-   int* tid_list;            // list of thread IDs per pool index
-   thread_use_t tmap;        // map from tids to pool index
-   free_list_t free_list;
+   std::atomic<int>* tid_list;   // list of thread IDs per pool index; 0 = free
+   std::atomic<int>* free_next;  // next pool index in the free stack per pool index
+   int64* acq_time;              // connection acquisition time per pool index; only accessed by the owning thread
+
+   // head of the lock-free free stack: the low 32 bits are the pool index + 1 (0 = empty), the high 32 bits
+   // are a counter incremented on every change to avoid ABA problems
+   std::atomic<uint64_t> free_head;
+
+   // unique ID for looking up connections allocated to the current thread
+   int64 pool_id;
 
    unsigned min,
       max,
       cmax,			 // current max
-      wait_count,
       wait_max,
       tl_warning_ms;
 
-   int64 tl_timeout_ms,
-      stats_reqs,
-      stats_hits
-      ;
+   std::atomic<unsigned> wait_count;
+
+   int64 tl_timeout_ms;
+
+   std::atomic<int64> stats_reqs,
+      stats_hits,
+      wait_hist[DSP_HIST_BUCKETS],
+      hold_hist[DSP_HIST_BUCKETS];
 
    ResolvedCallReferenceNode* warning_callback;
    AbstractQoreNode* callback_arg;
@@ -195,6 +204,12 @@ protected:
    void resetSQL();
 #endif
 
+   // returns the pool index of the connection allocated to the current thread or -1 if none; does not lock
+   DLLLOCAL int getThreadIndex() const;
+   DLLLOCAL void pushFree(int i);
+   DLLLOCAL int popFree();
+   // returns a connection to the pool; must be called by the thread that holds the connection
+   DLLLOCAL void releaseIntern(int i);
    DLLLOCAL Datasource* getAllocatedDS();
    DLLLOCAL Datasource* getDSIntern(bool& new_ds, int64& wait_total, ExceptionSink* xsink);
    DLLLOCAL Datasource* getDS(bool& new_ds, ExceptionSink* xsink);
@@ -286,8 +301,7 @@ public:
    }
 
    DLLLOCAL bool currentThreadInTransaction() const {
-      SafeLocker sl((QoreThreadLock*)this);
-      return tmap.find(gettid()) != tmap.end();
+      return getThreadIndex() != -1;
    }
 
    DLLLOCAL QoreHashNode* getConfigHash() const;
@@ -36,6 +36,8 @@
 #include "qore/intern/AbstractStatement.h"
 
 class ExpressionStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 private:
    AbstractQoreNode *exp;
    bool is_declaration;
@@ -38,19 +38,24 @@
 #include "qore/intern/FileInputStream.h"
 #include "qore/intern/InputStreamLineIterator.h"
 
+#ifdef Q_HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 /**
  * @brief Private data for the Qore::FileLineIterator class.
  */
 class FileLineIterator : public QoreIteratorBase {
 
 public:
-   DLLLOCAL FileLineIterator(ExceptionSink* xsink, const QoreStringNode* name, const QoreEncoding* enc = QCS_DEFAULT, const QoreStringNode* n_eol = 0, bool n_trim = true) :
+   DLLLOCAL FileLineIterator(ExceptionSink* xsink, const QoreStringNode* name, const QoreEncoding* enc = QCS_DEFAULT, const QoreStringNode* n_eol = 0, bool n_trim = true, bool n_mapped = false) :
       src(0),
       fis(0),
       encoding(enc),
       filename(name->stringRefSelf()),
       eol(n_eol ? n_eol->stringRefSelf() : 0),
-      trim(n_trim) {
+      trim(n_trim),
+      mapped(n_mapped) {
       doReset(xsink);
    }
 
@@ -60,7 +65,8 @@ public:
       encoding(old.encoding),
       filename(old.filename->stringRefSelf()),
       eol(old.eol ? old.eol->stringRefSelf() : 0),
-      trim(old.trim) {
+      trim(old.trim),
+      mapped(old.mapped) {
       doReset(xsink);
    }
 
@@ -134,6 +140,13 @@ private:
       if (*xsink)
          return;
       fis->ref();
+      // a mapped file is read from memory without system calls; pages are read ahead and released sequentially
+#ifdef MADV_SEQUENTIAL
+      if (mapped && fis->getFile().map(MADV_SEQUENTIAL, xsink))
+#else
+      if (mapped && fis->getFile().map(0, xsink))
+#endif
+         return;
       src = new InputStreamLineIterator(xsink, *fis, encoding, eol, trim);
    }
 
@@ -144,6 +157,8 @@ private:
    QoreStringNode* filename;
    QoreStringNode* eol;
    bool trim;
+   // true if the file is mapped into memory
+   bool mapped;
 };
 
 #endif // _QORE_FILELINEITERATOR_H
@@ -40,6 +40,8 @@
 #include "qore/intern/FunctionalOperatorInterface.h"
 
 class ForEachStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 private:
    AbstractQoreNode* var,
       * list;
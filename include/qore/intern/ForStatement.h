@@ -39,6 +39,8 @@ class StatementBlock;
 class LVList;
 
 class ForStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
    AbstractQoreNode *assignment;
    AbstractQoreNode *cond;
    AbstractQoreNode *iterator;
@@ -187,6 +187,8 @@ public:
    lvar_vec_t lv;
    LocalVar* argvid;
    LocalVar* selfid;
+   // the number of slots in the local and closure variable frames reserved for each call
+   unsigned lvar_slots, cvar_slots;
    bool resolved;
 
    DLLLOCAL UserSignature(int n_first_line, int n_last_line, AbstractQoreNode* params, RetTypeInfo* retTypeInfo, int64 po);
@@ -417,6 +419,7 @@ public:
 
 class VRMutex;
 class UserVariantExecHelper;
+class QoreBytecode;
 
 // base implementation shared between all user variants
 class UserVariantBase {
@@ -427,6 +430,8 @@ protected:
    StatementBlock* statements;
    // for "synchronized" functions
    VRMutex* gate;
+   // the compiled body if the function was parsed with %bytecode and could be compiled
+   QoreBytecode* bytecode;
 
 public:
    QoreProgram* pgm;
@@ -438,6 +443,7 @@ protected:
    bool init;
 
    DLLLOCAL QoreValue evalIntern(ReferenceHolder<QoreListNode>& argv, QoreObject* self, ExceptionSink* xsink) const;
+   DLLLOCAL QoreValue evalBytecode(const char* name, CodeEvaluationHelper* ceh, ExceptionSink* xsink) const;
    DLLLOCAL QoreValue eval(const char* name, CodeEvaluationHelper* ceh, QoreObject* self, ExceptionSink* xsink, const qore_class_private* qc = 0) const;
    DLLLOCAL int setupCall(CodeEvaluationHelper* ceh, ReferenceHolder<QoreListNode>& argv, ExceptionSink* xsink) const;
 
@@ -483,10 +489,7 @@ protected:
    ExceptionSink* xsink;
 
 public:
-   DLLLOCAL UserVariantExecHelper(const UserVariantBase* n_uvb, CodeEvaluationHelper* ceh, ExceptionSink* n_xsink) : ProgramThreadCountContextHelper(n_xsink, n_uvb->pgm, true), uvb(n_uvb), argv(n_xsink), xsink(n_xsink) {
-      if (*xsink || uvb->setupCall(ceh, argv, xsink))
-	 uvb = 0;
-   }
+   DLLLOCAL UserVariantExecHelper(const UserVariantBase* n_uvb, CodeEvaluationHelper* ceh, ExceptionSink* n_xsink);
 
    DLLLOCAL ~UserVariantExecHelper();
 
@@ -566,7 +569,55 @@ struct IList : public ilist_t {
    DLLLOCAL QoreFunction* getFunction(const qore_class_private* class_ctx, const qore_class_private*& last_class, const_iterator aqfi, bool& internal_access, bool& stop) const;
 };
 
+// the maximum number of arguments in calls whose runtime variant resolution is cached
+#define QORE_VARIANT_CACHE_ARGS 8
+// the number of argument type signatures cached for each function
+#define QORE_VARIANT_CACHE_SIZE 8
+
+// the key of a variant resolved at runtime: the argument types and the classes of object arguments together with the
+// runtime class context and parse options, which determine the variant found
+class VariantCacheKey : public InlineCacheEntry {
+public:
+   const qore_class_private* ctx;
+   int ctx_serial;
+   int64 po;
+   bool only_user;
+   unsigned nargs;
+   qore_type_t types[QORE_VARIANT_CACHE_ARGS];
+   const qore_class_private* cls[QORE_VARIANT_CACHE_ARGS];
+   int cls_serial[QORE_VARIANT_CACHE_ARGS];
+
+   // sets up the key for the given call; returns -1 if the call cannot be cached
+   DLLLOCAL int set(const QoreValueList* args, bool n_only_user, const qore_class_private* class_ctx);
+
+   DLLLOCAL bool matches(const VariantCacheKey& k) const {
+      if (nargs != k.nargs || ctx != k.ctx || po != k.po || only_user != k.only_user || gen != k.gen
+          || ctx_serial != k.ctx_serial)
+         return false;
+      for (unsigned i = 0; i < nargs; ++i) {
+         if (types[i] != k.types[i] || cls[i] != k.cls[i] || cls_serial[i] != k.cls_serial[i])
+            return false;
+      }
+      return true;
+   }
+};
+
+class VariantCacheEntry : public VariantCacheKey {
+public:
+   const AbstractQoreFunctionVariant* variant;
+
+   DLLLOCAL VariantCacheEntry(const VariantCacheKey& k, const AbstractQoreFunctionVariant* v) : VariantCacheKey(k), variant(v) {
+   }
+};
+
+typedef QoreInlineCache<VariantCacheEntry, QORE_VARIANT_CACHE_SIZE> VariantCache;
+
+// returns statistics about variants resolved at runtime
+DLLLOCAL QoreHashNode* qore_function_get_resolution_stats();
+
 class QoreFunction : protected QoreReferenceCounter {
+   friend QoreHashNode* qore_function_get_resolution_stats();
+
 protected:
    std::string name;
    qore_ns_private* ns;
@@ -599,6 +650,28 @@ protected:
 
    const QoreTypeInfo* nn_uniqueReturnType;
 
+   // variants resolved at runtime by argument types
+   mutable VariantCache vcache;
+   // number of variants resolved at runtime by searching the variant lists and found in the cache
+   mutable std::atomic<int64> resolutions, cache_hits;
+
+   // set when the function is in the list of functions with runtime resolution statistics
+   mutable std::atomic<bool> stats_registered;
+   // the name reported in statistics and the links in the statistics list
+   mutable std::string stats_name;
+   mutable const QoreFunction* stats_prev, * stats_next;
+
+   DLLLOCAL void registerStats() const;
+   DLLLOCAL void unregisterStats();
+
+   // invalidates variants cached by this and other functions
+   DLLLOCAL void invalidateVariantCache() {
+      if (resolutions.load(std::memory_order_relaxed) || cache_hits.load(std::memory_order_relaxed))
+         qore_inline_cache_gen.fetch_add(1, std::memory_order_release);
+   }
+
+   DLLLOCAL const AbstractQoreFunctionVariant* runtimeFindVariantIntern(ExceptionSink* xsink, const QoreValueList* args, bool only_user, const qore_class_private* class_ctx) const;
+
    DLLLOCAL void parseCheckReturnType() {
       if (parse_rt_done)
          return;
@@ -694,6 +767,8 @@ protected:
 
    DLLLOCAL virtual ~QoreFunction() {
       //printd(5, "QoreFunction::~QoreFunction() this: %p %s\n", this, name.c_str());
+      if (stats_registered.load(std::memory_order_acquire))
+         unregisterStats();
    }
 
 public:
@@ -703,7 +778,7 @@ public:
         nn_same_return_type(true), nn_unique_functionality(QDOM_DEFAULT),
         nn_unique_flags(QC_NO_FLAGS), nn_count(0), parse_rt_done(true),
         parse_init_done(true), has_user(false), has_builtin(false), has_mod_pub(false), inject(false),
-        nn_uniqueReturnType(0) {
+        nn_uniqueReturnType(0), resolutions(0), cache_hits(0), stats_registered(false), stats_prev(0), stats_next(0) {
       ilist.push_back(INode(this, Public));
       //printd(5, "QoreFunction::QoreFunction() this: %p %s\n", this, name.c_str());
    }
@@ -720,7 +795,8 @@ public:
         nn_count(old.nn_count),
         parse_rt_done(true), parse_init_done(true),
         has_user(old.has_user), has_builtin(old.has_builtin), has_mod_pub(false), inject(n_inject),
-        nn_uniqueReturnType(old.nn_uniqueReturnType) {
+        nn_uniqueReturnType(old.nn_uniqueReturnType), resolutions(0), cache_hits(0), stats_registered(false),
+        stats_prev(0), stats_next(0) {
       bool no_user = po & PO_NO_INHERIT_USER_FUNC_VARIANTS;
       bool no_builtin = po & PO_NO_SYSTEM_FUNC_VARIANTS;
 
@@ -923,6 +999,7 @@ public:
 
    // find variant at runtime
    // class_ctx is only for use in a class hierarchy and is only set if there is a current class context and it's reachable from the object being executed
+   // variants found are cached by the argument types
    DLLLOCAL const AbstractQoreFunctionVariant* runtimeFindVariant(ExceptionSink* xsink, const QoreValueList* args, bool only_user, const qore_class_private* class_ctx) const;
 
    DLLLOCAL void parseAssimilate(QoreFunction& other) {
@@ -1090,12 +1167,42 @@ public:
    DLLLOCAL virtual MethodFunctionBase* copy(const QoreClass* n_qc) const = 0;
 };
 
+// assigns frame slots to the local variables declared in user code
+/* variables are registered when declared, and slots are assigned when the code has been parsed, at which point it
+   is known which variables are bound in closures; closure-bound variables get slots in the closure variable frame
+*/
+class LocalVarFrameParseEnvironment {
+protected:
+   typedef std::vector<LocalVar*> lvar_vec_t;
+
+   UserSignature* sig;
+   QoreProgram* pgm;
+   lvar_vec_t vars;
+   LocalVarFrameParseEnvironment* prev;
+
+public:
+   DLLLOCAL LocalVarFrameParseEnvironment(UserSignature* n_sig) : sig(n_sig), pgm(getProgram()), prev(thread_set_lvar_frame_parse_env(this)) {
+   }
+
+   DLLLOCAL ~LocalVarFrameParseEnvironment();
+
+   DLLLOCAL void add(LocalVar* var) {
+      vars.push_back(var);
+   }
+
+   // returns the program whose code is being parsed
+   DLLLOCAL QoreProgram* getParseProgram() const {
+      return pgm;
+   }
+};
+
 class UserParamListLocalVarHelper {
 protected:
    UserVariantBase* uvb;
+   LocalVarFrameParseEnvironment fenv;
 
 public:
-   DLLLOCAL UserParamListLocalVarHelper(UserVariantBase* n_uvb, const QoreTypeInfo* classTypeInfo = 0) : uvb(n_uvb) {
+   DLLLOCAL UserParamListLocalVarHelper(UserVariantBase* n_uvb, const QoreTypeInfo* classTypeInfo = 0) : uvb(n_uvb), fenv(uvb->getUserSignature()) {
       uvb->parseInitPushLocalVars(classTypeInfo);
    }
 
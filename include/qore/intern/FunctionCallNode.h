@@ -225,6 +225,8 @@ protected:
    // is needed
    const QoreClass* qc;
    const QoreMethod* method;
+   // methods resolved at runtime for other receiver classes
+   mutable MethodCallCache mcache;
 
    DLLLOCAL virtual AbstractQoreNode* parseInitImpl(LocalVar* oflag, int pflag, int& lvids, const QoreTypeInfo*& typeInfo) = 0;
    DLLLOCAL virtual const QoreTypeInfo* getTypeInfo() const {
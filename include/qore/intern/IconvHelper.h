@@ -35,34 +35,60 @@
 #include <errno.h>
 #include <iconv.h>
 
+// conversions performed directly without iconv
+enum qore_fast_conversion_e {
+   QFC_NONE = 0,
+   QFC_UTF8_TO_ISO88591,
+   QFC_UTF8_TO_USASCII,
+   QFC_ISO88591_TO_UTF8,
+   QFC_USASCII_TO_UTF8,
+   QFC_UTF8_TO_UTF16LE,
+   QFC_UTF8_TO_UTF16BE,
+   QFC_UTF16LE_TO_UTF8,
+   QFC_UTF16BE_TO_UTF8,
+};
+
+// returns the direct conversion for the given encodings or QFC_NONE if the conversion must be made with iconv
+DLLLOCAL qore_fast_conversion_e q_get_fast_conversion(const QoreEncoding* to, const QoreEncoding* from);
+
+// converts as much input as possible with a direct conversion, updating the arguments like iconv(); returns 0 if all input
+// was converted, E2BIG if the output buffer is full, or -1 if the remaining input must be converted with iconv, which also
+// reports any errors
+DLLLOCAL int q_fast_convert(qore_fast_conversion_e type, char** inbuf, size_t* inavail, char** outbuf, size_t* outavail);
+
+// returns an iconv descriptor in its initial state from the calling thread's cache or opens a new one
+DLLLOCAL iconv_t q_iconv_get(const QoreEncoding* to, const QoreEncoding* from);
+
+// returns an iconv descriptor to the calling thread's cache
+DLLLOCAL void q_iconv_put(const QoreEncoding* to, const QoreEncoding* from, iconv_t c);
+
 class IconvHelper {
 
 public:
-   DLLLOCAL IconvHelper(const QoreEncoding *to, const QoreEncoding *from, ExceptionSink *xsink) : to(to), from(from) {
-#ifdef NEED_ICONV_TRANSLIT
-      QoreString to_code(const_cast<char *>(to->getCode()));
-      to_code.concat("//TRANSLIT");
-      c = iconv_open(to_code.getBuffer(), from->getCode());
-#else
-      c = iconv_open(to->getCode(), from->getCode());
-#endif
-      if (c == (iconv_t) -1) {
-         if (errno == EINVAL) {
-            xsink->raiseException("ENCODING-CONVERSION-ERROR", "cannot convert from \"%s\" to \"%s\"",
-                  from->getCode(), to->getCode());
-         } else {
-            reportUnknownError(xsink);
-         }
-      }
+   DLLLOCAL IconvHelper(const QoreEncoding *to, const QoreEncoding *from, ExceptionSink *xsink) : to(to), from(from), fast(q_get_fast_conversion(to, from)), c((iconv_t) -1) {
+      // descriptors for direct conversions are only opened when input has to be passed to iconv
+      if (!fast)
+         open(xsink);
    }
 
    DLLLOCAL ~IconvHelper() {
       if (c != (iconv_t) -1) {
-         iconv_close(c);
+         q_iconv_put(to, from, c);
       }
    }
 
    DLLLOCAL size_t iconv(char **inbuf, size_t *inavail, char **outbuf, size_t *outavail) {
+      if (fast) {
+         int rc = q_fast_convert(fast, inbuf, inavail, outbuf, outavail);
+         if (!rc)
+            return 0;
+         if (rc == E2BIG) {
+            errno = E2BIG;
+            return (size_t) -1;
+         }
+         if (c == (iconv_t) -1 && open(0))
+            return (size_t) -1;
+      }
       return iconv_adapter(::iconv, c, inbuf, inavail, outbuf, outavail);
    }
 
@@ -78,6 +104,21 @@ public:
    }
 
 private:
+   DLLLOCAL int open(ExceptionSink *xsink) {
+      c = q_iconv_get(to, from);
+      if (c != (iconv_t) -1)
+         return 0;
+      if (xsink) {
+         if (errno == EINVAL) {
+            xsink->raiseException("ENCODING-CONVERSION-ERROR", "cannot convert from \"%s\" to \"%s\"",
+                  from->getCode(), to->getCode());
+         } else {
+            reportUnknownError(xsink);
+         }
+      }
+      return -1;
+   }
+
    // needed for platforms where the input buffer is defined as "const char"
    template<typename T>
    static size_t iconv_adapter(size_t (*iconv_f)(iconv_t, T, size_t *, char **, size_t *), iconv_t handle,
@@ -88,6 +129,7 @@ private:
 private:
    const QoreEncoding *to;
    const QoreEncoding *from;
+   qore_fast_conversion_e fast;
    iconv_t c;
 };
 
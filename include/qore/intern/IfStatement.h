@@ -36,6 +36,8 @@
 #include "qore/intern/AbstractStatement.h"
 
 class IfStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 private:
    class AbstractQoreNode *cond;
    class StatementBlock *if_code;
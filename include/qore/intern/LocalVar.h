@@ -246,6 +246,18 @@ public:
       delete this;
    }
 
+   DLLLOCAL virtual bool scanRef() {
+      AutoLocker al(ref_mutex);
+      if (!references)
+         return false;
+      ++references;
+      return true;
+   }
+
+   DLLLOCAL virtual void scanDeref(ExceptionSink* xsink) {
+      deref(xsink);
+   }
+
    // returns the name of the object
    DLLLOCAL virtual const char* getName() const {
       return id;
@@ -258,16 +270,21 @@ private:
    std::string name;
    bool closure_use, parse_assigned;
    const QoreTypeInfo* typeInfo;
+   // the slot in the local or closure variable frame of the user code that declares the variable; -1 if the variable has no slot
+   /* variables without a slot (top-level variables and "self" in class member initialization) are found by name on the
+      thread-local variable stacks
+   */
+   int slot;
 
    DLLLOCAL LocalVarValue* get_var() const {
-      return thread_find_lvar(name.c_str());
+      return thread_find_lvar(name.c_str(), slot);
    }
 
 public:
-   DLLLOCAL LocalVar(const char* n_name, const QoreTypeInfo* ti) : name(n_name), closure_use(false), parse_assigned(false), typeInfo(ti) {
+   DLLLOCAL LocalVar(const char* n_name, const QoreTypeInfo* ti) : name(n_name), closure_use(false), parse_assigned(false), typeInfo(ti), slot(-1) {
    }
 
-   DLLLOCAL LocalVar(const LocalVar& old) : name(old.name), closure_use(old.closure_use), parse_assigned(old.parse_assigned), typeInfo(old.typeInfo) {
+   DLLLOCAL LocalVar(const LocalVar& old) : name(old.name), closure_use(old.closure_use), parse_assigned(old.parse_assigned), typeInfo(old.typeInfo), slot(old.slot) {
    }
 
    DLLLOCAL ~LocalVar() {
@@ -295,22 +312,22 @@ public:
       //printd(5, "LocalVar::instantiate(%s) this: %p '%s' value closure_use: %s pgm: %p val: %s\n", nval.getTypeName(), this, name.c_str(), closure_use ? "true" : "false", getProgram(), nval.getTypeName());
 
       if (!closure_use) {
-         LocalVarValue* val = thread_instantiate_lvar();
+         LocalVarValue* val = thread_instantiate_lvar(slot);
          val->set(name.c_str(), typeInfo, nval);
       }
       else
-         thread_instantiate_closure_var(name.c_str(), typeInfo, nval);
+         thread_instantiate_closure_var(name.c_str(), typeInfo, nval, slot);
    }
 
    DLLLOCAL void instantiateSelf(QoreObject* value) const {
       //printd(5, "LocalVar::instantiateSelf(%p) this: %p '%s'\n", value, this, name.c_str());
       if (!closure_use) {
-         LocalVarValue* val = thread_instantiate_lvar();
+         LocalVarValue* val = thread_instantiate_lvar(slot);
          val->set(name.c_str(), typeInfo, value, true);
       }
       else {
          QoreValue val(value->refSelf());
-         thread_instantiate_closure_var(name.c_str(), typeInfo, val);
+         thread_instantiate_closure_var(name.c_str(), typeInfo, val, slot);
       }
    }
 
@@ -318,16 +335,16 @@ public:
       //printd(5, "LocalVar::uninstantiate() this: %p '%s' closure_use: %s pgm: %p\n", this, name.c_str(), closure_use ? "true" : "false", getProgram());
 
       if (!closure_use)
-         thread_uninstantiate_lvar(xsink);
+         thread_uninstantiate_lvar(slot, xsink);
       else
-         thread_uninstantiate_closure_var(xsink);
+         thread_uninstantiate_closure_var(slot, xsink);
    }
 
    DLLLOCAL void uninstantiateSelf() const  {
       if (!closure_use)
-         thread_uninstantiate_self();
+         thread_uninstantiate_self(slot);
       else // cannot go out of scope here, so no destructor can be run, so we pass a NULL ExceptionSink ptr
-         thread_uninstantiate_closure_var(0);
+         thread_uninstantiate_closure_var(slot, 0);
    }
 
    DLLLOCAL QoreValue evalValue(bool& needs_deref, ExceptionSink* xsink) const {
@@ -336,7 +353,7 @@ public:
          return val->evalValue(needs_deref, xsink);
       }
 
-      ClosureVarValue* val = thread_find_closure_var(name.c_str());
+      ClosureVarValue* val = getClosureVar();
       return val->evalValue(needs_deref, xsink);
    }
 
@@ -361,8 +378,22 @@ public:
       return closure_use;
    }
 
+   DLLLOCAL void setSlot(int n_slot) {
+      slot = n_slot;
+   }
+
+   DLLLOCAL int getSlot() const {
+      return slot;
+   }
+
+   // returns the current value container of a closure-bound variable
+   DLLLOCAL ClosureVarValue* getClosureVar() const {
+      assert(closure_use);
+      return thread_find_closure_var(name.c_str(), slot);
+   }
+
    DLLLOCAL bool isRef() const {
-      return !closure_use ? get_var()->isRef() : thread_find_closure_var(name.c_str())->isRef();
+      return !closure_use ? get_var()->isRef() : getClosureVar()->isRef();
    }
 
    DLLLOCAL int getLValue(LValueHelper& lvh, bool for_remove) const {
@@ -372,14 +403,14 @@ public:
          return get_var()->getLValue(lvh, for_remove);
       }
 
-      return thread_find_closure_var(name.c_str())->getLValue(lvh, for_remove);
+      return getClosureVar()->getLValue(lvh, for_remove);
    }
 
    DLLLOCAL void remove(LValueRemoveHelper& lvrh) {
       if (!closure_use)
          return get_var()->remove(lvrh, typeInfo);
 
-      return thread_find_closure_var(name.c_str())->remove(lvrh);
+      return getClosureVar()->remove(lvrh);
    }
 
    DLLLOCAL const QoreTypeInfo* getTypeInfo() const {
@@ -391,11 +422,11 @@ public:
    }
 
    DLLLOCAL qore_type_t getValueType() const {
-      return !closure_use ? get_var()->val.getType() : thread_find_closure_var(name.c_str())->val.getType();
+      return !closure_use ? get_var()->val.getType() : getClosureVar()->val.getType();
    }
 
    DLLLOCAL const char* getValueTypeName() const {
-      return !closure_use ? get_var()->val.getTypeName() : thread_find_closure_var(name.c_str())->val.getTypeName();
+      return !closure_use ? get_var()->val.getTypeName() : getClosureVar()->val.getTypeName();
    }
 };
 
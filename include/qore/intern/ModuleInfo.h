@@ -337,6 +337,7 @@ public:
 
 class QoreUserModuleDefContextHelper;
 class QoreUserModule;
+struct QoreModulePreload;
 
 typedef std::set<std::string> strset_t;
 typedef std::map<std::string, strset_t> md_map_t;
@@ -440,6 +441,24 @@ protected:
    // list of module directories
    UniqueDirectoryList moduleDirList;
 
+   // user modules being preloaded: feature name -> TID of the thread loading the module
+   typedef std::map<std::string, int> preload_map_t;
+   preload_map_t preload_map;
+
+   // threads waiting for preloaded modules: TID -> feature name
+   typedef std::map<int, std::string> preload_wait_map_t;
+   preload_wait_map_t preload_wait;
+
+   // user modules parsed by preload threads that have not been set up yet: feature name -> parsed module
+   typedef std::map<std::string, QoreModulePreload*> preload_done_map_t;
+   preload_done_map_t preload_done;
+
+   // signaled when a module has been preloaded
+   QoreCondition preload_cond;
+
+   // the maximum number of threads used to preload modules (0 = preloading is disabled) and the number running
+   unsigned preload_max, preload_threads;
+
    DLLLOCAL QoreAbstractModule* findModuleUnlocked(const char* name) {
       module_map_t::iterator i = map.find(name);
       return i == map.end() ? 0 : i->second;
@@ -458,12 +477,24 @@ protected:
    DLLLOCAL QoreAbstractModule* loadUserModuleFromSource(ExceptionSink& xsink, const char* path, const char* feature, QoreProgram* tpgm, const char* src, bool reexport, QoreProgram* pgm = 0);
    DLLLOCAL QoreAbstractModule* setupUserModule(ExceptionSink& xsink, std::unique_ptr<QoreUserModule>& mi, QoreUserModuleDefContextHelper& qmd, unsigned load_opt = QMLO_NONE);
 
+   // finds the module with the given name in the module path; returns 1 for a binary module, 0 for a user module,
+   // and -1 if not found; the module's path is returned in str
+   DLLLOCAL int findModulePathUnlocked(const char* name, QoreString& str);
+
+   // loads the user modules required by the block of %requires directives starting with the current one in parallel
+   DLLLOCAL void parsePreloadModules(const char* name, QoreProgram* pgm);
+   // waits for the given module to be preloaded by another thread unless this would cause a deadlock
+   DLLLOCAL void waitPreloadUnlocked(const std::string& feature);
+   // sets up a user module parsed by a preload thread in the current thread, which runs the module's init closure;
+   // returns false if the module has not been preloaded from the given path
+   DLLLOCAL bool loadPreloadedUserModule(ExceptionSink& xsink, const char* path, const char* feature, QoreProgram* pgm, bool reexport, QoreAbstractModule*& mi);
+
    DLLLOCAL void reinjectModule(QoreAbstractModule* mi);
    DLLLOCAL void delOrig(QoreAbstractModule* mi);
    DLLLOCAL void getUniqueName(QoreString& nname, const char* name, const char* prefix);
 
 public:
-   DLLLOCAL QoreModuleManager() : mutex(0) {
+   DLLLOCAL QoreModuleManager() : mutex(0), preload_max(0), preload_threads(0) {
    }
 
    DLLLOCAL ~QoreModuleManager() {
@@ -504,6 +535,10 @@ public:
 
    DLLLOCAL void registerUserModuleFromSource(const char* name, const char* src, QoreProgram *pgm, ExceptionSink& xsink);
 
+   // parses a user module into its own Program without holding the module lock; called in preload threads and
+   // takes ownership of the argument; the module is set up when it's loaded by its %requires directive
+   DLLLOCAL void preloadUserModule(QoreModulePreload* mp, bool thread);
+
    DLLLOCAL void trySetUserModuleDependency(const QoreAbstractModule* mi) {
       if (!mi->isUser())
          return;
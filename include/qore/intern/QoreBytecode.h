@@ -0,0 +1,203 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreBytecode.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_INTERN_QOREBYTECODE_H
+#define _QORE_INTERN_QOREBYTECODE_H
+
+#include <vector>
+
+class UserSignature;
+class StatementBlock;
+class QoreValueList;
+
+// bytecode opcodes; "I", "F" and "B" operands are typed registers, "V" operands may hold any value,
+// "K" operands are immediate values stored in the instruction
+enum bc_op_e {
+   BC_LOC,         // set the runtime location to statement x.p
+   BC_JMP,         // jump to b
+   BC_JT,          // jump to b if bool register a is true
+   BC_JF,          // jump to b if bool register a is false
+   BC_JTV,         // jump to b if a evaluates to true
+   BC_JFV,         // jump to b if a evaluates to false
+   BC_JLT_II,      // jump to b if a < c
+   BC_JLE_II,
+   BC_JGT_II,
+   BC_JGE_II,
+   BC_JEQ_II,
+   BC_JNE_II,
+   BC_JLT_IK,      // jump to b if a < x.i
+   BC_JLE_IK,
+   BC_JGT_IK,
+   BC_JGE_IK,
+   BC_JEQ_IK,
+   BC_JNE_IK,
+   BC_LOADI,       // a = x.i
+   BC_LOADF,       // a = x.f
+   BC_LOADB,       // a = (bool)x.i
+   BC_LOADK,       // a = referenced constant node x.p
+   BC_MOVN,        // a = b (typed registers; no reference counting)
+   BC_MOV,         // a = referenced value of b
+   BC_CLEAR,       // dereference a and set it to NOTHING
+   BC_ASSIGN,      // a = value of b checked against type x.p; takes the value from b if c is set
+   BC_ASSIGN_I,    // int register a = value of b checked against type x.p
+   BC_ASSIGN_F,    // float register a = value of b checked against type x.p
+   BC_ASSIGN_B,    // bool register a = value of b checked against type x.p
+   BC_TOINT,       // int register a = b converted to an integer
+   BC_TOFLOAT,     // float register a = b converted to a float
+   BC_TOBOOL,      // bool register a = b converted to a bool
+   BC_I2F,         // float register a = int register b
+   BC_ADD_II,      // a = b + c
+   BC_SUB_II,
+   BC_MUL_II,
+   BC_DIV_II,
+   BC_MOD_II,
+   BC_ADD_IK,      // a = b + x.i
+   BC_SUB_IK,
+   BC_MUL_IK,
+   BC_NEG_I,       // a = -b
+   BC_INC_I,       // ++a
+   BC_DEC_I,       // --a
+   BC_ADD_FF,
+   BC_SUB_FF,
+   BC_MUL_FF,
+   BC_DIV_FF,
+   BC_NEG_F,
+   BC_LT_II,       // bool register a = b < c
+   BC_LE_II,
+   BC_GT_II,
+   BC_GE_II,
+   BC_EQ_II,
+   BC_NE_II,
+   BC_LT_FF,
+   BC_LE_FF,
+   BC_GT_FF,
+   BC_GE_FF,
+   BC_EQ_FF,
+   BC_NE_FF,
+   BC_NOT_B,       // a = !b
+   BC_ADD_VV,      // a = b + c with the semantics of the + operator
+   BC_SUB_VV,
+   BC_MUL_VV,
+   BC_DIV_VV,
+   BC_LT_VV,
+   BC_LE_VV,
+   BC_GT_VV,
+   BC_GE_VV,
+   BC_EQ_VV,
+   BC_NE_VV,
+   BC_AEQ_VV,      // a = b === c
+   BC_ANE_VV,      // a = b !== c
+   BC_PLUSEQ_V,    // a += b for string, list and hash registers; x.p is the type of a
+   BC_HGET,        // a = b.c
+   BC_HSET,        // hash register a.b = referenced value of c
+   BC_SQB,         // a = b[c]
+   BC_LIST,        // a = new list of the c values in the registers listed in the argument table at b
+   BC_HASH,        // a = new hash of the c key/value register pairs listed in the argument table at b
+   BC_ELEMENTS,    // int register a = elements b
+   BC_CALL,        // a = call of function call node x.p with c arguments in the registers listed in the argument table at b
+   BC_FE_NEXT,     // a = next element of the list in b at int register index c checked against type x.p and skip the next
+                   // instruction; if there are no more elements, continue with the next instruction
+   BC_RET,         // return the value of a
+   BC_RETN         // return NOTHING
+};
+
+// register kinds; typed registers always hold a value of the given type when read
+enum bc_kind_e {
+   BK_VALUE = 0,
+   BK_INT,
+   BK_FLOAT,
+   BK_BOOL
+};
+
+struct QoreBytecodeInstr {
+   bc_op_e op;
+   unsigned a, b, c;
+   union {
+      int64 i;
+      double f;
+      const void* p;
+   } x;
+};
+
+// a user function body compiled for the bytecode virtual machine
+/* function bodies are compiled only if they consist entirely of supported statements and expressions
+   and only reference local variables that are not used in closures; local variables are stored in
+   registers instead of on the thread-local variable stack, and int, float, and bool variables that are
+   always assigned before use are stored in typed registers
+*/
+class QoreBytecode {
+   friend class QoreBytecodeCompiler;
+
+protected:
+   typedef std::vector<QoreBytecodeInstr> code_vec_t;
+   typedef std::vector<unsigned char> kind_vec_t;
+
+   // the instructions
+   code_vec_t code;
+   // the kinds of all registers; the first registers hold the parameters
+   kind_vec_t kinds;
+   // the argument registers of all function calls and list and hash constructors
+   std::vector<unsigned> args;
+   // number of parameters
+   unsigned nparams;
+   // the parse options for all statements in the body
+   int64 po;
+   // the return type of the function
+   const QoreTypeInfo* returnTypeInfo;
+
+   DLLLOCAL QoreBytecode() : nparams(0), po(0), returnTypeInfo(0) {
+   }
+
+   DLLLOCAL QoreValue run(QoreValue* r, ExceptionSink* xsink) const;
+
+public:
+   // returns a new object if the body can be compiled, otherwise 0
+   DLLLOCAL static QoreBytecode* compile(const UserSignature& sig, StatementBlock* body);
+
+   // returns true if the given arguments can be used with the compiled code
+   /* the caller must fall back to the tree-walking interpreter if false is returned, which happens when
+      arguments are passed by reference or do not match the types of typed registers
+   */
+   DLLLOCAL bool acceptsArgs(const QoreValueList* args) const;
+
+   // executes the compiled code with the given arguments
+   DLLLOCAL QoreValue exec(const QoreValueList* args, ExceptionSink* xsink) const;
+
+   DLLLOCAL unsigned size() const {
+      return code.size();
+   }
+
+   DLLLOCAL unsigned numRegisters() const {
+      return kinds.size();
+   }
+};
+
+#endif
@@ -1843,6 +1843,8 @@ public:
       methodID;                     // for subclasses of builtin classes that will not have their own private data,
                                     // instead they will get the private data from this class
 
+   int serial;                      // unique for each class object (copies share the class ID), used for inline caches
+
    bool sys : 1,                        // system/builtin class?
       initialized : 1,                  // is initialized? (only performed once)
       parse_init_called : 1,            // has parseInit() been called? (performed once for each parseCommit())
@@ -1857,7 +1859,8 @@ public:
       owns_ornothingtypeinfo : 1,       // do we own the "or nothing" type info
       pub : 1,                          // is a public class (modules only)
       final : 1,                        // is the class "final" (cannot be inherited)
-      inject : 1                        // has the class been injected
+      inject : 1,                       // has the class been injected
+      committed : 1                     // has the class been committed
       ;
 
    int64 domain;                    // capabilities of builtin class to use in the context of parse restrictions
@@ -1888,6 +1891,9 @@ public:
    // pointer to owning program for imported classes
    QoreProgram* spgm;
 
+   // member layout of the first object constructed, shared by objects with the same members in the same order
+   mutable std::atomic<QoreHashShape*> member_shape;
+
    DLLLOCAL qore_class_private(QoreClass* n_cls, const char* nme, int64 dom = QDOM_DEFAULT, QoreTypeInfo* n_typeinfo = 0);
 
    // only called while the parse lock for the QoreProgram owning "old" is held
@@ -3314,4 +3320,8 @@ public:
    }
 };
 
+inline InlineCacheKey::InlineCacheKey(const qore_class_private* n_cls, const qore_class_private* n_ctx)
+   : cls(n_cls), cls_serial(n_cls->serial), ctx(n_ctx), ctx_serial(n_ctx ? n_ctx->serial : 0) {
+}
+
 #endif
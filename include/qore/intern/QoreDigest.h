@@ -0,0 +1,108 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreDigest.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QOREDIGEST_H
+#define _QORE_QOREDIGEST_H
+
+#include "qore/Transform.h"
+
+#include <openssl/evp.h>
+
+#include <string>
+
+// private data for the Digest and Hmac classes: an incremental message digest or HMAC calculated with an OpenSSL EVP
+// context; data is passed to OpenSSL directly from the caller's buffer
+class QoreDigest : public AbstractPrivateData {
+public:
+   // creates a digest with the given algorithm name (ex: "sha256")
+   DLLLOCAL QoreDigest(const char* alg, ExceptionSink* xsink);
+
+   // creates an HMAC with the given algorithm name and key; the key may be empty
+   DLLLOCAL QoreDigest(const char* alg, const void* key, size_t key_len, ExceptionSink* xsink);
+
+   // creates a copy of the digest including its current state
+   DLLLOCAL QoreDigest(const QoreDigest& old, ExceptionSink* xsink);
+
+   // adds data to the digest
+   DLLLOCAL int update(const void* ptr, size_t len, ExceptionSink* xsink);
+
+   // finishes the calculation and returns the digest; further updates are only possible after reset()
+   DLLLOCAL BinaryNode* finalize(ExceptionSink* xsink);
+
+   // starts a new calculation with the same algorithm and key
+   DLLLOCAL int reset(ExceptionSink* xsink);
+
+   // returns a Transform that passes data through unchanged and adds it to the digest
+   DLLLOCAL Transform* getTransform();
+
+   // returns the algorithm name as given in the constructor
+   DLLLOCAL const char* getAlgorithm() const {
+      return alg.c_str();
+   }
+
+   // returns the size of the digest in bytes
+   DLLLOCAL int size() const {
+      return EVP_MD_size(md);
+   }
+
+   // returns the exception code for errors
+   DLLLOCAL const char* getErr() const {
+      return hmac ? "HMAC-ERROR" : "DIGEST-ERROR";
+   }
+
+protected:
+   DLLLOCAL virtual ~QoreDigest();
+
+private:
+   // the algorithm name
+   std::string alg;
+   // the digest algorithm
+   const EVP_MD* md;
+   // true if an HMAC is calculated
+   bool hmac;
+   // the HMAC key
+   std::string key;
+   EVP_PKEY* pkey;
+   // the digest context
+   EVP_MD_CTX* ctx;
+   // true after finalize() has been called
+   bool done;
+   // the digest can be updated from a stream in another thread
+   mutable QoreThreadLock m;
+
+   // creates the HMAC key object from the key
+   DLLLOCAL int initKey(ExceptionSink* xsink);
+
+   // initializes the context; must be called with the lock held or from the constructor
+   DLLLOCAL int init(ExceptionSink* xsink);
+};
+
+#endif // _QORE_QOREDIGEST_H
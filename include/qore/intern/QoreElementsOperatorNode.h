@@ -61,6 +61,8 @@ public:
    DLLLOCAL virtual QoreOperatorNode* copyBackground(ExceptionSink* xsink) const {
       return copyBackgroundExplicit<QoreElementsOperatorNode>(xsink);
    }
+
+   DLLLOCAL static int64 getElements(QoreValue v, ExceptionSink* xsink);
 };
 
 #endif
@@ -39,6 +39,8 @@ extern QoreClass* QC_HASHLISTITERATOR;
 class QoreHashListIterator : public QoreIteratorBase {
 protected:
    QoreHashNode* h;
+   // empty hash with the keys of "h" used to create rows sharing the same key layout; created on demand
+   mutable QoreHashNode* row_shape;
    qore_offset_t i, limit;
    bool is_list;
 
@@ -73,7 +75,7 @@ protected:
    }
 
 public:
-   DLLLOCAL QoreHashListIterator(const QoreHashNode* n_h) : h(n_h->hashRefSelf()), i(-1), limit(0), is_list(false) {
+   DLLLOCAL QoreHashListIterator(const QoreHashNode* n_h) : h(n_h->hashRefSelf()), row_shape(0), i(-1), limit(0), is_list(false) {
       if (h->empty())
          return;
       // use an iterator for quick access to the first key in the hash
@@ -89,10 +91,10 @@ public:
          limit = 1;
    }
 
-   DLLLOCAL QoreHashListIterator() : h(0), i(-1), limit(0), is_list(false) {
+   DLLLOCAL QoreHashListIterator() : h(0), row_shape(0), i(-1), limit(0), is_list(false) {
    }
 
-   DLLLOCAL QoreHashListIterator(const QoreHashListIterator& old) : h(old.h ? old.h->hashRefSelf() : 0), i(old.i), limit(old.limit), is_list(old.is_list) {
+   DLLLOCAL QoreHashListIterator(const QoreHashListIterator& old) : h(old.h ? old.h->hashRefSelf() : 0), row_shape(0), i(old.i), limit(old.limit), is_list(old.is_list) {
    }
 
    DLLLOCAL void reset() {
@@ -105,6 +107,8 @@ public:
       if (ROdereference()) {
          if (h)
             h->deref(xsink);
+         if (row_shape)
+            row_shape->deref(xsink);
          delete this;
       }
    }
@@ -180,15 +184,21 @@ public:
       if (!is_list)
          return h->hashRefSelf();
 
-      ReferenceHolder<QoreHashNode> rv(new QoreHashNode, xsink);
+      // all rows share the key layout of the source hash
+      if (!row_shape)
+         row_shape = h->copyShape();
+      ReferenceHolder<QoreHashNode> rv(row_shape->copyShape(), xsink);
 
       ConstHashIterator hi(h);
+      HashIterator ri(*rv);
       while (hi.next()) {
+         ri.next();
          AbstractQoreNode* n = const_cast<AbstractQoreNode*>(hi.getValue());
          n = getReferencedValueIntern(n, hi.getKey(), xsink);
          if (*xsink)
             return 0;
-         rv->setKeyValue(hi.getKey(), n, xsink);
+         HashAssignmentHelper ha(ri);
+         ha.assign(n, xsink);
          // cannot have an exception here
          assert(!*xsink);
       }
@@ -33,58 +33,352 @@
 
 #define _QORE_QOREHASHNODEINTERN_H
 
-#include <qore/qlist>
+#include "qore/intern/xxhash.h"
+
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+
+// hashes with up to this many members are searched linearly; larger hashes get an open-addressing index
+#ifndef QORE_HASH_LINEAR_MAX
+#define QORE_HASH_LINEAR_MAX 8
+#endif
 
 // to maintain the order of inserts
+// members are allocated individually so that value pointers stay stable while the hash grows
 class HashMember {
 public:
-   AbstractQoreNode* node;
+   // value storage for members created with the hash
+   AbstractQoreNode* val;
+   // the value; refers to val or to a slot of the value vector of a former shared key layout (see qore_hash_private::unshape())
+   AbstractQoreNode*& node;
+   // keys up to the std::string SSO size are stored inline
    std::string key;
+   // cached key hash
+   unsigned hash;
+   // position in the ordered member vector
+   unsigned pos;
 
-   DLLLOCAL HashMember(const char* n_key) : node(0), key(n_key) {
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
+   }
+
+   DLLLOCAL HashMember(const char* n_key, size_t n_len, unsigned n_hash) : val(0), node(val), key(n_key, n_len), hash(n_hash), pos(0) {
+   }
+
+   // creates a member whose value is stored in the given slot
+   DLLLOCAL HashMember(const char* n_key, size_t n_len, unsigned n_hash, AbstractQoreNode** slot) : val(0), node(*slot), key(n_key, n_len), hash(n_hash), pos(0) {
    }
 
    DLLLOCAL ~HashMember() {
    }
 };
 
-typedef qlist<HashMember*> qhlist_t;
+// ordered member vector; deleted members leave a 0 entry until the vector is compacted
+typedef std::vector<HashMember*> qhlist_t;
 
-#ifdef HAVE_QORE_HASH_MAP
-//#warning compiling with hash_map
-#include <qore/hash_map_include.h>
-#include "qore/intern/xxhash.h"
+class qore_hash_private;
 
-typedef HASH_MAP<const char*, qhlist_t::iterator, qore_hash_str, eqstr> hm_hm_t;
-#else
-typedef std::map<const char*, qhlist_t::iterator, ltstr> hm_hm_t;
-#endif
+// immutable, reference-counted key layout shared by hashes with the same keys in the same order
+// (ex: rows created by row-oriented APIs); such hashes only store a value vector
+class QoreHashShape : public QoreReferenceCounter {
+public:
+   // keys in insertion order
+   std::vector<std::string> keys;
+   // cached key hashes
+   std::vector<unsigned> hashes;
+   // open-addressing index of key positions + 1; only used for shapes with more than QORE_HASH_LINEAR_MAX keys
+   unsigned* index = 0;
+   unsigned index_mask = 0;
+
+   // creates a shape from the keys of the given hash
+   DLLLOCAL QoreHashShape(const qore_hash_private& h);
+
+   DLLLOCAL ~QoreHashShape() {
+      free(index);
+   }
+
+   DLLLOCAL unsigned size() const {
+      return keys.size();
+   }
+
+   // returns the position of the key or -1 if not present
+   DLLLOCAL int find(const char* key, size_t klen, unsigned h) const {
+      if (!index) {
+         for (unsigned i = 0, e = keys.size(); i < e; ++i) {
+            if (hashes[i] == h && keys[i].size() == klen && !memcmp(keys[i].data(), key, klen))
+               return i;
+         }
+         return -1;
+      }
+
+      for (unsigned slot = h & index_mask; index[slot]; slot = (slot + 1) & index_mask) {
+         unsigned i = index[slot] - 1;
+         if (hashes[i] == h && keys[i].size() == klen && !memcmp(keys[i].data(), key, klen))
+            return i;
+      }
+      return -1;
+   }
+
+   DLLLOCAL void ref() const {
+      ROreference();
+   }
+
+   DLLLOCAL void deref() {
+      if (ROdereference())
+         delete this;
+   }
+};
 
 class qore_hash_private {
 public:
    qhlist_t member_list;
-   hm_hm_t hm;
+   // open-addressing index with linear probing; entries are member_list positions + 1, 0 = empty
+   unsigned* index = 0;
+   // index capacity - 1 (the capacity is always a power of 2)
+   unsigned index_mask = 0;
+   // number of live members
+   unsigned len = 0;
    unsigned obj_count = 0;
+   // shared key layout; if set, values are stored in shape_values in shape key order and member_list is empty
+   QoreHashShape* shape = 0;
+   AbstractQoreNode** shape_values = 0;
+   // the value vector of a former shared key layout; kept until the members are deleted because the members created by
+   // unshape() store their values in it, so that value pointers handed out before stay valid
+   AbstractQoreNode** unshaped_values = 0;
 #ifdef DEBUG
    bool is_obj = false;
 #endif
 
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
+   }
+
    DLLLOCAL qore_hash_private() {
    }
 
    // hashes should always be empty by the time they are deleted
    // because object destructors need to be run...
    DLLLOCAL ~qore_hash_private() {
-      assert(member_list.empty());
+      assert(!len);
+      assert(!shape);
+      free(index);
+      free(unshaped_values);
+   }
+
+   // sets the shared key layout for an empty hash; all keys are assigned NOTHING
+   DLLLOCAL void setShape(QoreHashShape* s) {
+      assert(!len && !shape);
+      s->ref();
+      shape = s;
+      len = s->size();
+      shape_values = (AbstractQoreNode**)calloc(len ? len : 1, sizeof(AbstractQoreNode*));
+   }
+
+   // converts a hash with a shared key layout to a normal hash; called before keys are added or removed
+   /** the values stay in place: the new members refer to the slots of the old value vector
+    */
+   DLLLOCAL void unshape() {
+      assert(shape);
+      assert(!unshaped_values);
+      QoreHashShape* s = shape;
+      unshaped_values = shape_values;
+      shape = 0;
+      shape_values = 0;
+      len = 0;
+
+      reserve(s->size());
+      for (unsigned i = 0, e = s->size(); i < e; ++i)
+         insert(s->keys[i].data(), s->keys[i].size(), s->hashes[i], &unshaped_values[i]);
+
+      s->deref();
+   }
+
+   // converts a normal hash to the given shared key layout if it has exactly the same keys in the same order;
+   // returns true if the layout was adopted
+   /** value pointers are not preserved, so this may only be called when no value pointers are in use (ex: for an
+       object's members after construction while holding the object's write lock)
+    */
+   DLLLOCAL bool adoptShape(QoreHashShape* s) {
+      if (shape || len != s->size())
+         return false;
+
+      unsigned j = 0;
+      for (qhlist_t::const_iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+         if (!*i)
+            continue;
+         if ((*i)->hash != s->hashes[j] || (*i)->key != s->keys[j])
+            return false;
+         ++j;
+      }
+
+      AbstractQoreNode** v = (AbstractQoreNode**)malloc((len ? len : 1) * sizeof(AbstractQoreNode*));
+      j = 0;
+      for (qhlist_t::iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+         if (!*i)
+            continue;
+         v[j++] = (*i)->node;
+         delete *i;
+      }
+      qhlist_t().swap(member_list);
+      free(index);
+      index = 0;
+      index_mask = 0;
+      free(unshaped_values);
+      unshaped_values = 0;
+
+      s->ref();
+      shape = s;
+      shape_values = v;
+      return true;
    }
 
-   DLLLOCAL int64 getKeyAsBigInt(const char* key, bool &found) const {
+   // returns a pointer to the value of the given key or 0 if the key is not present
+   DLLLOCAL AbstractQoreNode** findValuePtr(const char* key) const {
       assert(key);
-      hm_hm_t::const_iterator i = hm.find(key);
+      size_t klen = strlen(key);
+      unsigned h = hashKey(key, klen);
+      if (shape) {
+         int i = shape->find(key, klen, h);
+         return i < 0 ? 0 : &shape_values[i];
+      }
 
-      if (i != hm.end()) {
+      HashMember* m = find(key, klen, h);
+      return m ? &m->node : 0;
+   }
+
+   // returns a pointer to the value of the given key, creating the key if necessary
+   DLLLOCAL AbstractQoreNode** findCreateValuePtr(const char* key) {
+      if (shape) {
+         AbstractQoreNode** vp = findValuePtr(key);
+         if (vp)
+            return vp;
+         unshape();
+      }
+      return &findCreateMember(key)->node;
+   }
+
+   DLLLOCAL static unsigned hashKey(const char* key, size_t klen) {
+      return XXH32(key, klen, 0);
+   }
+
+   // returns the live member for the given key or 0 if not present
+   DLLLOCAL HashMember* find(const char* key, size_t klen, unsigned h) const {
+      if (!index) {
+         for (qhlist_t::const_iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+            if (*i && (*i)->hash == h && (*i)->key.size() == klen && !memcmp((*i)->key.data(), key, klen))
+               return *i;
+         }
+         return 0;
+      }
+
+      for (unsigned slot = h & index_mask; index[slot]; slot = (slot + 1) & index_mask) {
+         HashMember* m = member_list[index[slot] - 1];
+         assert(m);
+         if (m->hash == h && m->key.size() == klen && !memcmp(m->key.data(), key, klen))
+            return m;
+      }
+      return 0;
+   }
+
+   DLLLOCAL HashMember* find(const char* key) const {
+      assert(key);
+      size_t klen = strlen(key);
+      return find(key, klen, hashKey(key, klen));
+   }
+
+   DLLLOCAL void indexInsert(HashMember* m) {
+      unsigned slot = m->hash & index_mask;
+      while (index[slot])
+         slot = (slot + 1) & index_mask;
+      index[slot] = m->pos + 1;
+   }
+
+   // removes the member from the index with backward-shift deletion so no tombstones are needed
+   DLLLOCAL void indexRemove(HashMember* m) {
+      unsigned slot = m->hash & index_mask;
+      while (index[slot] != m->pos + 1) {
+         assert(index[slot]);
+         slot = (slot + 1) & index_mask;
+      }
+
+      unsigned hole = slot;
+      while (true) {
+         slot = (slot + 1) & index_mask;
+         if (!index[slot])
+            break;
+         unsigned home = member_list[index[slot] - 1]->hash & index_mask;
+         // move the entry back if its home slot is not cyclically in (hole, slot]
+         if ((slot > hole) ? (home <= hole || home > slot) : (home <= hole && home > slot)) {
+            index[hole] = index[slot];
+            hole = slot;
+         }
+      }
+      index[hole] = 0;
+   }
+
+   // (re)builds the index for the current member vector with at least the given capacity
+   DLLLOCAL void rebuildIndex(unsigned cap) {
+      free(index);
+      index = (unsigned*)calloc(cap, sizeof(unsigned));
+      index_mask = cap - 1;
+      for (qhlist_t::iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+         if (*i)
+            indexInsert(*i);
+      }
+   }
+
+   // removes deleted entries from the member vector and updates member positions
+   DLLLOCAL void compact() {
+      unsigned j = 0;
+      for (unsigned i = 0, e = member_list.size(); i < e; ++i) {
+         HashMember* m = member_list[i];
+         if (!m)
+            continue;
+         m->pos = j;
+         member_list[j++] = m;
+      }
+      member_list.resize(j);
+      if (index)
+         rebuildIndex(index_mask + 1);
+   }
+
+   DLLLOCAL HashMember* insert(const char* key, size_t klen, unsigned h, AbstractQoreNode** slot = 0) {
+      HashMember* om = slot ? new HashMember(key, klen, h, slot) : new HashMember(key, klen, h);
+      om->pos = member_list.size();
+      member_list.push_back(om);
+      ++len;
+
+      if (index) {
+         // keep the load factor under 3/4
+         if ((len * 4) > (index_mask + 1) * 3)
+            rebuildIndex((index_mask + 1) * 2);
+         else
+            indexInsert(om);
+      }
+      else if (len > QORE_HASH_LINEAR_MAX)
+         rebuildIndex(QORE_HASH_LINEAR_MAX * 4);
+
+      return om;
+   }
+
+   DLLLOCAL int64 getKeyAsBigInt(const char* key, bool &found) const {
+      AbstractQoreNode** vp = findValuePtr(key);
+
+      if (vp) {
          found = true;
-         return (*(i->second))->node ? (*(i->second))->node->getAsBigInt() : 0;
+         return *vp ? (*vp)->getAsBigInt() : 0;
       }
 
       found = false;
@@ -92,12 +386,11 @@ public:
    }
 
    DLLLOCAL bool getKeyAsBool(const char* key, bool& found) const {
-      assert(key);
-      hm_hm_t::const_iterator i = hm.find(key);
+      AbstractQoreNode** vp = findValuePtr(key);
 
-      if (i != hm.end()) {
+      if (vp) {
          found = true;
-         return (*(i->second))->node ? (*(i->second))->node->getAsBool() : false;
+         return *vp ? (*vp)->getAsBool() : false;
       }
 
       found = false;
@@ -105,116 +398,159 @@ public:
    }
 
    DLLLOCAL bool existsKey(const char* key) const {
-      assert(key);
-      return hm.find(key) != hm.end();
+      return findValuePtr(key) != 0;
    }
 
    DLLLOCAL bool existsKeyValue(const char* key) const {
-      assert(key);
-      hm_hm_t::const_iterator i = hm.find(key);
-      if (i == hm.end())
+      AbstractQoreNode** vp = findValuePtr(key);
+      if (!vp)
          return false;
-      return !is_nothing((*(i->second))->node);
+      return !is_nothing(*vp);
    }
 
    DLLLOCAL HashMember* findMember(const char* key) {
-      assert(key);
-      hm_hm_t::iterator i = hm.find(key);
-      return i != hm.end() ? (*(i->second)) : 0;
+      if (shape)
+         unshape();
+      return find(key);
    }
 
    DLLLOCAL HashMember* findCreateMember(const char* key) {
-      // otherwise create the new hash entry
-      HashMember* om = findMember(key);
+      assert(key);
+      if (shape)
+         unshape();
+      size_t klen = strlen(key);
+      unsigned h = hashKey(key, klen);
+
+      HashMember* om = find(key, klen, h);
       if (om)
-	 return om;
+         return om;
 
-      om = new HashMember(key);
-      member_list.push_back(om);
+      // otherwise create the new hash entry
+      return insert(key, klen, h);
+   }
 
-      // add to the map
-      qhlist_t::iterator i = member_list.end();
-      --i;
-      hm[om->key.c_str()] = i;
+   DLLLOCAL AbstractQoreNode **getKeyValuePtr(const char* key) {
+      return findCreateValuePtr(key);
+   }
 
-      // return the new member
-      return om;
+   // returns the first live member at or after the given position or 0 if there is none
+   DLLLOCAL HashMember* nextMember(size_t pos) const {
+      for (size_t e = member_list.size(); pos < e; ++pos) {
+         if (member_list[pos])
+            return member_list[pos];
+      }
+      return 0;
    }
 
-   DLLLOCAL AbstractQoreNode **getKeyValuePtr(const char* key) {
-      return &findCreateMember(key)->node;
+   // returns the last live member before the given position or 0 if there is none
+   DLLLOCAL HashMember* prevMember(size_t pos) const {
+      while (pos) {
+         if (member_list[--pos])
+            return member_list[pos];
+      }
+      return 0;
+   }
+
+   DLLLOCAL HashMember* firstMember() const {
+      return nextMember(0);
+   }
+
+   DLLLOCAL HashMember* lastMember() const {
+      return prevMember(member_list.size());
    }
 
    // NOTE: does not delete the value, this must be done by the caller before this call
-   // also does not delete map entry; must be done outside this call
-   DLLLOCAL void internDeleteKey(qhlist_t::iterator i) {
-      HashMember* om = *i;
+   DLLLOCAL void internDeleteKey(HashMember* om) {
+      assert(member_list[om->pos] == om);
 
-      member_list.erase(i);
+      if (index)
+         indexRemove(om);
+
+      if (!--len) {
+         member_list.clear();
+         free(index);
+         index = 0;
+         index_mask = 0;
+      }
+      else if (om->pos == member_list.size() - 1) {
+         // drop trailing deleted entries so the last member can be found immediately
+         member_list.pop_back();
+         while (!member_list.back())
+            member_list.pop_back();
+      }
+      else {
+         member_list[om->pos] = 0;
+         // compact the member vector if it's more than half empty
+         if (member_list.size() - len > len && member_list.size() > QORE_HASH_LINEAR_MAX)
+            compact();
+      }
 
       // free om memory
       delete om;
    }
 
    DLLLOCAL void deleteKey(const char* key, ExceptionSink *xsink) {
-      assert(key);
+      if (shape) {
+         if (!findValuePtr(key))
+            return;
+         unshape();
+      }
 
-      hm_hm_t::iterator i = hm.find(key);
+      HashMember* m = find(key);
 
-      if (i == hm.end())
+      if (!m)
          return;
 
-      qhlist_t::iterator li = i->second;
-      hm.erase(i);
-
       // dereference node if present
-      if ((*li)->node) {
-         if (needs_scan((*li)->node))
+      if (m->node) {
+         if (needs_scan(m->node))
             incScanCount(-1);
 
-         if ((*li)->node->getType() == NT_OBJECT)
-            reinterpret_cast<QoreObject*>((*li)->node)->doDelete(xsink);
-         (*li)->node->deref(xsink);
+         if (m->node->getType() == NT_OBJECT)
+            reinterpret_cast<QoreObject*>(m->node)->doDelete(xsink);
+         m->node->deref(xsink);
       }
 
-      internDeleteKey(li);
+      internDeleteKey(m);
    }
 
    // removes the value and dereferences it, without performing a delete on it
    DLLLOCAL void removeKey(const char* key, ExceptionSink *xsink) {
-      assert(key);
+      if (shape) {
+         if (!findValuePtr(key))
+            return;
+         unshape();
+      }
 
-      hm_hm_t::iterator i = hm.find(key);
+      HashMember* m = find(key);
 
-      if (i == hm.end())
+      if (!m)
          return;
 
-      qhlist_t::iterator li = i->second;
-      hm.erase(i);
-
       // dereference node if present
-      if ((*li)->node) {
-         if (needs_scan((*li)->node))
+      if (m->node) {
+         if (needs_scan(m->node))
             incScanCount(-1);
-         (*li)->node->deref(xsink);
+         m->node->deref(xsink);
       }
 
-      internDeleteKey(li);
+      internDeleteKey(m);
    }
 
    DLLLOCAL AbstractQoreNode *takeKeyValue(const char* key) {
-      assert(key);
+      if (shape) {
+         if (!findValuePtr(key))
+            return 0;
+         unshape();
+      }
 
-      hm_hm_t::iterator i = hm.find(key);
+      HashMember* m = find(key);
 
-      if (i == hm.end())
+      if (!m)
          return 0;
 
-      qhlist_t::iterator li = i->second;
-      hm.erase(i);
-
-      AbstractQoreNode *rv = (*li)->node;
-      internDeleteKey(li);
+      AbstractQoreNode *rv = m->node;
+      internDeleteKey(m);
 
       if (needs_scan(rv))
          incScanCount(-1);
@@ -223,43 +559,127 @@ public:
    }
 
    DLLLOCAL const char* getFirstKey() const  {
-      return member_list.empty() ? 0 : member_list.front()->key.c_str();
+      if (shape)
+         return len ? shape->keys[0].c_str() : 0;
+      HashMember* m = firstMember();
+      return m ? m->key.c_str() : 0;
    }
 
    DLLLOCAL const char* getLastKey() const {
-      return member_list.empty() ? 0 : member_list.back()->key.c_str();
+      if (shape)
+         return len ? shape->keys[len - 1].c_str() : 0;
+      HashMember* m = lastMember();
+      return m ? m->key.c_str() : 0;
    }
 
    DLLLOCAL QoreListNode* getKeys() const {
       QoreListNode* list = new QoreListNode;
 
+      if (shape) {
+         for (unsigned i = 0; i < len; ++i)
+            list->push(new QoreStringNode(shape->keys[i]));
+         return list;
+      }
+
       for (qhlist_t::const_iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
-         list->push(new QoreStringNode((*i)->key));
+         if (*i)
+            list->push(new QoreStringNode((*i)->key));
       }
       return list;
    }
 
    DLLLOCAL void merge(const qore_hash_private& h, ExceptionSink* xsink) {
+      if (h.shape) {
+         for (unsigned i = 0; i < h.len; ++i)
+            setKeyValue(h.shape->keys[i], h.shape_values[i] ? h.shape_values[i]->refSelf() : 0, xsink);
+         return;
+      }
+
       for (qhlist_t::const_iterator i = h.member_list.begin(), e = h.member_list.end(); i != e; ++i) {
-         setKeyValue((*i)->key, (*i)->node ? (*i)->node->refSelf() : 0, xsink);
+         if (*i)
+            setKeyValue((*i)->key, (*i)->node ? (*i)->node->refSelf() : 0, xsink);
       }
    }
 
+   // presizes the member vector and index for the given number of members
+   DLLLOCAL void reserve(unsigned size) {
+      member_list.reserve(size);
+      if (size > QORE_HASH_LINEAR_MAX && (!index || (size * 4) > (index_mask + 1) * 3)) {
+         unsigned cap = QORE_HASH_LINEAR_MAX * 4;
+         while ((size * 4) > cap * 3)
+            cap <<= 1;
+         rebuildIndex(cap);
+      }
+   }
+
+   // creates a new hash sharing the given key layout with all values set to NOTHING
+   DLLLOCAL static QoreHashNode* newHash(QoreHashShape* s) {
+      QoreHashNode* h = new QoreHashNode;
+      h->priv->setShape(s);
+      return h;
+   }
+
+   // assigns a value by position in a hash with a shared key layout
+   DLLLOCAL void setShapeValue(unsigned i, AbstractQoreNode* val, ExceptionSink* xsink) {
+      assert(shape);
+      assert(i < len);
+      hash_assignment_priv ha(*this, &shape_values[i]);
+      ha.assign(val, xsink);
+   }
+
+   // returns a new hash with the same keys sharing this hash's key layout, creating the layout if necessary
+   DLLLOCAL QoreHashNode* copyShape() const {
+      if (shape)
+         return newHash(shape);
+
+      QoreHashShape* s = new QoreHashShape(*this);
+      QoreHashNode* h = newHash(s);
+      s->deref();
+      return h;
+   }
+
    DLLLOCAL QoreHashNode* copy() const {
+      if (shape) {
+         QoreHashNode* h = newHash(shape);
+         for (unsigned i = 0; i < len; ++i) {
+            if (shape_values[i])
+               h->priv->shape_values[i] = shape_values[i]->refSelf();
+         }
+         h->priv->obj_count = obj_count;
+         return h;
+      }
+
       QoreHashNode* h = new QoreHashNode;
+      h->priv->reserve(len);
 
       // copy all members to new object
       for (qhlist_t::const_iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
          //printd(5, "QoreHashNode::copy() this: %p node: %p key='%s'\n", this, where->node, where->key);
-         h->setKeyValue((*i)->key, (*i)->node ? (*i)->node->refSelf() : 0, 0);
+         if (*i)
+            h->setKeyValue((*i)->key, (*i)->node ? (*i)->node->refSelf() : 0, 0);
       }
       return h;
    }
 
    DLLLOCAL AbstractQoreNode* evalImpl(ExceptionSink* xsink) const {
+      if (shape) {
+         QoreHashNodeHolder h(newHash(shape), xsink);
+         for (unsigned i = 0; i < len; ++i) {
+            if (!shape_values[i])
+               continue;
+            h->priv->setShapeValue(i, shape_values[i]->eval(xsink), 0);
+            if (*xsink)
+               return 0;
+         }
+         return h.release();
+      }
+
       QoreHashNodeHolder h(new QoreHashNode(), xsink);
+      h->priv->reserve(len);
 
       for (qhlist_t::const_iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+         if (!*i)
+            continue;
          h->setKeyValue((*i)->key, (*i)->node ? (*i)->node->eval(xsink) : 0, 0);
          if (*xsink)
             return 0;
@@ -279,14 +699,33 @@ public:
    }
 
    DLLLOCAL bool derefImpl(ExceptionSink* xsink, bool reverse = false) {
+      if (shape) {
+         for (unsigned i = 0; i < len; ++i) {
+            AbstractQoreNode* n = shape_values[reverse ? len - i - 1 : i];
+            if (n)
+               n->deref(xsink);
+         }
+         free(shape_values);
+         shape_values = 0;
+         shape->deref();
+         shape = 0;
+         len = 0;
+         obj_count = 0;
+         return true;
+      }
+
       if (reverse) {
          for (qhlist_t::reverse_iterator i = member_list.rbegin(), e = member_list.rend(); i != e; ++i) {
+            if (!*i)
+               continue;
             if ((*i)->node)
                (*i)->node->deref(xsink);
             delete *i;
          }
       } else {
          for (qhlist_t::iterator i = member_list.begin(), e = member_list.end(); i != e; ++i) {
+            if (!*i)
+               continue;
             if ((*i)->node)
                (*i)->node->deref(xsink);
             delete *i;
@@ -294,7 +733,12 @@ public:
       }
 
       member_list.clear();
-      hm.clear();
+      free(index);
+      index = 0;
+      index_mask = 0;
+      free(unshaped_values);
+      unshaped_values = 0;
+      len = 0;
       obj_count = 0;
       return true;
    }
@@ -311,11 +755,11 @@ public:
    }
 
    DLLLOCAL size_t size() const {
-      return member_list.size();
+      return len;
    }
 
    DLLLOCAL bool empty() const {
-      return member_list.empty();
+      return !len;
    }
 
    DLLLOCAL void incScanCount(int dt) {
@@ -345,11 +789,17 @@ public:
    }
 
    DLLLOCAL static AbstractQoreNode* getFirstKeyValue(const QoreHashNode* h) {
-      return h->priv->member_list.empty() ? 0 : h->priv->member_list.front()->node;
+      if (h->priv->shape)
+         return h->priv->len ? h->priv->shape_values[0] : 0;
+      HashMember* m = h->priv->firstMember();
+      return m ? m->node : 0;
    }
 
    DLLLOCAL static AbstractQoreNode* getLastKeyValue(const QoreHashNode* h) {
-      return h->priv->member_list.empty() ? 0 : h->priv->member_list.back()->node;
+      if (h->priv->shape)
+         return h->priv->len ? h->priv->shape_values[h->priv->len - 1] : 0;
+      HashMember* m = h->priv->lastMember();
+      return m ? m->node : 0;
    }
 };
 
@@ -55,6 +55,8 @@ public:
    DLLLOCAL virtual QoreOperatorNode* copyBackground(ExceptionSink* xsink) const {
       return copyBackgroundExplicit<QoreHashObjectDereferenceOperatorNode>(xsink);
    }
+
+   DLLLOCAL static QoreValue doHashObjectDereference(QoreValue l, QoreValue r, ExceptionSink* xsink);
 };
 
 #endif
@@ -0,0 +1,177 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreInlineCache.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QOREINLINECACHE_H
+#define _QORE_QOREINLINECACHE_H
+
+#include <atomic>
+
+// number of receiver classes cached for each call site; sites with more classes use the normal lookup
+#define QORE_INLINE_CACHE_SIZE 4
+
+class qore_class_private;
+class QoreHashShape;
+
+// the inline cache generation is incremented when methods are added to classes that have already been committed or
+// variants are added to functions that have already been committed, which invalidates all cached lookups
+DLLLOCAL extern std::atomic<unsigned> qore_inline_cache_gen;
+
+// base class for inline cache entries
+class InlineCacheEntry {
+public:
+   unsigned gen;
+
+   // link for replaced entries
+   InlineCacheEntry* next = 0;
+
+   DLLLOCAL InlineCacheEntry() : gen(qore_inline_cache_gen.load(std::memory_order_acquire)) {
+   }
+
+   DLLLOCAL bool stale() const {
+      return gen != qore_inline_cache_gen.load(std::memory_order_relaxed);
+   }
+};
+
+// the key of an inline cache entry: the receiver's class and the runtime class context, which determines access to
+// private methods and members; classes are also identified by their serial number so that a class allocated at the
+// address of a deleted class cannot match an entry
+class InlineCacheKey : public InlineCacheEntry {
+public:
+   const qore_class_private* cls;
+   int cls_serial;
+   const qore_class_private* ctx;
+   int ctx_serial;
+
+   DLLLOCAL InlineCacheKey(const qore_class_private* n_cls, const qore_class_private* n_ctx);
+
+   DLLLOCAL bool matches(const InlineCacheKey& k) const {
+      return cls == k.cls && ctx == k.ctx && gen == k.gen && cls_serial == k.cls_serial && ctx_serial == k.ctx_serial;
+   }
+};
+
+// a method resolved for a method call site
+class MethodCacheEntry : public InlineCacheKey {
+public:
+   const QoreMethod* method;
+
+   DLLLOCAL MethodCacheEntry(const InlineCacheKey& k, const QoreMethod* m) : InlineCacheKey(k), method(m) {
+   }
+};
+
+// the position of a member in the shared member layout of the receiver class for a self.member reference
+class MemberSlotEntry : public InlineCacheKey {
+public:
+   // the layout is referenced by the entry so it cannot be reused for a different layout
+   QoreHashShape* shape;
+   unsigned idx;
+
+   DLLLOCAL MemberSlotEntry(const InlineCacheKey& k, QoreHashShape* s, unsigned i);
+
+   DLLLOCAL ~MemberSlotEntry();
+};
+
+// polymorphic inline cache: entries are immutable once published and are only deleted with the cache, so they can
+// be read without locking; stale entries are replaced and kept until the cache is deleted
+template <class T, unsigned N = QORE_INLINE_CACHE_SIZE>
+class QoreInlineCache {
+public:
+   DLLLOCAL QoreInlineCache() {
+      for (unsigned i = 0; i < N; ++i)
+         slots[i] = 0;
+      retired = 0;
+   }
+
+   DLLLOCAL ~QoreInlineCache() {
+      for (unsigned i = 0; i < N; ++i)
+         delete slots[i].load(std::memory_order_relaxed);
+      InlineCacheEntry* e = retired.load(std::memory_order_relaxed);
+      while (e) {
+         InlineCacheEntry* n = e->next;
+         delete static_cast<T*>(e);
+         e = n;
+      }
+   }
+
+   // returns the entry for the given key or 0 if not present
+   template <class K>
+   DLLLOCAL const T* find(const K& k) const {
+      // slots are filled in order and never cleared
+      for (unsigned i = 0; i < N; ++i) {
+         const T* e = slots[i].load(std::memory_order_acquire);
+         if (!e)
+            break;
+         if (e->matches(k))
+            return e;
+      }
+      return 0;
+   }
+
+   // returns true if a new entry can be added
+   DLLLOCAL bool canAdd() const {
+      for (unsigned i = 0; i < N; ++i) {
+         const T* e = slots[i].load(std::memory_order_acquire);
+         if (!e || e->stale())
+            return true;
+      }
+      return false;
+   }
+
+   // adds the entry to the cache, which takes ownership of it; the entry is deleted if there is no free slot
+   DLLLOCAL void add(T* e) {
+      for (unsigned i = 0; i < N; ++i) {
+         T* old = slots[i].load(std::memory_order_acquire);
+         if (old && !old->stale())
+            continue;
+         if (!slots[i].compare_exchange_strong(old, e, std::memory_order_acq_rel))
+            continue;
+         if (old) {
+            // readers may still be using the old entry
+            old->next = retired.load(std::memory_order_relaxed);
+            while (!retired.compare_exchange_weak(old->next, old, std::memory_order_release))
+               ;
+         }
+         return;
+      }
+      delete e;
+   }
+
+private:
+   std::atomic<T*> slots[N];
+   std::atomic<InlineCacheEntry*> retired;
+
+   DLLLOCAL QoreInlineCache(const QoreInlineCache&);
+   DLLLOCAL QoreInlineCache& operator=(const QoreInlineCache&);
+};
+
+typedef QoreInlineCache<MethodCacheEntry> MethodCallCache;
+typedef QoreInlineCache<MemberSlotEntry> MemberSlotCache;
+
+#endif
@@ -42,6 +42,9 @@
 #define Q_HAVE_STATVFS
 #include <sys/statvfs.h>
 #endif
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+#define Q_HAVE_MMAP
+#endif
 #include <sys/stat.h>
 #include <unistd.h>
 #ifdef HAVE_EXECINFO_H
@@ -368,6 +371,8 @@ DLLLOCAL int statvfs(const char* path, struct statvfs* buf);
 DLLLOCAL int q_fstatvfs(const char* filepath, struct statvfs* buf);
 #endif
 
+#include "qore/intern/QoreSlabAllocator.h"
+#include "qore/intern/QoreInlineCache.h"
 #include "qore/intern/NamedScope.h"
 #include "qore/intern/QoreTypeInfo.h"
 #include "qore/intern/ParseNode.h"
@@ -611,10 +616,11 @@ class qore_object_private;
 class hash_assignment_priv {
 public:
    qore_hash_private& h;
-   HashMember* om;
+   // pointer to the value being assigned
+   AbstractQoreNode** vp;
    qore_object_private* o = 0;
 
-   DLLLOCAL hash_assignment_priv(qore_hash_private& n_h, HashMember* n_om) : h(n_h), om(n_om) {
+   DLLLOCAL hash_assignment_priv(qore_hash_private& n_h, AbstractQoreNode** n_vp) : h(n_h), vp(n_vp) {
    }
 
    DLLLOCAL hash_assignment_priv(qore_hash_private& n_h, const char* key, bool must_already_exist = false, qore_object_private* obj = 0);
@@ -789,7 +795,13 @@ public:
 };
 
 // pushes a marker on the local variable parse stack so that searches can skip to global thread-local variables when the search hits the marker
+class LocalVarFrameParseEnvironment;
+
 class VariableBlockHelper {
+protected:
+   // the frame environment of the enclosing code; local variables declared in the block do not get frame slots
+   LocalVarFrameParseEnvironment* fenv;
+
 public:
    DLLLOCAL VariableBlockHelper();
    DLLLOCAL ~VariableBlockHelper();
@@ -847,6 +859,8 @@ DLLLOCAL QoreStringNode* format_float_intern(int prec, const QoreString& dsep, c
 DLLLOCAL DateTimeNode* make_date_with_mask(const AbstractQoreZoneInfo* tz, const QoreString& dtstr, const QoreString& mask, ExceptionSink* xsink);
 DLLLOCAL QoreHashNode* date_info(const DateTime& d);
 DLLLOCAL void init_charmaps();
+DLLLOCAL void init_loopback_dbi();
+DLLLOCAL void delete_loopback_dbi_data();
 DLLLOCAL int do_unaccent(QoreString& str, const QoreString& src, ExceptionSink* xsink);
 DLLLOCAL int do_unaccent(QoreString& str, const QoreString& src, ExceptionSink* xsink);
 DLLLOCAL int do_tolower(QoreString& str, const QoreString& src, ExceptionSink* xsink);
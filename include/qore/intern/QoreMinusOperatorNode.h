@@ -69,6 +69,8 @@ public:
    DLLLOCAL virtual QoreOperatorNode* copyBackground(ExceptionSink* xsink) const {
       return copyBackgroundExplicit<QoreMinusOperatorNode>(xsink);
    }
+
+   DLLLOCAL static QoreValue doMinus(QoreValue l, QoreValue r, ExceptionSink* xsink);
 };
 
 #endif
@@ -69,6 +69,8 @@ public:
    DLLLOCAL virtual QoreOperatorNode* copyBackground(ExceptionSink* xsink) const {
       return copyBackgroundExplicit<QoreMultiplicationOperatorNode>(xsink);
    }
+
+   DLLLOCAL static QoreValue doMultiplication(QoreValue l, QoreValue r, ExceptionSink* xsink);
 };
 
 #endif
@@ -454,6 +454,13 @@ public:
 
    DLLLOCAL AbstractQoreNode* getReferencedMemberNoMethod(const char* mem, ExceptionSink* xsink) const;
 
+   // uses and updates the inline cache of a self.member reference
+   DLLLOCAL AbstractQoreNode* getReferencedMemberNoMethod(const char* mem, MemberSlotCache& cache, ExceptionSink* xsink) const;
+
+   // called after the object has been constructed; converts the member data to the member layout shared by objects
+   // of the class if the object has the same members, so that members can be accessed by position
+   DLLLOCAL void adoptMemberShape(const qore_class_private& cls);
+
    // lock not held on entry
    DLLLOCAL void doDeleteIntern(ExceptionSink* xsink) {
       printd(5, "qore_object_private::doDeleteIntern() execing destructor() obj: %p\n", obj);
@@ -568,10 +575,26 @@ public:
       return theclass->getName();
    }
 
+   DLLLOCAL virtual QoreProgram* getOwnerProgram() const {
+      return pgm;
+   }
+
    DLLLOCAL virtual void deleteObject() {
       delete obj;
    }
 
+   DLLLOCAL virtual bool scanRef() {
+      AutoLocker al(ref_mutex);
+      if (!references)
+         return false;
+      ++references;
+      return true;
+   }
+
+   DLLLOCAL virtual void scanDeref(ExceptionSink* xsink) {
+      obj->deref(xsink);
+   }
+
    DLLLOCAL virtual bool isValidImpl() const {
       if (status != OS_OK || in_destructor) {
          printd(QRO_LVL, "qore_object_intern::isValidImpl() this: %p cannot delete graph obj status: %d in_destructor: %d\n", this, status, in_destructor);
@@ -40,6 +40,8 @@
 #include <string>
 
 class QoreParseHashNode : public ParseNode {
+   friend class QoreBytecodeCompiler;
+
 protected:
    typedef std::map<std::string, bool> kmap_t;
    typedef std::vector<AbstractQoreNode*> nvec_t;
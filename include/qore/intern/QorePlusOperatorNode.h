@@ -69,6 +69,8 @@ public:
    DLLLOCAL virtual QoreOperatorNode* copyBackground(ExceptionSink* xsink) const {
       return copyBackgroundExplicit<QorePlusOperatorNode>(xsink);
    }
+
+   DLLLOCAL static QoreValue doPlus(QoreValue l, QoreValue r, ExceptionSink* xsink);
 };
 
 #endif
@@ -36,55 +36,45 @@
 #include <qore/QoreThreadLock.h>
 #include <qore/QoreCondition.h>
 
+#include <atomic>
 #include <string>
 
-class QoreQueueNode {
-public:
-   AbstractQoreNode* node;
-   QoreQueueNode* prev,
-                * next;
-   DLLLOCAL QoreQueueNode(AbstractQoreNode* n, QoreQueueNode* p, QoreQueueNode* nx) : node(n), prev(p), next(nx) {
-   }
-
-#ifdef DEBUG
-   DLLLOCAL ~QoreQueueNode() {
-      assert(!node);
-   }
-#endif
-
-   DLLLOCAL void del(ExceptionSink* xsink) {
-      if (node)
-         node->deref(xsink);
-
-#ifdef DEBUG
-      node = 0;
-#endif
-      delete this;
-   }
+// the initial size of the ring buffer; must be a power of 2
+#define QQ_MIN_CAPACITY 16
 
-   DLLLOCAL AbstractQoreNode* takeAndDel() {
-      AbstractQoreNode* rv = node;
-#ifdef DEBUG
-      node = 0;
-#endif
-      delete this;
-      return rv;
-   }
-};
+// the size of the lock-free ring buffer; must be a power of 2
+#define QQ_FAST_CAPACITY 128
 
 #define QW_DEL     -1
 #define QW_TIMEOUT -2
 #define QW_ERROR   -3
 
+// queue elements are stored in a ring buffer that grows as needed, so no memory is allocated per element
+// while an unbounded queue is empty and has no waiting threads, push() and shift() use a bounded lock-free ring
+// instead (see qore_queue_private::push()); all other operations first move its elements to the locked ring
 class qore_queue_private {
 private:
    enum queue_status_e { Queue_Deleted = -1 };
 
+   // an element of the lock-free ring
+   struct fast_cell {
+      // sequence number: the position that can be written next when equal to the position, readable when one higher
+      std::atomic<unsigned> seq;
+      AbstractQoreNode* val;
+   };
+
+   fast_cell* fbuf;                  // lock-free ring buffer; allocated when first enabled
+   std::atomic<unsigned> fhead,      // the next position to read in the lock-free ring
+                         ftail;      // the next position to write in the lock-free ring
+   std::atomic<bool> fast;           // true if push() and shift() can use the lock-free ring
+   std::atomic<unsigned> factive;    // number of threads in lock-free operations
+
    mutable QoreThreadLock l;
    QoreCondition read_cond,   // read Condition variable
                  write_cond;  // write Condition variable
-   QoreQueueNode* head,
-                * tail;
+   AbstractQoreNode** buf;    // ring buffer
+   unsigned cap,              // the size of the ring buffer; 0 or a power of 2
+            first;            // the position of the first element in the ring buffer
    std::string err;
    QoreStringNode* desc;
    int len,   // the number of elements currently in the queue (or -1 for deleted)
@@ -95,44 +85,79 @@ private:
    DLLLOCAL int waitReadIntern(ExceptionSink *xsink, int timeout_ms);
    DLLLOCAL int waitWriteIntern(ExceptionSink *xsink, int timeout_ms);
 
+   DLLLOCAL AbstractQoreNode*& at(unsigned i) const {
+      return buf[(first + i) & (cap - 1)];
+   }
+
+   // resizes the ring buffer; the new size must be a power of 2 and >= len
+   DLLLOCAL void resize(unsigned n_cap);
+
+   DLLLOCAL void grow() {
+      if ((unsigned)len == cap)
+         resize(cap ? cap << 1 : QQ_MIN_CAPACITY);
+   }
+
+   // gives back memory after bursts
+   DLLLOCAL void shrink() {
+      if (cap > QQ_MIN_CAPACITY && (unsigned)len < (cap >> 3))
+         resize(cap >> 1);
+   }
+
+   // lock-free ring operations; return false if the ring is full or empty, respectively
+   DLLLOCAL bool fastPush(AbstractQoreNode* v);
+   DLLLOCAL bool fastShift(AbstractQoreNode*& v);
+
+   // called in the lock before any operation on the locked ring; disables the lock-free ring and moves its elements
+   // to the locked ring
+   DLLLOCAL void disableFast();
+
+   // called in the lock after operations on the locked ring; enables the lock-free ring if the queue is unbounded,
+   // empty, has no waiting threads and no error
+   DLLLOCAL void enableFast();
+
    DLLLOCAL void pushNode(AbstractQoreNode* v);
    DLLLOCAL void pushIntern(AbstractQoreNode* v);
    DLLLOCAL void insertIntern(AbstractQoreNode* v);
 
+   DLLLOCAL AbstractQoreNode* shiftIntern();
+   DLLLOCAL AbstractQoreNode* popIntern();
+
    DLLLOCAL void clearIntern(ExceptionSink* xsink);
 
    // called in the lock; returns -1 if not possible (cannot write to the queue) or 0 of OK
    DLLLOCAL int checkWriteIntern(ExceptionSink* xsink, bool always_error = false);
 
 public:
-   DLLLOCAL qore_queue_private(int n_max = -1) : head(0), tail(0), desc(0), len(0), max(n_max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(int n_max = -1) : fbuf(0), fhead(0), ftail(0), fast(false), factive(0), buf(0), cap(0), first(0), desc(0), len(0), max(n_max), read_waiting(0), write_waiting(0) {
       assert(max);
       //printd(5, "qore_queue_private::qore_queue_private() this: %p max: %d\n", this, max);
    }
 
-   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : head(0), tail(0), err(orig.err), desc(orig.desc ? orig.desc->stringRefSelf() : 0), len(0), max(orig.max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : fbuf(0), fhead(0), ftail(0), fast(false), factive(0), buf(0), cap(0), first(0), err(orig.err), desc(orig.desc ? orig.desc->stringRefSelf() : 0), len(0), max(orig.max), read_waiting(0), write_waiting(0) {
       AutoLocker al(orig.l);
       if (orig.len == Queue_Deleted)
          return;
 
-      QoreQueueNode* w = orig.head;
-      while (w) {
-         pushIntern(w->node ? w->node->refSelf() : 0);
-         w = w->next;
+      const_cast<qore_queue_private&>(orig).disableFast();
+
+      for (int i = 0; i < orig.len; ++i) {
+         AbstractQoreNode* n = orig.at(i);
+         pushNode(n ? n->refSelf() : 0);
       }
 
-      //printd(5, "qore_queue_private::qore_queue_private() this=%p head=%p tail=%p waiting=%d len=%d\n", this, head, tail, waiting, len);
+      //printd(5, "qore_queue_private::qore_queue_private() this=%p len=%d\n", this, len);
    }
 
    // queues should not be deleted when other threads might
    // be accessing them
    DLLLOCAL ~qore_queue_private() {
       //QORE_TRACE("qore_queue_private::~qore_queue_private()");
-      //printd(5, "qore_queue_private::~qore_queue_private() this=%p head=%p tail=%p len=%d\n", this, head, tail, len);
-      assert(!head);
-      assert(!tail);
+      //printd(5, "qore_queue_private::~qore_queue_private() this=%p len=%d\n", this, len);
+      assert(!buf);
       assert(len == Queue_Deleted);
       assert(!desc);
+      assert(!fast);
+      free(fbuf);
    }
 
    // push at the end of the queue and take the reference - can only be used when len == -1
@@ -147,12 +172,24 @@ public:
    DLLLOCAL AbstractQoreNode* shift(ExceptionSink* xsink, int timeout_ms, bool& to);
    DLLLOCAL AbstractQoreNode* pop(ExceptionSink* xsink, int timeout_ms, bool& to);
 
+   // push all list elements at the end of the queue; returns the number of elements queued
+   DLLLOCAL int pushList(ExceptionSink* xsink, const QoreListNode* l, int timeout_ms, bool& to);
+
+   // removes up to n elements from the beginning of the queue
+   DLLLOCAL QoreListNode* shiftN(ExceptionSink* xsink, int n, int timeout_ms, bool& to);
+
    DLLLOCAL bool empty() const {
-      return !len;
+      return !size();
    }
 
    DLLLOCAL int size() const {
-      return len;
+      int rv = len;
+      if (rv != Queue_Deleted) {
+         // the read position is read first, as it can never pass the write position
+         unsigned h = fhead.load(std::memory_order_relaxed);
+         rv += (int)(ftail.load(std::memory_order_relaxed) - h);
+      }
+      return rv;
    }
 
    DLLLOCAL int getMax() const {
@@ -46,10 +46,25 @@
 class QoreRegexBase {
 protected:
    pcre* p;
+   // study data for the compiled pattern (including JIT code if available) or 0
+   pcre_extra* extra;
    int options;
    QoreString* str;
 
+   // compiles the pattern (must already be in UTF-8 encoding) and studies it; returns -1 if an exception was raised
+   DLLLOCAL int compile(const char* pattern, ExceptionSink* xsink);
+
+   // frees the compiled pattern and any study data
+   DLLLOCAL void freePattern();
+
+   DLLLOCAL int execIntern(const char* subject, int len, int offset, int* ovector, int ovecsize) const {
+      return pcre_exec(p, extra, subject, len, offset, 0, ovector, ovecsize);
+   }
+
 public:
+   // returns true if the PCRE library supports JIT compilation
+   DLLLOCAL static bool jitAvailable();
+
    DLLLOCAL void setCaseInsensitive();
    DLLLOCAL void setDotAll();
    DLLLOCAL void setExtended();
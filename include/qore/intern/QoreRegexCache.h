@@ -0,0 +1,113 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreRegexCache.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_INTERN_QOREREGEXCACHE_H
+#define _QORE_INTERN_QOREREGEXCACHE_H
+
+#include "qore/intern/QoreRegex.h"
+#include "qore/intern/QoreRegexSubst.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// maximum number of compiled patterns kept in the cache
+#ifndef QORE_REGEX_CACHE_SIZE
+#define QORE_REGEX_CACHE_SIZE 256
+#endif
+
+// bounded, thread-safe LRU cache of compiled regular expressions created at run time from dynamic patterns
+// (ex: by regex(), regex_subst() and regex_extract()); cached objects are immutable and are shared between threads
+class QoreRegexCache {
+public:
+   DLLLOCAL QoreRegexCache(unsigned n_max = QORE_REGEX_CACHE_SIZE) : max(n_max), hits(0), misses(0) {
+   }
+
+   DLLLOCAL ~QoreRegexCache() {
+      clear();
+   }
+
+   // returns a referenced regex for the given pattern and options or 0 if an exception was raised
+   DLLLOCAL QoreRegex* getRegex(const QoreString& pattern, int64 options, ExceptionSink* xsink);
+
+   // returns a referenced substitution regex for the given pattern and options (including QRE_GLOBAL) or 0 if an exception was raised
+   DLLLOCAL QoreRegexSubst* getRegexSubst(const QoreString& pattern, int64 options, ExceptionSink* xsink);
+
+   // returns a hash of cache statistics
+   DLLLOCAL QoreHashNode* getInfo() const;
+
+   // removes all entries
+   DLLLOCAL void clear();
+
+private:
+   struct Entry {
+      std::string key;
+      // only one of the following is set
+      QoreRegex* re;
+      QoreRegexSubst* rs;
+
+      DLLLOCAL Entry(const std::string& k, QoreRegex* r) : key(k), re(r), rs(0) {
+      }
+
+      DLLLOCAL Entry(const std::string& k, QoreRegexSubst* r) : key(k), re(0), rs(r) {
+      }
+
+      DLLLOCAL void deref() {
+         if (re)
+            re->deref();
+         else
+            rs->deref();
+      }
+   };
+
+   // entries in LRU order; the most recently used entry is first
+   typedef std::list<Entry> elist_t;
+   typedef std::unordered_map<std::string, elist_t::iterator> emap_t;
+
+   mutable QoreThreadLock m;
+   elist_t elist;
+   emap_t emap;
+   unsigned max;
+   int64 hits, misses;
+
+   // returns the cache key for the given pattern and options
+   DLLLOCAL static void getKey(std::string& key, char type, const QoreString& pattern, int64 options);
+
+   // returns the entry for the key and moves it to the front of the LRU list or 0 if not found; the lock must be held
+   DLLLOCAL Entry* find(const std::string& key);
+
+   // adds an entry and removes the least recently used entries exceeding the maximum size; the lock must be held
+   DLLLOCAL void add(const Entry& e);
+};
+
+DLLLOCAL extern QoreRegexCache QRC;
+
+#endif
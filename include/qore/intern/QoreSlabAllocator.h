@@ -0,0 +1,61 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreSlabAllocator.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORESLABALLOCATOR_H
+#define _QORE_QORESLABALLOCATOR_H
+
+// small objects are allocated from chunks of this size aligned to their size, so the chunk of an object can be found
+// from its address
+#define QORE_SLAB_CHUNK_SHIFT 16
+#define QORE_SLAB_CHUNK_SIZE (1 << QORE_SLAB_CHUNK_SHIFT)
+
+// size classes are multiples of 16 bytes; larger objects are allocated with ::operator new
+#define QORE_SLAB_CLASS_SHIFT 4
+#define QORE_SLAB_CLASSES 16
+#define QORE_SLAB_MAX_SIZE (QORE_SLAB_CLASSES << QORE_SLAB_CLASS_SHIFT)
+
+// the slab allocator is used for value nodes and their private data, which are allocated and freed at a high rate
+// in all threads; each thread allocates from its own chunks without locking, and objects freed in another thread are
+// returned to the owning thread with a lock-free list.  Memory not allocated from a slab (large objects, objects
+// allocated before the allocator was initialized or by modules built against older headers) is released with
+// ::operator delete, so any pointer can be passed to qore_slab_free().  The allocator is disabled if the
+// QORE_NO_SLAB_ALLOCATOR environment variable is set, for example to debug memory errors with valgrind
+
+// allocates memory for an object of the given size
+DLLLOCAL void* qore_slab_alloc(size_t size);
+
+// frees memory allocated with qore_slab_alloc() or ::operator new
+DLLLOCAL void qore_slab_free(void* p);
+
+// returns allocator statistics for get_allocator_stats()
+DLLLOCAL QoreHashNode* qore_slab_get_stats();
+
+#endif
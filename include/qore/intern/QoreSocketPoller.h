@@ -0,0 +1,160 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreSocketPoller.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_INTERN_QORESOCKETPOLLER_H
+#define _QORE_INTERN_QORESOCKETPOLLER_H
+
+#include <qore/AbstractPrivateData.h>
+#include <qore/QoreThreadLock.h>
+
+#if defined HAVE_SYS_EPOLL_H && defined HAVE_EPOLL_CREATE1
+#define QORE_SOCKET_POLLER_EPOLL
+#include <sys/epoll.h>
+#elif defined HAVE_POLL
+#define QORE_SOCKET_POLLER_POLL
+#include <poll.h>
+#endif
+
+#include <unordered_map>
+#include <set>
+#include <vector>
+
+// readiness events; also used as the event mask when registering sockets
+#define SP_READ     (1 << 0)
+#define SP_WRITE    (1 << 1)
+#define SP_ERROR    (1 << 2)
+#define SP_HANGUP   (1 << 3)
+#define SP_EVENTS   (SP_READ | SP_WRITE)
+
+// registration flags
+#define SP_EDGE     (1 << 8)
+#define SP_ONESHOT  (1 << 9)
+#define SP_FLAGS    (SP_EDGE | SP_ONESHOT)
+
+DLLLOCAL QoreClass* initSocketPollerClass(QoreNamespace& ns);
+DLLLOCAL extern qore_classid_t CID_SOCKETPOLLER;
+DLLLOCAL extern QoreClass* QC_SOCKETPOLLER;
+
+class QoreSocketObject;
+
+// waits for readiness events on many sockets at once; uses epoll(7) where available, otherwise poll(2)
+// registered Socket objects are referenced by the poller until they are removed or the poller is destroyed
+class QoreSocketPoller : public AbstractPrivateData {
+public:
+   DLLLOCAL QoreSocketPoller(ExceptionSink* xsink);
+
+   // registers a socket for the given events and flags; returns 0 for OK, -1 if an exception was raised
+   DLLLOCAL int add(const QoreObject* obj, QoreSocketObject* s, int events, const QoreValue data, ExceptionSink* xsink);
+
+   // changes the events and flags for a registered socket and rearms one-shot registrations; returns 0 for OK, -1 if an exception was raised
+   DLLLOCAL int modify(const QoreObject* obj, QoreSocketObject* s, int events, ExceptionSink* xsink);
+
+   // removes a registered socket; returns true if the socket was registered
+   DLLLOCAL bool remove(const QoreObject* obj, QoreSocketObject* s, ExceptionSink* xsink);
+
+   // removes all registered sockets
+   DLLLOCAL void clear(ExceptionSink* xsink);
+
+   // waits up to timeout_ms for events and returns a list of at most max hashes with "socket", "events" and "data" keys;
+   // returns an empty list on timeout or when woken up with wakeup(), 0 if an exception was raised
+   DLLLOCAL QoreListNode* wait(int timeout_ms, int max, ExceptionSink* xsink);
+
+   // wakes up threads blocked in wait()
+   DLLLOCAL void wakeup();
+
+   // returns true if the socket is registered
+   DLLLOCAL bool isRegistered(const QoreObject* obj) const;
+
+   // returns the number of registered sockets
+   DLLLOCAL size_t size() const;
+
+   // returns the name of the event notification mechanism used
+   DLLLOCAL static const char* getBackend();
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink);
+
+protected:
+   DLLLOCAL virtual ~QoreSocketPoller();
+
+private:
+   struct Entry {
+      // registration ID; stored with the descriptor in the kernel so that events for removed registrations are never misattributed
+      int64 id;
+      QoreObject* obj;
+      // the private data of the Socket object; used to check for data buffered in user space
+      QoreSocketObject* sock;
+      QoreValue data;
+      int fd;
+      int events;
+      // false after a one-shot registration has reported an event
+      bool armed;
+
+      DLLLOCAL Entry(int64 n_id, QoreObject* o, QoreSocketObject* s, QoreValue d, int n_fd, int n_events) : id(n_id), obj(o), sock(s), data(d), fd(n_fd), events(n_events), armed(true) {
+      }
+   };
+
+   typedef std::unordered_map<const QoreObject*, Entry*> omap_t;
+   typedef std::unordered_map<int64, Entry*> imap_t;
+   typedef std::vector<Entry*> elist_t;
+
+   mutable QoreThreadLock m;
+   // registrations by Socket object
+   omap_t omap;
+   // registrations by ID
+   imap_t imap;
+   // IDs of registrations for sockets with data already buffered in user space; epoll/poll cannot see this data,
+   // so these are reported by the next call to wait() without blocking
+   std::set<int64> ready;
+   // IDs of level-triggered read registrations reported by the last call to wait(); a partial read can leave data
+   // buffered in user space, so these are checked again by the next call
+   std::set<int64> reported;
+   // the next registration ID; 0 is reserved for the wakeup pipe
+   int64 next_id;
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   int epfd;
+#endif
+   // wakeup pipe
+   int wfd[2];
+
+   DLLLOCAL int addIntern(Entry* e, ExceptionSink* xsink);
+   DLLLOCAL int modifyIntern(Entry* e, ExceptionSink* xsink);
+   DLLLOCAL void removeIntern(Entry* e, QoreSocketObject* s);
+   // adds registrations reported by the last call to wait() that still have buffered data to the ready set; must be
+   // called without the lock held
+   DLLLOCAL void checkReported(ExceptionSink* xsink);
+   DLLLOCAL void drainWakeup();
+   // adds a result for an entry to the list; the lock must be held
+   DLLLOCAL void addResult(QoreListNode& l, Entry* e, int events);
+   // releases entries removed from the poller; must be called without the lock held
+   DLLLOCAL static void release(elist_t& el, ExceptionSink* xsink);
+};
+
+#endif
@@ -0,0 +1,103 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreThreadLocalObject.h
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORETHREADLOCALOBJECT_H
+#define _QORE_QORETHREADLOCALOBJECT_H
+
+#include <qore/QoreThreadLocalStorage.h>
+
+// default allocation policy for QoreThreadLocalObject
+template <typename T>
+struct QoreThreadLocalObjectTraits {
+   DLLLOCAL static T* create() {
+      return new T;
+   }
+
+   DLLLOCAL static void destroy(T* obj) {
+      delete obj;
+   }
+};
+
+// a per-thread object that is created on demand and destroyed when the thread terminates
+/** intended for static objects: the object of the thread that runs static destruction (normally the main thread) is
+    destroyed with the key, because thread-specific data destructors are not run for the main thread; the Traits class
+    provides static create() and destroy() functions; create() may return 0
+ */
+template <typename T, class Traits = QoreThreadLocalObjectTraits<T> >
+class QoreThreadLocalObject {
+public:
+   DLLLOCAL QoreThreadLocalObject() {
+      init = !pthread_key_create(&key, destroy_object);
+   }
+
+   DLLLOCAL ~QoreThreadLocalObject() {
+      if (!init)
+         return;
+      init = false;
+      T* obj = (T*)pthread_getspecific(key);
+      if (obj)
+         Traits::destroy(obj);
+      pthread_key_delete(key);
+   }
+
+   // returns the current thread's object or 0 if it has not been created
+   DLLLOCAL T* peek() const {
+      return init ? (T*)pthread_getspecific(key) : 0;
+   }
+
+   // returns the current thread's object, creating it if necessary; returns 0 if called before static initialization
+   // or after static destruction of this object
+   DLLLOCAL T* get() {
+      if (!init)
+         return 0;
+      T* obj = (T*)pthread_getspecific(key);
+      if (!obj) {
+         obj = Traits::create();
+         if (obj)
+            pthread_setspecific(key, obj);
+      }
+      return obj;
+   }
+
+private:
+   pthread_key_t key;
+   // static storage is zero-initialized before any constructor runs
+   bool init;
+
+   DLLLOCAL QoreThreadLocalObject(const QoreThreadLocalObject&);
+   DLLLOCAL QoreThreadLocalObject& operator=(const QoreThreadLocalObject&);
+
+   DLLLOCAL static void destroy_object(void* obj) {
+      Traits::destroy((T*)obj);
+   }
+};
+
+#endif // _QORE_QORETHREADLOCALOBJECT_H
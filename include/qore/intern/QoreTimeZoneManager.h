@@ -65,11 +65,6 @@ struct QoreLeapInfo {
    int total; // total correction after transition time
 };
 
-struct QoreDSTTransition {
-   int time;
-   struct QoreTransitionInfo *trans;
-};
-
 class AbstractQoreZoneInfo {
 protected:
    // region or time zone locale name (i.e. "Europe/Prague" or "-06:00" for UTC - 06:00)
@@ -160,14 +155,14 @@ public:
 
 class QoreZoneInfo : public AbstractQoreZoneInfo {
 protected:
-   // first positive transition entry (after the epoch)
-   int first_pos;
    bool valid;
    const char *std_abbr;  // standard time abbreviation
 
-   // QoreDSTTransition times
-   typedef std::vector<QoreDSTTransition> dst_transition_vec_t;
-   dst_transition_vec_t QoreDSTTransitions;
+   // transition times in seconds from the epoch in ascending order; kept separate from the types so that
+   // the binary search in getUTCOffsetImpl() only touches one small contiguous array
+   std::vector<int> trans_time;
+   // QoreTransitionInfo index for each entry in trans_time
+   std::vector<unsigned char> trans_type;
 
    // QoreTransitionInfo array
    trans_vec_t tti;
@@ -179,6 +174,10 @@ protected:
    // returns the UTC offset and local time zone name for the given time given as seconds from the epoch (1970-01-01Z)
    DLLLOCAL virtual int getUTCOffsetImpl(int64 epoch_offset, bool &is_dst, const char *&zone_name) const;
 
+   // returns the transition info in effect for the given time (0 = unknown, use the standard offset) and the
+   // [start, end) interval of epoch offsets that it applies to
+   DLLLOCAL const QoreTransitionInfo *findTransition(int64 epoch_offset, int64 &start, int64 &end) const;
+
 public:
    DLLLOCAL QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink *xsink);
 
@@ -264,6 +263,12 @@ protected:
    DLLLOCAL int processIntern(const char *fn, ExceptionSink *xsink);
    DLLLOCAL int process(const char *fn);
 
+   // returns the key for the given region name or zoneinfo file name in tzmap
+   DLLLOCAL const char *getRegionKey(const char *fn) const;
+
+   // returns an already-loaded region; does not load the region if it is not present
+   DLLLOCAL const AbstractQoreZoneInfo *findRegion(const char *fn) const;
+
    DLLLOCAL const AbstractQoreZoneInfo *processFile(const char *fn, bool use_path, ExceptionSink *xsink);
    DLLLOCAL int processDir(const char *d, ExceptionSink *xsink);
 
@@ -35,7 +35,16 @@
 
 #include "qore/intern/RSection.h"
 
+#include <qore/QoreThreadLocalStorage.h>
+
+#include <atomic>
 #include <set>
+#include <vector>
+
+// default number of queued objects that triggers a collection by the background cycle collector
+#define QCC_DEFAULT_TRIGGER 64
+// default maximum time in milliseconds that queued objects wait for the background cycle collector
+#define QCC_DEFAULT_INTERVAL 100
 
 class RSet;
 class RSetHelper;
@@ -73,7 +82,10 @@ public:
    // do we need to call isValidImpl()
    bool needs_is_valid;
 
-   DLLLOCAL RObject(int& n_refs, bool niv = false) : rscan(0), rcount(0), rwaiting(0), rcycle(0), ref_inprogress(0), ref_waiting(0), rset(0), references(n_refs), needs_is_valid(niv) {
+   // is the object queued for a scan by the background cycle collector; access serialized with the collector's lock
+   bool rqueued;
+
+   DLLLOCAL RObject(int& n_refs, bool niv = false) : rscan(0), rcount(0), rwaiting(0), rcycle(0), ref_inprogress(0), ref_waiting(0), rset(0), references(n_refs), needs_is_valid(niv), rqueued(false) {
    }
 
    DLLLOCAL virtual ~RObject();
@@ -104,6 +116,9 @@ public:
 
    DLLLOCAL bool scanCheck(RSetHelper& rsh, AbstractQoreNode* n);
 
+   // recalculates the recursive reference set for the object or queues it for the background cycle collector
+   DLLLOCAL void scanRSet();
+
    // very fast check if the object might have recursive references
    DLLLOCAL bool mightHaveRecursiveReferences() const {
       return rset || rcount;
@@ -129,8 +144,19 @@ public:
    // deletes the object itself
    DLLLOCAL virtual void deleteObject() = 0;
 
+   // adds a strong reference for the background cycle collector; returns false if the object has no more references
+   DLLLOCAL virtual bool scanRef() = 0;
+
+   // removes the strong reference added with scanRef(), which may collect the object and its recursive graph
+   DLLLOCAL virtual void scanDeref(ExceptionSink* xsink) = 0;
+
    // returns the name of the object
    DLLLOCAL virtual const char* getName() const = 0;
+
+   // returns the Program the object belongs to, or 0 if not known
+   DLLLOCAL virtual QoreProgram* getOwnerProgram() const {
+      return 0;
+   }
 };
 
 typedef std::set<RObject*> rset_t;
@@ -393,6 +419,117 @@ public:
    }
 };
 
+/* The background cycle collector: when enabled, recursive reference scans are not made in the thread that
+   changed or released an object; instead the object is queued with a strong reference, and a background thread
+   scans the queued objects in batches.  After each object has been scanned, the collector releases its
+   reference, which collects the object's graph if only recursive references remain.  The thread is started when
+   an object is queued and exits when no objects have been queued in the last interval.
+ */
+class QoreCycleCollector {
+public:
+   DLLLOCAL QoreCycleCollector() : deferred(false), trigger(QCC_DEFAULT_TRIGGER), interval(QCC_DEFAULT_INTERVAL), running(false),
+      waiting(false), roots_queued(0), roots_scanned(0), batches(0), scans(0), scan_us(0), bg_scans(0), bg_scan_us(0),
+      cycles_freed(0) {
+   }
+
+   // returns true if recursive reference scans should be queued for the background collector in the current thread
+   DLLLOCAL bool deferScan() {
+      return deferred.load(std::memory_order_relaxed) && !csync.get();
+   }
+
+   // queues the object with a strong reference; returns false if the object could not be queued
+   DLLLOCAL bool queue(RObject& obj);
+
+   // enables or disables the background collector; when disabled, queued objects are processed in the current thread
+   DLLLOCAL void set(bool enable, int n_trigger, int64 n_interval, ExceptionSink* xsink);
+
+   // processes all queued objects, or only the objects belonging to the given Program, in the current thread; when a
+   // Program is given, a batch with objects belonging to the Program being processed by the collector thread is
+   // waited for first
+   DLLLOCAL void flush(ExceptionSink* xsink, QoreProgram* pgm = 0);
+
+   // stops the background collector and processes all queued objects in the current thread
+   DLLLOCAL void del();
+
+   // runs the background collector thread
+   DLLLOCAL void run(ExceptionSink* xsink);
+
+   DLLLOCAL void scanDone(int64 us) {
+      scans.fetch_add(1, std::memory_order_relaxed);
+      scan_us.fetch_add(us, std::memory_order_relaxed);
+      if (csync.get() == this) {
+         bg_scans.fetch_add(1, std::memory_order_relaxed);
+         bg_scan_us.fetch_add(us, std::memory_order_relaxed);
+      }
+   }
+
+   DLLLOCAL void cycleFreed() {
+      cycles_freed.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   DLLLOCAL QoreHashNode* getStats();
+
+   // sets or clears synchronous scanning for the current thread; returns the previous value
+   DLLLOCAL void* setSync(void* v) {
+      void* rv = csync.get();
+      csync.set(v);
+      return rv;
+   }
+
+private:
+   // a queued object and the Program it belongs to
+   struct QoreCycleCollectorEntry {
+      RObject* obj;
+      QoreProgram* pgm;
+   };
+
+   typedef std::vector<QoreCycleCollectorEntry> rqueue_t;
+   typedef std::set<QoreProgram*> pgm_set_t;
+
+   QoreThreadLock l;
+   QoreCondition cond;
+   rqueue_t q;
+   // Programs with objects in the batch being processed by the collector thread
+   pgm_set_t active_pgms;
+
+   std::atomic<bool> deferred;
+   int trigger;
+   int64 interval;
+   bool running, waiting;
+
+   // set to this object in the collector thread and to another non-null value in threads where scans are synchronous
+   QoreThreadLocalStorage<void> csync;
+
+   std::atomic<int64> roots_queued, roots_scanned, batches, scans, scan_us, bg_scans, bg_scan_us, cycles_freed;
+
+   // scans the objects and releases their references; called without the lock held
+   DLLLOCAL void process(rqueue_t& batch, ExceptionSink* xsink);
+
+   // takes all queued objects, or only the objects belonging to the given Program; called with the lock held
+   DLLLOCAL void take(rqueue_t& batch, QoreProgram* pgm = 0);
+};
+
+DLLLOCAL extern QoreCycleCollector QCC;
+
+// makes recursive reference scans synchronous in the current thread while in scope and processes all queued objects
+// belonging to the given Program in the current thread when entering and leaving the scope
+class QoreCycleCollectorSyncHelper {
+public:
+   DLLLOCAL QoreCycleCollectorSyncHelper(ExceptionSink* xs, QoreProgram* p) : xsink(xs), pgm(p), old(QCC.setSync(this)) {
+      QCC.flush(xsink, pgm);
+   }
+
+   DLLLOCAL ~QoreCycleCollectorSyncHelper() {
+      QCC.flush(xsink, pgm);
+      QCC.setSync(old);
+   }
+
+private:
+   ExceptionSink* xsink;
+   QoreProgram* pgm;
+   void* old;
+};
+
 class qore_object_private;
 
 /** this class ensures that RObjects will not be deleted until all deref() calls are complete
@@ -36,6 +36,8 @@
 #include "qore/intern/AbstractStatement.h"
 
 class ReturnStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 private:
    AbstractQoreNode *exp;
 
@@ -105,6 +105,8 @@ public:
    DLLLOCAL const char* getCipherVersion() const;
    DLLLOCAL X509* getPeerCertificate() const;
    DLLLOCAL long verifyPeerCertificate() const;
+   // returns true if decrypted data is buffered in the SSL connection
+   DLLLOCAL bool pending() const;
 };
 
 class SSLSocketReferenceHelper {
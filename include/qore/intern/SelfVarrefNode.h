@@ -37,6 +37,8 @@ class SelfVarrefNode : public ParseNode  {
 protected:
    QoreProgramLocation loc;
    const QoreTypeInfo *returnTypeInfo;
+   // member positions for the receiver classes seen at runtime
+   mutable MemberSlotCache cache;
 
    DLLLOCAL virtual QoreValue evalValueImpl(bool &needs_deref, ExceptionSink *xsink) const;
 
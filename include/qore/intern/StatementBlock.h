@@ -104,6 +104,8 @@ public:
 };
 
 class StatementBlock : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 protected:
    typedef safe_dslist<AbstractStatement*> statement_list_t;
    statement_list_t statement_list;
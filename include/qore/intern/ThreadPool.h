@@ -32,14 +32,22 @@
 
 #define QTP_DEFAULT_RELEASE_MS 5000
 
+// number of buckets in the task latency histogram; bucket n counts tasks that waited less than 2^n microseconds
+// to be started (and at least 2^(n-1) microseconds for n > 0); the last bucket counts all longer waits
+#define QTP_LATENCY_BUCKETS 24
+
+#include <atomic>
 #include <deque>
+#include <vector>
 #include <qore/qlist>
+#include <qore/QoreRWLock.h>
 
 class ThreadTask;
 class ThreadPoolThread;
 
 typedef std::deque<ThreadTask*> taskq_t;
 typedef qlist<ThreadPoolThread*> tplist_t;
+typedef std::vector<ThreadPoolThread*> tpvec_t;
 
 class ThreadTask {
 protected:
@@ -47,7 +55,14 @@ protected:
    ResolvedCallReferenceNode* cancelCode;
 
 public:
-   DLLLOCAL ThreadTask(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc) : code(c), cancelCode(cc) {
+   // link in the submission stack
+   ThreadTask* next;
+   // submission sequence number
+   int64 seq;
+   // submission time in microseconds
+   int64 submitted;
+
+   DLLLOCAL ThreadTask(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc) : code(c), cancelCode(cc), next(0), seq(0), submitted(0) {
    }
 
    DLLLOCAL ~ThreadTask() {
@@ -74,6 +89,10 @@ public:
       if (cancelCode)
          cancelCode->execValue(0, xsink).discard(xsink);
    }
+
+   DLLLOCAL static bool seqLessThan(const ThreadTask* a, const ThreadTask* b) {
+      return a->seq < b->seq;
+   }
 };
 
 class ThreadTaskHolder {
@@ -100,17 +119,28 @@ public:
 
 class ThreadPool;
 
+// a pool thread; each thread has its own task deque: the thread takes tasks from the back, idle threads steal from the front
 class ThreadPoolThread {
+   friend class ThreadPool;
+
 protected:
    int id;
    ThreadPool& tp;
-   ThreadTask* task;
-   QoreCondition c,
-      *stopCond;
-   QoreThreadLock m;
+   // local task deque
+   taskq_t local;
+   // protects the local task deque
+   QoreThreadLock lm;
+   // idle threads wait on this condition with the ThreadPool lock
+   QoreCondition c;
+   // position in the ThreadPool's allocated or idle thread list
    tplist_t::iterator pos;
-   bool stopflag,
-      stopped;
+   // the following are protected by the ThreadPool lock
+   bool idle,       // in the idle thread list
+      listed,       // in the allocated or idle thread list
+      woken,        // idle thread has been woken up for work
+      stopflag;     // thread should terminate
+   // state for picking steal victims
+   unsigned seed;
 
    DLLLOCAL void finalize(ExceptionSink* xsink);
 
@@ -118,12 +148,7 @@ public:
    DLLLOCAL ThreadPoolThread(ThreadPool& n_tp, ExceptionSink* xsink);
 
    DLLLOCAL ~ThreadPoolThread() {
-      delete stopCond;
-      assert(!task);
-   }
-
-   DLLLOCAL void setPos(tplist_t::iterator p) {
-      pos = p;
+      assert(local.empty());
    }
 
    DLLLOCAL bool valid() const {
@@ -132,63 +157,53 @@ public:
 
    DLLLOCAL void worker(ExceptionSink* xsink);
 
-   DLLLOCAL void stop() {
-      AutoLocker al(m);
-      assert(!stopflag);
-      stopflag = true;
-      c.signal();
-      //printd(5, "ThreadPoolThread::stop() signaling stop for id %d\n", id);
-   }
-
-   DLLLOCAL void stopWait() {
-      //printd(5, "ThreadPoolThread::stopWait() stopping id %d\n", id);
-      assert(!stopCond);
-      stopCond = new QoreCondition;
-
-      AutoLocker al(m);
-      assert(!stopflag);
-      stopflag = true;
-      c.signal();
+   DLLLOCAL int getId() const {
+      return id;
    }
 
-   DLLLOCAL void stopConfirm(ExceptionSink* xsink) {
-      {
-	 AutoLocker al(m);
-	 assert(stopflag);
-	 assert(stopCond);
-	 while (!stopped)
-	    stopCond->wait(m);
-      }
-
-      //printd(5, "ThreadPoolThread::stopConfirm() stopped id %d\n", id);
-      finalize(xsink);
+   DLLLOCAL void push(ThreadTask* t) {
+      AutoLocker al(lm);
+      local.push_back(t);
    }
 
-   DLLLOCAL void submit(ThreadTask* t) {
-      AutoLocker al(m);
-      assert(!stopflag);
-      assert(!task);
-      task = t;
-      c.signal();
+   // takes the most recently queued task
+   DLLLOCAL ThreadTask* pop() {
+      AutoLocker al(lm);
+      if (local.empty())
+         return 0;
+      ThreadTask* t = local.back();
+      local.pop_back();
+      return t;
    }
 
-   DLLLOCAL int getId() const {
-      return id;
+   // takes the oldest queued task
+   DLLLOCAL ThreadTask* steal() {
+      AutoLocker al(lm);
+      if (local.empty())
+         return 0;
+      ThreadTask* t = local.front();
+      local.pop_front();
+      return t;
    }
 
-   DLLLOCAL tplist_t::iterator getPos() const {
-      return pos;
+   DLLLOCAL bool hasTasks() {
+      AutoLocker al(lm);
+      return !local.empty();
    }
 };
 
+// pool threads take tasks from their own deque, then from the shared submission stack, and finally steal from other threads;
+// the ThreadPool lock is only acquired to start, wake up, park or terminate threads
 class ThreadPool : public AbstractPrivateData {
+   friend class ThreadPoolThread;
+
 protected:
    int max,        // maximum number of threads in pool (if <= 0 then unlimited)
       minidle,     // minimum number of idle threads
       maxidle,     // maximum number of idle threads
       release_ms;  // number of milliseconds before idle threads are released when > minidle
 
-   // mutex for atomicity
+   // mutex for thread management
    QoreThreadLock m;
 
    // worker thread condition variable
@@ -200,82 +215,95 @@ protected:
    tplist_t ah,  // allocated thread list
       fh;        // free thread list
 
-   // quit flag
-   bool quit;
+   // all threads for stealing; the lock is acquired for writing with the ThreadPool lock held
+   QoreRWLock wl;
+   tpvec_t workers;
+
+   // lock-free stack of submitted tasks not yet taken by a thread (most recently submitted first)
+   std::atomic<ThreadTask*> submitted;
+
+   // number of threads waiting or about to wait in the idle list
+   std::atomic<int> nidle;
 
-   // master task queue
-   taskq_t q;
+   // total number of threads
+   std::atomic<int> nthreads;
 
-   // task waiting flag
-   bool waiting;
+   // number of submit calls in progress; checked when stopping so that no task is queued after the queues are drained
+   std::atomic<int> inflight;
 
-   bool stopflag,   // stop flag
-      stopped,      // stopped flag
-      confirm;      // confirm member thread stop
+   std::atomic<bool> stopflag;   // stop flag
 
-   DLLLOCAL int checkStopUnlocked(const char* m, ExceptionSink* xsink) {
-      if (stopflag) {
+   bool stopped,      // stopped flag
+      confirm;        // confirm member thread stop
+
+   // statistics
+   std::atomic<int64> seq,
+      queued,
+      max_queued,
+      completed,
+      steals,
+      latency_total,
+      latency_max;
+   std::atomic<int64> latency[QTP_LATENCY_BUCKETS];
+
+   DLLLOCAL int checkStop(const char* m, ExceptionSink* xsink) {
+      if (stopflag.load()) {
 	 xsink->raiseException("THREADPOOL-ERROR", "ThreadPool::%s() cannot be executed because the ThreadPool is being destroyed", m);
 	 return -1;
       }
       return 0;
    }
 
-   DLLLOCAL int addIdleWorker(ExceptionSink* xsink) {
-      std::unique_ptr<ThreadPoolThread> tpth(new ThreadPoolThread(*this, xsink));
-      if (!tpth->valid()) {
-	 assert(*xsink);
-	 return -1;
-      }
+   // starts a thread and adds it to the allocated or idle thread list; the lock must be held
+   DLLLOCAL ThreadPoolThread* startThreadUnlocked(bool idle, ExceptionSink* xsink);
 
-      ThreadPoolThread* tpt = tpth.release();
-      fh.push_back(tpt);
-#ifdef DEBUG
-      // set to an invalid iterator
-      tpt->setPos(fh.end());
-#endif
-      return 0;
-   }
+   // queues tasks linked from first to last; wakes up or starts threads if necessary
+   DLLLOCAL int queueTasks(ThreadTask* first, ThreadTask* last, int count, const char* meth, ExceptionSink* xsink);
 
-   DLLLOCAL ThreadPoolThread* getThreadUnlocked(ExceptionSink* xsink) {
-      while (!stopflag && fh.empty() && max && (int)ah.size() == max) {
-	 waiting = true;
-	 cond.wait(m);
-	 waiting = false;
-      }
+   // wakes up idle threads and optionally starts new threads for the given number of tasks
+   DLLLOCAL void notify(int count, bool start);
 
-      if (stopflag)
-	 return 0;
+   // moves an idle thread to the allocated thread list and wakes it up; the lock must be held
+   DLLLOCAL void wakeUnlocked();
 
-      ThreadPoolThread* tpt;
+   // returns the next task for the given thread or 0 if there are no tasks or the thread should stop
+   DLLLOCAL ThreadTask* getTask(ThreadPoolThread* tpt);
 
-      if (!fh.empty()) {
-	 tpt = fh.front();
-	 fh.pop_front();
-      }
-      else {
-	 std::unique_ptr<ThreadPoolThread> tpt_pt(new ThreadPoolThread(*this, xsink));
-	 if (!tpt_pt->valid()) {
-	    assert(*xsink);
-	    return 0;
-	 }
-	 tpt = tpt_pt.release();
-      }
+   // takes all tasks from the submission stack in submission order
+   DLLLOCAL ThreadTask* takeSubmitted(ThreadPoolThread* tpt);
 
-      ah.push_back(tpt);
-      tplist_t::iterator i = ah.end();
-      --i;
-      tpt->setPos(i);
-      return tpt;
-   }
+   // steals a task from another thread
+   DLLLOCAL ThreadTask* steal(ThreadPoolThread* tpt);
+
+   // returns true if there are any queued tasks
+   DLLLOCAL bool hasTasks();
+
+   // runs a task and updates statistics
+   DLLLOCAL void runTask(ThreadTask* task, ExceptionSink* xsink);
+
+   // moves the thread to the idle list and waits until woken up; returns true if the thread should terminate
+   DLLLOCAL bool park(ThreadPoolThread* tpt);
+
+   // waits in the idle list until woken up; returns true if the thread should terminate; the lock must be held
+   DLLLOCAL bool waitIdleUnlocked(ThreadPoolThread* tpt);
+
+   // removes a terminating thread from the pool
+   DLLLOCAL void threadExit(ThreadPoolThread* tpt);
+
+   // stops an idle thread; the lock must be held
+   DLLLOCAL void stopIdleUnlocked(ThreadPoolThread* tpt);
+
+   // removes all queued tasks in submission order
+   DLLLOCAL void drain(taskq_t& q);
 
 public:
    DLLLOCAL ThreadPool(ExceptionSink* xsink, int n_max = 0, int n_minidle = 0, int m_maxidle = 0, int n_release_ms = QTP_DEFAULT_RELEASE_MS);
 
    DLLLOCAL ~ThreadPool() {
-      assert(q.empty());
+      assert(!submitted.load());
       assert(ah.empty());
       assert(fh.empty());
+      assert(workers.empty());
       assert(stopped);
    }
 
@@ -303,8 +331,8 @@ public:
    // does not return until the thread pool has been stopped
    DLLLOCAL void stop() {
       AutoLocker al(m);
-      if (!stopflag) {
-	 stopflag = true;
+      if (!stopflag.load()) {
+	 stopflag.store(true);
 	 cond.signal();
       }
 
@@ -314,14 +342,14 @@ public:
 
    DLLLOCAL int stopWait(ExceptionSink* xsink) {
       AutoLocker al(m);
-      if (stopflag && !confirm) {
+      if (stopflag.load() && !confirm) {
 	 xsink->raiseException("THREADPOOL-ERROR", "cannot call ThreadPool::stopWait() after ()ThreadPool::stop() has been called since child threads have been detached and can no longer be traced");
 	 return -1;
       }
 
-      if (!stopflag) {
-	 stopflag = true;
+      if (!stopflag.load()) {
 	 confirm = true;
+	 stopflag.store(true);
 	 cond.signal();
       }
 
@@ -332,49 +360,23 @@ public:
    }
 
    DLLLOCAL int submit(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc, ExceptionSink* xsink) {
-      // optimistically create the task object outside the lock
+      // create the task object before checking the stop flag so that the references are released in all cases
       ThreadTaskHolder task(new ThreadTask(c, cc), xsink);
-
-      AutoLocker al(m);
-      if (checkStopUnlocked("submit", xsink))
-	  return -1;
-
-      if (q.empty())
-	 cond.signal();
-      q.push_back(task.release());
-
-      return 0;
+      ThreadTask* t = task.release();
+      return queueTasks(t, t, 1, "submit", xsink);
    }
 
+   // submits a list of tasks with a single queue operation; the list must only contain code values
+   DLLLOCAL int submitBatch(const QoreListNode* l, const ResolvedCallReferenceNode* cc, ExceptionSink* xsink);
+
    DLLLOCAL void threadCounts(int& idle, int& running) {
       AutoLocker al(m);
       idle = fh.size();
       running = ah.size();
    }
 
-   DLLLOCAL int done(ThreadPoolThread* tpt) {
-      {
-	 AutoLocker al(m);
-         // allow the thread to be removed from the active list by ThreadPool::worker() to avoid race conditions
-         if (stopflag)
-            return 0;
-
-	 if (!confirm) {
-	    tplist_t::iterator i = tpt->getPos();
-	    ah.erase(i);
-
-            // requeue thread if possible
-            if ((!maxidle && release_ms) || ((int)fh.size() < maxidle) || q.size() > fh.size()) {
-               fh.push_back(tpt);
-               if (waiting || (release_ms && (int)fh.size() > minidle))
-                  cond.signal();
-               return 0;
-            }
-	 }
-      }
-
-      return -1;
-   }
+   // returns a hash of scheduling statistics
+   DLLLOCAL QoreHashNode* getStats();
 
    DLLLOCAL void worker(ExceptionSink* xsink);
 };
@@ -36,6 +36,8 @@
 #include "qore/intern/AbstractStatement.h"
 
 class WhileStatement : public AbstractStatement {
+   friend class QoreBytecodeCompiler;
+
 protected:
    class AbstractQoreNode *cond;
    class StatementBlock *code;
@@ -1158,6 +1158,15 @@ protected:
    bool relative;
 
 public:
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
+   }
+
    DLLLOCAL qore_date_private(bool r = false) : relative(r) {
       if (r)
          d.rel.zero();
@@ -51,6 +51,15 @@ struct qore_list_private {
    bool finalized : 1;
    bool vlist : 1;
 
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
+   }
+
    DLLLOCAL qore_list_private() : entry(0), length(0), allocated(0), obj_count(0), finalized(false), vlist(false) {
    }
 
@@ -34,6 +34,7 @@
 #define _QORE_QORE_NUMBER_PRIVATE_H
 
 #include <cmath>
+#include <climits>
 #include <memory>
 using namespace std;
 
@@ -81,38 +82,112 @@ typedef int (*q_mpfr_unary_func_t)(mpfr_t, const mpfr_t, mpfr_rnd_t);
 // for unary operations on MPFR data without a rounding argument
 typedef int (*q_mpfr_unary_nr_func_t)(mpfr_t, const mpfr_t);
 
+// the maximum number of digits after the decimal point for numbers in the small-value representation
+#define QORE_NUM_SMALL_MAX_SCALE 18
+
+// powers of 10 from 10^0 to 10^QORE_NUM_SMALL_MAX_SCALE
+DLLLOCAL extern const int64 qore_pow10[QORE_NUM_SMALL_MAX_SCALE + 1];
+
+/* numbers that can be represented exactly as a 64-bit scaled decimal integer (ex: 12.34n = 1234 / 10^2) are stored
+   in the small-value representation without an MPFR value, and arithmetic, comparisons and string conversions are
+   performed on the integer value; the value is converted to MPFR ("promoted") on overflow and for all other
+   operations
+
+   the precision that the MPFR value would have is maintained in the small-value representation so that it can be
+   promoted without any loss of information
+*/
 struct qore_number_private_intern {
+   // the MPFR value; only initialized if small is false
    mpfr_t num;
+   // the scaled decimal value in the small-value representation (mant / 10^scale); never LLONG_MIN
+   int64 mant;
+   // the precision of the value in the small-value representation
+   mpfr_prec_t sprec;
+   // the number of digits after the decimal point in the small-value representation
+   unsigned char scale;
+   // true if the value is in the small-value representation
+   bool small;
 
-   DLLLOCAL qore_number_private_intern() {
-      mpfr_init2(num, QORE_DEFAULT_PREC);
+   // creates zero in the small-value representation
+   DLLLOCAL qore_number_private_intern() : mant(0), sprec(QORE_DEFAULT_PREC), scale(0), small(true) {
    }
 
-   DLLLOCAL qore_number_private_intern(mpfr_prec_t prec) {
+   DLLLOCAL qore_number_private_intern(mpfr_prec_t prec) : mant(0), sprec(0), scale(0), small(false) {
       if (prec > QORE_MAX_PREC)
          prec = QORE_MAX_PREC;
       mpfr_init2(num, prec);
    }
 
+   DLLLOCAL qore_number_private_intern(int64 m, unsigned s, mpfr_prec_t prec) : mant(m), sprec(QORE_MIN(prec, QORE_MAX_PREC)), scale(s), small(true) {
+      assert(m != -LLONG_MAX - 1);
+      assert(s <= QORE_NUM_SMALL_MAX_SCALE);
+   }
+
    DLLLOCAL ~qore_number_private_intern() {
-      mpfr_clear(num);
+      if (!small)
+         mpfr_clear(num);
+   }
+
+   // initializes the MPFR value; the value must be in the small-value representation
+   DLLLOCAL void initMpfr(mpfr_prec_t prec) {
+      assert(small);
+      if (prec > QORE_MAX_PREC)
+         prec = QORE_MAX_PREC;
+      mpfr_init2(num, prec);
+      small = false;
+   }
+
+   // converts the value to an MPFR value with the same precision
+   DLLLOCAL void promote() {
+      if (!small)
+         return;
+      mpfr_init2(num, sprec);
+      getMpfr(num);
+      small = false;
+   }
+
+   // sets an initialized MPFR value from the small-value representation
+   DLLLOCAL void getMpfr(mpfr_ptr x) const {
+      assert(small);
+      setMpfr(x, mant, scale);
+   }
+
+   DLLLOCAL mpfr_prec_t getPrec() const {
+      return small ? sprec : mpfr_get_prec(num);
    }
 
-   DLLLOCAL void checkPrec(q_mpfr_binary_func_t func, const mpfr_t r) {
+   // returns the precision for the result of an in-place binary operation with an argument of the given precision
+   DLLLOCAL mpfr_prec_t getInplacePrec(q_mpfr_binary_func_t func, mpfr_prec_t rprec) const {
+      mpfr_prec_t lprec = getPrec();
       mpfr_prec_t prec;
       if (func == mpfr_mul || func == mpfr_div) {
-         prec = mpfr_get_prec(num) + mpfr_get_prec(r);
+         prec = lprec + rprec;
       } else {
-         prec = QORE_MAX(mpfr_get_prec(num), mpfr_get_prec(r)) + 1;
+         prec = QORE_MAX(lprec, rprec) + 1;
+      }
+      // do not grow past the maximum precision with repeated operations
+      if (prec > QORE_MAX_PREC)
+         prec = QORE_MAX_PREC;
+      return prec > lprec ? prec : lprec;
+   }
+
+   DLLLOCAL void checkPrec(q_mpfr_binary_func_t func, mpfr_prec_t rprec) {
+      mpfr_prec_t prec = getInplacePrec(func, rprec);
+      if (prec > getPrec()) {
+         if (small)
+            sprec = prec;
+         else
+            mpfr_prec_round(num, prec, QORE_MPFR_RND);
       }
-      if (prec > mpfr_get_prec(num))
-         mpfr_prec_round(num, prec, QORE_MPFR_RND);
    }
 
    DLLLOCAL void setPrec(mpfr_prec_t prec) {
       if (prec > QORE_MAX_PREC)
          prec = QORE_MAX_PREC;
-      mpfr_prec_round(num, prec, QORE_MPFR_RND);
+      if (small)
+         sprec = prec;
+      else
+         mpfr_prec_round(num, prec, QORE_MPFR_RND);
    }
 
    DLLLOCAL static void do_divide_by_zero(ExceptionSink* xsink) {
@@ -131,12 +206,183 @@ struct qore_number_private_intern {
          xsink->raiseException("INVALID-NUMERIC-OPERATION", "invalid numeric operation attempted");
       }
    }
+
+   // sets an initialized MPFR value to m / 10^s with a single rounding
+   DLLLOCAL static void setMpfr(mpfr_ptr x, int64 m, unsigned s) {
+      if (!s) {
+         mpfr_set_sj(x, m, QORE_MPFR_RND);
+         return;
+      }
+      mpfr_t n, d;
+      mpfr_init2(n, 64);
+      mpfr_init2(d, 64);
+      mpfr_set_sj(n, m, QORE_MPFR_RND);
+      mpfr_set_sj(d, qore_pow10[s], QORE_MPFR_RND);
+      mpfr_div(x, n, d, QORE_MPFR_RND);
+      mpfr_clear(d);
+      mpfr_clear(n);
+   }
+
+   // parses a plain decimal string without an exponent into the small-value representation
+   /** @return true if the string could be parsed, false if not
+    */
+   DLLLOCAL static bool parseSmall(const char* str, int64& m, unsigned& s) {
+      const char* p = str;
+      bool neg = (*p == '-');
+      if (neg || *p == '+')
+         ++p;
+      if (*p < '0' || *p > '9')
+         return false;
+
+      int64 v = 0;
+      unsigned scale = 0;
+      // trailing zeros after the decimal point are only applied when followed by another digit
+      unsigned zeros = 0;
+      bool dp = false;
+      for (; *p; ++p) {
+         if (*p == '.') {
+            if (dp || p[1] < '0' || p[1] > '9')
+               return false;
+            dp = true;
+            continue;
+         }
+         if (*p < '0' || *p > '9')
+            return false;
+         int d = *p - '0';
+         if (dp) {
+            if (!d) {
+               ++zeros;
+               continue;
+            }
+            scale += zeros + 1;
+            if (scale > QORE_NUM_SMALL_MAX_SCALE)
+               return false;
+            for (; zeros; --zeros) {
+               if (v > LLONG_MAX / 10)
+                  return false;
+               v *= 10;
+            }
+         }
+         if (v > (LLONG_MAX - d) / 10)
+            return false;
+         v = v * 10 + d;
+      }
+      // negative zero is only supported by MPFR
+      if (neg && !v)
+         return false;
+      m = neg ? -v : v;
+      s = scale;
+      return true;
+   }
+
+   // returns true if the addition overflows
+   DLLLOCAL static bool addOverflow(int64 a, int64 b, int64& r) {
+      if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < -LLONG_MAX - b))
+         return true;
+      r = a + b;
+      return false;
+   }
+
+   // returns true if the multiplication overflows
+   DLLLOCAL static bool mulOverflow(int64 a, int64 b, int64& r) {
+      // 3037000499 = floor(sqrt(LLONG_MAX))
+      if ((a > 3037000499ll || a < -3037000499ll || b > 3037000499ll || b < -3037000499ll)
+          && a && b && (a < 0 ? -a : a) > LLONG_MAX / (b < 0 ? -b : b))
+         return true;
+      r = a * b;
+      return false;
+   }
+
+   // adds two values in the small-value representation; returns true on overflow
+   DLLLOCAL static bool smallAdd(int64 lm, unsigned ls, int64 rm, unsigned rs, int64& m, unsigned& s) {
+      if (ls < rs) {
+         if (mulOverflow(lm, qore_pow10[rs - ls], lm))
+            return true;
+         ls = rs;
+      } else if (rs < ls) {
+         if (mulOverflow(rm, qore_pow10[ls - rs], rm))
+            return true;
+      }
+      s = ls;
+      return addOverflow(lm, rm, m);
+   }
+
+   // multiplies two values in the small-value representation; returns true on overflow
+   DLLLOCAL static bool smallMultiply(int64 lm, unsigned ls, int64 rm, unsigned rs, int64& m, unsigned& s) {
+      if (mulOverflow(lm, rm, m))
+         return true;
+      s = ls + rs;
+      while (s > QORE_NUM_SMALL_MAX_SCALE) {
+         if (m % 10)
+            return true;
+         m /= 10;
+         --s;
+      }
+      return false;
+   }
+
+   // compares two values in the small-value representation; returns -1, 0, or 1
+   DLLLOCAL static int smallCompare(int64 lm, unsigned ls, int64 rm, unsigned rs) {
+      if (ls != rs) {
+         // compare the integer parts and then the fractional parts scaled to the same number of digits
+         int64 li = lm / qore_pow10[ls];
+         int64 ri = rm / qore_pow10[rs];
+         if (li != ri)
+            return li < ri ? -1 : 1;
+         lm %= qore_pow10[ls];
+         rm %= qore_pow10[rs];
+         if (ls < rs)
+            lm *= qore_pow10[rs - ls];
+         else
+            rm *= qore_pow10[ls - rs];
+      }
+      return lm < rm ? -1 : (lm > rm ? 1 : 0);
+   }
+};
+
+// provides read-only access to the MPFR value of a number in either representation
+class QoreMpfrValueHelper {
+public:
+   DLLLOCAL QoreMpfrValueHelper(const qore_number_private_intern& n) : tmp_init(n.small) {
+      if (tmp_init) {
+         mpfr_init2(tmp, n.sprec);
+         n.getMpfr(tmp);
+         val = tmp;
+      } else
+         val = n.num;
+   }
+
+   DLLLOCAL ~QoreMpfrValueHelper() {
+      if (tmp_init)
+         mpfr_clear(tmp);
+   }
+
+   DLLLOCAL mpfr_srcptr operator*() const {
+      return val;
+   }
+
+private:
+   mpfr_t tmp;
+   mpfr_srcptr val;
+   bool tmp_init;
 };
 
 struct qore_number_private : public qore_number_private_intern {
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
+   }
+
    DLLLOCAL explicit qore_number_private(mpfr_prec_t prec) : qore_number_private_intern(prec) {
    }
 
+   DLLLOCAL qore_number_private(int64 m, unsigned s, mpfr_prec_t prec) : qore_number_private_intern(m, s, prec) {
+   }
+
    DLLLOCAL qore_number_private(double f) {
       /* from the MPFR docs: http://www.mpfr.org/mpfr-current/mpfr.html
          Note: If you want to store a floating-point constant to a mpfr_t, you should use mpfr_set_str
@@ -147,14 +393,34 @@ struct qore_number_private : public qore_number_private_intern {
       */
 
       QoreStringMaker str("%.17g", f);
+      unsigned s;
+      if (parseSmall(str.getBuffer(), mant, s)) {
+         scale = s;
+         return;
+      }
+      initMpfr(QORE_DEFAULT_PREC);
       mpfr_set_str(num, str.getBuffer(), 10, QORE_MPFR_RND);
    }
 
    DLLLOCAL qore_number_private(int64 i) {
+      if (i != -LLONG_MAX - 1) {
+         mant = i;
+         return;
+      }
+      initMpfr(QORE_DEFAULT_PREC);
       mpfr_set_sj(num, i, QORE_MPFR_RND);
    }
 
-   DLLLOCAL qore_number_private(const char* str) : qore_number_private_intern(QORE_MAX(QORE_DEFAULT_PREC, strlen(str)*5)) {
+   DLLLOCAL qore_number_private(const char* str) {
+      mpfr_prec_t prec = QORE_MAX(QORE_DEFAULT_PREC, strlen(str)*5);
+      unsigned s;
+      if (!str[0] || parseSmall(str, mant, s)) {
+         if (str[0])
+            scale = s;
+         sprec = QORE_MIN(prec, QORE_MAX_PREC);
+         return;
+      }
+      initMpfr(prec);
       // see if number has an exponent and increase the number's precision if necessary
       const char* p = strchrs(str, "eE");
       if (p) {
@@ -163,25 +429,51 @@ struct qore_number_private : public qore_number_private_intern {
          if (np > getPrec())
             setPrec(np);
       }
-      if (!str[0])
-         mpfr_set_sj(num, 0, QORE_MPFR_RND);
-      else
-         mpfr_set_str(num, str, 10, QORE_MPFR_RND);
+      mpfr_set_str(num, str, 10, QORE_MPFR_RND);
    }
 
-   DLLLOCAL qore_number_private(const char* str, unsigned prec) : qore_number_private_intern(QORE_MAX(QORE_DEFAULT_PREC, prec)) {
+   DLLLOCAL qore_number_private(const char* str, unsigned prec) {
+      unsigned s;
+      if (parseSmall(str, mant, s)) {
+         scale = s;
+         sprec = QORE_MIN(QORE_MAX(QORE_DEFAULT_PREC, prec), QORE_MAX_PREC);
+         return;
+      }
+      initMpfr(QORE_MAX(QORE_DEFAULT_PREC, prec));
       mpfr_set_str(num, str, 10, QORE_MPFR_RND);
    }
 
-   DLLLOCAL qore_number_private(const qore_number_private& old) : qore_number_private_intern(mpfr_get_prec(old.num)) {
-      mpfr_set(num, old.num, QORE_MPFR_RND);
+   DLLLOCAL qore_number_private(const qore_number_private& old) : qore_number_private_intern(old.mant, old.scale, old.sprec) {
+      if (!old.small) {
+         initMpfr(mpfr_get_prec(old.num));
+         mpfr_set(num, old.num, QORE_MPFR_RND);
+      }
    }
 
    DLLLOCAL double getAsFloat() const {
-      return mpfr_get_d(num, QORE_MPFR_RND);
+      if (small) {
+         // integers up to 2^53 and all powers of 10 used here are exact doubles, so the division is correctly rounded
+         if (mant <= (1ll << 53) && mant >= -(1ll << 53))
+            return scale ? (double)mant / (double)qore_pow10[scale] : (double)mant;
+      }
+      QoreMpfrValueHelper v(*this);
+      return mpfr_get_d(*v, QORE_MPFR_RND);
    }
 
    DLLLOCAL int64 getAsBigInt() const {
+      if (small) {
+         if (!scale)
+            return mant;
+         // round to nearest with ties to even as with QORE_MPFR_RND
+         int64 p = qore_pow10[scale];
+         int64 q = mant / p;
+         int64 r = mant % p;
+         if (r < 0)
+            r = -r;
+         if (r * 2 > p || (r * 2 == p && (q & 1)))
+            q += mant < 0 ? -1 : 1;
+         return q;
+      }
       return mpfr_get_sj(num, QORE_MPFR_RND);
    }
 
@@ -190,36 +482,39 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL bool zero() const {
-      return (bool)mpfr_zero_p(num);
+      return small ? !mant : (bool)mpfr_zero_p(num);
    }
 
    DLLLOCAL bool nan() const {
-      return (bool)mpfr_nan_p(num);
+      return small ? false : (bool)mpfr_nan_p(num);
    }
 
    DLLLOCAL bool inf() const {
-      return (bool)mpfr_inf_p(num);
+      return small ? false : (bool)mpfr_inf_p(num);
    }
 
    DLLLOCAL bool number() const {
-      return (bool)mpfr_number_p(num);
+      return small ? true : (bool)mpfr_number_p(num);
    }
 
 #ifdef HAVE_MPFR_REGULAR
    // regular and not zero
    DLLLOCAL bool regular() const {
-      return (bool)mpfr_regular_p(num);
+      return small ? (bool)mant : (bool)mpfr_regular_p(num);
    }
 #endif
 
    DLLLOCAL int sign() const {
+      if (small)
+         return mant < 0 ? -1 : (mant ? 1 : 0);
       return mpfr_sgn(num);
    }
 
    DLLLOCAL void sprintf(QoreString& str, const char* fmt) const {
+      QoreMpfrValueHelper v(*this);
 #ifdef HAVE_MPFR_SPRINTF
       //printd(5, "qore_number_private::sprintf() fmt: '%s'\n", fmt);
-      int len = mpfr_snprintf(0, 0, fmt, num);
+      int len = mpfr_snprintf(0, 0, fmt, *v);
       if (!len)
          return;
       if (len < 0) {
@@ -227,11 +522,11 @@ struct qore_number_private : public qore_number_private_intern {
          return;
       }
       str.allocate(str.size() + len + 1);
-      mpfr_sprintf((char*)(str.getBuffer() + str.size()), fmt, num);
+      mpfr_sprintf((char*)(str.getBuffer() + str.size()), fmt, *v);
       str.terminate(str.size() + len);
 #else
       // if there is no mpfr_sprintf, then we convert to a long double and output the number
-      long double ld = mpfr_get_ld(num, QORE_MPFR_RND);
+      long double ld = mpfr_get_ld(*v, QORE_MPFR_RND);
       int len = ::snprintf(0, 0, fmt, ld);
       if (len <= 0)
          return;
@@ -277,19 +572,41 @@ struct qore_number_private : public qore_number_private_intern {
       return formatNumberString(str, prec, dsep_str, tsep_str, xsink);
    }
 
+   // returns true if both values are in the small-value representation and sets the comparison result
+   DLLLOCAL bool compareSmall(const qore_number_private& right, int& rc) const {
+      if (!small || !right.small)
+         return false;
+      rc = smallCompare(mant, scale, right.mant, right.scale);
+      return true;
+   }
+
+   // returns true if the value is an integer in the small-value representation that can be compared exactly with a double
+   DLLLOCAL bool isSmallDoubleInt() const {
+      return small && !scale && mant <= (1ll << 53) && mant >= -(1ll << 53);
+   }
+
    DLLLOCAL bool lessThan(const qore_number_private& right) const {
-      return mpfr_less_p(num, right.num);
+      int rc;
+      if (compareSmall(right, rc))
+         return rc < 0;
+      QoreMpfrValueHelper l(*this), r(right);
+      return mpfr_less_p(*l, *r);
    }
 
    DLLLOCAL bool lessThan(double right) const {
+      if (isSmallDoubleInt())
+         return (double)mant < right;
+      QoreMpfrValueHelper l(*this);
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
-      if (mpfr_nan_p(num) || std::isnan(right)) // If any of the "numbers" is NaN.
+      if (mpfr_nan_p(*l) || std::isnan(right)) // If any of the "numbers" is NaN.
          return false;
       mpfr_set_d(r, right, QORE_MPFR_RND);
-      return mpfr_less_p(num, r);
+      return mpfr_less_p(*l, r);
    }
 
    DLLLOCAL bool lessThan(int64 right) const {
+      if (small)
+         return smallCompare(mant, scale, right, 0) < 0;
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
       if (mpfr_nan_p(num)) // If the number is NaN.
          return false;
@@ -298,18 +615,27 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL bool lessThanOrEqual(const qore_number_private& right) const {
-      return mpfr_lessequal_p(num, right.num);
+      int rc;
+      if (compareSmall(right, rc))
+         return rc <= 0;
+      QoreMpfrValueHelper l(*this), r(right);
+      return mpfr_lessequal_p(*l, *r);
    }
 
    DLLLOCAL bool lessThanOrEqual(double right) const {
+      if (isSmallDoubleInt())
+         return (double)mant <= right;
+      QoreMpfrValueHelper l(*this);
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
-      if (mpfr_nan_p(num) || std::isnan(right)) // If any of the "numbers" is NaN.
+      if (mpfr_nan_p(*l) || std::isnan(right)) // If any of the "numbers" is NaN.
          return false;
       mpfr_set_d(r, right, QORE_MPFR_RND);
-      return mpfr_lessequal_p(num, r);
+      return mpfr_lessequal_p(*l, r);
    }
 
    DLLLOCAL bool lessThanOrEqual(int64 right) const {
+      if (small)
+         return smallCompare(mant, scale, right, 0) <= 0;
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
       if (mpfr_nan_p(num)) // If the number is NaN.
          return false;
@@ -318,18 +644,27 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL bool greaterThan(const qore_number_private& right) const {
-      return mpfr_greater_p(num, right.num);
+      int rc;
+      if (compareSmall(right, rc))
+         return rc > 0;
+      QoreMpfrValueHelper l(*this), r(right);
+      return mpfr_greater_p(*l, *r);
    }
 
    DLLLOCAL bool greaterThan(double right) const {
+      if (isSmallDoubleInt())
+         return (double)mant > right;
+      QoreMpfrValueHelper l(*this);
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
-      if (mpfr_nan_p(num) || std::isnan(right)) // If any of the "numbers" is NaN.
+      if (mpfr_nan_p(*l) || std::isnan(right)) // If any of the "numbers" is NaN.
          return false;
       mpfr_set_d(r, right, QORE_MPFR_RND);
-      return mpfr_greater_p(num, r);
+      return mpfr_greater_p(*l, r);
    }
 
    DLLLOCAL bool greaterThan(int64 right) const {
+      if (small)
+         return smallCompare(mant, scale, right, 0) > 0;
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
       if (mpfr_nan_p(num)) // If the number is NaN.
          return false;
@@ -338,18 +673,27 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL bool greaterThanOrEqual(const qore_number_private& right) const {
-      return mpfr_greaterequal_p(num, right.num);
+      int rc;
+      if (compareSmall(right, rc))
+         return rc >= 0;
+      QoreMpfrValueHelper l(*this), r(right);
+      return mpfr_greaterequal_p(*l, *r);
    }
 
    DLLLOCAL bool greaterThanOrEqual(double right) const {
+      if (isSmallDoubleInt())
+         return (double)mant >= right;
+      QoreMpfrValueHelper l(*this);
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
-      if (mpfr_nan_p(num) || std::isnan(right)) // If any of the "numbers" is NaN.
+      if (mpfr_nan_p(*l) || std::isnan(right)) // If any of the "numbers" is NaN.
          return false;
       mpfr_set_d(r, right, QORE_MPFR_RND);
-      return mpfr_greaterequal_p(num, r);
+      return mpfr_greaterequal_p(*l, r);
    }
 
    DLLLOCAL bool greaterThanOrEqual(int64 right) const {
+      if (small)
+         return smallCompare(mant, scale, right, 0) >= 0;
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
       if (mpfr_nan_p(num)) // If the number is NaN.
          return false;
@@ -358,16 +702,25 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL bool equals(const qore_number_private& right) const {
-      return mpfr_equal_p(num, right.num);
+      int rc;
+      if (compareSmall(right, rc))
+         return !rc;
+      QoreMpfrValueHelper l(*this), r(right);
+      return mpfr_equal_p(*l, *r);
    }
 
    DLLLOCAL bool equals(double right) const {
-      if (mpfr_nan_p(num) || std::isnan(right)) // If any of the "numbers" is NaN.
+      if (isSmallDoubleInt())
+         return (double)mant == right;
+      QoreMpfrValueHelper l(*this);
+      if (mpfr_nan_p(*l) || std::isnan(right)) // If any of the "numbers" is NaN.
          return false;
-      return 0 == mpfr_cmp_d(num, right);
+      return 0 == mpfr_cmp_d(*l, right);
    }
 
    DLLLOCAL bool equals(int64 right) const {
+      if (small)
+         return !smallCompare(mant, scale, right, 0);
       MPFR_TMP_VAR(r, QORE_DEFAULT_PREC);
       if (mpfr_nan_p(num)) // If the number is NaN.
          return false;
@@ -375,17 +728,21 @@ struct qore_number_private : public qore_number_private_intern {
       return mpfr_equal_p(num, r);
    }
 
+   // returns the precision for the result of a binary operation
+   DLLLOCAL mpfr_prec_t getBinaryPrec(q_mpfr_binary_func_t func, const qore_number_private& r) const {
+      if (func == mpfr_pow)
+         return getPrec() * QORE_MIN(QORE_MAX_PREC, r.getAsBigInt());
+      if (func == mpfr_mul || func == mpfr_div)
+         return getPrec() + r.getPrec();
+      return QORE_MAX(getPrec(), r.getPrec()) + 1;
+   }
+
    DLLLOCAL qore_number_private* doBinary(q_mpfr_binary_func_t func, const qore_number_private& r, ExceptionSink* xsink = 0) const {
-      mpfr_prec_t prec;
-      if (func == mpfr_pow) {
-         prec = mpfr_get_prec(num) * QORE_MIN(QORE_MAX_PREC, r.getAsBigInt());
-      } else if (func == mpfr_mul || func == mpfr_div) {
-         prec = mpfr_get_prec(num) + mpfr_get_prec(r.num);
-      } else {
-         prec = QORE_MAX(mpfr_get_prec(num), mpfr_get_prec(r.num)) + 1;
+      std::unique_ptr<qore_number_private> p(new qore_number_private(getBinaryPrec(func, r)));
+      {
+         QoreMpfrValueHelper lv(*this), rv(r);
+         func(p->num, *lv, *rv, QORE_MPFR_RND);
       }
-      std::unique_ptr<qore_number_private> p(new qore_number_private(prec));
-      func(p->num, num, r.num, QORE_MPFR_RND);
       if (xsink)
          checkFlags(xsink);
 
@@ -393,14 +750,26 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL qore_number_private* doPlus(const qore_number_private& r) const {
+      int64 m;
+      unsigned s;
+      if (small && r.small && !smallAdd(mant, scale, r.mant, r.scale, m, s))
+         return new qore_number_private(m, s, getBinaryPrec(mpfr_add, r));
       return doBinary(mpfr_add, r);
    }
 
    DLLLOCAL qore_number_private* doMinus(const qore_number_private& r) const {
+      int64 m;
+      unsigned s;
+      if (small && r.small && !smallAdd(mant, scale, -r.mant, r.scale, m, s))
+         return new qore_number_private(m, s, getBinaryPrec(mpfr_sub, r));
       return doBinary(mpfr_sub, r);
    }
 
    DLLLOCAL qore_number_private* doMultiply(const qore_number_private& r) const {
+      int64 m;
+      unsigned s;
+      if (small && r.small && !smallMultiply(mant, scale, r.mant, r.scale, m, s))
+         return new qore_number_private(m, s, getBinaryPrec(mpfr_mul, r));
       return doBinary(mpfr_mul, r);
    }
 
@@ -416,7 +785,13 @@ struct qore_number_private : public qore_number_private_intern {
 
    DLLLOCAL qore_number_private* doUnary(q_mpfr_unary_func_t func, ExceptionSink* xsink = 0) const {
       qore_number_private* p = new qore_number_private(*this);
-      func(p->num, num, QORE_MPFR_RND);
+      if (small && (func == mpfr_neg || func == mpfr_abs)) {
+         if (func == mpfr_neg || mant < 0)
+            p->mant = -mant;
+         return p;
+      }
+      p->promote();
+      func(p->num, p->num, QORE_MPFR_RND);
       if (xsink)
          checkFlags(xsink);
 
@@ -424,7 +799,10 @@ struct qore_number_private : public qore_number_private_intern {
    }
 
    DLLLOCAL void negateInPlace() {
-      mpfr_neg(num, num, QORE_MPFR_RND);
+      if (small)
+         mant = -mant;
+      else
+         mpfr_neg(num, num, QORE_MPFR_RND);
    }
 
    DLLLOCAL qore_number_private* negate() const {
@@ -437,7 +815,8 @@ struct qore_number_private : public qore_number_private_intern {
 
    DLLLOCAL qore_number_private* doUnaryNR(q_mpfr_unary_nr_func_t func, ExceptionSink* xsink = 0) const {
       qore_number_private* p = new qore_number_private(*this);
-      func(p->num, num);
+      p->promote();
+      func(p->num, p->num);
       if (xsink)
          checkFlags(xsink);
 
@@ -449,7 +828,8 @@ struct qore_number_private : public qore_number_private_intern {
         unique_ptr<qore_number_private> p0(new qore_number_private(*this));
 
         if (prec == 0) {
-            func(p0 -> num, num);
+            p0 -> promote();
+            func(p0 -> num, p0 -> num);
 
             if (xsink)
                 checkFlags(xsink);
@@ -462,6 +842,7 @@ struct qore_number_private : public qore_number_private_intern {
         if (prec > 0) {
             unique_ptr<qore_number_private> c(new qore_number_private(pow(10, prec)));
             unique_ptr<qore_number_private> p1(p0 -> doMultiply(*c));
+            p1 -> promote();
             func(p1 -> num, p1 -> num);
             p2 = p1 -> doDivideBy(*c, xsink);
         }
@@ -478,42 +859,68 @@ struct qore_number_private : public qore_number_private_intern {
         return p2;
     }
 
-   DLLLOCAL mpfr_prec_t getPrec() const {
-      return mpfr_get_prec(num);
-   }
-
    DLLLOCAL void inc() {
+      if (small && !addOverflow(mant, qore_pow10[scale], mant))
+         return;
+      promote();
       MPFR_TMP_VAR(tmp, mpfr_get_prec(num));
       mpfr_set(tmp, num, QORE_MPFR_RND);
       mpfr_add_si(num, tmp, 1, QORE_MPFR_RND);
    }
 
    DLLLOCAL void dec() {
+      if (small && !addOverflow(mant, -qore_pow10[scale], mant))
+         return;
+      promote();
       MPFR_TMP_VAR(tmp, mpfr_get_prec(num));
       mpfr_set(tmp, num, QORE_MPFR_RND);
       mpfr_sub_si(num, tmp, 1, QORE_MPFR_RND);
    }
 
    DLLLOCAL void doBinaryInplace(q_mpfr_binary_func_t func, const qore_number_private& r, ExceptionSink* xsink = 0) {
-      checkPrec(func, r.num);
+      promote();
+      checkPrec(func, r.getPrec());
+      QoreMpfrValueHelper rv(r);
       // some compilers (sun/oracle pro c++ notably) do not support arrays with a variable size
       // if not, we can't use the stack for the temporary variable and have to use a dynamically-allocated one
       MPFR_TMP_VAR(tmp, mpfr_get_prec(num));
       mpfr_set(tmp, num, QORE_MPFR_RND);
-      func(num, tmp, r.num, QORE_MPFR_RND);
+      func(num, tmp, *rv, QORE_MPFR_RND);
       if (xsink)
          checkFlags(xsink);
    }
 
+   // performs an in-place addition in the small-value representation; returns true if not possible
+   DLLLOCAL bool smallAddInplace(q_mpfr_binary_func_t func, int64 rm, const qore_number_private& r) {
+      int64 m;
+      unsigned s;
+      if (!small || !r.small || smallAdd(mant, scale, rm, r.scale, m, s))
+         return true;
+      sprec = getInplacePrec(func, r.sprec);
+      mant = m;
+      scale = s;
+      return false;
+   }
+
    DLLLOCAL void plusEquals(const qore_number_private& r) {
-      doBinaryInplace(mpfr_add, r);
+      if (smallAddInplace(mpfr_add, r.mant, r))
+         doBinaryInplace(mpfr_add, r);
    }
 
    DLLLOCAL void minusEquals(const qore_number_private& r) {
-      doBinaryInplace(mpfr_sub, r);
+      if (smallAddInplace(mpfr_sub, -r.mant, r))
+         doBinaryInplace(mpfr_sub, r);
    }
 
    DLLLOCAL void multiplyEquals(const qore_number_private& r) {
+      int64 m;
+      unsigned s;
+      if (small && r.small && !smallMultiply(mant, scale, r.mant, r.scale, m, s)) {
+         sprec = getInplacePrec(mpfr_mul, r.sprec);
+         mant = m;
+         scale = s;
+         return;
+      }
       doBinaryInplace(mpfr_mul, r);
    }
 
@@ -536,6 +943,13 @@ protected:
    // assumes dsep, tsep and num all have the same encoding
    DLLLOCAL static int formatNumberStringIntern(QoreString& num, int prec, const QoreString& dsep, const QoreString& tsep, ExceptionSink* xsink);
 
+   // formats an MPFR value as a decimal string
+   DLLLOCAL static void getMpfrString(mpfr_srcptr x, QoreString& str, bool round);
+
+   // formats a value in the small-value representation as a decimal string; returns false if the string would be
+   // subject to the rounding heuristic for MPFR values, in which case nothing is added to the string
+   DLLLOCAL bool getSmallString(QoreString& str) const;
+
 public:
    DLLLOCAL static void numError(QoreString& str) {
       str.concat("<number error>");
@@ -605,7 +1019,7 @@ public:
    }
 
    DLLLOCAL static QoreNumberNode* getPi() {
-      qore_number_private* p = new qore_number_private(0ll);
+      qore_number_private* p = new qore_number_private((mpfr_prec_t)QORE_DEFAULT_PREC);
       mpfr_const_pi(p->num, QORE_MPFR_RND);
       return new QoreNumberNode(p);
    }
@@ -91,7 +91,71 @@ public:
 typedef QoreThreadLocalStorage<QoreHashNode> qpgm_thread_local_storage_t;
 
 class ThreadLocalVariableData : public ThreadLocalData<LocalVarValue> {
+protected:
+   // the state of the stack before a local variable frame was reserved
+   struct FrameState {
+      Block* block;
+      int pos;
+      LocalVarValue* frame;
+      unsigned size;
+
+      DLLLOCAL FrameState(Block* b, int p, LocalVarValue* f, unsigned s) : block(b), pos(p), frame(f), size(s) {
+      }
+   };
+   typedef std::vector<FrameState> frame_vec_t;
+
+   // saved frame states for active calls of user code
+   frame_vec_t fstack;
+
 public:
+   // the local variable frame of the current call of user code; variables with a frame slot are stored here
+   LocalVarValue* frame;
+   // the number of slots in the current frame
+   unsigned frame_size;
+
+   DLLLOCAL ThreadLocalVariableData() : frame(0), frame_size(0) {
+   }
+
+   // reserves a contiguous frame of n variables on the stack for a call of user code
+   DLLLOCAL void enterFrame(unsigned n) {
+      fstack.push_back(FrameState(curr, curr->pos, frame, frame_size));
+      frame_size = n;
+      if (!n) {
+         frame = 0;
+         return;
+      }
+      assert(n <= QORE_THREAD_STACK_BLOCK);
+      if (curr->pos + (int)n > QORE_THREAD_STACK_BLOCK) {
+         // mark the unused entries at the end of the block so they cannot be found by name
+         for (int i = curr->pos; i < QORE_THREAD_STACK_BLOCK; ++i)
+            curr->var[i].id = 0;
+         curr->pos = QORE_THREAD_STACK_BLOCK;
+         if (!curr->next)
+            curr->next = new Block(curr);
+         curr = curr->next;
+      }
+      frame = &curr->var[curr->pos];
+      for (unsigned i = 0; i < n; ++i)
+         frame[i].id = 0;
+      curr->pos += n;
+   }
+
+   // releases the current frame and restores the previous one
+   DLLLOCAL void exitFrame() {
+      assert(!fstack.empty());
+      const FrameState& fs = fstack.back();
+      if (frame_size) {
+         while (curr != fs.block) {
+            curr->pos = 0;
+            curr = curr->prev;
+         }
+         curr->pos = fs.pos;
+      }
+      frame = fs.frame;
+      frame_size = fs.size;
+      fstack.pop_back();
+   }
+
    // marks all variables as finalized on the stack
    DLLLOCAL void finalize(arg_vec_t*& cl) {
       ThreadLocalVariableData::iterator i(curr);
@@ -112,7 +176,12 @@ public:
          uninstantiate(xsink);
    }
 
-   DLLLOCAL LocalVarValue* instantiate() {
+   DLLLOCAL LocalVarValue* instantiate(int slot) {
+      if (slot >= 0) {
+         assert((unsigned)slot < frame_size);
+         return &frame[slot];
+      }
+
       if (curr->pos == QORE_THREAD_STACK_BLOCK) {
 	 if (curr->next)
 	    curr = curr->next;
@@ -130,7 +199,23 @@ public:
       curr->var[curr->pos].uninstantiate(xsink);
    }
 
-   DLLLOCAL void uninstantiateSelf() {
+   DLLLOCAL void uninstantiate(int slot, ExceptionSink* xsink) {
+      if (slot < 0) {
+         uninstantiate(xsink);
+         return;
+      }
+      assert((unsigned)slot < frame_size);
+      frame[slot].uninstantiate(xsink);
+      frame[slot].id = 0;
+   }
+
+   DLLLOCAL void uninstantiateSelf(int slot) {
+      if (slot >= 0) {
+         assert((unsigned)slot < frame_size);
+         frame[slot].uninstantiateSelf();
+         frame[slot].id = 0;
+         return;
+      }
       uninstantiateIntern();
       curr->var[curr->pos].uninstantiateSelf();
    }
@@ -147,7 +232,16 @@ public:
       --curr->pos;
    }
 
-   DLLLOCAL LocalVarValue* find(const char* id) {
+   // finds the variable in the current frame if it has a slot, otherwise searches the stack by name
+   DLLLOCAL LocalVarValue* find(const char* id, int slot) {
+      if (slot >= 0) {
+         assert((unsigned)slot < frame_size);
+         assert(frame[slot].id == id);
+         // skipped entries are searched by name to find the variable in the calling frame
+         if (!frame[slot].skip)
+            return &frame[slot];
+      }
+
       Block* w = curr;
       while (true) {
 	 int p = w->pos;
@@ -175,6 +269,21 @@ public:
 
 class ThreadClosureVariableStack : public ThreadLocalData<ClosureVarValue*> {
 private:
+   // the state of the stack before a closure variable frame was reserved
+   struct FrameState {
+      Block* block;
+      int pos;
+      ClosureVarValue** frame;
+      unsigned size;
+
+      DLLLOCAL FrameState(Block* b, int p, ClosureVarValue** f, unsigned s) : block(b), pos(p), frame(f), size(s) {
+      }
+   };
+   typedef std::vector<FrameState> frame_vec_t;
+
+   // saved frame states for active calls of user code
+   frame_vec_t fstack;
+
    DLLLOCAL void instantiateIntern(ClosureVarValue* cvar) {
       //printd(5, "ThreadClosureVariableStack::instantiateIntern(%p = '%s') this: %p pgm: %p\n", cvar->id, cvar->id, this, getProgram());
 
@@ -191,10 +300,59 @@ private:
    }
 
 public:
+   // the closure variable frame of the current call of user code; empty slots are 0
+   ClosureVarValue** frame;
+   // the number of slots in the current frame
+   unsigned frame_size;
+
+   DLLLOCAL ThreadClosureVariableStack() : frame(0), frame_size(0) {
+   }
+
+   // reserves a contiguous frame of n closure variables on the stack for a call of user code
+   DLLLOCAL void enterFrame(unsigned n) {
+      fstack.push_back(FrameState(curr, curr->pos, frame, frame_size));
+      frame_size = n;
+      if (!n) {
+         frame = 0;
+         return;
+      }
+      assert(n <= QORE_THREAD_STACK_BLOCK);
+      if (curr->pos + (int)n > QORE_THREAD_STACK_BLOCK) {
+         for (int i = curr->pos; i < QORE_THREAD_STACK_BLOCK; ++i)
+            curr->var[i] = 0;
+         curr->pos = QORE_THREAD_STACK_BLOCK;
+         if (!curr->next)
+            curr->next = new Block(curr);
+         curr = curr->next;
+      }
+      frame = &curr->var[curr->pos];
+      for (unsigned i = 0; i < n; ++i)
+         frame[i] = 0;
+      curr->pos += n;
+   }
+
+   // releases the current frame and restores the previous one
+   DLLLOCAL void exitFrame() {
+      assert(!fstack.empty());
+      const FrameState& fs = fstack.back();
+      if (frame_size) {
+         while (curr != fs.block) {
+            curr->pos = 0;
+            curr = curr->prev;
+         }
+         curr->pos = fs.pos;
+      }
+      frame = fs.frame;
+      frame_size = fs.size;
+      fstack.pop_back();
+   }
+
    // marks all variables as finalized on the stack
    DLLLOCAL void finalize(arg_vec_t*& cl) {
       ThreadClosureVariableStack::iterator i(curr);
       while (i.next()) {
+         if (!i.get())
+            continue;
          AbstractQoreNode* n = i.get()->finalize();
          if (n && n->isReferenceCounted()) {
             if (!cl)
@@ -210,9 +368,15 @@ public:
          uninstantiate(xsink);
    }
 
-   DLLLOCAL ClosureVarValue* instantiate(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
+   DLLLOCAL ClosureVarValue* instantiate(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval, int slot) {
       ClosureVarValue* cvar = new ClosureVarValue(id, typeInfo, nval);
-      instantiateIntern(cvar);
+      if (slot >= 0) {
+         assert((unsigned)slot < frame_size);
+         assert(!frame[slot]);
+         frame[slot] = cvar;
+      }
+      else
+         instantiateIntern(cvar);
       return cvar;
    }
 
@@ -235,17 +399,42 @@ public:
 	 }
 	 curr = curr->prev;
       }
-      curr->var[--curr->pos]->deref(xsink);
+      ClosureVarValue* cvar = curr->var[--curr->pos];
+      // empty frame slots are only found when the stack is deleted
+      if (cvar)
+         cvar->deref(xsink);
    }
 
-   DLLLOCAL ClosureVarValue* find(const char* id) {
+   DLLLOCAL void uninstantiate(int slot, ExceptionSink* xsink) {
+      if (slot < 0) {
+         uninstantiate(xsink);
+         return;
+      }
+      assert((unsigned)slot < frame_size);
+      ClosureVarValue* cvar = frame[slot];
+      frame[slot] = 0;
+      cvar->deref(xsink);
+   }
+
+   // finds the variable in the current frame if it has a slot there, otherwise searches the stack by name
+   /* variables are also looked up outside of their frame when closures are created in background threads
+   */
+   DLLLOCAL ClosureVarValue* find(const char* id, int slot) {
+      if (slot >= 0 && (unsigned)slot < frame_size) {
+         ClosureVarValue* cvar = frame[slot];
+         if (cvar && cvar->id == id && !cvar->skip)
+            return cvar;
+      }
+
       printd(5, "ThreadClosureVariableStack::find() this: %p id: %p\n", this, id);
       Block* w = curr;
       while (true) {
          int p = w->pos;
          while (p) {
-	    printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p checking %p '%s' skip: %d\n", id, id, this, w->var[p - 1]->id, w->var[p - 1]->id, w->var[p - 1]->skip);
-	    if (w->var[--p]->id == id && !w->var[p]->skip) {
+            if (!w->var[--p])
+               continue;
+	    printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p checking %p '%s' skip: %d\n", id, id, this, w->var[p]->id, w->var[p]->id, w->var[p]->skip);
+	    if (w->var[p]->id == id && !w->var[p]->skip) {
 	       printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p returning: %p\n", id, id, this, w->var[p]);
 	       return w->var[p];
 	    }
@@ -256,7 +445,8 @@ public:
 	    printd(0, "ThreadClosureVariableStack::find() this: %p no closure-bound local variable '%s' (%p) on stack (pgm: %p) p: %d curr->prev: %p\n", this, id, id, getProgram(), p, curr->prev);
             p = curr->pos - 1;
             while (p >= 0) {
-               printd(0, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p]->id, curr->var[p]->id, curr->var[p]->skip);
+               if (curr->var[p])
+                  printd(0, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p]->id, curr->var[p]->id, curr->var[p]->skip);
                --p;
             }
          }
@@ -274,6 +464,8 @@ public:
          int p = w->pos;
          while (p) {
             --p;
+            if (!w->var[p])
+               continue;
             if (!cv)
                cv = new cvv_vec_t;
             cv->push_back(w->var[p]->refSelf());
@@ -363,6 +555,7 @@ public:
    unsigned thread_count;   // number of threads currently running in this Program
    unsigned thread_waiting; // number of threads waiting on all threads to terminate or parsing to complete
    unsigned parse_count;    // recursive parse count
+   std::atomic<unsigned> bytecode_count; // number of function variants compiled to bytecode
 
    // to save file names for later deleting
    cstr_vector_t fileList;
@@ -436,7 +629,7 @@ public:
    QoreProgram* pgm;
 
    DLLLOCAL qore_program_private_base(QoreProgram* n_pgm, int64 n_parse_options, QoreProgram* p_pgm = 0)
-      : thread_count(0), thread_waiting(0), parse_count(0), plock(&ma_recursive), parseSink(0), warnSink(0), pendingParseSink(0), RootNS(0), QoreNS(0),
+      : thread_count(0), thread_waiting(0), parse_count(0), bytecode_count(0), plock(&ma_recursive), parseSink(0), warnSink(0), pendingParseSink(0), RootNS(0), QoreNS(0),
         only_first_except(false), po_locked(false), po_allow_restrict(true), exec_class(false), base_object(false),
         requires_exception(false), tclear(0),
         exceptions_raised(0), ptid(0), pwo(n_parse_options), dom(0), pend_dom(0), thread_local_storage(0), twaiting(0),
@@ -1614,6 +1807,14 @@ public:
       return pgm.priv;
    }
 
+   DLLLOCAL static void incBytecodeCount(QoreProgram& pgm) {
+      pgm.priv->bytecode_count.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   DLLLOCAL static unsigned getBytecodeCount(const QoreProgram& pgm) {
+      return pgm.priv->bytecode_count.load(std::memory_order_relaxed);
+   }
+
    DLLLOCAL static void clearThreadData(QoreProgram& pgm, ExceptionSink* xsink) {
       pgm.priv->clearThreadData(xsink);
    }
@@ -33,6 +33,7 @@
 #define _QORE_INTERN_QORE_QF_PRIVATE_H
 
 #include "qore/intern/QC_Queue.h"
+#include "qore/intern/QoreMappedRegion.h"
 #ifdef HAVE_TERMIOS_H
 #include "qore/intern/QC_TermIOS.h"
 #endif
@@ -65,26 +66,59 @@ struct qore_qf_private {
    int fd;
    bool is_open;
    bool special_file;
+   // true if the file is connected to a terminal device
+   bool tty;
    const QoreEncoding* charset;
    std::string filename;
    mutable QoreThreadLock m;
    Queue* cb_queue;
+   // read-ahead buffer shared by all read operations; DEFAULT_FILE_BUFSIZE bytes allocated on demand
+   // rbuf[0] corresponds to the file offset (kernel position - rbuf_len); rbuf_pos is the logical read position in the buffer
+   mutable char* rbuf;
+   mutable qore_size_t rbuf_pos, rbuf_len;
+   // maximum number of bytes read ahead with a single read(2); 1 for terminals and system files so that no more data is consumed than requested
+   qore_size_t rbuf_size;
+   // read-only mapping of the file's contents; when set, rbuf points to the mapping, rbuf_len is the mapped size and
+   // the file descriptor is positioned at the end of the mapping, so the read-ahead buffer invariants hold unchanged
+   mutable QoreMappedRegion* mapping;
 
    DLLLOCAL qore_qf_private(const QoreEncoding* cs) : is_open(false),
 						      special_file(false),
+						      tty(false),
 						      charset(cs),
-						      cb_queue(0) {
+						      cb_queue(0),
+						      rbuf(0),
+						      rbuf_pos(0),
+						      rbuf_len(0),
+						      rbuf_size(1),
+						      mapping(0) {
    }
 
    DLLLOCAL ~qore_qf_private() {
       close_intern();
+      free(rbuf);
 
       // must be dereferenced and removed before deleting
       assert(!cb_queue);
    }
 
+   DLLLOCAL void makeSpecial(int sfd) {
+      is_open = true;
+      filename.clear();
+      charset = QCS_DEFAULT;
+      special_file = true;
+      fd = sfd;
+      tty = (bool)isatty(fd);
+      // system files may be shared with other code or processes, so no data is read ahead
+      rbuf_size = 1;
+      rbuf_pos = rbuf_len = 0;
+   }
+
    DLLLOCAL int close_intern() {
       filename.clear();
+      if (mapping)
+         unmapIntern();
+      rbuf_pos = rbuf_len = 0;
 
       int rc;
       if (is_open) {
@@ -125,6 +159,8 @@ struct qore_qf_private {
       if (cs)
 	 charset = cs;
       is_open = true;
+      tty = (bool)isatty(fd);
+      rbuf_size = tty ? 1 : DEFAULT_FILE_BUFSIZE;
       return 0;
    }
 
@@ -253,6 +289,8 @@ struct qore_qf_private {
 
    // assumes lock is held and file is open
    DLLLOCAL bool isDataAvailableIntern(int timeout_ms, const char* mname, ExceptionSink *xsink) const {
+      if (rbuf_pos < rbuf_len)
+         return true;
       return select(timeout_ms, true, mname, xsink);
    }
 
@@ -276,8 +314,8 @@ struct qore_qf_private {
    }
 #endif
 
-   // unlocked, assumes file is open
-   DLLLOCAL qore_size_t read(void *buf, qore_size_t bs) const {
+   // unlocked, assumes file is open; reads directly from the file, bypassing the read-ahead buffer
+   DLLLOCAL qore_offset_t readRaw(void *buf, qore_size_t bs) const {
       qore_offset_t rc;
       while (true) {
 	 rc = ::read(fd, buf, bs);
@@ -292,8 +330,101 @@ struct qore_qf_private {
       return rc;
    }
 
+   // unlocked, assumes file is open; reads more data into the read-ahead buffer
+   // returns the number of bytes read, 0 for EOF, or -1 for errors
+   DLLLOCAL qore_offset_t fillBuffer() const {
+      // mapped files are only read up to the end of the mapping
+      if (mapping)
+         return 0;
+
+      if (!rbuf)
+         rbuf = (char*)malloc(sizeof(char) * DEFAULT_FILE_BUFSIZE);
+      // move any unread data to the start of the buffer
+      else if (rbuf_pos == rbuf_len)
+         rbuf_pos = rbuf_len = 0;
+      else if (rbuf_len == DEFAULT_FILE_BUFSIZE) {
+         memmove(rbuf, rbuf + rbuf_pos, rbuf_len - rbuf_pos);
+         rbuf_len -= rbuf_pos;
+         rbuf_pos = 0;
+      }
+
+      qore_size_t bs = DEFAULT_FILE_BUFSIZE - rbuf_len;
+      if (bs > rbuf_size)
+         bs = rbuf_size;
+      qore_offset_t rc = readRaw(rbuf + rbuf_len, bs);
+      if (rc > 0)
+         rbuf_len += rc;
+      return rc;
+   }
+
+   // unlocked, assumes file is open; makes sure that at least "n" unread bytes are buffered if possible
+   // returns the number of unread bytes in the buffer
+   DLLLOCAL qore_size_t ensureBuffered(qore_size_t n) const {
+      while (rbuf_len - rbuf_pos < n && fillBuffer() > 0)
+         ;
+      return rbuf_len - rbuf_pos;
+   }
+
+   // unlocked; empties the read-ahead buffer once its data has been consumed so that data read past it is never served from it
+   DLLLOCAL void resetBuffer() const {
+      assert(rbuf_pos == rbuf_len);
+      rbuf_pos = rbuf_len = 0;
+   }
+
+   // unlocked; discards unread data in the read-ahead buffer and moves the file position back to the logical read position
+   // if the descriptor cannot be repositioned (pipes, FIFOs, sockets), the unread data is kept for later reads
+   DLLLOCAL void discardBuffer() const {
+      if (mapping) {
+         unmapIntern();
+         return;
+      }
+      if (rbuf_pos < rbuf_len && lseek(fd, -(off_t)(rbuf_len - rbuf_pos), SEEK_CUR) < 0)
+         return;
+      rbuf_pos = rbuf_len = 0;
+   }
+
+   // unlocked, assumes file is open; reads up to "bs" bytes, serving buffered data first
+   // large reads are made directly into the caller's buffer
+   DLLLOCAL qore_size_t read(void *buf, qore_size_t bs) const {
+      qore_size_t br = rbuf_len - rbuf_pos;
+      if (br) {
+         if (br > bs)
+            br = bs;
+         memcpy(buf, rbuf + rbuf_pos, br);
+         rbuf_pos += br;
+         if (br == bs)
+            return br;
+      }
+
+      if (mapping)
+         return br;
+
+      qore_size_t left = bs - br;
+      qore_offset_t rc;
+      if (left >= rbuf_size) {
+         resetBuffer();
+         rc = readRaw((char*)buf + br, left);
+         if (rc > 0)
+            return br + rc;
+      }
+      else {
+         rc = fillBuffer();
+         if (rc > 0) {
+            if ((qore_size_t)rc > left)
+               rc = left;
+            memcpy((char*)buf + br, rbuf + rbuf_pos, rc);
+            rbuf_pos += rc;
+            return br + rc;
+         }
+      }
+
+      return br ? br : rc;
+   }
+
    // unlocked, assumes file is open
    DLLLOCAL qore_size_t write(const void* buf, qore_size_t len, ExceptionSink* xsink = 0) const {
+      discardBuffer();
+
       qore_offset_t rc;
       while (true) {
 	 rc = ::write(fd, buf, len);
@@ -312,32 +443,29 @@ struct qore_qf_private {
 
    // private function, unlocked
    DLLLOCAL int readChar() const {
-      unsigned char ch = 0;
-      if (read(&ch, 1) != 1)
+      if (rbuf_pos == rbuf_len && fillBuffer() <= 0)
 	 return -1;
-      return (int)ch;
+      return (int)(unsigned char)rbuf[rbuf_pos++];
    }
 
    // private function, unlocked
+   // the bytes of the character are still in the read-ahead buffer immediately before rbuf_pos when this function returns
    DLLLOCAL int readUnicode(int* n_len = 0) const {
-#ifdef HAVE_LOCAL_VARIADIC_ARRAYS
-      char buf[charset->getMaxCharWidth()];
-#else
-      assert(charset->getMaxCharWidth() <= 4);
-      char buf[4];
-#endif
-      if (read(buf, 1) != 1)
+      if (rbuf_pos == rbuf_len && fillBuffer() <= 0)
 	 return -1;
 
-      int len = (int)charset->getCharLen(buf, 1);
+      int len = (int)charset->getCharLen(rbuf + rbuf_pos, 1);
       if (len < 0) {
 	 len = -len;
-	 for (int i = 1; i < len; ++i) {
-	    if (read(&buf[i], 1) != 1)
-	       return -1;
+	 if (ensureBuffered(len) < (qore_size_t)len) {
+	    rbuf_pos = rbuf_len;
+	    return -1;
 	 }
       }
 
+      const char* buf = rbuf + rbuf_pos;
+      rbuf_pos += len ? len : 1;
+
       if (n_len)
 	 *n_len = len;
 
@@ -347,9 +475,36 @@ struct qore_qf_private {
    DLLLOCAL char* readBlock(qore_offset_t &size, int timeout_ms, const char* mname, ExceptionSink* xsink) {
       qore_size_t bs = size > 0 && size < DEFAULT_FILE_BUFSIZE ? size : DEFAULT_FILE_BUFSIZE;
       qore_size_t br = 0;
-      char* buf = (char* )malloc(sizeof(char) * bs);
       char* bbuf = 0;
 
+      // return data from the read-ahead buffer first
+      if (rbuf_pos < rbuf_len) {
+         br = rbuf_len - rbuf_pos;
+         if (size > 0 && br > (qore_size_t)size)
+            br = size;
+         // ensure buffer is 1 byte bigger than needed
+         bbuf = (char* )malloc(sizeof(char) * (br + 1));
+         memcpy(bbuf, rbuf + rbuf_pos, br);
+         rbuf_pos += br;
+         if (size > 0) {
+            if (br >= (qore_size_t)size) {
+               size = br;
+               return bbuf;
+            }
+            if (size - br < bs)
+               bs = size - br;
+         }
+      }
+
+      if (mapping) {
+         size = br;
+         return bbuf;
+      }
+
+      resetBuffer();
+
+      char* buf = (char* )malloc(sizeof(char) * bs);
+
       while (true) {
 	 // wait for data
 	 if (timeout_ms >= 0 && !isDataAvailableIntern(timeout_ms, mname, xsink)) {
@@ -420,40 +575,36 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
-      bool tty = (bool)isatty(fd);
+      int rc = -1;
 
-      int ch, rc = -1;
-
-      while ((ch = readChar()) >= 0) {
-         str.concat((char)ch);
-         if (rc == -1)
-            rc = 0;
+      while (rbuf_pos < rbuf_len || fillBuffer() > 0) {
+         rc = 0;
 
-         if (ch == '\r') {
-            // see if next byte is \n' if we're not connected to a terminal device
-            if (!tty) {
-               ch = readChar();
-               if (ch >= 0) {
-                  if (ch == '\n') {
-                     if (incl_eol)
-                        str.concat((char)ch);
-                  }
-                  else {
-                     // reset file to previous byte position
-                     lseek(fd, -1, SEEK_CUR);
-                  }
-               }
-            }
-            if (!incl_eol)
-               str.terminate(str.strlen() - 1);
-            break;
+         // find the first EOL character in the buffered data
+         const char* p = rbuf + rbuf_pos;
+         qore_size_t avail = rbuf_len - rbuf_pos;
+         const char* e = (const char*)memchr(p, '\n', avail);
+         const char* cr = (const char*)memchr(p, '\r', e ? e - p : avail);
+         if (cr)
+            e = cr;
+
+         if (!e) {
+            str.concat(p, avail);
+            rbuf_pos = rbuf_len;
+            continue;
          }
 
-         if (ch == '\n') {
-            if (!incl_eol)
-               str.terminate(str.strlen() - 1);
-            break;
+         qore_size_t len = e - p + 1;
+         str.concat(p, incl_eol ? len : len - 1);
+         rbuf_pos += len;
+
+         // see if next byte is '\n' if we're not connected to a terminal device
+         if (cr && !tty && (rbuf_pos < rbuf_len || fillBuffer() > 0) && rbuf[rbuf_pos] == '\n') {
+            ++rbuf_pos;
+            if (incl_eol)
+               str.concat('\n');
          }
+         break;
       }
 
       return rc;
@@ -467,18 +618,24 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
-      int ch, rc = -1;
+      int rc = -1;
 
-      while ((ch = readChar()) >= 0) {
-         char c = ch;
-         str.concat(c);
-         if (rc == -1)
-            rc = 0;
-         if (c == byte) {
-            if (!incl_byte)
-               str.terminate(str.strlen() - 1);
-            break;
+      while (rbuf_pos < rbuf_len || fillBuffer() > 0) {
+         rc = 0;
+
+         const char* p = rbuf + rbuf_pos;
+         qore_size_t avail = rbuf_len - rbuf_pos;
+         const char* e = (const char*)memchr(p, byte, avail);
+         if (!e) {
+            str.concat(p, avail);
+            rbuf_pos = rbuf_len;
+            continue;
          }
+
+         qore_size_t len = e - p + 1;
+         str.concat(p, incl_byte ? len : len - 1);
+         rbuf_pos += len;
+         break;
       }
 
       return rc;
@@ -505,8 +662,6 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
-      bool tty = (bool)isatty(fd);
-
       int ch, rc = -1;
 
       while ((ch = readUnicode()) >= 0) {
@@ -536,8 +691,8 @@ struct qore_qf_private {
                         str.concatUnicode(ch);
                   }
                   else {
-                     // reset file to previous byte position
-                     lseek(fd, -len, SEEK_CUR);
+                     // reset to the previous byte position; the character is still in the read-ahead buffer
+                     rbuf_pos -= len ? len : 1;
                   }
                }
             }
@@ -721,7 +876,149 @@ struct qore_qf_private {
       if (!is_open)
          return -1;
 
-      return lseek(fd, 0, SEEK_CUR);
+      qore_offset_t rc = lseek(fd, 0, SEEK_CUR);
+      return rc < 0 ? rc : rc - (rbuf_len - rbuf_pos);
+   }
+
+   DLLLOCAL qore_size_t setPos(qore_size_t pos) {
+      AutoLocker al(m);
+
+      if (!is_open)
+         return -1;
+
+      // positions inside the read-ahead buffer are handled without discarding the buffered data
+      if (rbuf_len) {
+         qore_offset_t end = lseek(fd, 0, SEEK_CUR);
+         // the descriptor cannot be repositioned; keep the buffered data for later reads
+         if (end < 0)
+            return end;
+         if ((qore_offset_t)pos <= end && (qore_offset_t)pos >= end - (qore_offset_t)rbuf_len) {
+            rbuf_pos = rbuf_len - (end - pos);
+            return pos;
+         }
+         // positions outside of a mapping release it
+         if (mapping)
+            unmapIntern();
+         else
+            rbuf_pos = rbuf_len = 0;
+      }
+
+      return lseek(fd, pos, SEEK_SET);
+   }
+
+   // unlocked; maps the file into memory; the logical file position is retained
+   DLLLOCAL int mapIntern(int advice, ExceptionSink* xsink) {
+#ifdef Q_HAVE_MMAP
+      if (mapping)
+         unmapIntern();
+
+      struct stat sbuf;
+      if (fstat(fd, &sbuf)) {
+         xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "fstat() call failed");
+         return -1;
+      }
+      if (!S_ISREG(sbuf.st_mode)) {
+         xsink->raiseException("FILE-MAP-ERROR", "only regular files can be mapped into memory");
+         return -1;
+      }
+
+      qore_offset_t pos = lseek(fd, 0, SEEK_CUR);
+      if (pos < 0) {
+         xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "cannot determine the file position");
+         return -1;
+      }
+      pos -= rbuf_len - rbuf_pos;
+
+      qore_size_t size = sbuf.st_size;
+      void* addr = 0;
+      // an empty file cannot be mapped, but it can be handled as an empty mapping
+      if (size) {
+         addr = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (addr == MAP_FAILED) {
+            xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "mmap() call failed for " QLLD " byte%s", size, size == 1 ? "" : "s");
+            return -1;
+         }
+#ifdef HAVE_MADVISE
+         madvise(addr, size, advice);
+#endif
+      }
+
+      // position the descriptor at the end of the mapping so that rbuf[0] corresponds to file offset 0
+      if (lseek(fd, size, SEEK_SET) < 0) {
+         xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "cannot set the file position");
+         if (addr)
+            munmap(addr, size);
+         return -1;
+      }
+
+      free(rbuf);
+      mapping = new QoreMappedRegion(addr, size);
+      rbuf = (char*)addr;
+      rbuf_len = size;
+      rbuf_pos = (qore_size_t)pos > size ? size : pos;
+      return 0;
+#else
+      xsink->raiseException("MISSING-FEATURE-ERROR", "memory-mapped file I/O is not supported on this platform; check Option::HAVE_MMAP before calling this method to avoid this exception");
+      return -1;
+#endif
+   }
+
+   // unlocked; releases the mapping (slices returned by readSlice() remain valid) and moves the file position to the logical read position
+   DLLLOCAL void unmapIntern() const {
+      assert(mapping);
+      lseek(fd, -(off_t)(rbuf_len - rbuf_pos), SEEK_CUR);
+      mapping->deref();
+      mapping = 0;
+      rbuf = 0;
+      rbuf_pos = rbuf_len = 0;
+   }
+
+   // unlocked; returns a slice of up to "size" bytes (-1 = all remaining data) of the mapping without copying, 0 at the end of the mapping
+   DLLLOCAL BinaryNode* readSlice(qore_offset_t size) const {
+      assert(mapping);
+      qore_size_t avail = rbuf_len - rbuf_pos;
+      if (!avail)
+         return 0;
+      if (size > 0 && (qore_size_t)size < avail)
+         avail = size;
+      BinaryNode* b = new BinaryNode(mapping, rbuf + rbuf_pos, avail);
+      rbuf_pos += avail;
+      return b;
+   }
+
+   DLLLOCAL int map(int advice, ExceptionSink* xsink) {
+      AutoLocker al(m);
+
+      if (check_read_open(xsink))
+         return -1;
+
+      if (special_file) {
+         xsink->raiseException("FILE-MAP-ERROR", "system files cannot be mapped into memory");
+         return -1;
+      }
+
+      return mapIntern(advice, xsink);
+   }
+
+   DLLLOCAL void unmap() {
+      AutoLocker al(m);
+
+      if (mapping)
+         unmapIntern();
+   }
+
+   DLLLOCAL bool isMapped() const {
+      AutoLocker al(m);
+      return (bool)mapping;
+   }
+
+   // returns the file descriptor after discarding any read-ahead data so that the descriptor's position is the logical position
+   DLLLOCAL int getFD() const {
+      AutoLocker al(m);
+
+      if (is_open)
+         discardBuffer();
+      return fd;
    }
 
    DLLLOCAL void setEventQueue(Queue* cbq, ExceptionSink* xsink) {
@@ -940,6 +940,12 @@ struct qore_socket_private {
       return isSocketDataAvailable(timeout_ms, mname, xsink);
    }
 
+   // returns true if data has already been read from the descriptor and is buffered in user space,
+   // in which case it cannot be detected by waiting on the descriptor
+   DLLLOCAL bool hasBufferedData() const {
+      return buflen || (ssl && ssl->pending());
+   }
+
    DLLLOCAL bool isWriteFinished(int timeout_ms, const char* mname, ExceptionSink* xsink) {
       return asyncIoWait(timeout_ms, false, true, "Socket", mname, xsink);
    }
@@ -34,6 +34,9 @@
 #ifndef QORE_QORE_STRING_PRIVATE_H
 #define QORE_QORE_STRING_PRIVATE_H
 
+#include <atomic>
+#include <vector>
+
 #define MAX_INT_STRING_LEN     48
 #define MAX_BIGINT_STRING_LEN  48
 #define MAX_FLOAT_STRING_LEN   48
@@ -46,8 +49,69 @@
 #define QUS_QUERY    1
 #define QUS_FRAGMENT 2
 
+// the minimum byte length of multi-byte strings for which character indexes are built
+#define STR_CHAR_INDEX_MIN    256
+// the number of characters between character index checkpoints
+#define STR_CHAR_INDEX_STEP   64
+
+// sparse character index for a multi-byte string
+/* maps character offsets to byte offsets (and back) without scanning the string from the beginning; only
+   valid for the buffer, byte length and encoding that it was built for
+*/
+struct qore_string_char_index {
+   // the buffer, byte length and encoding the index was built for
+   const char* buf;
+   qore_size_t len;
+   const QoreEncoding* enc;
+   // the length of the string in characters
+   qore_size_t clen;
+   // if non-zero, all characters have this byte width (ex: 1 for an ASCII-only UTF-8 string)
+   unsigned width;
+   // false if the string contains invalid or embedded null characters; such strings are not indexed
+   bool valid;
+   // the byte offset of every STR_CHAR_INDEX_STEP-th character; empty if width is set
+   std::vector<qore_size_t> cp;
+
+   DLLLOCAL qore_string_char_index(const char* b, qore_size_t l, const QoreEncoding* e) : buf(b), len(l), enc(e), clen(0), width(0), valid(false) {
+   }
+
+   // returns true if the index describes the given string buffer
+   DLLLOCAL bool matches(const char* b, qore_size_t l, const QoreEncoding* e) const {
+      return buf == b && len == l && enc == e;
+   }
+
+   // returns the byte offset of character c; returns the byte length if c is beyond the end of the string
+   DLLLOCAL qore_size_t getByteOffset(qore_size_t c) const;
+
+   // returns the character position of byte offset b; b must be the offset of a character or the byte length
+   DLLLOCAL qore_size_t getCharPos(qore_size_t b) const;
+
+   // builds a new index for the given string; the index returned is not valid if the string cannot be indexed
+   DLLLOCAL static qore_string_char_index* build(const char* buf, qore_size_t len, const QoreEncoding* enc);
+};
+
 struct qore_string_private {
 private:
+   // lazily-built character index; deleted by invalidateCharIndex() whenever the string is modified
+   /* only set in const functions if no index is present, so an index is never replaced while other threads may
+      be using it
+   */
+   mutable std::atomic<qore_string_char_index*> cidx;
+   // the number of bytes scanned without an index since the string was last modified
+   mutable std::atomic<qore_size_t> cscan;
+
+   // returns the character index to use for an operation or 0 if the string should be scanned directly
+   /* indexes are built for multi-byte strings of at least STR_CHAR_INDEX_MIN bytes once more bytes have been
+      scanned for character offsets than the string holds, so strings that are modified between operations or
+      only accessed once are not indexed needlessly
+   */
+   DLLLOCAL const qore_string_char_index* getCharIndex() const;
+
+   // records the number of bytes scanned without an index
+   DLLLOCAL void addCharScan(qore_size_t b) const {
+      if (len >= STR_CHAR_INDEX_MIN)
+         cscan.fetch_add(b, std::memory_order_relaxed);
+   }
 
 public:
    qore_size_t len;
@@ -55,10 +119,19 @@ public:
    char* buf;
    const QoreEncoding* charset;
 
-   DLLLOCAL qore_string_private() {
+   // allocated with the slab allocator
+   DLLLOCAL static void* operator new(size_t size) {
+      return qore_slab_alloc(size);
+   }
+
+   DLLLOCAL static void operator delete(void* p) {
+      qore_slab_free(p);
    }
 
-   DLLLOCAL qore_string_private(const qore_string_private &p) {
+   DLLLOCAL qore_string_private() : cidx(0), cscan(0) {
+   }
+
+   DLLLOCAL qore_string_private(const qore_string_private &p) : cidx(0), cscan(0) {
       allocated = p.len + STR_CLASS_EXTRA;
       buf = (char*)malloc(sizeof(char) * allocated);
       len = p.len;
@@ -69,10 +142,73 @@ public:
    }
 
    DLLLOCAL ~qore_string_private() {
+      delete cidx.load(std::memory_order_relaxed);
       if (buf)
          free(buf);
    }
 
+   // must be called before the string buffer, length, or encoding is modified
+   DLLLOCAL void invalidateCharIndex() {
+      qore_string_char_index* ci = cidx.load(std::memory_order_relaxed);
+      if (ci) {
+         delete ci;
+         cidx.store(0, std::memory_order_relaxed);
+      }
+      if (cscan.load(std::memory_order_relaxed))
+         cscan.store(0, std::memory_order_relaxed);
+   }
+
+   // returns the length of the string in characters starting from byte offset start, which must be the offset of a character
+   DLLLOCAL qore_size_t getCharLength(bool& invalid, qore_size_t start = 0) const {
+      const qore_string_char_index* ci = getCharIndex();
+      if (ci) {
+         invalid = false;
+         return ci->clen - (start ? ci->getCharPos(start) : 0);
+      }
+      addCharScan(len - start);
+      return getEncoding()->getLength(buf + start, buf + len, invalid);
+   }
+
+   // returns the length of the string in characters starting from byte offset start, which must be the offset of a character
+   DLLLOCAL qore_size_t getCharLength(ExceptionSink* xsink, qore_size_t start = 0) const {
+      const qore_string_char_index* ci = getCharIndex();
+      if (ci)
+         return ci->clen - (start ? ci->getCharPos(start) : 0);
+      addCharScan(len - start);
+      return getEncoding()->getLength(buf + start, buf + len, xsink);
+   }
+
+   // returns the byte length of c characters or up to the end of the string starting from byte offset start, which must be the offset of a character
+   DLLLOCAL qore_size_t getCharByteLen(qore_size_t start, qore_size_t c, bool& invalid) const {
+      const qore_string_char_index* ci = c ? getCharIndex() : 0;
+      if (ci) {
+         invalid = false;
+         return ci->getByteOffset((start ? ci->getCharPos(start) : 0) + c) - start;
+      }
+      qore_size_t rc = getEncoding()->getByteLen(buf + start, buf + len, c, invalid);
+      addCharScan(rc);
+      return rc;
+   }
+
+   // returns the byte length of c characters or up to the end of the string starting from byte offset start, which must be the offset of a character
+   DLLLOCAL qore_size_t getCharByteLen(qore_size_t start, qore_size_t c, ExceptionSink* xsink) const {
+      const qore_string_char_index* ci = c ? getCharIndex() : 0;
+      if (ci)
+         return ci->getByteOffset((start ? ci->getCharPos(start) : 0) + c) - start;
+      qore_size_t rc = getEncoding()->getByteLen(buf + start, buf + len, c, xsink);
+      addCharScan(rc);
+      return rc;
+   }
+
+   // returns the character position of byte offset b, which must be the offset of a character or the byte length
+   DLLLOCAL qore_size_t getCharPos(qore_size_t b, ExceptionSink* xsink) const {
+      const qore_string_char_index* ci = b ? getCharIndex() : 0;
+      if (ci)
+         return ci->getCharPos(b);
+      addCharScan(b);
+      return getEncoding()->getCharPos(buf, buf + b, xsink);
+   }
+
    DLLLOCAL void check_char(qore_size_t i) {
       if (i >= allocated) {
          qore_size_t d = i >> 2;
@@ -211,7 +347,7 @@ public:
 
       qore_offset_t ind = index_simple(buf + pos, needle->getBuffer());
       if (ind != -1) {
-         ind = getEncoding()->getCharPos(buf, buf + pos + ind, xsink);
+         ind = getCharPos(pos + ind, xsink);
          if (*xsink)
             return -1;
       }
@@ -271,13 +407,13 @@ public:
       // get positive character offset if negative
       if (pos < 0) {
          // get the length of the string in characters
-         qore_size_t clen = getEncoding()->getLength(buf + start, buf + len, xsink);
+         qore_size_t clen = getCharLength(xsink, start);
          if (*xsink)
             return -1;
          pos = clen + pos;
       }
       // now get the byte position from this character offset
-      pos = getEncoding()->getByteLen(buf + start, buf + len, pos, xsink);
+      pos = getCharByteLen(start, pos, xsink);
       return *xsink ? -1 : 0;
    }
 
@@ -307,7 +443,7 @@ public:
 
       // calculate character position from byte position
       if (ind && ind != -1) {
-         ind = getEncoding()->getCharPos(buf, buf + ind, xsink);
+         ind = getCharPos(ind, xsink);
          if (*xsink)
             return 0;
       }
@@ -449,7 +585,7 @@ public:
    DLLLOCAL qore_offset_t getByteOffset(qore_size_t i, ExceptionSink* xsink) const {
       qore_size_t rc;
       if (i) {
-         rc = getEncoding()->getByteLen(buf, buf + len, i, xsink);
+         rc = getCharByteLen(0, i, xsink);
          if (*xsink)
             return -1;
       }
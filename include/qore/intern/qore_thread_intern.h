@@ -75,6 +75,7 @@ class CallStack;
 class LocalVar;
 class LocalVarValue;
 class ClosureParseEnvironment;
+class LocalVarFrameParseEnvironment;
 class QoreClosureBase;
 struct ClosureVarValue;
 class VLock;
@@ -293,6 +294,9 @@ DLLLOCAL QoreModuleDefContext* get_module_def_context();
 DLLLOCAL void parse_set_module_def_context_name(const char* name);
 DLLLOCAL const char* set_user_module_context_name(const char* n);
 DLLLOCAL const char* get_user_module_context_name();
+DLLLOCAL void inc_module_lock_count();
+DLLLOCAL void dec_module_lock_count();
+DLLLOCAL int get_module_lock_count();
 
 DLLLOCAL void set_thread_tz(const AbstractQoreZoneInfo* tz);
 DLLLOCAL const AbstractQoreZoneInfo* get_thread_tz(bool& set);
@@ -362,6 +366,18 @@ public:
    DLLLOCAL ~ModuleReExportHelper();
 };
 
+// marks the current thread as holding the module manager lock while loading modules
+class ModuleLockCountHelper {
+public:
+   DLLLOCAL ModuleLockCountHelper() {
+      inc_module_lock_count();
+   }
+
+   DLLLOCAL ~ModuleLockCountHelper() {
+      dec_module_lock_count();
+   }
+};
+
 class QoreParseCountContextHelper {
 protected:
    unsigned count;
@@ -437,17 +453,28 @@ DLLLOCAL block_list_t::iterator popBlock();
 // called by each "on_block_exit" statement to activate it's code for the block exit
 DLLLOCAL void advanceOnBlockExit();
 
-DLLLOCAL LocalVarValue* thread_instantiate_lvar();
-DLLLOCAL void thread_uninstantiate_lvar(ExceptionSink* xsink);
-DLLLOCAL void thread_uninstantiate_self();
+// local variables with a slot (>= 0) are stored in the frame of the current call of user code
+DLLLOCAL LocalVarValue* thread_instantiate_lvar(int slot);
+DLLLOCAL void thread_uninstantiate_lvar(int slot, ExceptionSink* xsink);
+DLLLOCAL void thread_uninstantiate_self(int slot);
 
 DLLLOCAL void thread_set_closure_parse_env(ClosureParseEnvironment* cenv);
 DLLLOCAL ClosureParseEnvironment* thread_get_closure_parse_env();
 
-DLLLOCAL ClosureVarValue* thread_instantiate_closure_var(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval);
+// returns the previous environment
+DLLLOCAL LocalVarFrameParseEnvironment* thread_set_lvar_frame_parse_env(LocalVarFrameParseEnvironment* fenv);
+DLLLOCAL LocalVarFrameParseEnvironment* thread_get_lvar_frame_parse_env();
+
+DLLLOCAL ClosureVarValue* thread_instantiate_closure_var(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval, int slot);
 DLLLOCAL void thread_instantiate_closure_var(ClosureVarValue* cvar);
 DLLLOCAL void thread_uninstantiate_closure_var(ExceptionSink* xsink);
-DLLLOCAL ClosureVarValue* thread_find_closure_var(const char* id);
+DLLLOCAL void thread_uninstantiate_closure_var(int slot, ExceptionSink* xsink);
+DLLLOCAL ClosureVarValue* thread_find_closure_var(const char* id, int slot);
+
+// reserves the local and closure variable frames for a call of user code
+DLLLOCAL void thread_enter_lvar_frame(unsigned lvars, unsigned cvars);
+// releases the frames reserved with thread_enter_lvar_frame()
+DLLLOCAL void thread_exit_lvar_frame();
 
 DLLLOCAL ClosureVarValue* thread_get_runtime_closure_var(const LocalVar* id);
 DLLLOCAL const QoreClosureBase* thread_set_runtime_closure_env(const QoreClosureBase* current);
@@ -495,7 +522,7 @@ public:
 
 DLLLOCAL const QoreListNode* thread_get_implicit_args();
 
-DLLLOCAL LocalVarValue* thread_find_lvar(const char* id);
+DLLLOCAL LocalVarValue* thread_find_lvar(const char* id, int slot);
 
 // to get the current runtime object
 DLLLOCAL QoreObject* runtime_get_stack_object();
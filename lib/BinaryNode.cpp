@@ -29,21 +29,101 @@
 */
 
 #include <qore/Qore.h>
+#include "qore/intern/QoreMappedRegion.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <map>
+
+// the memory mappings referenced by slices are kept outside of the objects so that the exported layout is unchanged
+typedef std::map<const BinaryNode*, QoreMappedRegion*> slice_map_t;
+static QoreThreadLock slice_lock;
+static slice_map_t slice_map;
+// number of entries in slice_map; objects owning their memory only need to check this
+static std::atomic<size_t> slice_count(0);
+
+static void slice_add(const BinaryNode* b, QoreMappedRegion* m) {
+   m->ref();
+   AutoLocker al(slice_lock);
+   assert(slice_map.find(b) == slice_map.end());
+   slice_map[b] = m;
+   ++slice_count;
+}
+
+// returns the mapping referenced by the given object or 0 if it owns its memory
+static QoreMappedRegion* slice_get(const BinaryNode* b) {
+   if (!slice_count)
+      return 0;
+   AutoLocker al(slice_lock);
+   slice_map_t::const_iterator i = slice_map.find(b);
+   return i == slice_map.end() ? 0 : i->second;
+}
+
+// removes the entry for the given object and returns its mapping (whose reference passes to the caller) or 0 if it owns its memory
+static QoreMappedRegion* slice_take(const BinaryNode* b) {
+   if (!slice_count)
+      return 0;
+   AutoLocker al(slice_lock);
+   slice_map_t::iterator i = slice_map.find(b);
+   if (i == slice_map.end())
+      return 0;
+   QoreMappedRegion* m = i->second;
+   slice_map.erase(i);
+   --slice_count;
+   return m;
+}
+
 BinaryNode::BinaryNode(void *p, qore_size_t size) : SimpleValueQoreNode(NT_BINARY) {
    ptr = p;
    len = size;
 }
 
+BinaryNode::BinaryNode(QoreMappedRegion* m, const void* p, qore_size_t size) : SimpleValueQoreNode(NT_BINARY), ptr(const_cast<void*>(p)), len(size) {
+   assert(m);
+   assert(!size || ((char*)p >= (char*)m->addr && (char*)p + size <= (char*)m->addr + m->size));
+   slice_add(this, m);
+}
+
 BinaryNode::~BinaryNode() {
-   if (ptr)
+   QoreMappedRegion* m = slice_take(this);
+   if (m)
+      m->deref();
+   else if (ptr)
       free(ptr);
 }
 
+void* BinaryNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void BinaryNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
+void BinaryNode::unshare() {
+   QoreMappedRegion* m = slice_take(this);
+   if (!m)
+      return;
+
+   void* np = 0;
+   if (len) {
+      np = malloc(len);
+      memcpy(np, ptr, len);
+   }
+   m->deref();
+   ptr = np;
+}
+
 void BinaryNode::clear() {
+   QoreMappedRegion* m = slice_take(this);
+   if (m) {
+      m->deref();
+      len = 0;
+      ptr = 0;
+      return;
+   }
    if (len) {
       assert(ptr);
       free(ptr);
@@ -77,6 +157,11 @@ BinaryNode *BinaryNode::copy() const {
    if (!len)
       return new BinaryNode();
 
+   // slices of a mapping are shared and only copied when modified
+   QoreMappedRegion* m = slice_get(this);
+   if (m)
+      return new BinaryNode(m, ptr, len);
+
    void *np = malloc(len);
    memcpy(np, ptr, len);
    return new BinaryNode(np, len);
@@ -88,6 +173,7 @@ const void *BinaryNode::getPtr() const {
 
 void BinaryNode::append(const void *nptr, qore_size_t size) {
    bool self_copy = nptr == ptr;
+   unshare();
    ptr = realloc(ptr, len + size);
    if (self_copy) {
       assert(size == len);
@@ -106,6 +192,7 @@ void BinaryNode::append(const BinaryNode &b) {
 }
 
 void BinaryNode::prepend(const void *nptr, qore_size_t size) {
+   unshare();
    ptr = realloc(ptr, len + size);
    // move memory forward
    memmove((char*)ptr + size, ptr, len);
@@ -115,6 +202,7 @@ void BinaryNode::prepend(const void *nptr, qore_size_t size) {
 }
 
 void *BinaryNode::giveBuffer() {
+   unshare();
    void *p = ptr;
    ptr = 0;
    len = 0;
@@ -168,6 +256,7 @@ const char *BinaryNode::getTypeName() const {
 
 int BinaryNode::preallocate(qore_size_t size) {
    //printd(5, "BinaryNode::preallocate(" QLLD ") this: %p ptr: %p len: " QLLD "\n", size, this, ptr, len);
+   unshare();
    ptr = q_realloc(ptr, size);
    if (ptr) {
       len = size;
@@ -239,6 +328,8 @@ void BinaryNode::splice(qore_offset_t offset, qore_offset_t length, BinaryNode*
    if (extract && length)
       extract->append((char*)ptr + offset, length);
 
+   unshare();
+
    // move down entries if necessary
    if (end != len)
       memmove((char*)ptr + offset, (char*)ptr + end, len - end);
@@ -271,6 +362,8 @@ void BinaryNode::splice(qore_offset_t offset, qore_offset_t length, const void*
    if (extract && length)
       extract->append((char*)ptr + offset, length);
 
+   unshare();
+
    // get number of entries to insert
    if ((qore_offset_t)data_len > length) { // make bigger
       qore_size_t ol = len;
@@ -32,9 +32,28 @@
 #include <zlib.h>
 #include <bzlib.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
 
 #include "qore/Qore.h"
 #include "qore/intern/CompressionTransforms.h"
+#include "qore/intern/QoreThreadLocalObject.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#ifdef HAVE_LZ4
+// the dictionary API of the lz4 frame format is only declared for static linking before lz4 1.10, but the functions
+// are exported by the shared library
+#define LZ4F_STATIC_LINKING_ONLY
+#include <lz4frame.h>
+#endif
 
 class CompressionErrorHelper {
 
@@ -94,6 +113,22 @@ public:
       }
       xsink->raiseException("BZIP2-ERROR", desc);
    }
+
+#ifdef HAVE_ZSTD
+   static void mapZstdError(size_t rc, ExceptionSink *xsink) {
+      xsink->raiseException("ZSTD-ERROR", "%s", ZSTD_getErrorName(rc));
+   }
+#endif
+
+#ifdef HAVE_LZ4
+   static void mapLz4Error(size_t rc, ExceptionSink *xsink) {
+      xsink->raiseException("LZ4-ERROR", "%s", LZ4F_getErrorName(rc));
+   }
+#endif
+
+   static void raiseMissingFeature(const char *alg, ExceptionSink *xsink) {
+      xsink->raiseException("MISSING-FEATURE-ERROR", "%s compression is not available in this build; for maximum portability, check Option::HAVE_%s before using it", alg, strcmp(alg, CompressionTransforms::ALG_ZSTD) ? "LZ4" : "ZSTD");
+   }
 };
 
 class ZlibDeflateTransform : public Transform {
@@ -352,26 +387,1237 @@ private:
    State state;
 };
 
-Transform *CompressionTransforms::getCompressor(const QoreStringNode *alg, int64 level, ExceptionSink *xsink) {
+#ifdef HAVE_ZSTD
+static int check_zstd_level(int64 &level, ExceptionSink *xsink) {
+   if (level == CompressionTransforms::LEVEL_DEFAULT) {
+      level = CompressionTransforms::ZSTD_LEVEL_DEFAULT;
+   } else if (!(level >= 1 && level <= ZSTD_maxCLevel())) {
+      xsink->raiseException("ZSTD-LEVEL-ERROR", "level must be between 1 - %d or -1 (value passed: " QLLD ")", ZSTD_maxCLevel(), level);
+      return -1;
+   }
+   return 0;
+}
+
+// sets up a compression context for a new frame; returns -1 on error
+static int init_zstd_cctx(ZSTD_CCtx *cctx, int level, const void *dict, size_t dict_len, ExceptionSink *xsink) {
+   size_t rc = ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+   if (!ZSTD_isError(rc))
+      rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+   if (!ZSTD_isError(rc))
+      rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+   if (!ZSTD_isError(rc) && dict_len)
+      rc = ZSTD_CCtx_loadDictionary(cctx, dict, dict_len);
+   if (ZSTD_isError(rc)) {
+      CompressionErrorHelper::mapZstdError(rc, xsink);
+      return -1;
+   }
+   return 0;
+}
+
+static int init_zstd_dctx(ZSTD_DCtx *dctx, const void *dict, size_t dict_len, ExceptionSink *xsink) {
+   size_t rc = ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+   if (!ZSTD_isError(rc) && dict_len)
+      rc = ZSTD_DCtx_loadDictionary(dctx, dict, dict_len);
+   if (ZSTD_isError(rc)) {
+      CompressionErrorHelper::mapZstdError(rc, xsink);
+      return -1;
+   }
+   return 0;
+}
+
+class ZstdCompressTransform : public Transform {
+
+public:
+   ZstdCompressTransform(int64 level, const BinaryNode *dict, ExceptionSink *xsink) : state(STATE_NOT_INIT) {
+      if (check_zstd_level(level, xsink))
+         return;
+
+      cctx = ZSTD_createCCtx();
+      if (!cctx) {
+         xsink->outOfMemory();
+         return;
+      }
+      state = STATE_OK;
+      if (init_zstd_cctx(cctx, level, dict ? dict->getPtr() : 0, dict ? dict->size() : 0, xsink))
+         state = STATE_ERROR;
+   }
+
+   ~ZstdCompressTransform() {
+      if (state != STATE_NOT_INIT) {
+         ZSTD_freeCCtx(cctx);
+      }
+   }
+
+   std::pair<int64, int64> apply(const void *src, int64 srcLen, void *dst, int64 dstLen, ExceptionSink *xsink) {
+      if (state == STATE_END) {
+         return std::make_pair(0, 0);
+      }
+      if (state != STATE_OK) {
+         xsink->raiseException("ZSTD-ERROR", "invalid zstd stream state");
+         return std::make_pair(0, 0);
+      }
+      ZSTD_inBuffer in = { src, static_cast<size_t>(srcLen), 0 };
+      ZSTD_outBuffer out = { dst, static_cast<size_t>(dstLen), 0 };
+      size_t rc = ZSTD_compressStream2(cctx, &out, &in, src ? ZSTD_e_continue : ZSTD_e_end);
+      if (ZSTD_isError(rc)) {
+         CompressionErrorHelper::mapZstdError(rc, xsink);
+         state = STATE_ERROR;
+         return std::make_pair(0, 0);
+      }
+      if (!src && !rc) {
+         state = STATE_END;
+      }
+      return std::make_pair(in.pos, out.pos);
+   }
+
+private:
+   enum State {
+      STATE_OK, STATE_ERROR, STATE_END, STATE_NOT_INIT
+   };
+
+private:
+   ZSTD_CCtx *cctx;
+   State state;
+};
+
+class ZstdDecompressTransform : public Transform {
+
+public:
+   ZstdDecompressTransform(const BinaryNode *dict, ExceptionSink *xsink) : state(STATE_NOT_INIT) {
+      dctx = ZSTD_createDCtx();
+      if (!dctx) {
+         xsink->outOfMemory();
+         return;
+      }
+      state = STATE_OK;
+      if (init_zstd_dctx(dctx, dict ? dict->getPtr() : 0, dict ? dict->size() : 0, xsink))
+         state = STATE_ERROR;
+   }
+
+   ~ZstdDecompressTransform() {
+      if (state != STATE_NOT_INIT) {
+         ZSTD_freeDCtx(dctx);
+      }
+   }
+
+   std::pair<int64, int64> apply(const void *src, int64 srcLen, void *dst, int64 dstLen, ExceptionSink *xsink) {
+      if (state == STATE_END) {
+         if (src) {
+            xsink->raiseException("ZSTD-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            state = STATE_ERROR;
+         }
+         return std::make_pair(0, 0);
+      }
+      if (state != STATE_OK) {
+         xsink->raiseException("ZSTD-ERROR", "invalid zstd stream state");
+         return std::make_pair(0, 0);
+      }
+      ZSTD_inBuffer in = { src, static_cast<size_t>(srcLen), 0 };
+      ZSTD_outBuffer out = { dst, static_cast<size_t>(dstLen), 0 };
+      size_t rc = ZSTD_decompressStream(dctx, &out, &in);
+      if (ZSTD_isError(rc)) {
+         CompressionErrorHelper::mapZstdError(rc, xsink);
+         state = STATE_ERROR;
+         return std::make_pair(0, 0);
+      }
+      if (!rc) {
+         if (in.pos != in.size) {
+            xsink->raiseException("ZSTD-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            state = STATE_ERROR;
+            return std::make_pair(0, 0);
+         }
+         state = STATE_END;
+      } else if (!src && !out.pos) {
+         xsink->raiseException("ZSTD-ERROR", "Unexpected end of compressed data stream");
+         state = STATE_ERROR;
+         return std::make_pair(0, 0);
+      }
+      return std::make_pair(in.pos, out.pos);
+   }
+
+private:
+   enum State {
+      STATE_OK, STATE_ERROR, STATE_END, STATE_NOT_INIT
+   };
+
+private:
+   ZSTD_DCtx *dctx;
+   State state;
+};
+#endif
+
+#ifdef HAVE_LZ4
+static int check_lz4_level(int64 &level, ExceptionSink *xsink) {
+   if (level == CompressionTransforms::LEVEL_DEFAULT) {
+      level = CompressionTransforms::LZ4_LEVEL_DEFAULT;
+   } else if (!(level >= 0 && level <= LZ4F_compressionLevel_max())) {
+      xsink->raiseException("LZ4-LEVEL-ERROR", "level must be between 0 - %d or -1 (value passed: " QLLD ")", LZ4F_compressionLevel_max(), level);
+      return -1;
+   }
+   return 0;
+}
+
+static void init_lz4_prefs(LZ4F_preferences_t &prefs, int level, unsigned long long content_size) {
+   memset(&prefs, 0, sizeof prefs);
+   prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+   prefs.frameInfo.contentSize = content_size;
+   prefs.compressionLevel = level;
+}
+
+class Lz4CompressTransform : public Transform {
+
+public:
+   Lz4CompressTransform(int64 level, const BinaryNode *dict, ExceptionSink *xsink) : cdict(0), opos(0), state(STATE_NOT_INIT) {
+      if (check_lz4_level(level, xsink))
+         return;
+
+      size_t rc = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+      if (LZ4F_isError(rc)) {
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         return;
+      }
+      state = STATE_OK;
+
+      init_lz4_prefs(prefs, level, 0);
+      if (dict) {
+         cdict = LZ4F_createCDict(dict->getPtr(), dict->size());
+         if (!cdict) {
+            xsink->outOfMemory();
+            state = STATE_ERROR;
+            return;
+         }
+      }
+
+      // the frame header is written with the first output
+      obuf.resize(LZ4F_HEADER_SIZE_MAX);
+      rc = cdict
+         ? LZ4F_compressBegin_usingCDict(cctx, &obuf[0], obuf.size(), cdict, &prefs)
+         : LZ4F_compressBegin(cctx, &obuf[0], obuf.size(), &prefs);
+      if (LZ4F_isError(rc)) {
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         state = STATE_ERROR;
+         return;
+      }
+      obuf.resize(rc);
+   }
+
+   ~Lz4CompressTransform() {
+      if (state != STATE_NOT_INIT) {
+         LZ4F_freeCompressionContext(cctx);
+      }
+      if (cdict) {
+         LZ4F_freeCDict(cdict);
+      }
+   }
+
+   std::pair<int64, int64> apply(const void *src, int64 srcLen, void *dst, int64 dstLen, ExceptionSink *xsink) {
+      // LZ4F_compressUpdate() requires an output buffer large enough for the worst case, so output is buffered here
+      if (opos == obuf.size()) {
+         if (state == STATE_END) {
+            return std::make_pair(0, 0);
+         }
+         if (state != STATE_OK) {
+            xsink->raiseException("LZ4-ERROR", "invalid lz4 stream state");
+            return std::make_pair(0, 0);
+         }
+      }
+
+      int64 consumed = 0;
+      if (opos == obuf.size()) {
+         size_t rc;
+         if (src) {
+            consumed = QORE_MIN(srcLen, (int64)CHUNK_SIZE);
+            obuf.resize(LZ4F_compressBound(consumed, &prefs));
+            rc = LZ4F_compressUpdate(cctx, &obuf[0], obuf.size(), src, consumed, 0);
+         } else {
+            obuf.resize(LZ4F_compressBound(0, &prefs));
+            rc = LZ4F_compressEnd(cctx, &obuf[0], obuf.size(), 0);
+            state = STATE_END;
+         }
+         if (LZ4F_isError(rc)) {
+            CompressionErrorHelper::mapLz4Error(rc, xsink);
+            state = STATE_ERROR;
+            obuf.clear();
+            opos = 0;
+            return std::make_pair(0, 0);
+         }
+         obuf.resize(rc);
+         opos = 0;
+      }
+
+      int64 n = QORE_MIN(dstLen, (int64)(obuf.size() - opos));
+      if (n) {
+         memcpy(dst, &obuf[opos], n);
+         opos += n;
+      }
+      return std::make_pair(consumed, n);
+   }
+
+private:
+   enum State {
+      STATE_OK, STATE_ERROR, STATE_END, STATE_NOT_INIT
+   };
+
+   // max input size passed to LZ4F_compressUpdate() at once
+   static constexpr int64 CHUNK_SIZE = 64 * 1024;
+
+private:
+   LZ4F_cctx *cctx;
+   LZ4F_CDict *cdict;
+   LZ4F_preferences_t prefs;
+   // compressed output not yet returned
+   std::vector<char> obuf;
+   size_t opos;
+   State state;
+};
+
+class Lz4DecompressTransform : public Transform {
+
+public:
+   Lz4DecompressTransform(const BinaryNode *dict, ExceptionSink *xsink) : state(STATE_NOT_INIT) {
+      size_t rc = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+      if (LZ4F_isError(rc)) {
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         return;
+      }
+      // the dictionary must stay available for the lifetime of the stream
+      if (dict) {
+         const char *p = static_cast<const char *>(dict->getPtr());
+         this->dict.assign(p, p + dict->size());
+      }
+      state = STATE_OK;
+   }
+
+   ~Lz4DecompressTransform() {
+      if (state != STATE_NOT_INIT) {
+         LZ4F_freeDecompressionContext(dctx);
+      }
+   }
+
+   std::pair<int64, int64> apply(const void *src, int64 srcLen, void *dst, int64 dstLen, ExceptionSink *xsink) {
+      if (state == STATE_END) {
+         if (src) {
+            xsink->raiseException("LZ4-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            state = STATE_ERROR;
+         }
+         return std::make_pair(0, 0);
+      }
+      if (state != STATE_OK) {
+         xsink->raiseException("LZ4-ERROR", "invalid lz4 stream state");
+         return std::make_pair(0, 0);
+      }
+      size_t dst_size = dstLen;
+      size_t src_size = srcLen;
+      size_t rc = dict.empty()
+         ? LZ4F_decompress(dctx, dst, &dst_size, src, &src_size, 0)
+         : LZ4F_decompress_usingDict(dctx, dst, &dst_size, src, &src_size, &dict[0], dict.size(), 0);
+      if (LZ4F_isError(rc)) {
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         state = STATE_ERROR;
+         return std::make_pair(0, 0);
+      }
+      if (!rc) {
+         if (src_size != static_cast<size_t>(srcLen)) {
+            xsink->raiseException("LZ4-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            state = STATE_ERROR;
+            return std::make_pair(0, 0);
+         }
+         state = STATE_END;
+      } else if (!src && !dst_size) {
+         xsink->raiseException("LZ4-ERROR", "Unexpected end of compressed data stream");
+         state = STATE_ERROR;
+         return std::make_pair(0, 0);
+      }
+      return std::make_pair(src_size, dst_size);
+   }
+
+private:
+   enum State {
+      STATE_OK, STATE_ERROR, STATE_END, STATE_NOT_INIT
+   };
+
+private:
+   LZ4F_dctx *dctx;
+   std::vector<char> dict;
+   State state;
+};
+#endif
+
+// compression contexts cached per thread for the one-shot zstd and lz4 functions, so that the compression state is
+// not allocated again for each call when compressing many small messages
+struct CompressionContexts {
+#ifdef HAVE_ZSTD
+   ZSTD_CCtx *zstd_cctx;
+   ZSTD_DCtx *zstd_dctx;
+#endif
+#ifdef HAVE_LZ4
+   LZ4F_cctx *lz4_cctx;
+   LZ4F_dctx *lz4_dctx;
+#endif
+
+   DLLLOCAL CompressionContexts() {
+#ifdef HAVE_ZSTD
+      zstd_cctx = 0;
+      zstd_dctx = 0;
+#endif
+#ifdef HAVE_LZ4
+      lz4_cctx = 0;
+      lz4_dctx = 0;
+#endif
+   }
+
+   DLLLOCAL ~CompressionContexts() {
+#ifdef HAVE_ZSTD
+      ZSTD_freeCCtx(zstd_cctx);
+      ZSTD_freeDCtx(zstd_dctx);
+#endif
+#ifdef HAVE_LZ4
+      if (lz4_cctx)
+         LZ4F_freeCompressionContext(lz4_cctx);
+      if (lz4_dctx)
+         LZ4F_freeDecompressionContext(lz4_dctx);
+#endif
+   }
+};
+
+static QoreThreadLocalObject<CompressionContexts> compression_contexts;
+
+// provides the contexts of the current thread, or temporary contexts if thread-local storage is not available
+class CompressionContextHelper {
+public:
+   DLLLOCAL CompressionContextHelper() : cc(compression_contexts.get()) {
+      if (!cc)
+         cc = &tmp;
+   }
+
+   DLLLOCAL CompressionContexts *operator->() {
+      return cc;
+   }
+
+private:
+   CompressionContexts *cc;
+   CompressionContexts tmp;
+};
+
+// returns the initial output buffer size for decompressing data with the given compressed and (if known) uncompressed
+// sizes; the size from the frame header is limited so that a corrupted header cannot cause a huge allocation
+static size_t get_decompress_buffer_size(size_t len, unsigned long long content_size, bool known) {
+   if (known)
+      return QORE_MAX((size_t)QORE_MIN(content_size, (unsigned long long)len * 256 + 4096), (size_t)1);
+   return len * 4 + 4096;
+}
+
+#ifdef HAVE_ZSTD
+static BinaryNode *zstd_compress(const void *ptr, size_t len, int64 level, const BinaryNode *dict, ExceptionSink *xsink) {
+   if (check_zstd_level(level, xsink))
+      return 0;
+
+   CompressionContextHelper cc;
+   if (!cc->zstd_cctx && !(cc->zstd_cctx = ZSTD_createCCtx())) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   if (init_zstd_cctx(cc->zstd_cctx, level, dict ? dict->getPtr() : 0, dict ? dict->size() : 0, xsink))
+      return 0;
+
+   size_t bs = ZSTD_compressBound(len);
+   SimpleRefHolder<BinaryNode> b(new BinaryNode);
+   if (b->preallocate(bs)) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   size_t rc = ZSTD_compress2(cc->zstd_cctx, const_cast<void *>(b->getPtr()), bs, ptr, len);
+   if (ZSTD_isError(rc)) {
+      CompressionErrorHelper::mapZstdError(rc, xsink);
+      return 0;
+   }
+   b->setSize(rc);
+   return b.release();
+}
+
+static BinaryNode *zstd_decompress(const void *ptr, size_t len, const BinaryNode *dict, ExceptionSink *xsink) {
+   CompressionContextHelper cc;
+   if (!cc->zstd_dctx && !(cc->zstd_dctx = ZSTD_createDCtx())) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   if (init_zstd_dctx(cc->zstd_dctx, dict ? dict->getPtr() : 0, dict ? dict->size() : 0, xsink))
+      return 0;
+
+   unsigned long long cs = ZSTD_getFrameContentSize(ptr, len);
+   size_t bs = get_decompress_buffer_size(len, cs, cs != ZSTD_CONTENTSIZE_UNKNOWN && cs != ZSTD_CONTENTSIZE_ERROR);
+   SimpleRefHolder<BinaryNode> b(new BinaryNode);
+   ZSTD_inBuffer in = { ptr, len, 0 };
+   size_t done = 0;
+   if (b->preallocate(bs)) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   while (true) {
+      ZSTD_outBuffer out = { static_cast<char *>(const_cast<void *>(b->getPtr())) + done, bs - done, 0 };
+      size_t rc = ZSTD_decompressStream(cc->zstd_dctx, &out, &in);
+      if (ZSTD_isError(rc)) {
+         CompressionErrorHelper::mapZstdError(rc, xsink);
+         return 0;
+      }
+      done += out.pos;
+      if (!rc) {
+         if (in.pos != in.size) {
+            xsink->raiseException("ZSTD-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            return 0;
+         }
+         break;
+      }
+      if (in.pos == in.size && out.pos < out.size) {
+         xsink->raiseException("ZSTD-ERROR", "Unexpected end of compressed data stream");
+         return 0;
+      }
+      if (done == bs) {
+         bs *= 2;
+         if (b->preallocate(bs)) {
+            xsink->outOfMemory();
+            return 0;
+         }
+      }
+   }
+   b->setSize(done);
+   return b.release();
+}
+#endif
+
+#ifdef HAVE_LZ4
+static BinaryNode *lz4_compress(const void *ptr, size_t len, int64 level, const BinaryNode *dict, ExceptionSink *xsink) {
+   if (check_lz4_level(level, xsink))
+      return 0;
+
+   LZ4F_preferences_t prefs;
+   init_lz4_prefs(prefs, level, len);
+
+   size_t bs = LZ4F_compressFrameBound(len, &prefs);
+   SimpleRefHolder<BinaryNode> b(new BinaryNode);
+   if (b->preallocate(bs)) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   void *dst = const_cast<void *>(b->getPtr());
+   size_t rc;
+   if (dict) {
+      CompressionContextHelper cc;
+      if (!cc->lz4_cctx) {
+         rc = LZ4F_createCompressionContext(&cc->lz4_cctx, LZ4F_VERSION);
+         if (LZ4F_isError(rc)) {
+            cc->lz4_cctx = 0;
+            CompressionErrorHelper::mapLz4Error(rc, xsink);
+            return 0;
+         }
+      }
+      LZ4F_CDict *cdict = LZ4F_createCDict(dict->getPtr(), dict->size());
+      if (!cdict) {
+         xsink->outOfMemory();
+         return 0;
+      }
+      rc = LZ4F_compressFrame_usingCDict(cc->lz4_cctx, dst, bs, ptr, len, cdict, &prefs);
+      LZ4F_freeCDict(cdict);
+   } else {
+      rc = LZ4F_compressFrame(dst, bs, ptr, len, &prefs);
+   }
+   if (LZ4F_isError(rc)) {
+      CompressionErrorHelper::mapLz4Error(rc, xsink);
+      return 0;
+   }
+   b->setSize(rc);
+   return b.release();
+}
+
+static BinaryNode *lz4_decompress(const void *ptr, size_t len, const BinaryNode *dict, ExceptionSink *xsink) {
+   CompressionContextHelper cc;
+   if (!cc->lz4_dctx) {
+      size_t rc = LZ4F_createDecompressionContext(&cc->lz4_dctx, LZ4F_VERSION);
+      if (LZ4F_isError(rc)) {
+         cc->lz4_dctx = 0;
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         return 0;
+      }
+   }
+   LZ4F_dctx *dctx = cc->lz4_dctx;
+   // the context may have been left in the middle of a frame by an earlier error
+   LZ4F_resetDecompressionContext(dctx);
+
+   if (!len) {
+      xsink->raiseException("LZ4-ERROR", "Unexpected end of compressed data stream");
+      return 0;
+   }
+
+   LZ4F_frameInfo_t info;
+   size_t pos = len;
+   size_t rc = LZ4F_getFrameInfo(dctx, &info, ptr, &pos);
+   if (LZ4F_isError(rc)) {
+      CompressionErrorHelper::mapLz4Error(rc, xsink);
+      return 0;
+   }
+
+   size_t bs = get_decompress_buffer_size(len, info.contentSize, info.contentSize);
+   SimpleRefHolder<BinaryNode> b(new BinaryNode);
+   const char *src = static_cast<const char *>(ptr);
+   size_t done = 0;
+   if (b->preallocate(bs)) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   while (true) {
+      size_t dst_size = bs - done;
+      size_t src_size = len - pos;
+      void *dst = static_cast<char *>(const_cast<void *>(b->getPtr())) + done;
+      rc = dict
+         ? LZ4F_decompress_usingDict(dctx, dst, &dst_size, src + pos, &src_size, dict->getPtr(), dict->size(), 0)
+         : LZ4F_decompress(dctx, dst, &dst_size, src + pos, &src_size, 0);
+      if (LZ4F_isError(rc)) {
+         CompressionErrorHelper::mapLz4Error(rc, xsink);
+         return 0;
+      }
+      pos += src_size;
+      done += dst_size;
+      if (!rc) {
+         if (pos != len) {
+            xsink->raiseException("LZ4-ERROR", "Unexpected extra bytes at the end of the compressed data stream");
+            return 0;
+         }
+         break;
+      }
+      if (pos == len && done < bs) {
+         xsink->raiseException("LZ4-ERROR", "Unexpected end of compressed data stream");
+         return 0;
+      }
+      if (done == bs) {
+         bs *= 2;
+         if (b->preallocate(bs)) {
+            xsink->outOfMemory();
+            return 0;
+         }
+      }
+   }
+   b->setSize(done);
+   return b.release();
+}
+#endif
+
+// a block of input data compressed independently by a ParallelCompressTransform worker thread
+struct ParallelCompressionBlock {
+   std::vector<char> in;
+   // deflate: the last 32KB of the preceding input used as the dictionary for this block
+   std::vector<char> dict;
+   std::vector<unsigned char> out;
+   // size of the input data
+   int64 in_len;
+   // bzip2: the bit range of the single compressed block in "out"
+   int64 bit_start, bit_end;
+   // deflate: CRC-32 or Adler-32 of the input; bzip2: the block CRC
+   uint32_t check;
+   // error code or 0
+   int rc;
+   bool last, done;
+
+   DLLLOCAL ParallelCompressionBlock(bool l) : in_len(0), bit_start(0), bit_end(0), check(0), rc(0), last(l), done(false) {
+   }
+};
+
+/* compresses input in blocks on a set of worker threads and writes a single standard gzip, zlib or bzip2 stream
+
+   for gzip and zlib, each block is compressed as raw deflate data with the end of the preceding block as the
+   dictionary and ended with a sync flush, so the blocks can be concatenated to form one deflate stream; the
+   checksums of the blocks are combined for the trailer
+
+   for bzip2, each block is small enough to be compressed to exactly one bzip2 block, which is then copied bit by bit
+   into the output stream with the combined stream CRC written at the end
+*/
+class ParallelCompressTransform : public Transform {
+public:
+   enum Format { FMT_GZIP, FMT_ZLIB, FMT_BZIP2 };
+
+   DLLLOCAL ParallelCompressTransform(Format f, int lvl, int64 bs, unsigned nt) : fmt(f), level(lvl), block_size(bs),
+      nthreads(nt), max_queued(nt * 2), running(0), idle(0), stop(false), cur(0), submitted_last(false), total_in(0),
+      check(f == FMT_ZLIB ? adler32(0, Z_NULL, 0) : 0), acc(0), nacc(0), opos(0), state(STATE_OK) {
+      writeHeader();
+   }
+
+   virtual ~ParallelCompressTransform() {
+      stopWorkers();
+      delete cur;
+      for (block_deque_t::iterator i = blocks.begin(), e = blocks.end(); i != e; ++i)
+         delete *i;
+   }
+
+   std::pair<int64, int64> apply(const void *src, int64 srcLen, void *dst, int64 dstLen, ExceptionSink *xsink) {
+      if (state == STATE_END)
+         return std::make_pair(0, 0);
+      if (state != STATE_OK) {
+         raiseError(Z_STREAM_ERROR, xsink);
+         return std::make_pair(0, 0);
+      }
+
+      int64 rc = 0;
+      if (src) {
+         // copy input to the current block until the queue is full
+         const char *p = static_cast<const char *>(src);
+         while (rc < srcLen) {
+            if (!cur) {
+               if (blocks.size() >= max_queued)
+                  break;
+               cur = new ParallelCompressionBlock(false);
+               cur->in.reserve(block_size);
+            }
+            int64 n = QORE_MIN(srcLen - rc, block_size - (int64)cur->in.size());
+            cur->in.insert(cur->in.end(), p + rc, p + rc + n);
+            rc += n;
+            if ((int64)cur->in.size() == block_size && submit(xsink))
+               return std::make_pair(0, 0);
+         }
+      }
+      else if (!submitted_last) {
+         // submit the final block; for deflate, an empty final block is needed to end the stream
+         if (!cur)
+            cur = new ParallelCompressionBlock(true);
+         else
+            cur->last = true;
+         if (submit(xsink))
+            return std::make_pair(0, 0);
+      }
+
+      // wait for output if no input could be consumed or if flushing
+      int64 wc = write(dst, dstLen, !rc, xsink);
+      if (*xsink)
+         return std::make_pair(0, 0);
+      if (!src && !wc)
+         state = STATE_END;
+      return std::make_pair(rc, wc);
+   }
+
+private:
+   enum State {
+      STATE_OK, STATE_ERROR, STATE_END
+   };
+
+   typedef std::deque<ParallelCompressionBlock*> block_deque_t;
+
+   Format fmt;
+   int level;
+   int64 block_size;
+   unsigned nthreads,
+      // max number of blocks queued or being compressed
+      max_queued,
+      // number of worker threads started
+      running,
+      // number of worker threads waiting for a block
+      idle;
+
+   QoreThreadLock l;
+   // signaled when a block has been queued for compression or the workers should stop
+   QoreCondition work_cond;
+   // signaled when a block has been compressed
+   QoreCondition done_cond;
+   // blocks not yet taken by a worker
+   block_deque_t todo;
+   std::vector<pthread_t> workers;
+   bool stop;
+
+   // blocks in output order; only accessed in the calling thread
+   block_deque_t blocks;
+   ParallelCompressionBlock *cur;
+   // deflate: the dictionary for the next block
+   std::vector<char> dict;
+   bool submitted_last;
+   int64 total_in;
+   // combined checksum of the input (deflate) or the stream CRC (bzip2)
+   uint32_t check;
+
+   // output waiting to be written to the destination buffer
+   std::vector<unsigned char> obuf;
+   // bzip2: bit accumulator for output not yet aligned to a byte boundary
+   uint32_t acc;
+   int nacc;
+   size_t opos;
+
+   State state;
+
+   DLLLOCAL int submit(ExceptionSink *xsink) {
+      ParallelCompressionBlock *b = cur;
+      cur = 0;
+      if (b->last)
+         submitted_last = true;
+      b->in_len = b->in.size();
+
+      if (fmt != FMT_BZIP2) {
+         b->dict.swap(dict);
+         size_t dl = QORE_MIN(b->in.size(), (size_t)32768);
+         if (dl < 32768 && !b->dict.empty()) {
+            // keep the end of the previous dictionary if the block is smaller than the deflate window
+            size_t keep = QORE_MIN(b->dict.size(), (size_t)32768 - dl);
+            dict.assign(b->dict.end() - keep, b->dict.end());
+         }
+         dict.insert(dict.end(), b->in.end() - dl, b->in.end());
+      }
+
+      blocks.push_back(b);
+
+      AutoLocker al(l);
+      todo.push_back(b);
+      // start another worker if all are busy
+      if (running < nthreads && todo.size() > idle) {
+         pthread_t ptid;
+         int rc = pthread_create(&ptid, ta_default.get_ptr(), worker_thread, this);
+         if (rc && !running) {
+            xsink->raiseErrnoException("THREAD-CREATION-FAILURE", rc, "cannot start compression worker thread");
+            state = STATE_ERROR;
+            return -1;
+         }
+         if (!rc) {
+            workers.push_back(ptid);
+            ++running;
+            ++idle;
+         }
+      }
+      work_cond.signal();
+      return 0;
+   }
+
+   DLLLOCAL static void *worker_thread(void *arg) {
+      static_cast<ParallelCompressTransform *>(arg)->work();
+      return 0;
+   }
+
+   DLLLOCAL void work() {
+      z_stream strm;
+      bool zinit = false;
+      if (fmt != FMT_BZIP2) {
+         strm.zalloc = Z_NULL;
+         strm.zfree = Z_NULL;
+         strm.opaque = Z_NULL;
+         zinit = deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+      }
+
+      SafeLocker sl(l);
+      while (true) {
+         while (!stop && todo.empty())
+            work_cond.wait(l);
+         if (stop)
+            break;
+         ParallelCompressionBlock *b = todo.front();
+         todo.pop_front();
+         --idle;
+         sl.unlock();
+
+         if (fmt == FMT_BZIP2)
+            compressBzip2(*b);
+         else if (!zinit)
+            b->rc = Z_MEM_ERROR;
+         else
+            compressDeflate(strm, *b);
+
+         sl.lock();
+         ++idle;
+         b->done = true;
+         done_cond.broadcast();
+      }
+      sl.unlock();
+
+      if (zinit)
+         deflateEnd(&strm);
+   }
+
+   DLLLOCAL void compressDeflate(z_stream &strm, ParallelCompressionBlock &b) {
+      int rc = deflateReset(&strm);
+      if (rc == Z_OK && !b.dict.empty())
+         rc = deflateSetDictionary(&strm, reinterpret_cast<const Bytef *>(&b.dict[0]), b.dict.size());
+      if (rc != Z_OK) {
+         b.rc = rc;
+         return;
+      }
+
+      // room for the stored block ending a sync flush as well
+      b.out.resize(deflateBound(&strm, b.in.size()) + 16);
+      strm.next_in = b.in.empty() ? Z_NULL : reinterpret_cast<Bytef *>(&b.in[0]);
+      strm.avail_in = b.in.size();
+      strm.next_out = &b.out[0];
+      strm.avail_out = b.out.size();
+      rc = deflate(&strm, b.last ? Z_FINISH : Z_SYNC_FLUSH);
+      if (b.last ? rc != Z_STREAM_END : (rc != Z_OK || !strm.avail_out)) {
+         b.rc = rc == Z_OK || rc == Z_STREAM_END ? Z_BUF_ERROR : rc;
+         return;
+      }
+      b.out.resize(b.out.size() - strm.avail_out);
+
+      const Bytef *p = b.in.empty() ? Z_NULL : reinterpret_cast<const Bytef *>(&b.in[0]);
+      b.check = fmt == FMT_GZIP ? crc32(crc32(0, Z_NULL, 0), p, b.in.size()) : adler32(adler32(0, Z_NULL, 0), p, b.in.size());
+      b.in.clear();
+      b.dict.clear();
+   }
+
+   DLLLOCAL static uint64_t getBits(const unsigned char *p, int64 pos, int n) {
+      uint64_t v = 0;
+      for (int i = 0; i < n; ++i, ++pos)
+         v = (v << 1) | ((p[pos >> 3] >> (7 - (pos & 7))) & 1);
+      return v;
+   }
+
+   DLLLOCAL void compressBzip2(ParallelCompressionBlock &b) {
+      // an empty final block contributes no data to the stream
+      if (b.in.empty())
+         return;
+
+      unsigned len = b.in.size() + b.in.size() / 100 + 600;
+      b.out.resize(len);
+      int rc = BZ2_bzBuffToBuffCompress(reinterpret_cast<char *>(&b.out[0]), &len, &b.in[0], b.in.size(), level, 0, 30);
+      if (rc != BZ_OK) {
+         b.rc = rc;
+         return;
+      }
+      b.out.resize(len);
+      b.in.clear();
+
+      // the stream is: "BZh" + level, blocks starting with the 48-bit block magic, then the 48-bit end-of-stream
+      // magic, the 32-bit stream CRC and 0 - 7 bits of padding
+      const unsigned char *p = &b.out[0];
+      int64 bits = (int64)len * 8;
+      for (int pad = 0; pad < 8; ++pad) {
+         int64 e = bits - pad - 80;
+         if (e >= 32 && getBits(p, e, 48) == 0x177245385090ull) {
+            b.bit_start = 32;
+            b.bit_end = e;
+            if (e > 32) {
+               // with one block, the stream CRC is the block CRC
+               b.check = (uint32_t)getBits(p, 80, 32);
+               if (b.check != (uint32_t)getBits(p, e + 48, 32))
+                  b.rc = BZ_SEQUENCE_ERROR;
+            }
+            return;
+         }
+      }
+      b.rc = BZ_DATA_ERROR_MAGIC;
+   }
+
+   DLLLOCAL void putBits(uint64_t v, int n) {
+      while (n > 0) {
+         int k = QORE_MIN(n, 24 - nacc);
+         n -= k;
+         acc = (acc << k) | (uint32_t)((v >> n) & ((1u << k) - 1));
+         nacc += k;
+         while (nacc >= 8) {
+            nacc -= 8;
+            obuf.push_back((unsigned char)(acc >> nacc));
+         }
+      }
+   }
+
+   DLLLOCAL void writeHeader() {
+      if (fmt == FMT_GZIP) {
+         static const unsigned char gzip_header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+         obuf.assign(gzip_header, gzip_header + sizeof(gzip_header));
+      }
+      else if (fmt == FMT_ZLIB) {
+         unsigned flevel = level == Z_DEFAULT_COMPRESSION || level == 6 ? 2 : (level < 2 ? 0 : (level < 6 ? 1 : 3));
+         unsigned hdr = (0x78 << 8) | (flevel << 6);
+         hdr += 31 - hdr % 31;
+         obuf.push_back((unsigned char)(hdr >> 8));
+         obuf.push_back((unsigned char)hdr);
+      }
+      else {
+         const char h[] = { 'B', 'Z', 'h', (char)('0' + level) };
+         obuf.assign(h, h + sizeof(h));
+      }
+   }
+
+   DLLLOCAL void writeTrailer() {
+      if (fmt == FMT_GZIP) {
+         for (int i = 0; i < 4; ++i)
+            obuf.push_back((unsigned char)(check >> (i * 8)));
+         for (int i = 0; i < 4; ++i)
+            obuf.push_back((unsigned char)(total_in >> (i * 8)));
+      }
+      else if (fmt == FMT_ZLIB) {
+         for (int i = 3; i >= 0; --i)
+            obuf.push_back((unsigned char)(check >> (i * 8)));
+      }
+      else {
+         putBits(0x177245385090ull, 48);
+         putBits(check, 32);
+         if (nacc)
+            putBits(0, 8 - nacc);
+      }
+   }
+
+   // moves the output of the next compressed block to the output buffer; returns -1 on error
+   DLLLOCAL int takeBlock(ParallelCompressionBlock *b, ExceptionSink *xsink) {
+      blocks.pop_front();
+      std::unique_ptr<ParallelCompressionBlock> holder(b);
+      if (b->rc) {
+         state = STATE_ERROR;
+         raiseError(b->rc, xsink);
+         return -1;
+      }
+
+      obuf.erase(obuf.begin(), obuf.begin() + opos);
+      opos = 0;
+      if (fmt == FMT_BZIP2) {
+         if (b->bit_end > b->bit_start) {
+            const unsigned char *p = &b->out[0];
+            int64 i = b->bit_start;
+            int sh = i & 7;
+            for (; i + 8 <= b->bit_end; i += 8) {
+               const unsigned char *bp = p + (i >> 3);
+               putBits(sh ? (unsigned char)((bp[0] << sh) | (bp[1] >> (8 - sh))) : bp[0], 8);
+            }
+            if (i < b->bit_end)
+               putBits(getBits(p, i, b->bit_end - i), b->bit_end - i);
+            check = ((check << 1) | (check >> 31)) ^ b->check;
+         }
+      }
+      else {
+         obuf.insert(obuf.end(), b->out.begin(), b->out.end());
+         check = fmt == FMT_GZIP ? crc32_combine(check, b->check, b->in_len) : adler32_combine(check, b->check, b->in_len);
+         total_in += b->in_len;
+      }
+      if (b->last)
+         writeTrailer();
+      return 0;
+   }
+
+   // writes available output to the destination buffer; waits for the next block if there is no output and "block"
+   // is true
+   DLLLOCAL int64 write(void *dst, int64 dstLen, bool block, ExceptionSink *xsink) {
+      while (opos == obuf.size() && !blocks.empty()) {
+         ParallelCompressionBlock *b = blocks.front();
+         {
+            SafeLocker sl(l);
+            while (!b->done) {
+               if (!block)
+                  return 0;
+               done_cond.wait(l);
+            }
+         }
+         if (takeBlock(b, xsink))
+            return 0;
+      }
+
+      int64 n = QORE_MIN(dstLen, (int64)(obuf.size() - opos));
+      if (n) {
+         memcpy(dst, &obuf[opos], n);
+         opos += n;
+      }
+      if (opos == obuf.size() && submitted_last && blocks.empty())
+         stopWorkers();
+      return n;
+   }
+
+   DLLLOCAL void raiseError(int rc, ExceptionSink *xsink) {
+      if (fmt == FMT_BZIP2)
+         CompressionErrorHelper::mapBzip2Error(rc, xsink);
+      else
+         CompressionErrorHelper::mapZlibError(rc, xsink);
+   }
+
+   DLLLOCAL void stopWorkers() {
+      {
+         AutoLocker al(l);
+         if (workers.empty())
+            return;
+         stop = true;
+         work_cond.broadcast();
+      }
+      for (std::vector<pthread_t>::iterator i = workers.begin(), e = workers.end(); i != e; ++i)
+         pthread_join(*i, 0);
+      workers.clear();
+      stop = false;
+      running = 0;
+      idle = 0;
+   }
+};
+
+// raises an exception if a dictionary is given for an algorithm that does not support one
+static int check_no_dict(const QoreStringNode *alg, const BinaryNode *dict, ExceptionSink *xsink) {
+   if (!dict)
+      return 0;
+   xsink->raiseException("COMPRESS-ERROR", "the %s algorithm does not support dictionaries", alg->getBuffer());
+   return -1;
+}
+
+Transform *CompressionTransforms::getCompressor(const QoreStringNode *alg, int64 level, const BinaryNode *dict, ExceptionSink *xsink) {
    if (*alg == ALG_ZLIB) {
-      return new ZlibDeflateTransform(level, xsink, false);
+      return check_no_dict(alg, dict, xsink) ? 0 : new ZlibDeflateTransform(level, xsink, false);
    } else if (*alg == ALG_GZIP) {
-      return new ZlibDeflateTransform(level, xsink, true);
+      return check_no_dict(alg, dict, xsink) ? 0 : new ZlibDeflateTransform(level, xsink, true);
    } else if (*alg == ALG_BZIP2) {
-      return new Bzip2CompressTransform(level, xsink);
+      return check_no_dict(alg, dict, xsink) ? 0 : new Bzip2CompressTransform(level, xsink);
+   } else if (*alg == ALG_ZSTD) {
+#ifdef HAVE_ZSTD
+      return new ZstdCompressTransform(level, dict, xsink);
+#else
+      CompressionErrorHelper::raiseMissingFeature(ALG_ZSTD, xsink);
+      return 0;
+#endif
+   } else if (*alg == ALG_LZ4) {
+#ifdef HAVE_LZ4
+      return new Lz4CompressTransform(level, dict, xsink);
+#else
+      CompressionErrorHelper::raiseMissingFeature(ALG_LZ4, xsink);
+      return 0;
+#endif
    }
    xsink->raiseException("COMPRESS-ERROR", "Unknown compression algorithm: %s", alg->getBuffer());
    return 0;
 }
 
-Transform *CompressionTransforms::getDecompressor(const QoreStringNode *alg, ExceptionSink *xsink) {
+Transform *CompressionTransforms::getParallelCompressor(const QoreStringNode *alg, int64 level, int64 block_size, int64 threads, ExceptionSink *xsink) {
+   ParallelCompressTransform::Format fmt;
+   if (*alg == ALG_ZLIB || *alg == ALG_GZIP) {
+      fmt = *alg == ALG_ZLIB ? ParallelCompressTransform::FMT_ZLIB : ParallelCompressTransform::FMT_GZIP;
+      if (level == LEVEL_DEFAULT) {
+         level = Z_DEFAULT_COMPRESSION;
+      } else if (!(level >= 0 && level <= 9)) {
+         xsink->raiseException("ZLIB-LEVEL-ERROR", "level must be between 0 - 9 or -1 (value passed: %d)", level);
+         return 0;
+      }
+   } else if (*alg == ALG_BZIP2) {
+      fmt = ParallelCompressTransform::FMT_BZIP2;
+      if (level == LEVEL_DEFAULT) {
+         level = 3;
+      } else if (!(level >= 1 && level <= 9)) {
+         xsink->raiseException("BZIP2-LEVEL-ERROR", "level must be between 1 - 9 or -1 (value passed: %d)", level);
+         return 0;
+      }
+   } else {
+      xsink->raiseException("COMPRESS-ERROR", "Unknown compression algorithm: %s", alg->getBuffer());
+      return 0;
+   }
+
+   if (block_size && block_size < PARALLEL_BLOCK_SIZE_MIN) {
+      xsink->raiseException("COMPRESS-ERROR", "block size must be at least %d bytes or 0 for the default (value passed: " QLLD ")", (int)PARALLEL_BLOCK_SIZE_MIN, block_size);
+      return 0;
+   }
+   if (fmt == ParallelCompressTransform::FMT_BZIP2) {
+      // blocks must fit into a single bzip2 block after the initial run-length encoding, which can expand the data
+      // by up to 25%
+      int64 max = (level * 100000 - 19) * 4 / 5;
+      if (!block_size || block_size > max)
+         block_size = max;
+   } else if (!block_size) {
+      block_size = PARALLEL_BLOCK_SIZE_DEFAULT;
+   }
+
+   if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (threads <= 0)
+         threads = 1;
+   }
+   if (threads > PARALLEL_THREADS_MAX)
+      threads = PARALLEL_THREADS_MAX;
+
+   return new ParallelCompressTransform(fmt, level, block_size, threads);
+}
+
+Transform *CompressionTransforms::getDecompressor(const QoreStringNode *alg, const BinaryNode *dict, ExceptionSink *xsink) {
    if (*alg == ALG_ZLIB) {
-      return new ZlibInflateTransform(xsink, false);
+      return check_no_dict(alg, dict, xsink) ? 0 : new ZlibInflateTransform(xsink, false);
    } else if (*alg == ALG_GZIP) {
-      return new ZlibInflateTransform(xsink, true);
+      return check_no_dict(alg, dict, xsink) ? 0 : new ZlibInflateTransform(xsink, true);
    } else if (*alg == ALG_BZIP2) {
-      return new Bzip2DecompressTransform(xsink);
+      return check_no_dict(alg, dict, xsink) ? 0 : new Bzip2DecompressTransform(xsink);
+   } else if (*alg == ALG_ZSTD) {
+#ifdef HAVE_ZSTD
+      return new ZstdDecompressTransform(dict, xsink);
+#else
+      CompressionErrorHelper::raiseMissingFeature(ALG_ZSTD, xsink);
+      return 0;
+#endif
+   } else if (*alg == ALG_LZ4) {
+#ifdef HAVE_LZ4
+      return new Lz4DecompressTransform(dict, xsink);
+#else
+      CompressionErrorHelper::raiseMissingFeature(ALG_LZ4, xsink);
+      return 0;
+#endif
    }
    xsink->raiseException("COMPRESS-ERROR", "Unknown compression algorithm: %s", alg->getBuffer());
    return 0;
 }
+
+BinaryNode *CompressionTransforms::compress(const char *alg, const void *ptr, size_t len, int64 level, const BinaryNode *dict, ExceptionSink *xsink) {
+   if (!strcmp(alg, ALG_ZSTD)) {
+#ifdef HAVE_ZSTD
+      return zstd_compress(ptr, len, level, dict, xsink);
+#endif
+   } else {
+      assert(!strcmp(alg, ALG_LZ4));
+#ifdef HAVE_LZ4
+      return lz4_compress(ptr, len, level, dict, xsink);
+#endif
+   }
+   CompressionErrorHelper::raiseMissingFeature(alg, xsink);
+   return 0;
+}
+
+BinaryNode *CompressionTransforms::decompress(const char *alg, const void *ptr, size_t len, const BinaryNode *dict, ExceptionSink *xsink) {
+   if (!strcmp(alg, ALG_ZSTD)) {
+#ifdef HAVE_ZSTD
+      return zstd_decompress(ptr, len, dict, xsink);
+#endif
+   } else {
+      assert(!strcmp(alg, ALG_LZ4));
+#ifdef HAVE_LZ4
+      return lz4_decompress(ptr, len, dict, xsink);
+#endif
+   }
+   CompressionErrorHelper::raiseMissingFeature(alg, xsink);
+   return 0;
+}
+
+BinaryNode *CompressionTransforms::trainZstdDictionary(const QoreListNode *samples, int64 max_size, ExceptionSink *xsink) {
+#ifdef HAVE_ZSTD
+   if (max_size < 256) {
+      xsink->raiseException("ZSTD-DICTIONARY-ERROR", "the maximum dictionary size must be at least 256 bytes (value passed: " QLLD ")", max_size);
+      return 0;
+   }
+
+   // ZDICT_trainFromBuffer() takes the samples concatenated in one buffer
+   std::vector<char> buf;
+   std::vector<size_t> sizes;
+   ConstListIterator li(samples);
+   for (int i = 0; li.next(); ++i) {
+      const AbstractQoreNode *n = li.getValue();
+      qore_type_t t = get_node_type(n);
+      const char *p;
+      size_t l;
+      if (t == NT_BINARY) {
+         const BinaryNode *b = reinterpret_cast<const BinaryNode *>(n);
+         p = static_cast<const char *>(b->getPtr());
+         l = b->size();
+      } else if (t == NT_STRING) {
+         const QoreStringNode *str = reinterpret_cast<const QoreStringNode *>(n);
+         p = str->getBuffer();
+         l = str->size();
+      } else {
+         xsink->raiseException("ZSTD-DICTIONARY-ERROR", "sample %d is type '%s'; expecting 'string' or 'binary'", i, get_type_name(n));
+         return 0;
+      }
+      buf.insert(buf.end(), p, p + l);
+      sizes.push_back(l);
+   }
+
+   SimpleRefHolder<BinaryNode> b(new BinaryNode);
+   if (b->preallocate(max_size)) {
+      xsink->outOfMemory();
+      return 0;
+   }
+   size_t rc = ZDICT_trainFromBuffer(const_cast<void *>(b->getPtr()), max_size, buf.empty() ? 0 : &buf[0], sizes.empty() ? 0 : &sizes[0], sizes.size());
+   if (ZDICT_isError(rc)) {
+      xsink->raiseException("ZSTD-DICTIONARY-ERROR", "%s", ZDICT_getErrorName(rc));
+      return 0;
+   }
+   b->setSize(rc);
+   return b.release();
+#else
+   CompressionErrorHelper::raiseMissingFeature(ALG_ZSTD, xsink);
+   return 0;
+#endif
+}
@@ -89,7 +89,7 @@ static inline int in_list(AbstractQoreNode *node, struct node_row_list_s *nlist,
 
 Context::Context(char *nme, ExceptionSink *xsink, AbstractQoreNode *exp, AbstractQoreNode *cond,
 		 int sort_type, AbstractQoreNode *sort, AbstractQoreNode *summary,
-		 int ignore_key) : value(0), master_row_list(0), row_list(0), group_values(0) {
+		 int ignore_key) : value(0), master_row_list(0), row_list(0), group_values(0), row_shape(0) {
    int allocated = 0;
    //int sense, lcolumn = -1, fcolumn = -1
    //class Key *key = 0;
@@ -350,6 +350,8 @@ Context::~Context() {
 
    if (name)
       free(name);
+   if (row_shape)
+      row_shape->deref(0);
    if (master_row_list) {
       free(master_row_list);
       if (group_values) {
@@ -434,22 +436,25 @@ QoreHashNode *Context::getRow(ExceptionSink *xsink) {
    if (!value)
       return 0;
 
-   ReferenceHolder<QoreHashNode> h(new QoreHashNode(), xsink);
+   // all rows share the key layout of the context hash
+   if (!row_shape)
+      row_shape = value->copyShape();
+   ReferenceHolder<QoreHashNode> h(row_shape->copyShape(), xsink);
 
    HashIterator hi(value);
+   HashIterator ri(*h);
    while (hi.next()) {
-      const char *key = hi.getKey();
-      printd(5, "Context::getRow() key=%s\n", key);
+      ri.next();
+      printd(5, "Context::getRow() key=%s\n", hi.getKey());
       // get list from hash
       ReferenceHolder<AbstractQoreNode> v(hi.getReferencedValue(), xsink);
 
-      // if the hash key does not contain a list, then set the value to NOTHING
-      if (get_node_type(*v) != NT_LIST)
-	 h->setKeyValue(key, 0, 0);
-      else {
+      // if the hash key does not contain a list, then the value remains NOTHING
+      if (get_node_type(*v) == NT_LIST) {
 	 // set key value to list entry
 	 QoreListNode *l = reinterpret_cast<QoreListNode *>(*v);
-	 h->setKeyValue(key, l->eval_entry(row_list[pos], xsink), 0);
+	 HashAssignmentHelper ha(ri);
+	 ha.assign(l->eval_entry(row_list[pos], xsink), 0);
       }
    }
 
@@ -30,20 +30,76 @@
 
 #include <qore/Qore.h>
 #include "qore/intern/DatasourcePool.h"
+#include "qore/intern/QoreThreadLocalObject.h"
 
 #include <memory>
+#include <vector>
+
+// connections allocated to the current thread; only accessed by the thread itself, so a thread that already holds
+// a connection can find it without locking the pool
+class DatasourcePoolThreadConnections {
+public:
+   // returns the pool index or -1 if the thread holds no connection from the given pool
+   DLLLOCAL int find(int64 pool_id) const {
+      for (dsp_conn_vec_t::const_iterator i = conn.begin(), e = conn.end(); i != e; ++i)
+         if (i->pool_id == pool_id)
+            return i->idx;
+      return -1;
+   }
+
+   DLLLOCAL void add(int64 pool_id, int idx) {
+      DatasourcePoolThreadConnection c = { pool_id, idx };
+      conn.push_back(c);
+   }
+
+   DLLLOCAL void remove(int64 pool_id) {
+      for (dsp_conn_vec_t::iterator i = conn.begin(), e = conn.end(); i != e; ++i) {
+         if (i->pool_id == pool_id) {
+            conn.erase(i);
+            return;
+         }
+      }
+      assert(false);
+   }
+
+private:
+   struct DatasourcePoolThreadConnection {
+      int64 pool_id;
+      int idx;
+   };
+
+   typedef std::vector<DatasourcePoolThreadConnection> dsp_conn_vec_t;
+
+   dsp_conn_vec_t conn;
+};
+
+static QoreThreadLocalObject<DatasourcePoolThreadConnections> dsp_thread_conn;
+
+// source of unique pool IDs; pool addresses can be reused, IDs are not
+static std::atomic<int64> dsp_pool_id(0);
+
+static void dsp_hist_add(std::atomic<int64>* hist, int64 us) {
+   int b = 0;
+   while (b < (DSP_HIST_BUCKETS - 1) && us >= (1ll << b))
+      ++b;
+   hist[b].fetch_add(1, std::memory_order_relaxed);
+}
 
 DatasourcePool::DatasourcePool(ExceptionSink* xsink, DBIDriver* ndsl, const char* user, const char* pass,
 			       const char* db, const char* charset, const char* hostname, unsigned mn, unsigned mx, int port, const QoreHashNode* opts,
 			       Queue* q, AbstractQoreNode* a) :
       pool(new Datasource*[mx]),
-      tid_list(new int[mx]),
+      tid_list(new std::atomic<int>[mx]),
+      free_next(new std::atomic<int>[mx]),
+      acq_time(new int64[mx]),
+      free_head(0),
+      pool_id(++dsp_pool_id),
       min(mn),
       max(mx),
       cmax(0),
-      wait_count(0),
       wait_max(0),
       tl_warning_ms(0),
+      wait_count(0),
       tl_timeout_ms(120000),
       stats_reqs(0),
       stats_hits(0),
@@ -67,13 +123,17 @@ DatasourcePool::DatasourcePool(ExceptionSink* xsink, DBIDriver* ndsl, const char
 
 DatasourcePool::DatasourcePool(const DatasourcePool& old, ExceptionSink* xsink) :
    pool(new Datasource*[old.max]),
-   tid_list(new int[old.max]),
+   tid_list(new std::atomic<int>[old.max]),
+   free_next(new std::atomic<int>[old.max]),
+   acq_time(new int64[old.max]),
+   free_head(0),
+   pool_id(++dsp_pool_id),
    min(old.min),
    max(old.max),
    cmax(0),
-   wait_count(0),
    wait_max(0),
    tl_warning_ms(old.tl_warning_ms),
+   wait_count(0),
    tl_timeout_ms(old.tl_timeout_ms),
    stats_reqs(0),
    stats_hits(0),
@@ -88,6 +148,8 @@ DatasourcePool::~DatasourcePool() {
    //printd(5, "DatasourcePool::~DatasourcePool() trlist.remove() this: %p\n", this);
    for (unsigned i = 0; i < cmax; ++i)
       delete pool[i];
+   delete [] acq_time;
+   delete [] free_next;
    delete [] tid_list;
    delete [] pool;
    assert(!warning_callback);
@@ -96,6 +158,13 @@ DatasourcePool::~DatasourcePool() {
 
 // common constructor code
 void DatasourcePool::init(ExceptionSink* xsink) {
+   for (unsigned i = 0; i < max; ++i)
+      tid_list[i] = 0;
+   for (int i = 0; i < DSP_HIST_BUCKETS; ++i) {
+      wait_hist[i] = 0;
+      hold_hist[i] = 0;
+   }
+
    // ths intiial Datasource creation could throw an exception if there is an error in a driver option, for example
    std::unique_ptr<Datasource> ds(config.get(xsink));
    if (*xsink)
@@ -108,7 +177,7 @@ void DatasourcePool::init(ExceptionSink* xsink) {
    pool[0] = ds.release();
    //printd(5, "DP::init() open %s: %p (%d)\n", ndsl->getName(), pool[0], xsink->isEvent());
    // add to free list
-   free_list.push_back(0);
+   pushFree(0);
 
    while (++cmax < min) {
       ds.reset(config.get());
@@ -118,7 +187,7 @@ void DatasourcePool::init(ExceptionSink* xsink) {
       pool[cmax] = ds.release();
       //printd(5, "DP::init() open %s: %p (%d)\n", ndsl->getName(), pool[cmax], xsink->isEvent());
       // add to free list
-      free_list.push_back(cmax);
+      pushFree(cmax);
    }
    valid = true;
 }
@@ -127,13 +196,11 @@ void DatasourcePool::cleanup(ExceptionSink* xsink) {
    int tid = gettid();
 
    // thread must have a Datasource allocated
-   SafeLocker sl((QoreThreadLock *)this);
-   thread_use_t::iterator i = tmap.find(tid);
-   assert(i != tmap.end());
-   sl.unlock();
+   int i = getThreadIndex();
+   assert(i != -1);
 
 #ifndef DEBUG_1
-   xsink->raiseException("DATASOURCEPOOL-LOCK-EXCEPTION", "%s:%s@%s: TID %d terminated while in a transaction with connection %d; transaction will be automatically rolled back and the datasource returned to the pool", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid, i->second);
+   xsink->raiseException("DATASOURCEPOOL-LOCK-EXCEPTION", "%s:%s@%s: TID %d terminated while in a transaction with connection %d; transaction will be automatically rolled back and the datasource returned to the pool", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid, i);
 #else
    QoreString* sql = getAndResetSQL();
    xsink->raiseException("DATASOURCEPOOL-LOCK-EXCEPTION", "%s:%s@%s: TID %d terminated while in a transaction; transaction will be automatically rolled back and the datasource returned to the pool\n%s", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid, sql ? sql->getBuffer() : "<no data>");
@@ -142,16 +209,9 @@ void DatasourcePool::cleanup(ExceptionSink* xsink) {
 #endif
 
    // execute rollback on Datasource before releasing to pool
-   pool[i->second]->rollback(xsink);
-
-   // grab lock to add to free list and erase thread map entry
-   sl.lock();
-   free_list.push_back(i->second);
-   // erase thread map entry
-   tmap.erase(i);
-   // signal any waiting threads
-   if (wait_count)
-      signal();
+   pool[i]->rollback(xsink);
+
+   releaseIntern(i);
 }
 
 void DatasourcePool::destructor(ExceptionSink* xsink) {
@@ -161,15 +221,15 @@ void DatasourcePool::destructor(ExceptionSink* xsink) {
    valid = false;
 
    int tid = gettid();
-   thread_use_t::iterator i = tmap.find(tid);
-   unsigned curr = i == tmap.end() ? (unsigned)-1 : i->second;
+   int i = getThreadIndex();
+   unsigned curr = i == -1 ? (unsigned)-1 : (unsigned)i;
 
    for (unsigned j = 0; j < cmax; ++j) {
       if (j != curr && pool[j]->isInTransaction())
-	 xsink->raiseException("DATASOURCEPOOL-ERROR", "%s:%s@%s: TID %d deleted DatasourcePool while TID %d using connection %d/%d was in a transaction", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), gettid(), tid_list[j], j + 1, cmax);
+	 xsink->raiseException("DATASOURCEPOOL-ERROR", "%s:%s@%s: TID %d deleted DatasourcePool while TID %d using connection %d/%d was in a transaction", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), gettid(), tid_list[j].load(), j + 1, cmax);
    }
 
-   if (i != tmap.end() && pool[curr]->isInTransaction()) {
+   if (i != -1 && pool[curr]->isInTransaction()) {
       xsink->raiseException("DATASOURCEPOOL-LOCK-EXCEPTION", "%s:%s@%s: TID %d deleted DatasourcePool while in a transaction; transaction will be automatically rolled back", pool[0]->getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid);
       sl.unlock();
 
@@ -223,16 +283,57 @@ void DatasourcePool::freeDS() {
 
    remove_thread_resource(this);
 
-   int tid = gettid();
+   int i = getThreadIndex();
+   assert(i != -1);
+   assert(!pool[i]->isInTransaction());
+   releaseIntern(i);
+}
 
-   AutoLocker al((QoreThreadLock*)this);
+int DatasourcePool::getThreadIndex() const {
+   const DatasourcePoolThreadConnections* tc = dsp_thread_conn.peek();
+   int i = tc ? tc->find(pool_id) : -1;
+   assert(i == -1 || tid_list[i] == gettid());
+   return i;
+}
 
-   thread_use_t::iterator i = tmap.find(tid);
-   assert(!pool[i->second]->isInTransaction());
-   free_list.push_back(i->second);
-   tmap.erase(i);
-   if (wait_count)
+void DatasourcePool::pushFree(int i) {
+   uint64_t head = free_head.load();
+   while (true) {
+      free_next[i].store((int)(head & 0xffffffff) - 1, std::memory_order_relaxed);
+      uint64_t nh = ((head >> 32) + 1) << 32 | (uint64_t)(i + 1);
+      if (free_head.compare_exchange_weak(head, nh))
+         break;
+   }
+}
+
+int DatasourcePool::popFree() {
+   uint64_t head = free_head.load();
+   while (true) {
+      int i = (int)(head & 0xffffffff) - 1;
+      if (i == -1)
+         return -1;
+      // the next index may be stale if another thread popped this entry in the meantime, but then the counter
+      // in the head has changed and the exchange fails
+      uint64_t nh = ((head >> 32) + 1) << 32 | (uint64_t)(free_next[i].load(std::memory_order_relaxed) + 1);
+      if (free_head.compare_exchange_weak(head, nh))
+         return i;
+   }
+}
+
+void DatasourcePool::releaseIntern(int i) {
+   int64 hold = q_clock_getmicros() - acq_time[i];
+   dsp_hist_add(hold_hist, hold < 0 ? 0 : hold);
+
+   dsp_thread_conn.get()->remove(pool_id);
+   tid_list[i] = 0;
+   pushFree(i);
+
+   // a waiting thread increments wait_count before checking the free list again while holding the lock, so
+   // either it finds this connection or it will be signaled here
+   if (wait_count) {
+      AutoLocker al((QoreThreadLock*)this);
       signal();
+   }
 }
 
 Datasource* DatasourcePool::getDS(bool &new_ds, ExceptionSink* xsink) {
@@ -275,11 +376,10 @@ Datasource* DatasourcePool::getDS(bool &new_ds, ExceptionSink* xsink) {
 }
 
 Datasource* DatasourcePool::getAllocatedDS() {
-   SafeLocker sl((QoreThreadLock*)this);
-   // see if thread already has a datasource allocated
-   thread_use_t::iterator i = tmap.find(gettid());
-   assert(i != tmap.end());
-   return pool[i->second];
+   // thread must have a datasource allocated
+   int i = getThreadIndex();
+   assert(i != -1);
+   return pool[i];
 }
 
 // must be called in the lock
@@ -310,100 +410,100 @@ int DatasourcePool::checkWait(int64 wait_total, ExceptionSink* xsink) {
 Datasource* DatasourcePool::getDSIntern(bool& new_ds, int64& wait_total, ExceptionSink* xsink) {
    assert(!new_ds);
 
-   int tid = gettid();
-
-   Datasource* ds;
-
-   SafeLocker sl((QoreThreadLock*)this);
-
    // increase request counter
-   ++stats_reqs;
+   stats_reqs.fetch_add(1, std::memory_order_relaxed);
 
    // see if thread already has a datasource allocated
-   thread_use_t::iterator i = tmap.find(tid);
-   if (i != tmap.end()) {
-      ++stats_hits;
-      //printd(5, "DatasourcePool::getDSIntern() this: %p returning already allocated ds: %p\n", this, pool[i->second]);
-      return pool[i->second];
+   int fi = getThreadIndex();
+   if (fi != -1) {
+      stats_hits.fetch_add(1, std::memory_order_relaxed);
+      //printd(5, "DatasourcePool::getDSIntern() this: %p returning already allocated ds: %p\n", this, pool[fi]);
+      return pool[fi];
    }
 
    // will be a new allocation, not already in a transaction
    new_ds = true;
 
-   // iteration flag
-   bool iter = false;
-
-   // see if there is a datasource free
-   while (true) {
-      if (!free_list.empty()) {
-	 int fi = free_list.front();
-	 free_list.pop_front();
-	 // DEBUG
-	 //printf("DSP::getDS() assigning tid %d index %d from free list (%N)\n", $tid, $i, $.p[$i]);
-
-	 tmap[tid] = fi;
-	 ds = pool[fi];
-	 tid_list[fi] = tid;
-
-	 // increase hit counter
-	 if (!iter)
-	    ++stats_hits;
-	 break;
-      }
-
-      // see if we can open a new connection
-      if (cmax < max) {
-	 ds = pool[cmax] = config.get();
-
-	 tmap[tid] = cmax;
-	 tid_list[cmax++] = tid;
-
-	 // increase hit counter
-	 if (!iter)
-	    ++stats_hits;
-
-	 break;
-      }
-
-      //printd(5, "DatasourcePool::getDSIntern() this: %p tl_timeout_ms: %d max: %d\n", this, tl_timeout_ms, max);
-      // otherwise we sleep until a connection becomes available
-      ++wait_count;
-      int64 warn_start = q_clock_getmicros();
-      int rc = tl_timeout_ms ? wait((QoreThreadLock*)this, tl_timeout_ms) : wait((QoreThreadLock*)this);
-      wait_count--;
-
-      // add waiting time to total time
-      wait_total += (q_clock_getmicros() - warn_start);
-
-      if (!valid) {
-	 xsink->raiseException("DATASOURCEPOOL-ERROR", "%s:%s@%s: DatasourcePool deleted while TID %d waiting on a connection to become free", getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid);
-	 return 0;
-      }
+   int tid = gettid();
 
-      if (rc && tl_timeout_ms) {
-	 xsink->raiseException("DATASOURCEPOOL-TIMEOUT", "%s:%s@%s: TID %d timed out on datasource pool after waiting %d millisecond%s for a free connection (max %d connections in use)",
-			       getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid,
-			       tl_timeout_ms, tl_timeout_ms == 1 ? "" : "s", max);
-	 return 0;
+   // see if there is a datasource free; the pool lock is only needed to open new connections or to wait
+   fi = popFree();
+   if (fi == -1) {
+      SafeLocker sl((QoreThreadLock*)this);
+
+      // iteration flag
+      bool iter = false;
+
+      while (true) {
+         fi = popFree();
+         if (fi != -1)
+            break;
+
+         // see if we can open a new connection
+         if (cmax < max) {
+            fi = cmax;
+            pool[cmax++] = config.get();
+            break;
+         }
+
+         // the free list is checked again after incrementing the wait count so that a connection released in the
+         // meantime is not missed; see releaseIntern()
+         ++wait_count;
+         fi = popFree();
+         if (fi != -1) {
+            --wait_count;
+            break;
+         }
+
+         //printd(5, "DatasourcePool::getDSIntern() this: %p tl_timeout_ms: %d max: %d\n", this, tl_timeout_ms, max);
+         // otherwise we sleep until a connection becomes available
+         int64 warn_start = q_clock_getmicros();
+         int rc = tl_timeout_ms ? wait((QoreThreadLock*)this, tl_timeout_ms) : wait((QoreThreadLock*)this);
+         --wait_count;
+
+         // add waiting time to total time
+         wait_total += (q_clock_getmicros() - warn_start);
+
+         if (!valid) {
+            xsink->raiseException("DATASOURCEPOOL-ERROR", "%s:%s@%s: DatasourcePool deleted while TID %d waiting on a connection to become free", getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid);
+            return 0;
+         }
+
+         if (rc && tl_timeout_ms) {
+            xsink->raiseException("DATASOURCEPOOL-TIMEOUT", "%s:%s@%s: TID %d timed out on datasource pool after waiting %d millisecond%s for a free connection (max %d connections in use)",
+                                  getDriverName(), pool[0]->getUsernameStr().c_str(), pool[0]->getDBNameStr().c_str(), tid,
+                                  tl_timeout_ms, tl_timeout_ms == 1 ? "" : "s", max);
+            return 0;
+         }
+
+         if (!iter)
+            iter = true;
       }
 
+      // increase hit counter
       if (!iter)
-	 iter = true;
-      continue;
-   }
+         stats_hits.fetch_add(1, std::memory_order_relaxed);
 
-   if (wait_total > wait_max)
-      wait_max = wait_total;
+      if (wait_total > wait_max)
+         wait_max = wait_total;
+   }
+   else
+      stats_hits.fetch_add(1, std::memory_order_relaxed);
 
-   sl.unlock();
+   // DEBUG
+   //printf("DSP::getDS() assigning tid %d index %d from free list (%N)\n", $tid, $i, $.p[$i]);
+   tid_list[fi] = tid;
+   acq_time[fi] = q_clock_getmicros();
+   dsp_thread_conn.get()->add(pool_id, fi);
+   dsp_hist_add(wait_hist, wait_total);
 
    // add to thread resource list
-   //printd(5, "DatasourcePool::getDSIntern() set_thread_resource(this: %p) ds: %p\n", this, ds);
+   //printd(5, "DatasourcePool::getDSIntern() set_thread_resource(this: %p) ds: %p\n", this, pool[fi]);
 
    set_thread_resource(this);
 
-   assert(ds);
-   return ds;
+   assert(pool[fi]);
+   return pool[fi];
 }
 
 AbstractQoreNode* DatasourcePool::select(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
@@ -494,24 +594,27 @@ QoreStringNode* DatasourcePool::toString() {
    QoreStringNode* str = new QoreStringNode();
 
    SafeLocker sl((QoreThreadLock *)this);
-   str->sprintf("this: %p, min: %d, max: %d, cmax: %d, wait_count: %d, thread_map = (", this, min, max, cmax, wait_count);
-   thread_use_t::const_iterator ti = tmap.begin();
-   while (ti != tmap.end()) {
-      str->sprintf("tid %d: %d, ", ti->first, ti->second);
-      ++ti;
+   str->sprintf("this: %p, min: %d, max: %d, cmax: %d, wait_count: %d, thread_map = (", this, min, max, cmax, wait_count.load());
+   // connections are allocated and released without the lock, so this is only a snapshot
+   QoreString fl;
+   bool used = false;
+   for (unsigned i = 0; i < cmax; ++i) {
+      int tid = tid_list[i];
+      if (tid) {
+         str->sprintf("tid %d: %d, ", tid, i);
+         used = true;
+      }
+      else
+         fl.sprintf("%d, ", i);
    }
-   if (!tmap.empty())
+   if (used)
       str->terminate(str->strlen() - 2);
+   sl.unlock();
 
    str->sprintf("), free_list = (");
-   free_list_t::const_iterator fi = free_list.begin();
-   while (fi != free_list.end()) {
-      str->sprintf("%d, ", *fi);
-      ++fi;
-   }
-   if (!free_list.empty())
-      str->terminate(str->strlen() - 2);
-   sl.unlock();
+   if (fl.strlen())
+      fl.terminate(fl.strlen() - 2);
+   str->concat(&fl);
    str->concat(')');
    return str;
 }
@@ -553,9 +656,7 @@ const QoreEncoding* DatasourcePool::getQoreEncoding() const {
 }
 
 bool DatasourcePool::inTransaction() {
-   int tid = gettid();
-   AutoLocker al((QoreThreadLock *)this);
-   return tmap.find(tid) != tmap.end();
+   return getThreadIndex() != -1;
 }
 
 QoreHashNode* DatasourcePool::getConfigHash() const {
@@ -621,8 +722,16 @@ QoreHashNode* DatasourcePool::getUsageInfo() const {
       h->setKeyValue("timeout", new QoreBigIntNode(tl_warning_ms), 0);
    }
    h->setKeyValue("wait_max", new QoreBigIntNode(wait_max), 0);
-   h->setKeyValue("stats_reqs", new QoreBigIntNode(stats_reqs), 0);
-   h->setKeyValue("stats_hits", new QoreBigIntNode(stats_hits), 0);
+   h->setKeyValue("stats_reqs", new QoreBigIntNode(stats_reqs.load()), 0);
+   h->setKeyValue("stats_hits", new QoreBigIntNode(stats_hits.load()), 0);
+   QoreListNode* wl = new QoreListNode;
+   QoreListNode* hl = new QoreListNode;
+   for (int i = 0; i < DSP_HIST_BUCKETS; ++i) {
+      wl->push(new QoreBigIntNode(wait_hist[i].load()));
+      hl->push(new QoreBigIntNode(hold_hist[i].load()));
+   }
+   h->setKeyValue("wait_hist", wl, 0);
+   h->setKeyValue("hold_hist", hl, 0);
    return h;
 }
 
@@ -75,6 +75,14 @@ DateTimeNode::DateTimeNode(const DateTimeNode& dt) : SimpleValueQoreNode(NT_DATE
 DateTimeNode::~DateTimeNode() {
 }
 
+void* DateTimeNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void DateTimeNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
 // get the value of the type in a string context (default implementation = del = false and returns NullString)
 // if del is true, then the returned QoreString*  should be deleted, if false, then it must not be
 // use the QoreStringValueHelper class (defined in QoreStringNode.h) instead of using this function directly
@@ -33,11 +33,13 @@
 #include "qore/intern/QoreClassIntern.h"
 #include "qore/intern/qore_program_private.h"
 #include "qore/intern/qore_list_private.h"
+#include "qore/intern/QoreBytecode.h"
 
 #include <stdio.h>
 #include <ctype.h>
 #include <assert.h>
 #include <cmath>
+#include <algorithm>
 
 // FIXME: xxx set parse location
 static void duplicateSignatureException(const char* cname, const char* name, const AbstractFunctionSignature* sig) {
@@ -339,7 +341,7 @@ UserSignature::UserSignature(int first_line, int last_line, AbstractQoreNode* pa
    AbstractFunctionSignature(retTypeInfo ? retTypeInfo->getTypeInfo() : 0),
    parseReturnTypeInfo(retTypeInfo ? retTypeInfo->takeParseTypeInfo() : 0),
    loc(first_line, last_line),
-   lv(0), argvid(0), selfid(0), resolved(false) {
+   lv(0), argvid(0), selfid(0), lvar_slots(0), cvar_slots(0), resolved(false) {
 
    bool needs_types = (bool)(po & (PO_REQUIRE_TYPES | PO_REQUIRE_PROTOTYPES));
    bool bare_refs = (bool)(po & PO_ALLOW_BARE_REFS);
@@ -698,8 +700,136 @@ static int check_extra_args(AbstractFunctionSignature* sig, const type_vec_t& ar
    return 0;
 }
 
-// finds a variant at runtime
+int VariantCacheKey::set(const QoreValueList* args, bool n_only_user, const qore_class_private* class_ctx) {
+   nargs = args ? args->size() : 0;
+   if (nargs > QORE_VARIANT_CACHE_ARGS)
+      return -1;
+   // access checks are only made with a current Program
+   if (!getProgram())
+      return -1;
+
+   ctx = class_ctx;
+   ctx_serial = class_ctx ? class_ctx->serial : 0;
+   po = runtime_get_parse_options();
+   only_user = n_only_user;
+
+   for (unsigned i = 0; i < nargs; ++i) {
+      QoreValue n = args->retrieveEntry(i);
+      types[i] = n.getType();
+      if (types[i] == NT_OBJECT) {
+         const qore_class_private* qc = qore_class_private::get(*n.get<const QoreObject>()->getClass());
+         cls[i] = qc;
+         cls_serial[i] = qc->serial;
+      }
+      else {
+         cls[i] = 0;
+         cls_serial[i] = 0;
+      }
+   }
+   return 0;
+}
+
+// functions with runtime resolution statistics
+static QoreThreadLock func_stats_lck;
+static const QoreFunction* func_stats_head = 0;
+
+void QoreFunction::registerStats() const {
+   AutoLocker al(func_stats_lck);
+   if (stats_registered.load(std::memory_order_relaxed))
+      return;
+
+   const char* class_name = className();
+   if (class_name) {
+      stats_name = class_name;
+      stats_name += "::";
+   }
+   stats_name += name;
+
+   stats_next = func_stats_head;
+   if (func_stats_head)
+      func_stats_head->stats_prev = this;
+   func_stats_head = this;
+
+   stats_registered.store(true, std::memory_order_release);
+}
+
+void QoreFunction::unregisterStats() {
+   AutoLocker al(func_stats_lck);
+   if (stats_prev)
+      stats_prev->stats_next = stats_next;
+   else
+      func_stats_head = stats_next;
+   if (stats_next)
+      stats_next->stats_prev = stats_prev;
+}
+
+struct FunctionResolutionStats {
+   std::string name;
+   int64 resolutions,
+      cache_hits;
+   unsigned variants;
+
+   // sorts functions with the most calls first
+   DLLLOCAL bool operator<(const FunctionResolutionStats& other) const {
+      return resolutions + cache_hits > other.resolutions + other.cache_hits;
+   }
+};
+
+QoreHashNode* qore_function_get_resolution_stats() {
+   std::vector<FunctionResolutionStats> fv;
+   {
+      AutoLocker al(func_stats_lck);
+      for (const QoreFunction* f = func_stats_head; f; f = f->stats_next)
+         fv.push_back(FunctionResolutionStats {f->stats_name, f->resolutions.load(std::memory_order_relaxed), f->cache_hits.load(std::memory_order_relaxed), (unsigned)f->vlist.size()});
+   }
+   std::stable_sort(fv.begin(), fv.end());
+
+   int64 resolutions = 0, cache_hits = 0;
+   QoreListNode* l = new QoreListNode;
+   for (auto& i : fv) {
+      resolutions += i.resolutions;
+      cache_hits += i.cache_hits;
+
+      QoreHashNode* fh = new QoreHashNode;
+      fh->setKeyValue("name", new QoreStringNode(i.name), 0);
+      fh->setKeyValue("variants", new QoreBigIntNode(i.variants), 0);
+      fh->setKeyValue("resolutions", new QoreBigIntNode(i.resolutions), 0);
+      fh->setKeyValue("cache_hits", new QoreBigIntNode(i.cache_hits), 0);
+      l->push(fh);
+   }
+
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("resolutions", new QoreBigIntNode(resolutions), 0);
+   h->setKeyValue("cache_hits", new QoreBigIntNode(cache_hits), 0);
+   h->setKeyValue("functions", l, 0);
+   return h;
+}
+
+// finds a variant at runtime using the cache if possible
 const AbstractQoreFunctionVariant* QoreFunction::runtimeFindVariant(ExceptionSink* xsink, const QoreValueList* args, bool only_user, const qore_class_private* class_ctx) const {
+   if (!stats_registered.load(std::memory_order_acquire))
+      registerStats();
+
+   VariantCacheKey k;
+   bool cache = !k.set(args, only_user, class_ctx);
+   if (cache) {
+      const VariantCacheEntry* e = vcache.find(k);
+      if (e) {
+         cache_hits.fetch_add(1, std::memory_order_relaxed);
+         return e->variant;
+      }
+   }
+
+   resolutions.fetch_add(1, std::memory_order_relaxed);
+   const AbstractQoreFunctionVariant* variant = runtimeFindVariantIntern(xsink, args, only_user, class_ctx);
+   // errors are not cached
+   if (variant && cache && vcache.canAdd())
+      vcache.add(new VariantCacheEntry(k, variant));
+   return variant;
+}
+
+// finds a variant at runtime
+const AbstractQoreFunctionVariant* QoreFunction::runtimeFindVariantIntern(ExceptionSink* xsink, const QoreValueList* args, bool only_user, const qore_class_private* class_ctx) const {
    int match = -1;
    const AbstractQoreFunctionVariant* variant = 0;
 
@@ -1315,6 +1445,46 @@ void QoreFunction::addBuiltinVariant(AbstractQoreFunctionVariant* variant) {
    if (!has_builtin)
       has_builtin = true;
    addVariant(variant);
+   // invalidate after the variant is visible so that resolutions started before the change are not cached
+   invalidateVariantCache();
+}
+
+LocalVarFrameParseEnvironment::~LocalVarFrameParseEnvironment() {
+   thread_set_lvar_frame_parse_env(prev);
+
+   unsigned ls = 0, cs = 0;
+   for (lvar_vec_t::iterator i = vars.begin(), e = vars.end(); i != e; ++i) {
+      if ((*i)->closureUse())
+         ++cs;
+      else
+         ++ls;
+   }
+
+   // frames must fit in a single block of the thread-local variable stacks; otherwise variables are found by name
+   if (ls > QORE_THREAD_STACK_BLOCK || cs > QORE_THREAD_STACK_BLOCK)
+      return;
+
+   ls = cs = 0;
+   for (lvar_vec_t::iterator i = vars.begin(), e = vars.end(); i != e; ++i)
+      (*i)->setSlot((*i)->closureUse() ? cs++ : ls++);
+
+   sig->lvar_slots = ls;
+   sig->cvar_slots = cs;
+}
+
+UserVariantExecHelper::UserVariantExecHelper(const UserVariantBase* n_uvb, CodeEvaluationHelper* ceh, ExceptionSink* n_xsink) : ProgramThreadCountContextHelper(n_xsink, n_uvb->pgm, true), uvb(n_uvb), argv(n_xsink), xsink(n_xsink) {
+   if (*xsink) {
+      uvb = 0;
+      return;
+   }
+
+   const UserSignature* sig = uvb->getUserSignature();
+   thread_enter_lvar_frame(sig->lvar_slots, sig->cvar_slots);
+
+   if (uvb->setupCall(ceh, argv, xsink)) {
+      thread_exit_lvar_frame();
+      uvb = 0;
+   }
 }
 
 UserVariantExecHelper::~UserVariantExecHelper() {
@@ -1326,15 +1496,17 @@ UserVariantExecHelper::~UserVariantExecHelper() {
       //printd(5, "UserVariantExecHelper::~UserVariantExecHelper() this: %p %s %d/%d %p lv: %s (%s)\n", this, sig->getSignatureText(), i, sig->numParams(), sig->lv[i], sig->lv[i]->getName(), sig->lv[i]->getValueTypeName());
       sig->lv[i]->uninstantiate(xsink);
    }
+   thread_exit_lvar_frame();
 }
 
 UserVariantBase::UserVariantBase(StatementBlock *b, int n_sig_first_line, int n_sig_last_line, AbstractQoreNode* params, RetTypeInfo* rv, bool synced)
    : signature(n_sig_first_line, n_sig_last_line, params, rv, b ? b->pwo.parse_options : parse_get_parse_options()), statements(b), gate(synced ? new VRMutex : 0),
-     pgm(getProgram()), recheck(false), init(false) {
+     bytecode(0), pgm(getProgram()), recheck(false), init(false) {
    //printd(5, "UserVariantBase::UserVariantBase() this: %p params: %p rv: %p b: %p synced: %d\n", params, rv, b, synced);
 }
 
 UserVariantBase::~UserVariantBase() {
+   delete bytecode;
    delete gate;
    delete statements;
 }
@@ -1438,6 +1610,27 @@ QoreValue UserVariantBase::evalIntern(ReferenceHolder<QoreListNode> &argv, QoreO
    return val;
 }
 
+// executes the compiled body; local variables are held in registers, so no local variables are instantiated
+QoreValue UserVariantBase::evalBytecode(const char* name, CodeEvaluationHelper* ceh, ExceptionSink* xsink) const {
+   CodeContextHelper cch(xsink, CT_USER, name, 0, ceh ? ceh->getClass() : 0);
+
+   QoreValue val;
+   // enter gate if necessary
+   if (!gate || (gate->enter(xsink) >= 0)) {
+      val = bytecode->exec(ceh ? ceh->getArgs() : 0, xsink);
+
+      // exit gate if necessary
+      if (gate)
+         gate->exit();
+   }
+
+   // if return value is NOTHING; make sure it's valid; maybe there wasn't a return statement
+   if (!*xsink && val.isNothing())
+      signature.getReturnTypeInfo()->acceptAssignment("<block return>", val, xsink);
+
+   return val;
+}
+
 // primary function for executing user code
 QoreValue UserVariantBase::eval(const char* name, CodeEvaluationHelper* ceh, QoreObject *self, ExceptionSink* xsink, const qore_class_private* qc) const {
    QORE_TRACE("UserVariantBase::eval()");
@@ -1449,6 +1642,9 @@ QoreValue UserVariantBase::eval(const char* name, CodeEvaluationHelper* ceh, Qor
    ProgramThreadCountContextHelper tch(xsink, pgm, true);
    if (*xsink) return QoreValue();
 
+   if (bytecode && !self && bytecode->acceptsArgs(ceh ? ceh->getArgs() : 0))
+      return evalBytecode(name, ceh, xsink);
+
    UserVariantExecHelper uveh(this, ceh, xsink);
    if (!uveh)
       return QoreValue();
@@ -1745,6 +1941,9 @@ int QoreFunction::addPendingVariant(AbstractQoreFunctionVariant* variant) {
 }
 
 void QoreFunction::parseCommit() {
+   // variants added to a function already called invalidate the resolved variants
+   bool invalidate = !pending_vlist.empty() && !vlist.empty();
+
    for (vlist_t::iterator i = pending_vlist.begin(), e = pending_vlist.end(); i != e; ++i) {
       vlist.push_back(*i);
 
@@ -1759,6 +1958,10 @@ void QoreFunction::parseCommit() {
    }
    pending_vlist.clear();
 
+   // invalidate after the new variants are visible so that resolutions started before the change are not cached
+   if (invalidate)
+      invalidateVariantCache();
+
    if (!parse_same_return_type && same_return_type)
       same_return_type = false;
 
@@ -1819,6 +2022,13 @@ void UserFunctionVariant::parseInit(QoreFunction* f) {
    // can (and must) be called even if statements is NULL
    statements->parseInit(this);
 
+   // compile the body if requested; functions that cannot be compiled are executed normally
+   if (statements && (statements->pwo.parse_options & PO_BYTECODE) && !bytecode) {
+      bytecode = QoreBytecode::compile(signature, statements);
+      if (bytecode)
+         qore_program_private::incBytecodeCount(*pgm);
+   }
+
    // recheck types against committed types if necessary
    if (recheck)
       f->parseCheckDuplicateSignatureCommitted(&signature);
@@ -60,6 +60,27 @@ QoreValue AbstractMethodCallNode::exec(QoreObject* o, const char* c_str, Excepti
 	 ? qore_method_private::evalNormalVariant(*method, xsink, o, reinterpret_cast<const QoreExternalMethodVariant*>(variant), args)
 	 : qore_method_private::eval(*method, xsink, o, args);
    }
+
+   // otherwise the method is resolved for the runtime class and class context; successful lookups are cached
+   // so that the search and access checks are only made once for each receiver class
+   if (c_str && strcmp(c_str, "copy")) {
+      const qore_class_private* cls = qore_class_private::get(*o->getClass());
+      InlineCacheKey k(cls, runtime_get_class());
+      const MethodCacheEntry* e = mcache.find(k);
+      if (e)
+         return qore_method_private::eval(*e->method, xsink, o, args);
+
+      if (mcache.canAdd()) {
+         const QoreMethod* m = cls->getMethodForEval(c_str, o->getProgram(), xsink);
+         if (*xsink)
+            return QoreValue();
+         if (m) {
+            mcache.add(new MethodCacheEntry(k, m));
+            return qore_method_private::eval(*m, xsink, o, args);
+         }
+      }
+   }
+
    //printd(5, "AbstractMethodCallNode::exec() calling QoreObject::evalMethod() for %s::%s()\n", o->getClassName(), c_str);
    return o->evalMethodValue(c_str, args, xsink);
 }
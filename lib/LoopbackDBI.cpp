@@ -0,0 +1,1433 @@
+/*
+  LoopbackDBI.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2016 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+/* the "loopback" DBI driver: an in-process, in-memory database built into the library so that the overhead of
+   Datasource, DatasourcePool, SQLStatement and user code using them can be measured without a database server
+
+   tables are kept per database name for the lifetime of the process and are shared by all connections to the same
+   database; a small SQL subset is supported (see the "Loopback DBI Driver" section in the module documentation)
+
+   changes are applied to the shared tables immediately and are recorded in a per-connection undo log, which is
+   replayed on rollback, so other connections can see uncommitted changes ("read uncommitted" isolation)
+*/
+
+#include <qore/Qore.h>
+#include <qore/QoreRWLock.h>
+#include <qore/SQLStatement.h>
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#define LOOPBACK_VERSION "1.0"
+
+// option: synthetic latency in microseconds for each request sent to the "server"
+#define LOOPBACK_OPT_LATENCY "latency"
+// option: synthetic latency in microseconds when opening a connection
+#define LOOPBACK_OPT_CONNECT_LATENCY "connect-latency"
+
+static DBIDriver* DBID_LOOPBACK = 0;
+
+// a table row; rows are immutable once stored in a table and are shared with result sets and undo logs
+class LoopbackRow : public QoreReferenceCounter {
+public:
+   typedef std::vector<AbstractQoreNode*> val_vec_t;
+
+   // column values; 0 = SQL NULL
+   val_vec_t v;
+
+   DLLLOCAL LoopbackRow(size_t n) : v(n, 0) {
+   }
+
+   DLLLOCAL void ref() {
+      ROreference();
+   }
+
+   DLLLOCAL void deref() {
+      if (ROdereference())
+         delete this;
+   }
+
+private:
+   DLLLOCAL ~LoopbackRow() {
+      for (val_vec_t::iterator i = v.begin(), e = v.end(); i != e; ++i)
+         discard(*i, 0);
+   }
+};
+
+typedef std::vector<std::string> lb_name_vec_t;
+
+class LoopbackTable {
+public:
+   typedef std::map<int64, LoopbackRow*> rmap_t;
+
+   // unique table serial number; undo log entries for dropped tables are ignored
+   int64 serial;
+   lb_name_vec_t cols;
+   rmap_t rows;
+   int64 next_id;
+
+   DLLLOCAL LoopbackTable(int64 s, const lb_name_vec_t& c) : serial(s), cols(c), next_id(1) {
+   }
+
+   DLLLOCAL ~LoopbackTable() {
+      for (rmap_t::iterator i = rows.begin(), e = rows.end(); i != e; ++i)
+         i->second->deref();
+   }
+
+   // returns the column index or -1 if the column does not exist
+   DLLLOCAL int findColumn(const std::string& name) const {
+      for (unsigned i = 0; i < cols.size(); ++i)
+         if (cols[i] == name)
+            return i;
+      return -1;
+   }
+};
+
+class LoopbackDb {
+public:
+   typedef std::map<std::string, LoopbackTable*> tmap_t;
+
+   QoreRWLock rwl;
+   tmap_t tables;
+
+   DLLLOCAL ~LoopbackDb() {
+      for (tmap_t::iterator i = tables.begin(), e = tables.end(); i != e; ++i)
+         delete i->second;
+   }
+
+   // must be called with the lock held
+   DLLLOCAL LoopbackTable* find(const std::string& name) const {
+      tmap_t::const_iterator i = tables.find(name);
+      return i == tables.end() ? 0 : i->second;
+   }
+};
+
+// process-wide database storage
+class LoopbackDbManager {
+public:
+   DLLLOCAL LoopbackDbManager() : serial(0) {
+   }
+
+   DLLLOCAL LoopbackDb* get(const char* name) {
+      AutoLocker al(l);
+      std::string n = name ? name : "";
+      dbmap_t::iterator i = dbmap.find(n);
+      if (i != dbmap.end())
+         return i->second;
+      LoopbackDb* db = new LoopbackDb;
+      dbmap[n] = db;
+      return db;
+   }
+
+   DLLLOCAL int64 getSerial() {
+      AutoLocker al(l);
+      return ++serial;
+   }
+
+   DLLLOCAL void clear() {
+      AutoLocker al(l);
+      for (dbmap_t::iterator i = dbmap.begin(), e = dbmap.end(); i != e; ++i)
+         delete i->second;
+      dbmap.clear();
+   }
+
+private:
+   typedef std::map<std::string, LoopbackDb*> dbmap_t;
+
+   QoreThreadLock l;
+   dbmap_t dbmap;
+   int64 serial;
+};
+
+static LoopbackDbManager LBM;
+
+// an undo log entry: "old" is 0 if the row was inserted, otherwise the row is restored
+struct LoopbackUndo {
+   std::string table;
+   int64 serial;
+   int64 id;
+   LoopbackRow* old;
+};
+
+typedef std::vector<LoopbackUndo> lb_undo_vec_t;
+
+// private data for each connection
+class LoopbackConnection {
+public:
+   LoopbackDb* db;
+   lb_undo_vec_t undo;
+   int64 latency,
+      connect_latency;
+
+   DLLLOCAL LoopbackConnection(LoopbackDb* d) : db(d), latency(0), connect_latency(0) {
+   }
+
+   DLLLOCAL ~LoopbackConnection() {
+      commit();
+   }
+
+   // simulates a request round trip to the server
+   DLLLOCAL void request() const {
+      if (latency > 0)
+         qore_usleep(latency);
+   }
+
+   // must be called with the write lock held
+   DLLLOCAL void logUndo(const std::string& table, int64 serial, int64 id, LoopbackRow* old) {
+      LoopbackUndo u = { table, serial, id, old };
+      undo.push_back(u);
+   }
+
+   DLLLOCAL void commit() {
+      for (lb_undo_vec_t::iterator i = undo.begin(), e = undo.end(); i != e; ++i)
+         if (i->old)
+            i->old->deref();
+      undo.clear();
+   }
+
+   DLLLOCAL void rollback() {
+      if (undo.empty())
+         return;
+
+      QoreAutoRWWriteLocker al(db->rwl);
+      for (lb_undo_vec_t::reverse_iterator i = undo.rbegin(), e = undo.rend(); i != e; ++i) {
+         LoopbackTable* t = db->find(i->table);
+         if (!t || t->serial != i->serial) {
+            if (i->old)
+               i->old->deref();
+            continue;
+         }
+         LoopbackTable::rmap_t::iterator ri = t->rows.find(i->id);
+         if (ri != t->rows.end()) {
+            ri->second->deref();
+            if (i->old)
+               ri->second = i->old;
+            else
+               t->rows.erase(ri);
+         }
+         else if (i->old)
+            t->rows[i->id] = i->old;
+      }
+      undo.clear();
+   }
+};
+
+// an operand in an SQL statement: either a bind parameter or a literal value
+struct LoopbackOperand {
+   // bind parameter index or -1 for a literal value
+   int param;
+   AbstractQoreNode* val;
+
+   DLLLOCAL LoopbackOperand() : param(-1), val(0) {
+   }
+};
+
+enum lb_op_e { LB_EQ, LB_NE, LB_LT, LB_LE, LB_GT, LB_GE, LB_IS_NULL, LB_IS_NOT_NULL };
+
+struct LoopbackCond {
+   std::string col;
+   lb_op_e op;
+   LoopbackOperand val;
+};
+
+enum lb_sql_e { LB_SELECT, LB_INSERT, LB_UPDATE, LB_DELETE, LB_CREATE, LB_DROP, LB_TRUNCATE };
+
+typedef std::vector<LoopbackOperand> lb_operand_vec_t;
+typedef std::vector<LoopbackCond> lb_cond_vec_t;
+
+// a parsed SQL statement
+class LoopbackSql {
+public:
+   lb_sql_e type;
+   std::string table;
+   // select list (empty = "*"), insert columns, update set columns, or create columns
+   lb_name_vec_t cols;
+   // insert values or update set values
+   lb_operand_vec_t vals;
+   lb_cond_vec_t where;
+   // "select count(*)"
+   bool count;
+   // number of bind parameters
+   int params;
+   // argument indexes of bind parameters in the argument list given when the SQL was parsed
+   std::vector<int> pargs;
+
+   DLLLOCAL LoopbackSql() : type(LB_SELECT), count(false), params(0) {
+   }
+
+   DLLLOCAL ~LoopbackSql() {
+      for (lb_operand_vec_t::iterator i = vals.begin(), e = vals.end(); i != e; ++i)
+         discard(i->val, 0);
+      for (lb_cond_vec_t::iterator i = where.begin(), e = where.end(); i != e; ++i)
+         discard(i->val.val, 0);
+      clearTokens();
+   }
+
+   DLLLOCAL int parse(const QoreString& sql, const QoreListNode* args, bool raw, ExceptionSink* xsink);
+
+private:
+   enum tok_e { T_END, T_IDENT, T_NUM, T_STR, T_PARAM, T_PUNCT };
+
+   struct Token {
+      tok_e type;
+      // identifiers are converted to lower case
+      std::string text;
+      AbstractQoreNode* val;
+      int param;
+   };
+
+   typedef std::vector<Token> tok_vec_t;
+
+   tok_vec_t tl;
+   size_t tp;
+
+   DLLLOCAL int tokenize(const QoreString& str, ExceptionSink* xsink);
+
+   DLLLOCAL void clearTokens() {
+      for (tok_vec_t::iterator i = tl.begin(), e = tl.end(); i != e; ++i)
+         discard(i->val, 0);
+      tl.clear();
+   }
+   DLLLOCAL int parseIntern(ExceptionSink* xsink);
+   DLLLOCAL int error(ExceptionSink* xsink, const char* fmt, ...);
+
+   DLLLOCAL const Token& cur() const {
+      return tl[tp];
+   }
+
+   DLLLOCAL bool isKeyword(const char* kw) const {
+      return tl[tp].type == T_IDENT && tl[tp].text == kw;
+   }
+
+   DLLLOCAL bool isPunct(const char* p) const {
+      return tl[tp].type == T_PUNCT && tl[tp].text == p;
+   }
+
+   DLLLOCAL int expectKeyword(const char* kw, ExceptionSink* xsink) {
+      if (!isKeyword(kw))
+         return error(xsink, "expecting '%s'", kw);
+      ++tp;
+      return 0;
+   }
+
+   DLLLOCAL int expectPunct(const char* p, ExceptionSink* xsink) {
+      if (!isPunct(p))
+         return error(xsink, "expecting '%s'", p);
+      ++tp;
+      return 0;
+   }
+
+   DLLLOCAL int getIdent(std::string& id, const char* what, ExceptionSink* xsink) {
+      if (cur().type != T_IDENT)
+         return error(xsink, "expecting %s", what);
+      id = cur().text;
+      ++tp;
+      return 0;
+   }
+
+   DLLLOCAL int getOperand(LoopbackOperand& op, ExceptionSink* xsink);
+   DLLLOCAL int getNameList(lb_name_vec_t& l, ExceptionSink* xsink);
+   DLLLOCAL int getWhere(ExceptionSink* xsink);
+   DLLLOCAL int skipColumnDef(ExceptionSink* xsink);
+};
+
+int LoopbackSql::error(ExceptionSink* xsink, const char* fmt, ...) {
+   QoreStringNode* desc = new QoreStringNode;
+   va_list args;
+   while (true) {
+      va_start(args, fmt);
+      int rc = desc->vsprintf(fmt, args);
+      va_end(args);
+      if (!rc)
+         break;
+   }
+   const Token& t = cur();
+   if (t.type == T_END)
+      desc->concat(" at the end of the SQL string");
+   else if (t.type == T_PARAM)
+      desc->concat(" near bind placeholder %v");
+   else if (t.type == T_STR)
+      desc->concat(" near a string literal");
+   else
+      desc->sprintf(" near '%s'", t.text.c_str());
+   xsink->raiseException("LOOPBACK-SQL-ERROR", desc);
+   return -1;
+}
+
+int LoopbackSql::tokenize(const QoreString& str, ExceptionSink* xsink) {
+   const char* p = str.getBuffer();
+   while (true) {
+      while (isspace(*p))
+         ++p;
+      Token t;
+      t.val = 0;
+      t.param = -1;
+      if (!*p) {
+         t.type = T_END;
+         tl.push_back(t);
+         break;
+      }
+      if (isalpha(*p) || *p == '_') {
+         const char* s = p;
+         while (isalnum(*p) || *p == '_' || *p == '$' || *p == '.')
+            ++p;
+         t.type = T_IDENT;
+         t.text.assign(s, p - s);
+         for (std::string::iterator i = t.text.begin(), e = t.text.end(); i != e; ++i)
+            *i = tolower(*i);
+      }
+      else if (isdigit(*p) || (*p == '.' && isdigit(p[1]))) {
+         const char* s = p;
+         bool flt = false;
+         while (isdigit(*p))
+            ++p;
+         if (*p == '.') {
+            flt = true;
+            ++p;
+            while (isdigit(*p))
+               ++p;
+         }
+         if ((*p == 'e' || *p == 'E') && (isdigit(p[1]) || ((p[1] == '-' || p[1] == '+') && isdigit(p[2])))) {
+            flt = true;
+            p += 2;
+            while (isdigit(*p))
+               ++p;
+         }
+         t.type = T_NUM;
+         t.text.assign(s, p - s);
+         if (flt)
+            t.val = new QoreFloatNode(strtod(t.text.c_str(), 0));
+         else
+            t.val = new QoreBigIntNode(strtoll(t.text.c_str(), 0, 10));
+      }
+      else if (*p == '\'') {
+         QoreStringNode* s = new QoreStringNode(str.getEncoding());
+         ++p;
+         while (true) {
+            if (!*p) {
+               s->deref();
+               xsink->raiseException("LOOPBACK-SQL-ERROR", "unterminated string literal in SQL");
+               return -1;
+            }
+            if (*p == '\'') {
+               if (p[1] != '\'')
+                  break;
+               ++p;
+            }
+            s->concat(*p);
+            ++p;
+         }
+         ++p;
+         t.type = T_STR;
+         t.val = s;
+      }
+      else if (*p == '%' && p[1] == 'v') {
+         p += 2;
+         t.type = T_PARAM;
+         t.param = params++;
+      }
+      else {
+         t.type = T_PUNCT;
+         if ((p[0] == '<' && (p[1] == '=' || p[1] == '>')) || ((p[0] == '>' || p[0] == '!') && p[1] == '=')) {
+            t.text.assign(p, 2);
+            p += 2;
+         }
+         else
+            t.text.assign(p++, 1);
+      }
+      tl.push_back(t);
+   }
+   return 0;
+}
+
+int LoopbackSql::getOperand(LoopbackOperand& op, ExceptionSink* xsink) {
+   const Token& t = cur();
+   if (t.type == T_PARAM) {
+      op.param = t.param;
+      ++tp;
+      return 0;
+   }
+   if (t.type == T_NUM || t.type == T_STR) {
+      op.val = t.val->refSelf();
+      ++tp;
+      return 0;
+   }
+   if (isPunct("-") && tl[tp + 1].type == T_NUM) {
+      ++tp;
+      const AbstractQoreNode* n = cur().val;
+      if (n->getType() == NT_INT)
+         op.val = new QoreBigIntNode(-n->getAsBigInt());
+      else
+         op.val = new QoreFloatNode(-n->getAsFloat());
+      ++tp;
+      return 0;
+   }
+   if (isKeyword("null")) {
+      ++tp;
+      return 0;
+   }
+   return error(xsink, "expecting a value");
+}
+
+int LoopbackSql::getNameList(lb_name_vec_t& l, ExceptionSink* xsink) {
+   while (true) {
+      std::string n;
+      if (getIdent(n, "a column name", xsink))
+         return -1;
+      l.push_back(n);
+      if (!isPunct(","))
+         return 0;
+      ++tp;
+   }
+}
+
+int LoopbackSql::getWhere(ExceptionSink* xsink) {
+   if (!isKeyword("where"))
+      return 0;
+   ++tp;
+   while (true) {
+      LoopbackCond c;
+      if (getIdent(c.col, "a column name", xsink))
+         return -1;
+      if (isKeyword("is")) {
+         ++tp;
+         c.op = LB_IS_NULL;
+         if (isKeyword("not")) {
+            ++tp;
+            c.op = LB_IS_NOT_NULL;
+         }
+         if (expectKeyword("null", xsink))
+            return -1;
+      }
+      else {
+         if (cur().type != T_PUNCT)
+            return error(xsink, "expecting a comparison operator");
+         const std::string& o = cur().text;
+         if (o == "=")
+            c.op = LB_EQ;
+         else if (o == "<>" || o == "!=")
+            c.op = LB_NE;
+         else if (o == "<")
+            c.op = LB_LT;
+         else if (o == "<=")
+            c.op = LB_LE;
+         else if (o == ">")
+            c.op = LB_GT;
+         else if (o == ">=")
+            c.op = LB_GE;
+         else
+            return error(xsink, "expecting a comparison operator");
+         ++tp;
+         if (getOperand(c.val, xsink))
+            return -1;
+      }
+      where.push_back(c);
+      if (!isKeyword("and"))
+         return 0;
+      ++tp;
+   }
+}
+
+int LoopbackSql::skipColumnDef(ExceptionSink* xsink) {
+   int level = 0;
+   while (true) {
+      if (cur().type == T_END)
+         return error(xsink, "unterminated column definition");
+      if (isPunct("("))
+         ++level;
+      else if (isPunct(")")) {
+         if (!level)
+            return 0;
+         --level;
+      }
+      else if (isPunct(",") && !level)
+         return 0;
+      ++tp;
+   }
+}
+
+int LoopbackSql::parseIntern(ExceptionSink* xsink) {
+   if (isKeyword("select")) {
+      type = LB_SELECT;
+      ++tp;
+      if (isPunct("*"))
+         ++tp;
+      else if (isKeyword("count") && tl[tp + 1].type == T_PUNCT && tl[tp + 1].text == "(") {
+         tp += 2;
+         if (expectPunct("*", xsink) || expectPunct(")", xsink))
+            return -1;
+         count = true;
+      }
+      else if (getNameList(cols, xsink))
+         return -1;
+      if (expectKeyword("from", xsink) || getIdent(table, "a table name", xsink) || getWhere(xsink))
+         return -1;
+   }
+   else if (isKeyword("insert")) {
+      type = LB_INSERT;
+      ++tp;
+      if (expectKeyword("into", xsink) || getIdent(table, "a table name", xsink))
+         return -1;
+      if (isPunct("(")) {
+         ++tp;
+         if (getNameList(cols, xsink) || expectPunct(")", xsink))
+            return -1;
+      }
+      if (expectKeyword("values", xsink) || expectPunct("(", xsink))
+         return -1;
+      while (true) {
+         LoopbackOperand op;
+         if (getOperand(op, xsink))
+            return -1;
+         vals.push_back(op);
+         if (!isPunct(","))
+            break;
+         ++tp;
+      }
+      if (expectPunct(")", xsink))
+         return -1;
+      if (!cols.empty() && cols.size() != vals.size())
+         return error(xsink, "%d column(s) given but %d value(s)", (int)cols.size(), (int)vals.size());
+   }
+   else if (isKeyword("update")) {
+      type = LB_UPDATE;
+      ++tp;
+      if (getIdent(table, "a table name", xsink) || expectKeyword("set", xsink))
+         return -1;
+      while (true) {
+         std::string c;
+         LoopbackOperand op;
+         if (getIdent(c, "a column name", xsink) || expectPunct("=", xsink) || getOperand(op, xsink))
+            return -1;
+         cols.push_back(c);
+         vals.push_back(op);
+         if (!isPunct(","))
+            break;
+         ++tp;
+      }
+      if (getWhere(xsink))
+         return -1;
+   }
+   else if (isKeyword("delete")) {
+      type = LB_DELETE;
+      ++tp;
+      if (expectKeyword("from", xsink) || getIdent(table, "a table name", xsink) || getWhere(xsink))
+         return -1;
+   }
+   else if (isKeyword("create")) {
+      type = LB_CREATE;
+      ++tp;
+      if (expectKeyword("table", xsink) || getIdent(table, "a table name", xsink) || expectPunct("(", xsink))
+         return -1;
+      while (true) {
+         std::string c;
+         if (getIdent(c, "a column name", xsink) || skipColumnDef(xsink))
+            return -1;
+         cols.push_back(c);
+         if (!isPunct(","))
+            break;
+         ++tp;
+      }
+      if (expectPunct(")", xsink))
+         return -1;
+   }
+   else if (isKeyword("drop") || isKeyword("truncate")) {
+      type = isKeyword("drop") ? LB_DROP : LB_TRUNCATE;
+      ++tp;
+      if (expectKeyword("table", xsink) || getIdent(table, "a table name", xsink))
+         return -1;
+   }
+   else
+      return error(xsink, "unsupported SQL statement");
+
+   if (isPunct(";"))
+      ++tp;
+   if (cur().type != T_END)
+      return error(xsink, "unexpected text");
+   return 0;
+}
+
+int LoopbackSql::parse(const QoreString& sql, const QoreListNode* args, bool raw, ExceptionSink* xsink) {
+   // expand inline %d and %s arguments and assign argument positions to %v bind placeholders
+   QoreString str(sql.getEncoding());
+   str.reserve(sql.size());
+   int ai = 0;
+   const char* p = sql.getBuffer();
+   bool quote = false;
+   while (*p) {
+      if (*p == '\'')
+         quote = !quote;
+      else if (*p == '%' && !raw && ((p[1] == 'v' && !quote) || p[1] == 'd' || p[1] == 's')) {
+         if (p[1] == 'v') {
+            pargs.push_back(ai++);
+            str.concat(p, 2);
+         }
+         else {
+            const AbstractQoreNode* v = args ? args->retrieve_entry(ai) : 0;
+            ++ai;
+            if (p[1] == 'd')
+               DBI_concat_numeric(&str, v);
+            else if (DBI_concat_string(&str, v, xsink))
+               return -1;
+         }
+         p += 2;
+         continue;
+      }
+      str.concat(*p);
+      ++p;
+   }
+
+   if (tokenize(str, xsink))
+      return -1;
+
+   if (raw && params) {
+      xsink->raiseException("LOOPBACK-SQL-ERROR", "bind placeholders cannot be used with raw SQL");
+      return -1;
+   }
+
+   tp = 0;
+   int rc = parseIntern(xsink);
+   clearTokens();
+   return rc;
+}
+
+// compares two non-NULL values
+static int loopback_compare(const AbstractQoreNode* l, const AbstractQoreNode* r, ExceptionSink* xsink) {
+   qore_type_t lt = l->getType(), rt = r->getType();
+   if (lt == NT_INT && rt == NT_INT) {
+      int64 li = reinterpret_cast<const QoreBigIntNode*>(l)->val, ri = reinterpret_cast<const QoreBigIntNode*>(r)->val;
+      return li < ri ? -1 : (li > ri ? 1 : 0);
+   }
+   if (lt == NT_STRING && rt == NT_STRING)
+      return strcmp(reinterpret_cast<const QoreStringNode*>(l)->getBuffer(), reinterpret_cast<const QoreStringNode*>(r)->getBuffer());
+   if (lt == NT_DATE && rt == NT_DATE)
+      return DateTime::compareDates(reinterpret_cast<const DateTimeNode*>(l), reinterpret_cast<const DateTimeNode*>(r));
+   if ((lt == NT_INT || lt == NT_FLOAT || lt == NT_NUMBER || lt == NT_STRING || lt == NT_BOOLEAN)
+       && (rt == NT_INT || rt == NT_FLOAT || rt == NT_NUMBER || rt == NT_STRING || rt == NT_BOOLEAN)) {
+      double lf = l->getAsFloat(), rf = r->getAsFloat();
+      return lf < rf ? -1 : (lf > rf ? 1 : 0);
+   }
+   return compareSoft(l, r, xsink) ? 1 : 0;
+}
+
+// an executed SQL statement with its bound values and results
+class LoopbackExec {
+public:
+   typedef std::vector<LoopbackRow*> row_vec_t;
+
+   LoopbackConnection* conn;
+   const LoopbackSql& sql;
+   // bind parameter values; not referenced
+   std::vector<const AbstractQoreNode*> pv;
+
+   // result set: column names, column indexes in the table rows, and rows
+   lb_name_vec_t rcols;
+   std::vector<int> ridx;
+   row_vec_t rows;
+   int64 affected;
+
+   DLLLOCAL LoopbackExec(LoopbackConnection* c, const LoopbackSql& s) : conn(c), sql(s), affected(0) {
+   }
+
+   DLLLOCAL ~LoopbackExec() {
+      clearRows();
+   }
+
+   DLLLOCAL void clearRows() {
+      for (row_vec_t::iterator i = rows.begin(), e = rows.end(); i != e; ++i)
+         (*i)->deref();
+      rows.clear();
+   }
+
+   // sets bind values from the argument list given when the SQL was parsed
+   DLLLOCAL void setArgs(const QoreListNode* args) {
+      pv.resize(sql.params);
+      for (unsigned i = 0; i < sql.pargs.size(); ++i)
+         pv[i] = args ? args->retrieve_entry(sql.pargs[i]) : 0;
+   }
+
+   // sets bind values from a list of values for the bind placeholders only
+   DLLLOCAL void setBind(const QoreListNode* args) {
+      pv.resize(sql.params);
+      for (int i = 0; i < sql.params; ++i)
+         pv[i] = args ? args->retrieve_entry(i) : 0;
+   }
+
+   DLLLOCAL int exec(ExceptionSink* xsink);
+
+   DLLLOCAL bool isSelect() const {
+      return sql.type == LB_SELECT;
+   }
+
+   // returns a row hash template for the result columns
+   DLLLOCAL QoreHashNode* rowTemplate() const {
+      QoreHashNode* h = new QoreHashNode;
+      for (lb_name_vec_t::const_iterator i = rcols.begin(), e = rcols.end(); i != e; ++i)
+         h->setKeyValue(i->c_str(), 0, 0);
+      return h;
+   }
+
+   DLLLOCAL QoreHashNode* getRow(const QoreHashNode* tmpl, const LoopbackRow* row) const {
+      QoreHashNode* h = tmpl->copyShape();
+      for (unsigned i = 0; i < rcols.size(); ++i)
+         h->setKeyValue(rcols[i].c_str(), getValue(row, i), 0);
+      return h;
+   }
+
+   // returns rows [start, end) as a hash of lists
+   DLLLOCAL QoreHashNode* getColumns(size_t start, size_t end) const {
+      QoreHashNode* h = new QoreHashNode;
+      for (unsigned i = 0; i < rcols.size(); ++i) {
+         QoreListNode* l = new QoreListNode;
+         for (size_t r = start; r < end; ++r)
+            l->push(getValue(rows[r], i));
+         h->setKeyValue(rcols[i].c_str(), l, 0);
+      }
+      return h;
+   }
+
+   // returns rows [start, end) as a list of hashes
+   DLLLOCAL QoreListNode* getRows(size_t start, size_t end) const {
+      QoreListNode* l = new QoreListNode;
+      if (start < end) {
+         ReferenceHolder<QoreHashNode> tmpl(rowTemplate(), 0);
+         for (size_t r = start; r < end; ++r)
+            l->push(getRow(*tmpl, rows[r]));
+      }
+      return l;
+   }
+
+private:
+   DLLLOCAL AbstractQoreNode* getValue(const LoopbackRow* row, unsigned i) const {
+      // "select count(*)" rows have no table columns
+      AbstractQoreNode* v = row->v[ridx.empty() ? i : ridx[i]];
+      return v ? v->refSelf() : null();
+   }
+
+   DLLLOCAL const AbstractQoreNode* getOperand(const LoopbackOperand& op, size_t ai) const {
+      if (op.param == -1)
+         return op.val;
+      const AbstractQoreNode* v = pv[op.param];
+      if (v && v->getType() == NT_LIST)
+         v = reinterpret_cast<const QoreListNode*>(v)->retrieve_entry(ai);
+      return is_nothing(v) || is_null(v) ? 0 : v;
+   }
+
+   DLLLOCAL int match(const LoopbackTable& t, const std::vector<int>& widx, const LoopbackRow& row, size_t ai, bool& m, ExceptionSink* xsink) const;
+   DLLLOCAL int resolve(const LoopbackTable& t, const lb_name_vec_t& names, std::vector<int>& idx, ExceptionSink* xsink) const;
+   DLLLOCAL int execDml(LoopbackTable& t, size_t ai, ExceptionSink* xsink);
+   DLLLOCAL int checkValue(const AbstractQoreNode* v, ExceptionSink* xsink) const;
+   DLLLOCAL int getArraySize(size_t& n, ExceptionSink* xsink) const;
+};
+
+int LoopbackExec::resolve(const LoopbackTable& t, const lb_name_vec_t& names, std::vector<int>& idx, ExceptionSink* xsink) const {
+   for (lb_name_vec_t::const_iterator i = names.begin(), e = names.end(); i != e; ++i) {
+      int ci = t.findColumn(*i);
+      if (ci == -1) {
+         xsink->raiseException("LOOPBACK-SQL-ERROR", "table '%s' has no column '%s'", sql.table.c_str(), i->c_str());
+         return -1;
+      }
+      idx.push_back(ci);
+   }
+   return 0;
+}
+
+int LoopbackExec::match(const LoopbackTable& t, const std::vector<int>& widx, const LoopbackRow& row, size_t ai, bool& m, ExceptionSink* xsink) const {
+   m = false;
+   for (unsigned i = 0; i < sql.where.size(); ++i) {
+      const LoopbackCond& c = sql.where[i];
+      const AbstractQoreNode* v = row.v[widx[i]];
+      if (c.op == LB_IS_NULL) {
+         if (v)
+            return 0;
+         continue;
+      }
+      if (c.op == LB_IS_NOT_NULL) {
+         if (!v)
+            return 0;
+         continue;
+      }
+      const AbstractQoreNode* o = getOperand(c.val, ai);
+      // comparisons with NULL are never true
+      if (!v || !o)
+         return 0;
+      int rc = loopback_compare(v, o, xsink);
+      if (*xsink)
+         return -1;
+      bool ok;
+      switch (c.op) {
+         case LB_EQ: ok = !rc; break;
+         case LB_NE: ok = rc; break;
+         case LB_LT: ok = rc < 0; break;
+         case LB_LE: ok = rc <= 0; break;
+         case LB_GT: ok = rc > 0; break;
+         default: ok = rc >= 0; break;
+      }
+      if (!ok)
+         return 0;
+   }
+   m = true;
+   return 0;
+}
+
+int LoopbackExec::checkValue(const AbstractQoreNode* v, ExceptionSink* xsink) const {
+   qore_type_t t = get_node_type(v);
+   if (t == NT_HASH || t == NT_OBJECT || t == NT_LIST || t == NT_RUNTIME_CLOSURE || t == NT_FUNCREF) {
+      xsink->raiseException("LOOPBACK-BIND-ERROR", "cannot store a value of type '%s' in table '%s'", get_type_name(v), sql.table.c_str());
+      return -1;
+   }
+   return 0;
+}
+
+int LoopbackExec::getArraySize(size_t& n, ExceptionSink* xsink) const {
+   n = 0;
+   bool array = false;
+   for (int i = 0; i < sql.params; ++i) {
+      if (get_node_type(pv[i]) != NT_LIST)
+         continue;
+      size_t s = reinterpret_cast<const QoreListNode*>(pv[i])->size();
+      if (!array) {
+         n = s;
+         array = true;
+      }
+      else if (s != n) {
+         xsink->raiseException("LOOPBACK-BIND-ERROR", "array bind lists have different sizes (%lu and %lu)", (unsigned long)n, (unsigned long)s);
+         return -1;
+      }
+   }
+   if (!array)
+      n = 1;
+   return 0;
+}
+
+int LoopbackExec::execDml(LoopbackTable& t, size_t ai, ExceptionSink* xsink) {
+   std::vector<int> widx;
+   for (lb_cond_vec_t::const_iterator i = sql.where.begin(), e = sql.where.end(); i != e; ++i) {
+      int ci = t.findColumn(i->col);
+      if (ci == -1) {
+         xsink->raiseException("LOOPBACK-SQL-ERROR", "table '%s' has no column '%s'", sql.table.c_str(), i->col.c_str());
+         return -1;
+      }
+      widx.push_back(ci);
+   }
+
+   if (sql.type == LB_INSERT) {
+      LoopbackRow* row = new LoopbackRow(t.cols.size());
+      if (sql.cols.empty() && sql.vals.size() != t.cols.size()) {
+         row->deref();
+         xsink->raiseException("LOOPBACK-SQL-ERROR", "table '%s' has %d column(s) but %d value(s) were given", sql.table.c_str(), (int)t.cols.size(), (int)sql.vals.size());
+         return -1;
+      }
+      for (unsigned i = 0; i < sql.vals.size(); ++i) {
+         int ci = i;
+         if (!sql.cols.empty() && (ci = t.findColumn(sql.cols[i])) == -1) {
+            row->deref();
+            xsink->raiseException("LOOPBACK-SQL-ERROR", "table '%s' has no column '%s'", sql.table.c_str(), sql.cols[i].c_str());
+            return -1;
+         }
+         const AbstractQoreNode* v = getOperand(sql.vals[i], ai);
+         if (checkValue(v, xsink)) {
+            row->deref();
+            return -1;
+         }
+         discard(row->v[ci], 0);
+         row->v[ci] = v ? v->refSelf() : 0;
+      }
+      int64 id = t.next_id++;
+      t.rows[id] = row;
+      conn->logUndo(sql.table, t.serial, id, 0);
+      ++affected;
+      return 0;
+   }
+
+   std::vector<int> sidx;
+   if (sql.type == LB_UPDATE && resolve(t, sql.cols, sidx, xsink))
+      return -1;
+
+   for (LoopbackTable::rmap_t::iterator i = t.rows.begin(), e = t.rows.end(); i != e;) {
+      bool m;
+      if (match(t, widx, *i->second, ai, m, xsink))
+         return -1;
+      if (!m) {
+         ++i;
+         continue;
+      }
+      ++affected;
+      if (sql.type == LB_DELETE) {
+         // the row's reference is moved to the undo log
+         conn->logUndo(sql.table, t.serial, i->first, i->second);
+         t.rows.erase(i++);
+         continue;
+      }
+      assert(sql.type == LB_UPDATE);
+      LoopbackRow* row = new LoopbackRow(t.cols.size());
+      for (unsigned ci = 0; ci < t.cols.size(); ++ci)
+         row->v[ci] = i->second->v[ci] ? i->second->v[ci]->refSelf() : 0;
+      for (unsigned si = 0; si < sidx.size(); ++si) {
+         const AbstractQoreNode* v = getOperand(sql.vals[si], ai);
+         if (checkValue(v, xsink)) {
+            row->deref();
+            return -1;
+         }
+         discard(row->v[sidx[si]], 0);
+         row->v[sidx[si]] = v ? v->refSelf() : 0;
+      }
+      conn->logUndo(sql.table, t.serial, i->first, i->second);
+      i->second = row;
+      ++i;
+   }
+   return 0;
+}
+
+int LoopbackExec::exec(ExceptionSink* xsink) {
+   clearRows();
+   rcols.clear();
+   ridx.clear();
+   affected = 0;
+
+   conn->request();
+   LoopbackDb& db = *conn->db;
+
+   if (sql.type == LB_SELECT) {
+      QoreAutoRWReadLocker al(db.rwl);
+      const LoopbackTable* t = db.find(sql.table);
+      if (!t) {
+         xsink->raiseException("LOOPBACK-TABLE-ERROR", "table '%s' does not exist", sql.table.c_str());
+         return -1;
+      }
+      for (int i = 0; i < sql.params; ++i) {
+         if (get_node_type(pv[i]) == NT_LIST) {
+            xsink->raiseException("LOOPBACK-BIND-ERROR", "array binds are only supported for DML statements");
+            return -1;
+         }
+      }
+      std::vector<int> widx;
+      for (lb_cond_vec_t::const_iterator i = sql.where.begin(), e = sql.where.end(); i != e; ++i) {
+         int ci = t->findColumn(i->col);
+         if (ci == -1) {
+            xsink->raiseException("LOOPBACK-SQL-ERROR", "table '%s' has no column '%s'", sql.table.c_str(), i->col.c_str());
+            return -1;
+         }
+         widx.push_back(ci);
+      }
+      if (!sql.count) {
+         rcols = sql.cols.empty() ? t->cols : sql.cols;
+         if (resolve(*t, rcols, ridx, xsink))
+            return -1;
+      }
+      int64 cnt = 0;
+      for (LoopbackTable::rmap_t::const_iterator i = t->rows.begin(), e = t->rows.end(); i != e; ++i) {
+         if (!sql.where.empty()) {
+            bool m;
+            if (match(*t, widx, *i->second, 0, m, xsink))
+               return -1;
+            if (!m)
+               continue;
+         }
+         if (sql.count)
+            ++cnt;
+         else {
+            i->second->ref();
+            rows.push_back(i->second);
+         }
+      }
+      if (sql.count) {
+         rcols.push_back("count");
+         LoopbackRow* row = new LoopbackRow(1);
+         row->v[0] = new QoreBigIntNode(cnt);
+         rows.push_back(row);
+      }
+      return 0;
+   }
+
+   QoreAutoRWWriteLocker al(db.rwl);
+   LoopbackTable* t = db.find(sql.table);
+
+   if (sql.type == LB_CREATE) {
+      if (t) {
+         xsink->raiseException("LOOPBACK-TABLE-ERROR", "table '%s' already exists", sql.table.c_str());
+         return -1;
+      }
+      db.tables[sql.table] = new LoopbackTable(LBM.getSerial(), sql.cols);
+      return 0;
+   }
+
+   if (!t) {
+      xsink->raiseException("LOOPBACK-TABLE-ERROR", "table '%s' does not exist", sql.table.c_str());
+      return -1;
+   }
+
+   if (sql.type == LB_DROP) {
+      db.tables.erase(sql.table);
+      delete t;
+      return 0;
+   }
+
+   if (sql.type == LB_TRUNCATE) {
+      for (LoopbackTable::rmap_t::iterator i = t->rows.begin(), e = t->rows.end(); i != e; ++i)
+         conn->logUndo(sql.table, t->serial, i->first, i->second);
+      affected = t->rows.size();
+      t->rows.clear();
+      return 0;
+   }
+
+   // execute DML once for each row of array bind values
+   size_t n;
+   if (getArraySize(n, xsink))
+      return -1;
+   for (size_t ai = 0; ai < n; ++ai) {
+      if (execDml(*t, ai, xsink))
+         return -1;
+   }
+   return 0;
+}
+
+static LoopbackConnection* loopback_get_connection(Datasource* ds) {
+   return (LoopbackConnection*)ds->getPrivateData();
+}
+
+static int loopback_open(Datasource* ds, ExceptionSink* xsink) {
+   LoopbackConnection* c = new LoopbackConnection(LBM.get(ds->getDBName()));
+
+   // options are set after the connection has been opened, so the connection latency is taken from the connection options
+   const QoreHashNode* opts = ds->getConnectOptions();
+   if (opts) {
+      bool found;
+      int64 cl = opts->getKeyAsBigInt(LOOPBACK_OPT_CONNECT_LATENCY, found);
+      if (found && cl > 0)
+         qore_usleep(cl);
+   }
+
+   if (ds->getDBEncoding())
+      ds->setQoreEncoding(ds->getDBEncoding());
+   else {
+      ds->setDBEncoding("utf8");
+      ds->setQoreEncoding(QCS_UTF8);
+   }
+
+   ds->setPrivateData((void*)c);
+   return 0;
+}
+
+static int loopback_close(Datasource* ds) {
+   LoopbackConnection* c = loopback_get_connection(ds);
+   // uncommitted changes are rolled back when the connection is closed
+   c->rollback();
+   delete c;
+   ds->setPrivateData(0);
+   return 0;
+}
+
+// executes the SQL and returns the result in the given format: 0 = hash of lists, 1 = list of hashes, 2 = single row,
+// 3 = affected rows for DML or a hash of lists for selects
+static AbstractQoreNode* loopback_exec_intern(Datasource* ds, const QoreString* qstr, const QoreListNode* args, int fmt, bool raw, ExceptionSink* xsink) {
+   LoopbackSql sql;
+   if (sql.parse(*qstr, args, raw, xsink))
+      return 0;
+
+   LoopbackExec ex(loopback_get_connection(ds), sql);
+   ex.setArgs(args);
+   if (ex.exec(xsink))
+      return 0;
+
+   if (!ex.isSelect()) {
+      if (fmt < 3)
+         return 0;
+      return new QoreBigIntNode(ex.affected);
+   }
+
+   switch (fmt) {
+      case 1:
+         return ex.getRows(0, ex.rows.size());
+      case 2: {
+         if (ex.rows.size() > 1) {
+            xsink->raiseException("LOOPBACK-SELECT-ROW-ERROR", "SQL passed to selectRow() returned more than 1 row");
+            return 0;
+         }
+         if (ex.rows.empty())
+            return 0;
+         ReferenceHolder<QoreHashNode> tmpl(ex.rowTemplate(), xsink);
+         return ex.getRow(*tmpl, ex.rows[0]);
+      }
+      default:
+         return ex.getColumns(0, ex.rows.size());
+   }
+}
+
+static AbstractQoreNode* loopback_select(Datasource* ds, const QoreString* qstr, const QoreListNode* args, ExceptionSink* xsink) {
+   return loopback_exec_intern(ds, qstr, args, 0, false, xsink);
+}
+
+static AbstractQoreNode* loopback_select_rows(Datasource* ds, const QoreString* qstr, const QoreListNode* args, ExceptionSink* xsink) {
+   return loopback_exec_intern(ds, qstr, args, 1, false, xsink);
+}
+
+static QoreHashNode* loopback_select_row(Datasource* ds, const QoreString* qstr, const QoreListNode* args, ExceptionSink* xsink) {
+   return reinterpret_cast<QoreHashNode*>(loopback_exec_intern(ds, qstr, args, 2, false, xsink));
+}
+
+static AbstractQoreNode* loopback_exec(Datasource* ds, const QoreString* qstr, const QoreListNode* args, ExceptionSink* xsink) {
+   return loopback_exec_intern(ds, qstr, args, 3, false, xsink);
+}
+
+static AbstractQoreNode* loopback_exec_raw(Datasource* ds, const QoreString* qstr, ExceptionSink* xsink) {
+   return loopback_exec_intern(ds, qstr, 0, 3, true, xsink);
+}
+
+static int loopback_commit(Datasource* ds, ExceptionSink* xsink) {
+   LoopbackConnection* c = loopback_get_connection(ds);
+   c->request();
+   c->commit();
+   return 0;
+}
+
+static int loopback_rollback(Datasource* ds, ExceptionSink* xsink) {
+   LoopbackConnection* c = loopback_get_connection(ds);
+   c->request();
+   c->rollback();
+   return 0;
+}
+
+static AbstractQoreNode* loopback_get_server_version(Datasource* ds, ExceptionSink* xsink) {
+   loopback_get_connection(ds)->request();
+   return new QoreStringNode(LOOPBACK_VERSION);
+}
+
+static AbstractQoreNode* loopback_get_client_version(const Datasource* ds, ExceptionSink* xsink) {
+   return new QoreStringNode(LOOPBACK_VERSION);
+}
+
+static int loopback_opt_set(Datasource* ds, const char* opt, const AbstractQoreNode* val, ExceptionSink* xsink) {
+   LoopbackConnection* c = loopback_get_connection(ds);
+   int64 v = val ? val->getAsBigInt() : 0;
+   if (v < 0)
+      v = 0;
+   if (!strcasecmp(opt, LOOPBACK_OPT_LATENCY))
+      c->latency = v;
+   else {
+      assert(!strcasecmp(opt, LOOPBACK_OPT_CONNECT_LATENCY));
+      c->connect_latency = v;
+   }
+   return 0;
+}
+
+static AbstractQoreNode* loopback_opt_get(const Datasource* ds, const char* opt) {
+   const LoopbackConnection* c = (const LoopbackConnection*)ds->getPrivateData();
+   if (!c)
+      return 0;
+   if (!strcasecmp(opt, LOOPBACK_OPT_LATENCY))
+      return new QoreBigIntNode(c->latency);
+   assert(!strcasecmp(opt, LOOPBACK_OPT_CONNECT_LATENCY));
+   return new QoreBigIntNode(c->connect_latency);
+}
+
+// private data for SQLStatement objects
+class LoopbackStatement {
+public:
+   LoopbackSql sql;
+   LoopbackExec ex;
+   // bound values
+   QoreListNode* args;
+   // true if the bound values are only for bind placeholders
+   bool bind_only;
+   // current row position
+   size_t pos;
+
+   DLLLOCAL LoopbackStatement(LoopbackConnection* c) : ex(c, sql), args(0), bind_only(false), pos(0) {
+   }
+
+   DLLLOCAL ~LoopbackStatement() {
+      assert(!args);
+   }
+
+   DLLLOCAL void del(ExceptionSink* xsink) {
+      if (args) {
+         args->deref(xsink);
+         args = 0;
+      }
+   }
+
+   DLLLOCAL void setArgs(const QoreListNode* l, bool bo, ExceptionSink* xsink) {
+      del(xsink);
+      args = l ? l->listRefSelf() : 0;
+      bind_only = bo;
+   }
+
+   DLLLOCAL int exec(ExceptionSink* xsink) {
+      if (bind_only)
+         ex.setBind(args);
+      else
+         ex.setArgs(args);
+      pos = 0;
+      return ex.exec(xsink);
+   }
+
+   DLLLOCAL size_t getEnd(int rows) const {
+      size_t end = ex.rows.size();
+      if (rows > 0 && pos + rows < end)
+         end = pos + rows;
+      return end;
+   }
+};
+
+static LoopbackStatement* loopback_get_stmt(SQLStatement* stmt) {
+   return (LoopbackStatement*)stmt->getPrivateData();
+}
+
+static int loopback_stmt_prepare_intern(SQLStatement* stmt, const QoreString& str, const QoreListNode* args, bool raw, ExceptionSink* xsink) {
+   assert(!stmt->getPrivateData());
+   LoopbackStatement* ls = new LoopbackStatement(loopback_get_connection(stmt->getDatasource()));
+   stmt->setPrivateData(ls);
+
+   if (ls->sql.parse(str, args, raw, xsink))
+      return -1;
+   ls->setArgs(args, false, xsink);
+   return 0;
+}
+
+static int loopback_stmt_prepare(SQLStatement* stmt, const QoreString& str, const QoreListNode* args, ExceptionSink* xsink) {
+   return loopback_stmt_prepare_intern(stmt, str, args, false, xsink);
+}
+
+static int loopback_stmt_prepare_raw(SQLStatement* stmt, const QoreString& str, ExceptionSink* xsink) {
+   return loopback_stmt_prepare_intern(stmt, str, 0, true, xsink);
+}
+
+static int loopback_stmt_bind(SQLStatement* stmt, const QoreListNode& l, ExceptionSink* xsink) {
+   LoopbackStatement* ls = loopback_get_stmt(stmt);
+   ls->setArgs(&l, true, xsink);
+   return 0;
+}
+
+static int loopback_stmt_exec(SQLStatement* stmt, ExceptionSink* xsink) {
+   return loopback_get_stmt(stmt)->exec(xsink);
+}
+
+static int loopback_stmt_define(SQLStatement* stmt, ExceptionSink* xsink) {
+   return 0;
+}
+
+static int loopback_stmt_affected_rows(SQLStatement* stmt, ExceptionSink* xsink) {
+   return (int)loopback_get_stmt(stmt)->ex.affected;
+}
+
+static QoreHashNode* loopback_stmt_get_output(SQLStatement* stmt, ExceptionSink* xsink) {
+   // output placeholders are not supported
+   return new QoreHashNode;
+}
+
+static QoreHashNode* loopback_stmt_fetch_row(SQLStatement* stmt, ExceptionSink* xsink) {
+   LoopbackStatement* ls = loopback_get_stmt(stmt);
+   if (!ls->pos || ls->pos > ls->ex.rows.size()) {
+      xsink->raiseException("LOOPBACK-FETCH-ROW-ERROR", "SQLStatement::fetchRow() called without a current row; call SQLStatement::next() before fetching a row");
+      return 0;
+   }
+   ReferenceHolder<QoreHashNode> tmpl(ls->ex.rowTemplate(), xsink);
+   return ls->ex.getRow(*tmpl, ls->ex.rows[ls->pos - 1]);
+}
+
+static QoreListNode* loopback_stmt_fetch_rows(SQLStatement* stmt, int rows, ExceptionSink* xsink) {
+   LoopbackStatement* ls = loopback_get_stmt(stmt);
+   size_t end = ls->getEnd(rows);
+   QoreListNode* l = ls->ex.getRows(ls->pos, end);
+   ls->pos = end;
+   return l;
+}
+
+static QoreHashNode* loopback_stmt_fetch_columns(SQLStatement* stmt, int rows, ExceptionSink* xsink) {
+   LoopbackStatement* ls = loopback_get_stmt(stmt);
+   size_t end = ls->getEnd(rows);
+   QoreHashNode* h = ls->ex.getColumns(ls->pos, end);
+   ls->pos = end;
+   return h;
+}
+
+static bool loopback_stmt_next(SQLStatement* stmt, ExceptionSink* xsink) {
+   LoopbackStatement* ls = loopback_get_stmt(stmt);
+   if (ls->pos >= ls->ex.rows.size())
+      return false;
+   ++ls->pos;
+   return true;
+}
+
+static int loopback_stmt_close(SQLStatement* stmt, ExceptionSink* xsink) {
+   LoopbackStatement* ls = (LoopbackStatement*)stmt->takePrivateData();
+   ls->del(xsink);
+   delete ls;
+   return *xsink ? -1 : 0;
+}
+
+void init_loopback_dbi() {
+   qore_dbi_method_list methods;
+   methods.add(QDBI_METHOD_OPEN, loopback_open);
+   methods.add(QDBI_METHOD_CLOSE, loopback_close);
+   methods.add(QDBI_METHOD_SELECT, loopback_select);
+   methods.add(QDBI_METHOD_SELECT_ROWS, loopback_select_rows);
+   methods.add(QDBI_METHOD_SELECT_ROW, loopback_select_row);
+   methods.add(QDBI_METHOD_EXEC, loopback_exec);
+   methods.add(QDBI_METHOD_EXECRAW, loopback_exec_raw);
+   methods.add(QDBI_METHOD_COMMIT, loopback_commit);
+   methods.add(QDBI_METHOD_ROLLBACK, loopback_rollback);
+   methods.add(QDBI_METHOD_GET_SERVER_VERSION, loopback_get_server_version);
+   methods.add(QDBI_METHOD_GET_CLIENT_VERSION, loopback_get_client_version);
+
+   methods.add(QDBI_METHOD_STMT_PREPARE, loopback_stmt_prepare);
+   methods.add(QDBI_METHOD_STMT_PREPARE_RAW, loopback_stmt_prepare_raw);
+   methods.add(QDBI_METHOD_STMT_BIND, loopback_stmt_bind);
+   methods.add(QDBI_METHOD_STMT_BIND_VALUES, loopback_stmt_bind);
+   methods.add(QDBI_METHOD_STMT_EXEC, loopback_stmt_exec);
+   methods.add(QDBI_METHOD_STMT_DEFINE, loopback_stmt_define);
+   methods.add(QDBI_METHOD_STMT_FETCH_ROW, loopback_stmt_fetch_row);
+   methods.add(QDBI_METHOD_STMT_FETCH_ROWS, loopback_stmt_fetch_rows);
+   methods.add(QDBI_METHOD_STMT_FETCH_COLUMNS, loopback_stmt_fetch_columns);
+   methods.add(QDBI_METHOD_STMT_NEXT, loopback_stmt_next);
+   methods.add(QDBI_METHOD_STMT_CLOSE, loopback_stmt_close);
+   methods.add(QDBI_METHOD_STMT_AFFECTED_ROWS, loopback_stmt_affected_rows);
+   methods.add(QDBI_METHOD_STMT_GET_OUTPUT, loopback_stmt_get_output);
+   methods.add(QDBI_METHOD_STMT_GET_OUTPUT_ROWS, loopback_stmt_get_output);
+
+   methods.add(QDBI_METHOD_OPT_SET, loopback_opt_set);
+   methods.add(QDBI_METHOD_OPT_GET, loopback_opt_get);
+
+   methods.registerOption(LOOPBACK_OPT_LATENCY, "synthetic latency in microseconds added to each request", softBigIntTypeInfo);
+   methods.registerOption(LOOPBACK_OPT_CONNECT_LATENCY, "synthetic latency in microseconds added when a connection is opened", softBigIntTypeInfo);
+
+   DBID_LOOPBACK = DBI.registerDriver("loopback", methods, DBI_CAP_TRANSACTION_MANAGEMENT | DBI_CAP_CHARSET_SUPPORT
+                                      | DBI_CAP_BIND_BY_VALUE | DBI_CAP_HAS_ARRAY_BIND);
+}
+
+void delete_loopback_dbi_data() {
+   LBM.clear();
+}
@@ -54,6 +54,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <unistd.h>
 
 #include <string>
 #include <map>
@@ -387,6 +388,20 @@ void QoreModuleManager::init(bool se) {
 
    mutex = new QoreThreadLock(&ma_recursive);
 
+   // set the number of threads used to preload user modules in parallel; by default one less than the number of CPUs
+   const char* mt = getenv("QORE_MODULE_THREADS");
+   if (mt && *mt) {
+      int n = atoi(mt);
+      preload_max = n > 0 ? n : 0;
+   }
+#ifdef _SC_NPROCESSORS_ONLN
+   else {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      if (n > 1)
+         preload_max = n - 1;
+   }
+#endif
+
    // initialize blacklist
    // add old QT modules to blacklist
    mod_blacklist.insert(std::make_pair((const char*)"qt-core", qt_blacklist_string));
@@ -510,6 +525,21 @@ static void check_module_version(QoreAbstractModule* mi, mod_op_e op, version_li
    }
 }
 
+// gets the feature name of a user module from its path
+static void get_user_module_feature(const char* path, QoreString& n) {
+   n = path;
+   qore_offset_t i = n.rfind('.');
+   if (i > 0)
+      n.terminate(i);
+#ifdef _Q_WINDOWS
+   i = n.rfindAny("\\/");
+#else
+   i = n.rfind(QORE_DIR_SEP);
+#endif
+   if (i >= 0)
+      n.replace(0, i + 1, (const char*)0);
+}
+
 static void qore_check_load_module_intern(QoreAbstractModule* mi, mod_op_e op, version_list_t* version, QoreProgram* pgm, ExceptionSink& xsink) {
    // check version if necessary
    if (version) {
@@ -549,6 +579,8 @@ void QoreModuleManager::loadModuleIntern(ExceptionSink& xsink, const char* name,
    //printd(5, "QoreModuleManager::loadModuleIntern() '%s' reexport: %d pgm: %p\n", name, reexport, pgm);
 
    ReferenceHolder<QoreProgram> pholder(mpgm, &xsink);
+   // modules are not preloaded in parallel while the module lock is held
+   ModuleLockCountHelper mlch;
 
    // check for special "qore" feature
    if (!strcmp(name, "qore")) {
@@ -675,19 +707,35 @@ void QoreModuleManager::loadModuleIntern(ExceptionSink& xsink, const char* name,
 	 mi = loadBinaryModuleFromPath(xsink, name, 0, pgm, reexport);
       }
       else {
-	 QoreString n(name);
-	 qore_offset_t i = n.rfind('.');
-	 if (i > 0)
-	    n.terminate(i);
-#ifdef _Q_WINDOWS
-	 i = n.rfindAny("\\/");
-#else
-	 i = n.rfind(QORE_DIR_SEP);
-#endif
-	 if (i >= 0)
-	    n.replace(0, i + 1, (const char*)0);
+	 QoreString n;
+	 get_user_module_feature(name, n);
+
+	 if (!mpgm && !load_opt) {
+	    // wait for the module if it's being parsed in a background thread
+	    waitPreloadUnlocked(n.getBuffer());
+
+	    // if the module has already been loaded from the same file (ex: by a module parsed in a background
+	    // thread), then use it
+	    mi = findModuleUnlocked(n.getBuffer());
+	    if (mi && mi->isUser()) {
+	       QoreProgram* p = pgm ? pgm : getProgram();
+	       QoreString path(name);
+	       q_normalize_path(path, p ? p->parseGetScriptDir() : 0);
+	       if (path == mi->getFileName()) {
+		  trySetUserModuleDependency(mi);
+		  qore_check_load_module_intern(mi, op, version, pgm, xsink);
+		  // make sure to add reexport info if the module should be reexported
+		  if (reexport && !xsink)
+		     ModuleReExportHelper mrh(mi, true);
+		  return;
+	       }
+	    }
+	    mi = 0;
+	 }
 
-	 mi = loadUserModuleFromPath(xsink, name, n.getBuffer(), pgm, reexport, pholder.release(), load_opt & QMLO_REINJECT ? mpgm : 0, load_opt);
+	 // use the module if it has been parsed in a background thread
+	 if (mpgm || load_opt || !loadPreloadedUserModule(xsink, name, n.getBuffer(), pgm, reexport, mi))
+	    mi = loadUserModuleFromPath(xsink, name, n.getBuffer(), pgm, reexport, pholder.release(), load_opt & QMLO_REINJECT ? mpgm : 0, load_opt);
       }
 
       if (xsink) {
@@ -702,6 +750,44 @@ void QoreModuleManager::loadModuleIntern(ExceptionSink& xsink, const char* name,
 
    // otherwise, try to find module in the module path
    QoreString str;
+   int rc = findModulePathUnlocked(name, str);
+   if (rc == 1) {
+      if (mpgm) {
+	 xsink.raiseException("LOAD-MODULE-ERROR", "cannot load a binary module with a Program container");
+	 return;
+      }
+
+      mi = loadBinaryModuleFromPath(xsink, str.getBuffer(), name, pgm, reexport);
+      if (xsink) {
+	 assert(!mi);
+	 return;
+      }
+
+      assert(mi);
+      qore_check_load_module_intern(mi, op, version, pgm, xsink);
+      return;
+   }
+
+   if (!rc) {
+      // use the module if it has been parsed in a background thread
+      if (mpgm || load_opt || !loadPreloadedUserModule(xsink, str.getBuffer(), name, pgm, reexport, mi))
+	 mi = loadUserModuleFromPath(xsink, str.getBuffer(), name, pgm, reexport, pholder.release(), load_opt & QMLO_REINJECT ? mpgm : 0, load_opt);
+      if (xsink) {
+	 assert(!mi);
+	 return;
+      }
+
+      assert(mi);
+      qore_check_load_module_intern(mi, op, version, pgm, xsink);
+      return;
+   }
+
+   QoreStringNode* desc = new QoreStringNodeMaker("feature '%s' is not builtin and no module with this name could be found in the module path: ", name);
+   moduleDirList.appendPath(*desc);
+   xsink.raiseExceptionArg("LOAD-MODULE-ERROR", new QoreStringNode(name), desc);
+}
+
+int QoreModuleManager::findModulePathUnlocked(const char* name, QoreString& str) {
    struct stat sb;
 
    strdeque_t::const_iterator w = moduleDirList.begin();
@@ -721,20 +807,7 @@ void QoreModuleManager::loadModuleIntern(ExceptionSink& xsink, const char* name,
 	 //printd(5, "ModuleManager::loadModule(%s) trying binary module: %s\n", name, str.getBuffer());
 	 if (!stat(str.getBuffer(), &sb)) {
 	    printd(5, "ModuleManager::loadModule(%s) found binary module: %s\n", name, str.getBuffer());
-	    if (mpgm) {
-	       xsink.raiseException("LOAD-MODULE-ERROR", "cannot load a binary module with a Program container");
-	       return;
-	    }
-
-	    mi = loadBinaryModuleFromPath(xsink, str.getBuffer(), name, pgm, reexport);
-	    if (xsink) {
-	       assert(!mi);
-	       return;
-	    }
-
-	    assert(mi);
-	    qore_check_load_module_intern(mi, op, version, pgm, xsink);
-	    return;
+	    return 1;
 	 }
 
 	 // build path to user module
@@ -748,24 +821,14 @@ void QoreModuleManager::loadModuleIntern(ExceptionSink& xsink, const char* name,
 	    if (!q_absolute_path(str.getBuffer()))
 	       q_normalize_path(str);
 	    printd(5, "ModuleManager::loadModule(%s) found user module: %s\n", name, str.getBuffer());
-	    mi = loadUserModuleFromPath(xsink, str.getBuffer(), name, pgm, reexport, pholder.release(), load_opt & QMLO_REINJECT ? mpgm : 0, load_opt);
-	    if (xsink) {
-	       assert(!mi);
-	       return;
-	    }
-
-	    assert(mi);
-	    qore_check_load_module_intern(mi, op, version, pgm, xsink);
-	    return;
+	    return 0;
 	 }
       }
 
       ++w;
    }
 
-   QoreStringNode* desc = new QoreStringNodeMaker("feature '%s' is not builtin and no module with this name could be found in the module path: ", name);
-   moduleDirList.appendPath(*desc);
-   xsink.raiseExceptionArg("LOAD-MODULE-ERROR", new QoreStringNode(name), desc);
+   return -1;
 }
 
 void ModuleManager::registerUserModuleFromSource(const char* name, const char* src, QoreProgram* pgm, ExceptionSink* xsink) {
@@ -786,6 +849,9 @@ QoreStringNode* ModuleManager::parseLoadModule(const char* name, QoreProgram* pg
 void QoreModuleManager::parseLoadModule(ExceptionSink& xsink, const char* name, QoreProgram* pgm, bool reexport) {
    //printd(5, "ModuleManager::parseLoadModule(name: %s, pgm: %p, reexport: %d)\n", name, pgm, reexport);
 
+   // load independent user modules in parallel; they are added to the Program in order below
+   parsePreloadModules(name, pgm);
+
    char* p = strchrs(name, "<>=");
    if (p) {
       QoreString str(name, p - name);
@@ -842,6 +908,357 @@ void QoreModuleManager::registerUserModuleFromSource(const char* name, const cha
    loadModuleIntern(xsink, name, pgm, false, MOD_OP_NONE, 0, src);
 }
 
+// a user module parsed in parallel before the %requires directive that loads it is executed; the module is set up
+// and its init closure is run when the %requires directive is executed
+struct QoreModulePreload {
+   // the module's feature name and path
+   std::string feature, path;
+   // the script directory of the Program requiring the module
+   std::string td;
+   // parse options for the module
+   int64 po;
+   // the parsed module
+   std::unique_ptr<QoreUserModule> mi;
+   // the module definition (tags and closures) taken from the parsing thread's context
+   QoreModuleDefContext mdc;
+   // errors raised while parsing the module
+   ExceptionSink xsink;
+
+   DLLLOCAL QoreModulePreload(const char* f, const char* p, const char* dir, int64 n_po) : feature(f), path(p), td(dir ? dir : ""), po(n_po) {
+   }
+
+   DLLLOCAL ~QoreModulePreload() {
+      // errors for modules that are never loaded are not reported
+      xsink.clear();
+   }
+};
+
+// moves the module definition from one context to another
+static void move_module_def(QoreModuleDefContext& to, QoreModuleDefContext& from) {
+   to.vmap.swap(from.vmap);
+   std::swap(to.init_c, from.init_c);
+   std::swap(to.del_c, from.del_c);
+}
+
+// reads the block of %requires directives starting with the given line of the given file, skipping blank lines and
+// comments; returns -1 if the line does not contain a %requires directive for the given module
+static int get_requires_block(const char* fn, int line, const char* name, name_vec_t& req) {
+   FILE* fp = fopen(fn, "r");
+   if (!fp)
+      return -1;
+   ON_BLOCK_EXIT(fclose, fp);
+
+   std::string ln;
+   char buf[1024];
+   for (int l = 1; ; ++l) {
+      ln.clear();
+      while (fgets(buf, sizeof(buf), fp)) {
+         ln += buf;
+         if (ln[ln.size() - 1] == '\n')
+            break;
+      }
+      if (ln.empty())
+         break;
+      if (l < line)
+         continue;
+
+      QoreString str(ln.c_str());
+      str.trim();
+      if (l > line && (str.empty() || *str.getBuffer() == '#'))
+         continue;
+      // parse directives must start at the beginning of the line
+      if (strncmp(ln.c_str(), "%requires", 9) || (!qore_isblank(ln[9]) && ln[9] != '('))
+         break;
+
+      str.replace(0, 9, (const char*)0);
+      str.trim();
+      // skip the reexport option
+      if (*str.getBuffer() == '(') {
+         qore_offset_t i = str.find(')');
+         if (i < 0)
+            break;
+         str.replace(0, i + 1, (const char*)0);
+         str.trim();
+      }
+      if (l == line && strcmp(str.getBuffer(), name))
+         return -1;
+      req.push_back(str.getBuffer());
+   }
+
+   return req.empty() ? -1 : 0;
+}
+
+// removes any version specification from the argument of a %requires directive
+static void strip_module_version(QoreString& str) {
+   char* p = strchrs(str.getBuffer(), "<>=");
+   if (p) {
+      str.terminate(p - str.getBuffer());
+      str.trim();
+   }
+}
+
+// reads the features required by the given module file; returns -1 if the file cannot be read or if it includes
+// other files or loads modules with %try-module, in which case the modules it loads cannot be determined
+static int get_module_requires(const char* fn, name_vec_t& req) {
+   FILE* fp = fopen(fn, "r");
+   if (!fp)
+      return -1;
+   ON_BLOCK_EXIT(fclose, fp);
+
+   std::string ln;
+   char buf[1024];
+   while (true) {
+      ln.clear();
+      while (fgets(buf, sizeof(buf), fp)) {
+         ln += buf;
+         if (ln[ln.size() - 1] == '\n')
+            break;
+      }
+      if (ln.empty())
+         break;
+
+      // parse directives must start at the beginning of the line
+      if (!strncmp(ln.c_str(), "%include", 8) || !strncmp(ln.c_str(), "%try-module", 11))
+         return -1;
+      if (strncmp(ln.c_str(), "%requires", 9) || (!qore_isblank(ln[9]) && ln[9] != '('))
+         continue;
+
+      QoreString str(ln.c_str() + 9);
+      str.trim();
+      // skip the reexport option
+      if (*str.getBuffer() == '(') {
+         qore_offset_t i = str.find(')');
+         if (i < 0)
+            return -1;
+         str.replace(0, i + 1, (const char*)0);
+         str.trim();
+      }
+      strip_module_version(str);
+      if (q_find_first_path_sep(str.getBuffer())) {
+         QoreString feature;
+         get_user_module_feature(str.getBuffer(), feature);
+         req.push_back(feature.getBuffer());
+      }
+      else
+         req.push_back(str.getBuffer());
+   }
+
+   return 0;
+}
+
+static void qmm_preload_thread(ExceptionSink* xsink, void* arg) {
+   QMM.preloadUserModule((QoreModulePreload*)arg, true);
+}
+
+void QoreModuleManager::parsePreloadModules(const char* name, QoreProgram* pgm) {
+   // modules are only preloaded for %requires directives in source files, and only if this thread does not hold
+   // the module lock, as preload threads need the lock to register the modules
+   if (!preload_max || !pgm || get_module_lock_count())
+      return;
+
+   QoreProgramLocation loc = get_parse_location();
+   name_vec_t req;
+   if (!loc.file || get_requires_block(loc.file, loc.start_line, name, req))
+      return;
+
+   // set the parse options as in loadUserModuleFromPath(); the Program's options cannot change in the block
+   int64 po = pgm->getParseOptions64();
+   if (po & PO_NO_MODULES)
+      return;
+   po = USER_MOD_PO | (po & ~(PO_FREE_OPTIONS|PO_REQUIRE_TYPES));
+   const char* td = pgm->parseGetScriptDir();
+
+   int tid = gettid();
+   // modules to be preloaded by this thread
+   std::vector<QoreModulePreload*> jobs;
+
+   {
+      AutoLocker al(mutex);
+      for (name_vec_t::iterator i = req.begin(), e = req.end(); i != e; ++i) {
+         // remove any version specification; versions are checked when the module is added to the Program
+         QoreString str(i->c_str());
+         strip_module_version(str);
+
+         QoreString path, feature;
+         if (q_find_first_path_sep(str.getBuffer())) {
+            if (str.size() > 5 && !strcasecmp(".qmod", str.getBuffer() + str.size() - 5))
+               continue;
+            path = str;
+            get_user_module_feature(str.getBuffer(), feature);
+         }
+         else {
+            // binary modules are not preloaded
+            if (findModulePathUnlocked(str.getBuffer(), path))
+               continue;
+            feature = str;
+         }
+
+         if (pgm->checkFeature(feature.getBuffer()) || findModuleUnlocked(feature.getBuffer())
+             || preload_map.find(feature.getBuffer()) != preload_map.end()
+             || preload_done.find(feature.getBuffer()) != preload_done.end())
+            continue;
+
+         // modules that load modules that have not been loaded yet are not preloaded, so that the initialization
+         // code of all modules runs in this thread in the order the modules are loaded by the %requires directives
+         {
+            QoreString fn(path);
+            q_normalize_path(fn, td);
+            name_vec_t mreq;
+            if (get_module_requires(fn.getBuffer(), mreq))
+               continue;
+            name_vec_t::iterator ri = mreq.begin(), re = mreq.end();
+            for (; ri != re; ++ri) {
+               if (*ri != "qore" && !pgm->checkFeature(ri->c_str()) && !findModuleUnlocked(ri->c_str()))
+                  break;
+            }
+            if (ri != re)
+               continue;
+         }
+
+         // the module is registered as being loaded by this thread until a preload thread starts
+         preload_map[feature.getBuffer()] = tid;
+         jobs.push_back(new QoreModulePreload(feature.getBuffer(), path.getBuffer(), td, po));
+      }
+   }
+
+   // start a thread for each module after the first, which is loaded in this thread, as long as the limit allows
+   std::vector<QoreModulePreload*> local;
+   for (unsigned i = 0; i < jobs.size(); ++i) {
+      if (i) {
+         {
+            AutoLocker al(mutex);
+            if (preload_threads < preload_max)
+               ++preload_threads;
+            else {
+               local.push_back(jobs[i]);
+               continue;
+            }
+         }
+         ExceptionSink xsink;
+         if (q_start_thread(&xsink, qmm_preload_thread, jobs[i]) != -1)
+            continue;
+         xsink.clear();
+         AutoLocker al(mutex);
+         --preload_threads;
+      }
+      local.push_back(jobs[i]);
+   }
+
+   // modules are waited for when they are loaded
+   for (unsigned i = 0; i < local.size(); ++i)
+      preloadUserModule(local[i], false);
+}
+
+void QoreModuleManager::waitPreloadUnlocked(const std::string& feature) {
+   int tid = gettid();
+   while (true) {
+      preload_map_t::iterator i = preload_map.find(feature);
+      if (i == preload_map.end())
+         return;
+
+      // do not wait if the thread loading the module is waiting for this thread, directly or indirectly; the
+      // module will then be loaded again in this thread
+      int owner = i->second;
+      for (unsigned n = 0; n <= preload_wait.size(); ++n) {
+         if (owner == tid)
+            return;
+         preload_wait_map_t::iterator wi = preload_wait.find(owner);
+         if (wi == preload_wait.end())
+            break;
+         preload_map_t::iterator pi = preload_map.find(wi->second);
+         if (pi == preload_map.end())
+            break;
+         owner = pi->second;
+      }
+
+      preload_wait[tid] = feature;
+      preload_cond.wait(mutex);
+      preload_wait.erase(tid);
+   }
+}
+
+void QoreModuleManager::preloadUserModule(QoreModulePreload* mp, bool thread) {
+   std::unique_ptr<QoreModulePreload> holder(mp);
+
+   {
+      AutoLocker al(mutex);
+      // the module may have been loaded by another thread in the meantime
+      if (findModuleUnlocked(mp->feature.c_str())) {
+         preload_map.erase(mp->feature);
+         if (thread)
+            --preload_threads;
+         preload_cond.broadcast();
+         return;
+      }
+      preload_map[mp->feature] = gettid();
+   }
+
+   printd(5, "QoreModuleManager::preloadUserModule() loading '%s' from '%s'\n", mp->feature.c_str(), mp->path.c_str());
+
+   ExceptionSink xsink;
+   QoreParseCountContextHelper pcch;
+   mp->mi.reset(new QoreUserModule(mp->td.empty() ? 0 : mp->td.c_str(), mp->path.c_str(), mp->feature.c_str(), new QoreProgram(mp->po), QMLO_NONE));
+   ModuleReExportHelper mrh(mp->mi.get(), false);
+   std::unique_ptr<QoreUserModuleDefContextHelper> qmd(new QoreUserModuleDefContextHelper(mp->feature.c_str(), xsink));
+
+   // the module is parsed without holding the module lock
+   mp->mi->getProgram()->parseFile(mp->mi->getFileName(), &xsink, &xsink, QP_WARN_MODULES);
+
+   AutoLocker al(mutex);
+   move_module_def(mp->mdc, *qmd);
+   qmd.reset();
+
+   preload_map.erase(mp->feature);
+   // the module is not used if it has been loaded by another thread in the meantime
+   if (!findModuleUnlocked(mp->feature.c_str())) {
+      // parse errors are raised when the module is loaded by the %requires directive
+      mp->xsink.assimilate(xsink);
+      preload_done[mp->feature] = holder.release();
+   }
+   else
+      xsink.clear();
+   if (thread)
+      --preload_threads;
+   preload_cond.broadcast();
+}
+
+bool QoreModuleManager::loadPreloadedUserModule(ExceptionSink& xsink, const char* path, const char* feature, QoreProgram* pgm, bool reexport, QoreAbstractModule*& mi) {
+   waitPreloadUnlocked(feature);
+
+   preload_done_map_t::iterator i = preload_done.find(feature);
+   if (i == preload_done.end())
+      return false;
+
+   // the module must have been parsed from the same file
+   QoreProgram* p = pgm ? pgm : getProgram();
+   QoreString npath(path);
+   q_normalize_path(npath, p ? p->parseGetScriptDir() : 0);
+   if (npath != i->second->mi->getFileName())
+      return false;
+
+   std::unique_ptr<QoreModulePreload> mp(i->second);
+   preload_done.erase(i);
+
+   // if errors have already been raised, the module is loaded normally, so that errors are reported as without
+   // parallel parsing
+   if (xsink)
+      return false;
+
+   printd(5, "QoreModuleManager::loadPreloadedUserModule() setting up '%s' from '%s'\n", feature, mp->mi->getFileName());
+
+   if (mp->xsink) {
+      xsink.assimilate(mp->xsink);
+      mi = 0;
+      return true;
+   }
+
+   ModuleReExportHelper mrh(mp->mi.get(), reexport);
+   QoreUserModuleDefContextHelper qmd(feature, xsink);
+   move_module_def(qmd, mp->mdc);
+   mi = setupUserModule(xsink, mp->mi, qmd);
+   return true;
+}
+
 // const char* path, const char* feature, ReferenceHolder<QoreProgram>& pgm
 QoreAbstractModule* QoreModuleManager::setupUserModule(ExceptionSink& xsink, std::unique_ptr<QoreUserModule>& mi, QoreUserModuleDefContextHelper& qmd, unsigned load_opt) {
    // see if a module with this name is already registered
@@ -1313,6 +1730,11 @@ void QoreModuleManager::delUser() {
 void QoreModuleManager::cleanup() {
    QORE_TRACE("ModuleManager::cleanup()");
 
+   // delete any preloaded modules that were never loaded
+   for (preload_done_map_t::iterator i = preload_done.begin(), e = preload_done.end(); i != e; ++i)
+      delete i->second;
+   preload_done.clear();
+
    module_map_t::iterator i;
    while ((i = map.begin()) != map.end()) {
       QoreAbstractModule* m = i->second;
@@ -0,0 +1,1576 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreBytecode.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include "qore/intern/QoreBytecode.h"
+#include "qore/intern/QoreObjectIntern.h"
+#include "qore/intern/QoreParseHashNode.h"
+#include "qore/intern/StatementBlock.h"
+#include "qore/intern/ExpressionStatement.h"
+#include "qore/intern/IfStatement.h"
+#include "qore/intern/WhileStatement.h"
+#include "qore/intern/DoWhileStatement.h"
+#include "qore/intern/ForStatement.h"
+#include "qore/intern/ForEachStatement.h"
+#include "qore/intern/ReturnStatement.h"
+#include "qore/intern/BreakStatement.h"
+#include "qore/intern/ContinueStatement.h"
+
+#include <map>
+#include <set>
+#include <memory>
+
+// number of registers allocated on the C++ stack; functions needing more registers allocate them on the heap
+#define QORE_BC_LOCAL_REGS 16
+
+// comparison operators in the order of the comparison opcodes
+enum bc_cmp_e {
+   BCC_LT = 0,
+   BCC_LE,
+   BCC_GT,
+   BCC_GE,
+   BCC_EQ,
+   BCC_NE
+};
+
+// the comparison with the opposite result for each comparison
+static const bc_cmp_e bc_cmp_inverse[] = { BCC_GE, BCC_GT, BCC_LE, BCC_LT, BCC_NE, BCC_EQ };
+
+// compiles a user function body to bytecode
+/* compilation fails as a whole if any statement or expression in the body is not supported; in this case
+   the function is executed by the tree-walking interpreter
+*/
+class QoreBytecodeCompiler {
+protected:
+   typedef std::vector<unsigned> reg_vec_t;
+   typedef std::map<const LocalVar*, unsigned> lvmap_t;
+   typedef std::set<const LocalVar*> lvset_t;
+
+   // the local variables of a block or statement
+   struct Scope {
+      std::vector<const LocalVar*> vars;
+      reg_vec_t regs;
+   };
+
+   // a loop being compiled; jumps for "break" and "continue" are patched when the loop has been compiled
+   struct Loop {
+      reg_vec_t breaks, continues;
+      // the number of open scopes when the loop body is entered
+      size_t depth;
+
+      DLLLOCAL Loop(size_t d) : depth(d) {
+      }
+   };
+
+   QoreBytecode& bc;
+   // maps local variables to registers
+   lvmap_t lvmap;
+   // local variables that will be stored in typed registers when their scope is opened
+   lvset_t typed;
+   // local variables in typed registers that have been assigned a value
+   lvset_t assigned;
+   // free registers for each register kind
+   reg_vec_t free_regs[4];
+   // registers holding intermediate values of the current statement
+   reg_vec_t temps;
+   std::vector<Scope> scopes;
+   std::vector<Loop> loops;
+   // the expression whose value is ignored in the current expression statement
+   const AbstractQoreNode* ignored;
+   // true once the parse options have been taken from the first statement
+   bool po_set;
+
+   DLLLOCAL static bc_kind_e getKind(const QoreTypeInfo* ti) {
+      if (ti == bigIntTypeInfo)
+         return BK_INT;
+      if (ti == floatTypeInfo)
+         return BK_FLOAT;
+      if (ti == boolTypeInfo)
+         return BK_BOOL;
+      return BK_VALUE;
+   }
+
+   // variables used in closures and reference variables must be stored in the thread-local variable stack
+   DLLLOCAL static bool supported(const LocalVar* lv) {
+      const QoreTypeInfo* ti = lv->getTypeInfo();
+      return !lv->closureUse() && ti != referenceTypeInfo && ti != referenceOrNothingTypeInfo;
+   }
+
+   DLLLOCAL static bool hasEffect(const AbstractQoreNode* n) {
+      return n && n->needs_eval() && node_has_effect(n);
+   }
+
+   DLLLOCAL unsigned char kind(unsigned r) const {
+      return bc.kinds[r];
+   }
+
+   DLLLOCAL unsigned pc() const {
+      return bc.code.size();
+   }
+
+   DLLLOCAL QoreBytecodeInstr& emit(bc_op_e op, unsigned a = 0, unsigned b = 0, unsigned c = 0) {
+      QoreBytecodeInstr i;
+      i.op = op;
+      i.a = a;
+      i.b = b;
+      i.c = c;
+      i.x.i = 0;
+      bc.code.push_back(i);
+      return bc.code.back();
+   }
+
+   // sets the target of all given jumps
+   DLLLOCAL void patch(const reg_vec_t& jumps, unsigned target) {
+      for (reg_vec_t::const_iterator i = jumps.begin(), e = jumps.end(); i != e; ++i)
+         bc.code[*i].b = target;
+   }
+
+   DLLLOCAL unsigned newReg(unsigned char k) {
+      reg_vec_t& fr = free_regs[k];
+      if (!fr.empty()) {
+         unsigned r = fr.back();
+         fr.pop_back();
+         return r;
+      }
+      bc.kinds.push_back(k);
+      return bc.kinds.size() - 1;
+   }
+
+   DLLLOCAL unsigned temp(unsigned char k) {
+      unsigned r = newReg(k);
+      temps.push_back(r);
+      return r;
+   }
+
+   DLLLOCAL bool isTemp(unsigned r) const {
+      for (reg_vec_t::const_iterator i = temps.begin(), e = temps.end(); i != e; ++i)
+         if (*i == r)
+            return true;
+      return false;
+   }
+
+   // returns true if any value temporary registers have been allocated since the given mark
+   DLLLOCAL bool hasValueTemps(unsigned mark) const {
+      for (size_t i = mark; i < temps.size(); ++i)
+         if (kind(temps[i]) == BK_VALUE)
+            return true;
+      return false;
+   }
+
+   // releases all temporary registers allocated since the given mark; value registers are cleared
+   DLLLOCAL void releaseTemps(unsigned mark) {
+      while (temps.size() > mark) {
+         unsigned r = temps.back();
+         temps.pop_back();
+         if (kind(r) == BK_VALUE)
+            emit(BC_CLEAR, r);
+         free_regs[kind(r)].push_back(r);
+      }
+   }
+
+   // returns the destination register if it has the given kind, otherwise a new temporary register
+   DLLLOCAL unsigned target(int dst, unsigned char k) {
+      return dst >= 0 && kind(dst) == k ? (unsigned)dst : temp(k);
+   }
+
+   // copies the given register to a temporary register if it is not already one
+   DLLLOCAL unsigned copy(unsigned r) {
+      if (isTemp(r))
+         return r;
+      unsigned t = temp(kind(r));
+      emit(kind(r) == BK_VALUE ? BC_MOV : BC_MOVN, t, r);
+      return t;
+   }
+
+   DLLLOCAL int openScope(const LVList* lvars) {
+      scopes.push_back(Scope());
+      if (!lvars)
+         return 0;
+
+      Scope& s = scopes.back();
+      for (LVList::lv_vec_t::const_iterator i = lvars->lv.begin(), e = lvars->lv.end(); i != e; ++i) {
+         const LocalVar* lv = *i;
+         if (!supported(lv))
+            return -1;
+         unsigned r = newReg(typed.find(lv) != typed.end() ? getKind(lv->getTypeInfo()) : BK_VALUE);
+         lvmap[lv] = r;
+         s.vars.push_back(lv);
+         s.regs.push_back(r);
+      }
+      return 0;
+   }
+
+   // emits code to clear the value registers of the given scope
+   DLLLOCAL void clearScope(const Scope& s) {
+      for (size_t i = s.regs.size(); i; --i)
+         if (kind(s.regs[i - 1]) == BK_VALUE)
+            emit(BC_CLEAR, s.regs[i - 1]);
+   }
+
+   DLLLOCAL void closeScope() {
+      Scope& s = scopes.back();
+      clearScope(s);
+      for (size_t i = 0; i < s.vars.size(); ++i) {
+         lvmap.erase(s.vars[i]);
+         assigned.erase(s.vars[i]);
+         typed.erase(s.vars[i]);
+         free_regs[kind(s.regs[i])].push_back(s.regs[i]);
+      }
+      scopes.pop_back();
+   }
+
+   // marks the local variable declared by the given expression for a typed register if it has a typed register kind
+   DLLLOCAL void markTypedDecl(const AbstractQoreNode* n) {
+      const QoreAssignmentOperatorNode* a = dynamic_cast<const QoreAssignmentOperatorNode*>(n);
+      if (!a || get_node_type(a->getLeft()) != NT_VARREF)
+         return;
+      const VarRefNode* v = reinterpret_cast<const VarRefNode*>(a->getLeft());
+      if (v->isDecl() && v->getType() == VT_LOCAL && getKind(v->ref.id->getTypeInfo()) != BK_VALUE)
+         typed.insert(v->ref.id);
+   }
+
+   // finds the register of a local variable
+   DLLLOCAL int local(const AbstractQoreNode* n, unsigned& r, const LocalVar*& lv) const {
+      if (get_node_type(n) != NT_VARREF)
+         return -1;
+      const VarRefNode* v = reinterpret_cast<const VarRefNode*>(n);
+      if (v->getType() != VT_LOCAL || dynamic_cast<const VarRefNewObjectNode*>(v) || dynamic_cast<const VarRefTryModuleErrorNode*>(v))
+         return -1;
+      lvmap_t::const_iterator i = lvmap.find(v->ref.id);
+      if (i == lvmap.end())
+         return -1;
+      r = i->second;
+      lv = i->first;
+      return 0;
+   }
+
+   DLLLOCAL int readLocal(const AbstractQoreNode* n, unsigned& r) const {
+      const LocalVar* lv;
+      if (local(n, r, lv))
+         return -1;
+      // typed registers cannot be read before they have been assigned
+      return kind(r) != BK_VALUE && assigned.find(lv) == assigned.end() ? -1 : 0;
+   }
+
+   // compiles both operands of a binary operator
+   DLLLOCAL int operands(const AbstractQoreNode* l, const AbstractQoreNode* r, unsigned& lr, unsigned& rr) {
+      if (expr(l, lr))
+         return -1;
+      // the right operand could change a local variable used as the left operand
+      if (hasEffect(r))
+         lr = copy(lr);
+      return expr(r, rr);
+   }
+
+   // converts an int register to a float register
+   DLLLOCAL unsigned toFloat(unsigned r) {
+      if (kind(r) == BK_FLOAT)
+         return r;
+      unsigned t = temp(BK_FLOAT);
+      emit(BC_I2F, t, r);
+      return t;
+   }
+
+   DLLLOCAL static bool isNumeric(unsigned char k) {
+      return k == BK_INT || k == BK_FLOAT;
+   }
+
+   // compiles an arithmetic operator with the given typed and generic opcodes
+   DLLLOCAL int arith(const AbstractQoreNode* l, const AbstractQoreNode* rn, unsigned& r, int dst, bc_op_e op_ii, bc_op_e op_ik, bc_op_e op_ff, bc_op_e op_vv) {
+      unsigned lr, rr;
+      if (expr(l, lr))
+         return -1;
+      if (op_ik != op_ii && kind(lr) == BK_INT && get_node_type(rn) == NT_INT) {
+         r = target(dst, BK_INT);
+         emit(op_ik, r, lr).x.i = reinterpret_cast<const QoreBigIntNode*>(rn)->val;
+         return 0;
+      }
+      if (hasEffect(rn))
+         lr = copy(lr);
+      if (expr(rn, rr))
+         return -1;
+      unsigned char lk = kind(lr), rk = kind(rr);
+      if (lk == BK_INT && rk == BK_INT) {
+         r = target(dst, BK_INT);
+         emit(op_ii, r, lr, rr);
+      }
+      else if (isNumeric(lk) && isNumeric(rk)) {
+         lr = toFloat(lr);
+         rr = toFloat(rr);
+         r = target(dst, BK_FLOAT);
+         emit(op_ff, r, lr, rr);
+      }
+      else {
+         r = target(dst, BK_VALUE);
+         emit(op_vv, r, lr, rr);
+      }
+      return 0;
+   }
+
+   // returns the comparison operator for the given node or -1 if it is not a comparison
+   DLLLOCAL static int getComparison(const AbstractQoreNode* n) {
+      if (dynamic_cast<const QoreLogicalLessThanOperatorNode*>(n))
+         return BCC_LT;
+      if (dynamic_cast<const QoreLogicalLessThanOrEqualsOperatorNode*>(n))
+         return BCC_LE;
+      if (dynamic_cast<const QoreLogicalGreaterThanOperatorNode*>(n))
+         return BCC_GT;
+      if (dynamic_cast<const QoreLogicalGreaterThanOrEqualsOperatorNode*>(n))
+         return BCC_GE;
+      if (dynamic_cast<const QoreLogicalNotEqualsOperatorNode*>(n))
+         return BCC_NE;
+      if (dynamic_cast<const QoreLogicalEqualsOperatorNode*>(n))
+         return BCC_EQ;
+      return -1;
+   }
+
+   // compiles a comparison to a bool register
+   DLLLOCAL int compare(int cmp, const QoreBinaryOperatorNode<>* o, unsigned& r, int dst) {
+      unsigned lr, rr;
+      if (operands(o->getLeft(), o->getRight(), lr, rr))
+         return -1;
+      unsigned char lk = kind(lr), rk = kind(rr);
+      if (lk == BK_INT && rk == BK_INT) {
+         r = target(dst, BK_BOOL);
+         emit((bc_op_e)(BC_LT_II + cmp), r, lr, rr);
+      }
+      else if (isNumeric(lk) && isNumeric(rk)) {
+         lr = toFloat(lr);
+         rr = toFloat(rr);
+         r = target(dst, BK_BOOL);
+         emit((bc_op_e)(BC_LT_FF + cmp), r, lr, rr);
+      }
+      else {
+         r = target(dst, BK_BOOL);
+         emit((bc_op_e)(BC_LT_VV + cmp), r, lr, rr);
+      }
+      return 0;
+   }
+
+   // emits code that jumps if the given expression evaluates to jump_if; the jumps are added to the given list
+   DLLLOCAL int cond(const AbstractQoreNode* n, bool jump_if, reg_vec_t& jumps) {
+      if (get_node_type(n) == NT_OPERATOR) {
+         const QoreLogicalNotOperatorNode* no = dynamic_cast<const QoreLogicalNotOperatorNode*>(n);
+         if (no)
+            return cond(no->getExp(), !jump_if, jumps);
+
+         // "or" is a subclass of "and" and must be checked first
+         const QoreLogicalOrOperatorNode* oo = dynamic_cast<const QoreLogicalOrOperatorNode*>(n);
+         const QoreLogicalAndOperatorNode* ao = oo ? 0 : dynamic_cast<const QoreLogicalAndOperatorNode*>(n);
+         if (oo || ao) {
+            const QoreLogicalAndOperatorNode* o = oo ? oo : ao;
+            // the value that decides the result without evaluating the right operand
+            bool shortcut = (bool)oo;
+            if (jump_if == shortcut)
+               return cond(o->getLeft(), shortcut, jumps) || cond(o->getRight(), shortcut, jumps) ? -1 : 0;
+            reg_vec_t skip;
+            if (cond(o->getLeft(), shortcut, skip) || cond(o->getRight(), jump_if, jumps))
+               return -1;
+            patch(skip, pc());
+            return 0;
+         }
+
+         int cmp = getComparison(n);
+         if (cmp >= 0) {
+            const QoreBinaryOperatorNode<>* o = reinterpret_cast<const QoreBinaryOperatorNode<>*>(n);
+            if (!jump_if)
+               cmp = bc_cmp_inverse[cmp];
+            unsigned mark = temps.size();
+            unsigned lr, rr;
+            if (expr(o->getLeft(), lr))
+               return -1;
+            if (kind(lr) == BK_INT && get_node_type(o->getRight()) == NT_INT) {
+               releaseTemps(mark);
+               jumps.push_back(pc());
+               emit((bc_op_e)(BC_JLT_IK + cmp), lr).x.i = reinterpret_cast<const QoreBigIntNode*>(o->getRight())->val;
+               return 0;
+            }
+            if (hasEffect(o->getRight()))
+               lr = copy(lr);
+            if (expr(o->getRight(), rr))
+               return -1;
+            if (kind(lr) == BK_INT && kind(rr) == BK_INT) {
+               releaseTemps(mark);
+               jumps.push_back(pc());
+               emit((bc_op_e)(BC_JLT_II + cmp), lr, 0, rr);
+               return 0;
+            }
+            // restore the original comparison for the generic case below
+            if (!jump_if)
+               cmp = bc_cmp_inverse[cmp];
+            unsigned char lk = kind(lr), rk = kind(rr);
+            unsigned t = temp(BK_BOOL);
+            if (isNumeric(lk) && isNumeric(rk)) {
+               lr = toFloat(lr);
+               rr = toFloat(rr);
+               emit((bc_op_e)(BC_LT_FF + cmp), t, lr, rr);
+            }
+            else
+               emit((bc_op_e)(BC_LT_VV + cmp), t, lr, rr);
+            releaseTemps(mark);
+            jumps.push_back(pc());
+            emit(jump_if ? BC_JT : BC_JF, t);
+            return 0;
+         }
+      }
+
+      unsigned mark = temps.size();
+      unsigned r;
+      if (expr(n, r))
+         return -1;
+      bc_op_e op;
+      if (kind(r) == BK_BOOL)
+         op = jump_if ? BC_JT : BC_JF;
+      else if (hasValueTemps(mark)) {
+         // value temporaries are cleared before the jump, so the result is converted first
+         unsigned t = temp(BK_BOOL);
+         emit(BC_TOBOOL, t, r);
+         r = t;
+         op = jump_if ? BC_JT : BC_JF;
+      }
+      else
+         op = jump_if ? BC_JTV : BC_JFV;
+      releaseTemps(mark);
+      jumps.push_back(pc());
+      emit(op, r);
+      return 0;
+   }
+
+   // compiles a boolean expression to a bool register
+   DLLLOCAL int boolValue(const AbstractQoreNode* n, unsigned& r, int dst) {
+      r = target(dst, BK_BOOL);
+      reg_vec_t f;
+      if (cond(n, false, f))
+         return -1;
+      emit(BC_LOADB, r).x.i = 1;
+      unsigned j = pc();
+      emit(BC_JMP);
+      patch(f, pc());
+      emit(BC_LOADB, r).x.i = 0;
+      bc.code[j].b = pc();
+      return 0;
+   }
+
+   // compiles the given expressions in order and adds their registers to the argument table
+   /* values of local variables are copied if a later expression has side effects
+    */
+   DLLLOCAL int values(const std::vector<const AbstractQoreNode*>& nodes, unsigned& off) {
+      unsigned last_effect = 0;
+      for (unsigned i = 0; i < nodes.size(); ++i)
+         if (hasEffect(nodes[i]))
+            last_effect = i;
+
+      reg_vec_t regs;
+      for (unsigned i = 0; i < nodes.size(); ++i) {
+         unsigned vr;
+         if (expr(nodes[i], vr))
+            return -1;
+         if (i < last_effect)
+            vr = copy(vr);
+         regs.push_back(vr);
+      }
+
+      off = bc.args.size();
+      bc.args.insert(bc.args.end(), regs.begin(), regs.end());
+      return 0;
+   }
+
+   DLLLOCAL static void listValues(const QoreListNode* l, std::vector<const AbstractQoreNode*>& nodes) {
+      for (unsigned i = 0, e = l ? l->size() : 0; i < e; ++i)
+         nodes.push_back(l->retrieve_entry(i));
+   }
+
+   DLLLOCAL int call(const FunctionCallNode* fc, unsigned& r, int dst) {
+      if (!fc->getFunction())
+         return -1;
+
+      std::vector<const AbstractQoreNode*> nodes;
+      listValues(fc->getArgs(), nodes);
+      unsigned off;
+      if (values(nodes, off))
+         return -1;
+      r = target(dst, BK_VALUE);
+      emit(BC_CALL, r, off, nodes.size()).x.p = fc;
+      return 0;
+   }
+
+   DLLLOCAL int list(const QoreListNode* l, unsigned& r, int dst) {
+      std::vector<const AbstractQoreNode*> nodes;
+      listValues(l, nodes);
+      unsigned off;
+      if (values(nodes, off))
+         return -1;
+      r = target(dst, BK_VALUE);
+      emit(BC_LIST, r, off, nodes.size());
+      return 0;
+   }
+
+   // keys and values are evaluated in pairs in the order given
+   DLLLOCAL int hash(const QoreParseHashNode* h, unsigned& r, int dst) {
+      std::vector<const AbstractQoreNode*> nodes;
+      for (size_t i = 0; i < h->keys.size(); ++i) {
+         nodes.push_back(h->keys[i]);
+         nodes.push_back(h->values[i]);
+      }
+      unsigned off;
+      if (values(nodes, off))
+         return -1;
+      r = target(dst, BK_VALUE);
+      emit(BC_HASH, r, off, h->keys.size());
+      return 0;
+   }
+
+   DLLLOCAL int assign(const AbstractQoreNode* l, const AbstractQoreNode* rn, unsigned& r) {
+      if (get_node_type(l) == NT_VARREF) {
+         unsigned lr;
+         const LocalVar* lv;
+         if (local(l, lr, lv))
+            return -1;
+         unsigned char k = kind(lr);
+         const QoreTypeInfo* ti = lv->getTypeInfo();
+         unsigned rr;
+         if (k != BK_VALUE) {
+            if (expr(rn, rr, lr))
+               return -1;
+            if (rr != lr) {
+               if (kind(rr) == k)
+                  emit(BC_MOVN, lr, rr);
+               else
+                  emit(k == BK_INT ? BC_ASSIGN_I : (k == BK_FLOAT ? BC_ASSIGN_F : BC_ASSIGN_B), lr, rr).x.p = ti;
+            }
+            assigned.insert(lv);
+         }
+         else {
+            // values can only be written directly to the variable if no type check is necessary
+            bool check = ti->hasType();
+            if (expr(rn, rr, check ? -1 : (int)lr))
+               return -1;
+            if (rr != lr)
+               emit(BC_ASSIGN, lr, rr, isTemp(rr) && kind(rr) == BK_VALUE).x.p = check ? ti : 0;
+         }
+         r = lr;
+         return 0;
+      }
+
+      // hash element assignment to a local hash variable
+      const QoreHashObjectDereferenceOperatorNode* ho = dynamic_cast<const QoreHashObjectDereferenceOperatorNode*>(l);
+      if (ho) {
+         unsigned hr;
+         const LocalVar* lv;
+         if (local(ho->getLeft(), hr, lv) || kind(hr) != BK_VALUE)
+            return -1;
+         const QoreTypeInfo* ti = lv->getTypeInfo();
+         if (ti != hashTypeInfo && ti != hashOrNothingTypeInfo)
+            return -1;
+         // the value is evaluated before the key as with the tree-walking interpreter
+         unsigned vr, kr;
+         if (expr(rn, vr))
+            return -1;
+         if (hasEffect(ho->getRight()))
+            vr = copy(vr);
+         if (expr(ho->getRight(), kr))
+            return -1;
+         emit(BC_HSET, hr, kr, vr);
+         r = vr;
+         return 0;
+      }
+
+      return -1;
+   }
+
+   DLLLOCAL int incDec(const AbstractQoreNode* n, bool inc, bool pre, unsigned& r, bool ign) {
+      unsigned lr;
+      if (readLocal(n, lr) || kind(lr) != BK_INT)
+         return -1;
+      if (!pre && !ign) {
+         r = temp(BK_INT);
+         emit(BC_MOVN, r, lr);
+      }
+      else
+         r = lr;
+      emit(inc ? BC_INC_I : BC_DEC_I, lr);
+      return 0;
+   }
+
+   DLLLOCAL int plusMinusEquals(const AbstractQoreNode* l, const AbstractQoreNode* rn, bool plus, unsigned& r) {
+      unsigned lr;
+      if (readLocal(l, lr))
+         return -1;
+      unsigned char k = kind(lr);
+      if (k == BK_INT) {
+         if (get_node_type(rn) == NT_INT) {
+            emit(plus ? BC_ADD_IK : BC_SUB_IK, lr, lr).x.i = reinterpret_cast<const QoreBigIntNode*>(rn)->val;
+            r = lr;
+            return 0;
+         }
+         unsigned rr;
+         if (expr(rn, rr))
+            return -1;
+         if (kind(rr) != BK_INT) {
+            unsigned t = temp(BK_INT);
+            emit(BC_TOINT, t, rr);
+            rr = t;
+         }
+         emit(plus ? BC_ADD_II : BC_SUB_II, lr, lr, rr);
+      }
+      else if (k == BK_FLOAT) {
+         unsigned rr;
+         if (expr(rn, rr))
+            return -1;
+         if (kind(rr) != BK_FLOAT) {
+            unsigned t = temp(BK_FLOAT);
+            emit(BC_TOFLOAT, t, rr);
+            rr = t;
+         }
+         emit(plus ? BC_ADD_FF : BC_SUB_FF, lr, lr, rr);
+      }
+      else {
+         const LocalVar* lv;
+         local(l, lr, lv);
+         const QoreTypeInfo* ti = lv->getTypeInfo();
+         if (!plus || (ti != stringTypeInfo && ti != stringOrNothingTypeInfo && ti != listTypeInfo
+                       && ti != listOrNothingTypeInfo && ti != hashTypeInfo && ti != hashOrNothingTypeInfo))
+            return -1;
+         unsigned rr;
+         if (expr(rn, rr))
+            return -1;
+         emit(BC_PLUSEQ_V, lr, rr).x.p = ti;
+      }
+      r = lr;
+      return 0;
+   }
+
+   DLLLOCAL int op(const AbstractQoreNode* n, unsigned& r, int dst) {
+      if (get_node_type(n) != NT_OPERATOR)
+         return -1;
+
+      {
+         const QoreAssignmentOperatorNode* o = dynamic_cast<const QoreAssignmentOperatorNode*>(n);
+         if (o)
+            return assign(o->getLeft(), o->getRight(), r);
+      }
+      // decrement operators are subclasses of the increment operators and must be checked first
+      {
+         const QorePreDecrementOperatorNode* o = dynamic_cast<const QorePreDecrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), false, true, r, false);
+      }
+      {
+         const QorePreIncrementOperatorNode* o = dynamic_cast<const QorePreIncrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), true, true, r, false);
+      }
+      {
+         const QoreIntPostDecrementOperatorNode* o = dynamic_cast<const QoreIntPostDecrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), false, false, r, n == ignored);
+      }
+      {
+         const QoreIntPostIncrementOperatorNode* o = dynamic_cast<const QoreIntPostIncrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), true, false, r, n == ignored);
+      }
+      {
+         const QorePostDecrementOperatorNode* o = dynamic_cast<const QorePostDecrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), false, false, r, n == ignored);
+      }
+      {
+         const QorePostIncrementOperatorNode* o = dynamic_cast<const QorePostIncrementOperatorNode*>(n);
+         if (o)
+            return incDec(o->getExp(), true, false, r, n == ignored);
+      }
+      {
+         const QorePlusEqualsOperatorNode* o = dynamic_cast<const QorePlusEqualsOperatorNode*>(n);
+         if (o)
+            return plusMinusEquals(o->getLeft(), o->getRight(), true, r);
+      }
+      {
+         const QoreMinusEqualsOperatorNode* o = dynamic_cast<const QoreMinusEqualsOperatorNode*>(n);
+         if (o)
+            return plusMinusEquals(o->getLeft(), o->getRight(), false, r);
+      }
+
+      if (dynamic_cast<const QoreLogicalNotOperatorNode*>(n) || dynamic_cast<const QoreLogicalAndOperatorNode*>(n))
+         return boolValue(n, r, dst);
+
+      {
+         int cmp = getComparison(n);
+         if (cmp >= 0)
+            return compare(cmp, reinterpret_cast<const QoreBinaryOperatorNode<>*>(n), r, dst);
+      }
+      {
+         // "!==" is a subclass of "===" and must be checked first
+         const QoreLogicalAbsoluteNotEqualsOperatorNode* ne = dynamic_cast<const QoreLogicalAbsoluteNotEqualsOperatorNode*>(n);
+         const QoreLogicalAbsoluteEqualsOperatorNode* o = ne ? ne : dynamic_cast<const QoreLogicalAbsoluteEqualsOperatorNode*>(n);
+         if (o) {
+            unsigned lr, rr;
+            if (operands(o->getLeft(), o->getRight(), lr, rr))
+               return -1;
+            r = target(dst, BK_BOOL);
+            // values of the same typed kind are equal if their values are equal
+            if (kind(lr) == BK_INT && kind(rr) == BK_INT)
+               emit(ne ? BC_NE_II : BC_EQ_II, r, lr, rr);
+            else if (kind(lr) == BK_FLOAT && kind(rr) == BK_FLOAT)
+               emit(ne ? BC_NE_FF : BC_EQ_FF, r, lr, rr);
+            else
+               emit(ne ? BC_ANE_VV : BC_AEQ_VV, r, lr, rr);
+            return 0;
+         }
+      }
+      {
+         const QorePlusOperatorNode* o = dynamic_cast<const QorePlusOperatorNode*>(n);
+         if (o)
+            return arith(o->getLeft(), o->getRight(), r, dst, BC_ADD_II, BC_ADD_IK, BC_ADD_FF, BC_ADD_VV);
+      }
+      {
+         const QoreMinusOperatorNode* o = dynamic_cast<const QoreMinusOperatorNode*>(n);
+         if (o)
+            return arith(o->getLeft(), o->getRight(), r, dst, BC_SUB_II, BC_SUB_IK, BC_SUB_FF, BC_SUB_VV);
+      }
+      {
+         const QoreMultiplicationOperatorNode* o = dynamic_cast<const QoreMultiplicationOperatorNode*>(n);
+         if (o)
+            return arith(o->getLeft(), o->getRight(), r, dst, BC_MUL_II, BC_MUL_IK, BC_MUL_FF, BC_MUL_VV);
+      }
+      {
+         const QoreDivisionOperatorNode* o = dynamic_cast<const QoreDivisionOperatorNode*>(n);
+         if (o)
+            return arith(o->getLeft(), o->getRight(), r, dst, BC_DIV_II, BC_DIV_II, BC_DIV_FF, BC_DIV_VV);
+      }
+      {
+         const QoreModuloOperatorNode* o = dynamic_cast<const QoreModuloOperatorNode*>(n);
+         if (o) {
+            unsigned lr, rr;
+            if (operands(o->getLeft(), o->getRight(), lr, rr))
+               return -1;
+            if (kind(lr) != BK_INT) {
+               unsigned t = temp(BK_INT);
+               emit(BC_TOINT, t, lr);
+               lr = t;
+            }
+            if (kind(rr) != BK_INT) {
+               unsigned t = temp(BK_INT);
+               emit(BC_TOINT, t, rr);
+               rr = t;
+            }
+            r = target(dst, BK_INT);
+            emit(BC_MOD_II, r, lr, rr);
+            return 0;
+         }
+      }
+      {
+         const QoreUnaryMinusOperatorNode* o = dynamic_cast<const QoreUnaryMinusOperatorNode*>(n);
+         if (o) {
+            unsigned er;
+            if (expr(o->getExp(), er) || !isNumeric(kind(er)))
+               return -1;
+            r = target(dst, kind(er));
+            emit(kind(er) == BK_INT ? BC_NEG_I : BC_NEG_F, r, er);
+            return 0;
+         }
+      }
+      {
+         const QoreQuestionMarkOperatorNode* o = dynamic_cast<const QoreQuestionMarkOperatorNode*>(n);
+         if (o) {
+            QoreQuestionMarkOperatorNode* qo = const_cast<QoreQuestionMarkOperatorNode*>(o);
+            r = temp(BK_VALUE);
+            reg_vec_t f;
+            if (cond(qo->get(0), false, f))
+               return -1;
+            for (unsigned i = 1; i < 3; ++i) {
+               unsigned mark = temps.size(), er;
+               if (expr(qo->get(i), er))
+                  return -1;
+               emit(BC_MOV, r, er);
+               releaseTemps(mark);
+               if (i == 1) {
+                  unsigned j = pc();
+                  emit(BC_JMP);
+                  patch(f, pc());
+                  f.clear();
+                  f.push_back(j);
+               }
+            }
+            patch(f, pc());
+            return 0;
+         }
+      }
+      {
+         const QoreSquareBracketsOperatorNode* o = dynamic_cast<const QoreSquareBracketsOperatorNode*>(n);
+         if (o) {
+            unsigned lr, rr;
+            if (operands(o->getLeft(), o->getRight(), lr, rr))
+               return -1;
+            r = target(dst, BK_VALUE);
+            emit(BC_SQB, r, lr, rr);
+            return 0;
+         }
+      }
+      {
+         const QoreHashObjectDereferenceOperatorNode* o = dynamic_cast<const QoreHashObjectDereferenceOperatorNode*>(n);
+         if (o) {
+            unsigned lr, rr;
+            if (operands(o->getLeft(), o->getRight(), lr, rr))
+               return -1;
+            r = target(dst, BK_VALUE);
+            emit(BC_HGET, r, lr, rr);
+            return 0;
+         }
+      }
+      {
+         const QoreElementsOperatorNode* o = dynamic_cast<const QoreElementsOperatorNode*>(n);
+         if (o) {
+            unsigned er;
+            if (expr(o->getExp(), er))
+               return -1;
+            r = target(dst, BK_INT);
+            emit(BC_ELEMENTS, r, er);
+            return 0;
+         }
+      }
+
+      return -1;
+   }
+
+   // compiles an expression; the result is in register r, which may be a local variable register
+   /* if dst is not negative, the result is written to register dst if possible
+    */
+   DLLLOCAL int expr(const AbstractQoreNode* n, unsigned& r, int dst = -1) {
+      switch (get_node_type(n)) {
+         case NT_NOTHING:
+            r = temp(BK_VALUE);
+            emit(BC_CLEAR, r);
+            return 0;
+         case NT_INT:
+            r = target(dst, BK_INT);
+            emit(BC_LOADI, r).x.i = reinterpret_cast<const QoreBigIntNode*>(n)->val;
+            return 0;
+         case NT_FLOAT:
+            r = target(dst, BK_FLOAT);
+            emit(BC_LOADF, r).x.f = reinterpret_cast<const QoreFloatNode*>(n)->f;
+            return 0;
+         case NT_BOOLEAN:
+            r = target(dst, BK_BOOL);
+            emit(BC_LOADB, r).x.i = reinterpret_cast<const QoreBoolNode*>(n)->getValue();
+            return 0;
+         case NT_VARREF:
+            return readLocal(n, r);
+         case NT_FUNCTION_CALL: {
+            const FunctionCallNode* fc = dynamic_cast<const FunctionCallNode*>(n);
+            return fc ? call(fc, r, dst) : -1;
+         }
+         case NT_LIST:
+            if (n->needs_eval())
+               return list(reinterpret_cast<const QoreListNode*>(n), r, dst);
+            break;
+         case NT_PARSE_HASH:
+            return hash(reinterpret_cast<const QoreParseHashNode*>(n), r, dst);
+      }
+
+      if (!n->needs_eval()) {
+         r = target(dst, BK_VALUE);
+         emit(BC_LOADK, r).x.p = n;
+         return 0;
+      }
+
+      return op(n, r, dst);
+   }
+
+   // compiles an expression whose value is not used
+   DLLLOCAL int exprIgnored(const AbstractQoreNode* n) {
+      unsigned mark = temps.size(), r;
+      ignored = n;
+      int rc = expr(n, r);
+      ignored = 0;
+      releaseTemps(mark);
+      return rc;
+   }
+
+   DLLLOCAL int block(StatementBlock* b) {
+      if (!b->on_block_exit_list.empty())
+         return -1;
+
+      for (StatementBlock::statement_list_t::iterator i = b->statement_list.begin(), e = b->statement_list.end(); i != e; ++i) {
+         ExpressionStatement* es = dynamic_cast<ExpressionStatement*>(*i);
+         if (es && es->exp)
+            markTypedDecl(es->exp);
+      }
+
+      if (openScope(b->lvars))
+         return -1;
+      for (StatementBlock::statement_list_t::iterator i = b->statement_list.begin(), e = b->statement_list.end(); i != e; ++i) {
+         if (stmt(*i))
+            return -1;
+      }
+      closeScope();
+      return 0;
+   }
+
+   // compiles a loop body; jumps for "continue" are patched to the given target
+   DLLLOCAL int loopBody(StatementBlock* code) {
+      loops.push_back(Loop(scopes.size()));
+      return code ? block(code) : 0;
+   }
+
+   DLLLOCAL void loopEnd(unsigned cont, unsigned end) {
+      patch(loops.back().continues, cont);
+      patch(loops.back().breaks, end);
+      loops.pop_back();
+   }
+
+   DLLLOCAL int loopJump(bool brk) {
+      if (loops.empty())
+         return -1;
+      Loop& l = loops.back();
+      for (size_t i = scopes.size(); i > l.depth; --i)
+         clearScope(scopes[i - 1]);
+      (brk ? l.breaks : l.continues).push_back(pc());
+      emit(BC_JMP);
+      return 0;
+   }
+
+   DLLLOCAL int stmt(AbstractStatement* s) {
+      // one set of parse options is applied to the entire function
+      if (!po_set) {
+         bc.po = s->pwo.parse_options;
+         po_set = true;
+      }
+      else if (s->pwo.parse_options != bc.po)
+         return -1;
+
+      StatementBlock* b = dynamic_cast<StatementBlock*>(s);
+      if (b)
+         return block(b);
+
+      emit(BC_LOC).x.p = &s->loc;
+
+      ExpressionStatement* es = dynamic_cast<ExpressionStatement*>(s);
+      if (es)
+         return es->exp ? exprIgnored(es->exp) : 0;
+
+      IfStatement* is = dynamic_cast<IfStatement*>(s);
+      if (is) {
+         if (openScope(is->lvars))
+            return -1;
+         reg_vec_t f;
+         if (cond(is->cond, false, f) || (is->if_code && block(is->if_code)))
+            return -1;
+         if (is->else_code) {
+            unsigned j = pc();
+            emit(BC_JMP);
+            patch(f, pc());
+            if (block(is->else_code))
+               return -1;
+            bc.code[j].b = pc();
+         }
+         else
+            patch(f, pc());
+         closeScope();
+         return 0;
+      }
+
+      // "do ... while" is a subclass of "while" and must be checked first
+      DoWhileStatement* dws = dynamic_cast<DoWhileStatement*>(s);
+      if (dws) {
+         WhileStatement* ws = dws;
+         if (openScope(ws->lvars))
+            return -1;
+         unsigned top = pc();
+         if (loopBody(ws->code))
+            return -1;
+         unsigned cont = pc();
+         reg_vec_t t;
+         if (cond(ws->cond, true, t))
+            return -1;
+         patch(t, top);
+         loopEnd(cont, pc());
+         closeScope();
+         return 0;
+      }
+
+      WhileStatement* ws = dynamic_cast<WhileStatement*>(s);
+      if (ws) {
+         if (openScope(ws->lvars))
+            return -1;
+         unsigned top = pc();
+         reg_vec_t f;
+         if (cond(ws->cond, false, f) || loopBody(ws->code))
+            return -1;
+         emit(BC_JMP).b = top;
+         patch(f, pc());
+         loopEnd(top, pc());
+         closeScope();
+         return 0;
+      }
+
+      ForStatement* fs = dynamic_cast<ForStatement*>(s);
+      if (fs) {
+         if (fs->assignment)
+            markTypedDecl(fs->assignment);
+         if (openScope(fs->lvars) || (fs->assignment && exprIgnored(fs->assignment)))
+            return -1;
+         unsigned top = pc();
+         reg_vec_t f;
+         if ((fs->cond && cond(fs->cond, false, f)) || loopBody(fs->code))
+            return -1;
+         unsigned cont = pc();
+         if (fs->iterator && exprIgnored(fs->iterator))
+            return -1;
+         emit(BC_JMP).b = top;
+         patch(f, pc());
+         loopEnd(cont, pc());
+         closeScope();
+         return 0;
+      }
+
+      ForEachStatement* fes = dynamic_cast<ForEachStatement*>(s);
+      if (fes)
+         return forEach(fes);
+
+      ReturnStatement* rs = dynamic_cast<ReturnStatement*>(s);
+      if (rs) {
+         if (!rs->exp) {
+            emit(BC_RETN);
+            return 0;
+         }
+         unsigned mark = temps.size(), r;
+         if (expr(rs->exp, r))
+            return -1;
+         emit(BC_RET, r, 0, isTemp(r) && kind(r) == BK_VALUE);
+         releaseTemps(mark);
+         return 0;
+      }
+
+      if (dynamic_cast<BreakStatement*>(s))
+         return loopJump(true);
+      if (dynamic_cast<ContinueStatement*>(s))
+         return loopJump(false);
+
+      return -1;
+   }
+
+   // only "foreach" over a list without references and without $# is supported
+   DLLLOCAL int forEach(ForEachStatement* fes) {
+      if (fes->is_ref || fes->iterator_func || !fes->code)
+         return -1;
+
+      const AbstractQoreNode* ln = fes->list;
+      if (get_node_type(ln) == NT_VARREF) {
+         const QoreTypeInfo* ti = reinterpret_cast<const VarRefNode*>(ln)->getTypeInfo();
+         if (ti != listTypeInfo && ti != listOrNothingTypeInfo && ti != softListTypeInfo && ti != softListOrNothingTypeInfo)
+            return -1;
+      }
+      else if (get_node_type(ln) != NT_LIST || ln->needs_eval())
+         return -1;
+
+      if (openScope(fes->lvars))
+         return -1;
+
+      unsigned vr;
+      const LocalVar* lv;
+      if (local(fes->var, vr, lv) || kind(vr) != BK_VALUE)
+         return -1;
+
+      unsigned mark = temps.size(), lr;
+      if (expr(ln, lr))
+         return -1;
+      // the list is referenced for the duration of the loop
+      lr = copy(lr);
+      unsigned idx = temp(BK_INT);
+      emit(BC_LOADI, idx).x.i = 0;
+
+      unsigned top = pc();
+      const QoreTypeInfo* ti = lv->getTypeInfo();
+      emit(BC_FE_NEXT, vr, lr, idx).x.p = ti->hasType() ? ti : 0;
+      unsigned exit = pc();
+      emit(BC_JMP);
+      if (loopBody(fes->code))
+         return -1;
+      emit(BC_JMP).b = top;
+      unsigned end = pc();
+      bc.code[exit].b = end;
+      loopEnd(top, end);
+      releaseTemps(mark);
+      closeScope();
+      return 0;
+   }
+
+public:
+   DLLLOCAL QoreBytecodeCompiler(QoreBytecode& b) : bc(b), ignored(0), po_set(false) {
+   }
+
+   DLLLOCAL int compile(const UserSignature& sig, StatementBlock* body) {
+      if (!body || body->statement_list.empty() || sig.selfid)
+         return -1;
+
+      // parameters are stored in the first registers
+      bc.nparams = sig.lv.size();
+      for (unsigned i = 0; i < bc.nparams; ++i) {
+         const LocalVar* lv = sig.lv[i];
+         if (!supported(lv))
+            return -1;
+         bc_kind_e k = getKind(lv->getTypeInfo());
+         bc.kinds.push_back(k);
+         lvmap[lv] = i;
+         if (k != BK_VALUE)
+            assigned.insert(lv);
+      }
+      bc.returnTypeInfo = sig.getReturnTypeInfo();
+
+      if (block(body))
+         return -1;
+      // implicit return at the end of the function; checked by the caller
+      emit(BC_RETN, 0, 0, 1);
+
+      // the integer assignment semantics of %broken-int-assignments are not implemented
+      if (bc.po & PO_BROKEN_INT_ASSIGNMENTS)
+         return -1;
+
+      assert(temps.empty());
+      assert(loops.empty());
+      return 0;
+   }
+};
+
+QoreBytecode* QoreBytecode::compile(const UserSignature& sig, StatementBlock* body) {
+   std::unique_ptr<QoreBytecode> bc(new QoreBytecode);
+   QoreBytecodeCompiler c(*bc);
+   if (c.compile(sig, body))
+      return 0;
+   printd(5, "QoreBytecode::compile() compiled %d instructions with %d registers\n", bc->size(), bc->numRegisters());
+   return bc.release();
+}
+
+bool QoreBytecode::acceptsArgs(const QoreValueList* args) const {
+   unsigned nargs = args ? args->size() : 0;
+   for (unsigned i = 0; i < nparams; ++i) {
+      qore_type_t t = i < nargs ? args->retrieveEntry(i).getType() : NT_NOTHING;
+      switch (kinds[i]) {
+         case BK_INT: if (t != NT_INT) return false; break;
+         case BK_FLOAT: if (t != NT_FLOAT) return false; break;
+         case BK_BOOL: if (t != NT_BOOLEAN) return false; break;
+         default: if (t == NT_REFERENCE) return false; break;
+      }
+   }
+   return true;
+}
+
+static inline void bc_set_int(QoreValue& v, int64 i) {
+   v.type = QV_Int;
+   v.v.i = i;
+}
+
+static inline void bc_set_float(QoreValue& v, double f) {
+   v.type = QV_Float;
+   v.v.f = f;
+}
+
+static inline void bc_set_bool(QoreValue& v, bool b) {
+   v.type = QV_Bool;
+   v.v.b = b;
+}
+
+// sets a value register to the given referenced value and dereferences the old value
+static inline void bc_set(QoreValue& v, QoreValue nv, ExceptionSink* xsink) {
+   if (v.type == QV_Node && v.v.n)
+      v.v.n->deref(xsink);
+   v = nv;
+}
+
+// takes the value from a register and leaves NOTHING in it
+static inline QoreValue bc_take(QoreValue& v) {
+   QoreValue rv = v;
+   v.clear();
+   return rv;
+}
+
+// ensures that the node in the given register is not shared so it can be modified
+static inline AbstractQoreNode* bc_unique(QoreValue& v, ExceptionSink* xsink) {
+   if (!v.v.n->is_unique()) {
+      AbstractQoreNode* n = v.v.n->realCopy();
+      v.v.n->deref(xsink);
+      v.v.n = n;
+   }
+   return v.v.n;
+}
+
+// executes a generic binary operator that returns a value
+#define BC_DO_VALUE(f) { QoreValue rv = f(r[i->b], r[i->c], xsink); if (*xsink) { rv.discard(xsink); goto error; } bc_set(r[i->a], rv, xsink); break; }
+// executes a generic binary operator that returns a bool
+#define BC_DO_BOOL(e) { bool rv = e; if (*xsink) goto error; bc_set_bool(r[i->a], rv); break; }
+// jumps if the given expression is true
+#define BC_JUMP_IF(e) if (e) { i = start + i->b; continue; } break
+
+QoreValue QoreBytecode::run(QoreValue* r, ExceptionSink* xsink) const {
+   const QoreBytecodeInstr* start = &code[0];
+   const QoreBytecodeInstr* i = start;
+
+   while (true) {
+      switch (i->op) {
+         case BC_LOC:
+            update_runtime_location(*reinterpret_cast<const QoreProgramLocation*>(i->x.p));
+            pthread_testcancel();
+            break;
+
+         case BC_JMP: i = start + i->b; continue;
+         case BC_JT: BC_JUMP_IF(r[i->a].v.b);
+         case BC_JF: BC_JUMP_IF(!r[i->a].v.b);
+         case BC_JTV: BC_JUMP_IF(r[i->a].getAsBool());
+         case BC_JFV: BC_JUMP_IF(!r[i->a].getAsBool());
+         case BC_JLT_II: BC_JUMP_IF(r[i->a].v.i < r[i->c].v.i);
+         case BC_JLE_II: BC_JUMP_IF(r[i->a].v.i <= r[i->c].v.i);
+         case BC_JGT_II: BC_JUMP_IF(r[i->a].v.i > r[i->c].v.i);
+         case BC_JGE_II: BC_JUMP_IF(r[i->a].v.i >= r[i->c].v.i);
+         case BC_JEQ_II: BC_JUMP_IF(r[i->a].v.i == r[i->c].v.i);
+         case BC_JNE_II: BC_JUMP_IF(r[i->a].v.i != r[i->c].v.i);
+         case BC_JLT_IK: BC_JUMP_IF(r[i->a].v.i < i->x.i);
+         case BC_JLE_IK: BC_JUMP_IF(r[i->a].v.i <= i->x.i);
+         case BC_JGT_IK: BC_JUMP_IF(r[i->a].v.i > i->x.i);
+         case BC_JGE_IK: BC_JUMP_IF(r[i->a].v.i >= i->x.i);
+         case BC_JEQ_IK: BC_JUMP_IF(r[i->a].v.i == i->x.i);
+         case BC_JNE_IK: BC_JUMP_IF(r[i->a].v.i != i->x.i);
+
+         case BC_LOADI: bc_set_int(r[i->a], i->x.i); break;
+         case BC_LOADF: bc_set_float(r[i->a], i->x.f); break;
+         case BC_LOADB: bc_set_bool(r[i->a], (bool)i->x.i); break;
+         case BC_LOADK:
+            bc_set(r[i->a], QoreValue(const_cast<AbstractQoreNode*>(reinterpret_cast<const AbstractQoreNode*>(i->x.p))->refSelf()), xsink);
+            break;
+         case BC_MOVN: r[i->a] = r[i->b]; break;
+         case BC_MOV: bc_set(r[i->a], r[i->b].refSelf(), xsink); break;
+         case BC_CLEAR:
+            r[i->a].discard(xsink);
+            r[i->a].clear();
+            break;
+
+         case BC_ASSIGN: {
+            QoreValue nv = i->c ? bc_take(r[i->b]) : r[i->b].refSelf();
+            if (i->x.p) {
+               reinterpret_cast<const QoreTypeInfo*>(i->x.p)->acceptAssignment("<lvalue>", nv, xsink);
+               if (*xsink) {
+                  nv.discard(xsink);
+                  goto error;
+               }
+            }
+            bc_set(r[i->a], nv, xsink);
+            break;
+         }
+         case BC_ASSIGN_I:
+         case BC_ASSIGN_F:
+         case BC_ASSIGN_B: {
+            ValueHolder nv(r[i->b].refSelf(), xsink);
+            reinterpret_cast<const QoreTypeInfo*>(i->x.p)->acceptAssignment("<lvalue>", *nv, xsink);
+            if (*xsink)
+               goto error;
+            if (i->op == BC_ASSIGN_I)
+               bc_set_int(r[i->a], nv->getAsBigInt());
+            else if (i->op == BC_ASSIGN_F)
+               bc_set_float(r[i->a], nv->getAsFloat());
+            else
+               bc_set_bool(r[i->a], nv->getAsBool());
+            break;
+         }
+
+         case BC_TOINT: bc_set_int(r[i->a], r[i->b].getAsBigInt()); break;
+         case BC_TOFLOAT: bc_set_float(r[i->a], r[i->b].getAsFloat()); break;
+         case BC_TOBOOL: bc_set_bool(r[i->a], r[i->b].getAsBool()); break;
+         case BC_I2F: bc_set_float(r[i->a], (double)r[i->b].v.i); break;
+
+         case BC_ADD_II: bc_set_int(r[i->a], r[i->b].v.i + r[i->c].v.i); break;
+         case BC_SUB_II: bc_set_int(r[i->a], r[i->b].v.i - r[i->c].v.i); break;
+         case BC_MUL_II: bc_set_int(r[i->a], r[i->b].v.i * r[i->c].v.i); break;
+         case BC_DIV_II:
+            if (!r[i->c].v.i) {
+               xsink->raiseException("DIVISION-BY-ZERO", "division by zero found in integer expression");
+               goto error;
+            }
+            bc_set_int(r[i->a], r[i->b].v.i / r[i->c].v.i);
+            break;
+         case BC_MOD_II:
+            if (!r[i->c].v.i) {
+               xsink->raiseException("DIVISION-BY-ZERO", "modula operand cannot be zero (" QLLD " %% " QLLD " attempted)", r[i->b].v.i, r[i->c].v.i);
+               goto error;
+            }
+            bc_set_int(r[i->a], r[i->b].v.i % r[i->c].v.i);
+            break;
+         case BC_ADD_IK: bc_set_int(r[i->a], r[i->b].v.i + i->x.i); break;
+         case BC_SUB_IK: bc_set_int(r[i->a], r[i->b].v.i - i->x.i); break;
+         case BC_MUL_IK: bc_set_int(r[i->a], r[i->b].v.i * i->x.i); break;
+         case BC_NEG_I: bc_set_int(r[i->a], -r[i->b].v.i); break;
+         case BC_INC_I: ++r[i->a].v.i; break;
+         case BC_DEC_I: --r[i->a].v.i; break;
+
+         case BC_ADD_FF: bc_set_float(r[i->a], r[i->b].v.f + r[i->c].v.f); break;
+         case BC_SUB_FF: bc_set_float(r[i->a], r[i->b].v.f - r[i->c].v.f); break;
+         case BC_MUL_FF: bc_set_float(r[i->a], r[i->b].v.f * r[i->c].v.f); break;
+         case BC_DIV_FF:
+            if (!r[i->c].v.f) {
+               xsink->raiseException("DIVISION-BY-ZERO", "division by zero found in floating-point expression");
+               goto error;
+            }
+            bc_set_float(r[i->a], r[i->b].v.f / r[i->c].v.f);
+            break;
+         case BC_NEG_F: bc_set_float(r[i->a], -r[i->b].v.f); break;
+
+         case BC_LT_II: bc_set_bool(r[i->a], r[i->b].v.i < r[i->c].v.i); break;
+         case BC_LE_II: bc_set_bool(r[i->a], r[i->b].v.i <= r[i->c].v.i); break;
+         case BC_GT_II: bc_set_bool(r[i->a], r[i->b].v.i > r[i->c].v.i); break;
+         case BC_GE_II: bc_set_bool(r[i->a], r[i->b].v.i >= r[i->c].v.i); break;
+         case BC_EQ_II: bc_set_bool(r[i->a], r[i->b].v.i == r[i->c].v.i); break;
+         case BC_NE_II: bc_set_bool(r[i->a], r[i->b].v.i != r[i->c].v.i); break;
+         case BC_LT_FF: bc_set_bool(r[i->a], r[i->b].v.f < r[i->c].v.f); break;
+         case BC_LE_FF: bc_set_bool(r[i->a], r[i->b].v.f <= r[i->c].v.f); break;
+         case BC_GT_FF: bc_set_bool(r[i->a], r[i->b].v.f > r[i->c].v.f); break;
+         case BC_GE_FF: bc_set_bool(r[i->a], r[i->b].v.f >= r[i->c].v.f); break;
+         case BC_EQ_FF: bc_set_bool(r[i->a], r[i->b].v.f == r[i->c].v.f); break;
+         case BC_NE_FF: bc_set_bool(r[i->a], r[i->b].v.f != r[i->c].v.f); break;
+         case BC_NOT_B: bc_set_bool(r[i->a], !r[i->b].v.b); break;
+
+         case BC_ADD_VV: BC_DO_VALUE(QorePlusOperatorNode::doPlus);
+         case BC_SUB_VV: BC_DO_VALUE(QoreMinusOperatorNode::doMinus);
+         case BC_MUL_VV: BC_DO_VALUE(QoreMultiplicationOperatorNode::doMultiplication);
+         case BC_DIV_VV: BC_DO_VALUE(QoreDivisionOperatorNode::doDivision);
+         case BC_LT_VV: BC_DO_BOOL(QoreLogicalLessThanOperatorNode::doLessThan(r[i->b], r[i->c], xsink));
+         case BC_LE_VV: BC_DO_BOOL(QoreLogicalLessThanOrEqualsOperatorNode::doLessThanOrEquals(r[i->b], r[i->c], xsink));
+         case BC_GT_VV: BC_DO_BOOL(QoreLogicalGreaterThanOperatorNode::doGreaterThan(r[i->b], r[i->c], xsink));
+         case BC_GE_VV: BC_DO_BOOL(QoreLogicalGreaterThanOrEqualsOperatorNode::doGreaterThanOrEquals(r[i->b], r[i->c], xsink));
+         case BC_EQ_VV: BC_DO_BOOL(QoreLogicalEqualsOperatorNode::softEqual(r[i->b], r[i->c], xsink));
+         case BC_NE_VV: BC_DO_BOOL(QoreLogicalNotEqualsOperatorNode::softNotEqual(r[i->b], r[i->c], xsink));
+         case BC_AEQ_VV: BC_DO_BOOL(QoreLogicalAbsoluteEqualsOperatorNode::hardEqual(r[i->b], r[i->c], xsink));
+         case BC_ANE_VV: BC_DO_BOOL(!QoreLogicalAbsoluteEqualsOperatorNode::hardEqual(r[i->b], r[i->c], xsink));
+
+         case BC_PLUSEQ_V: {
+            // the same semantics as QorePlusEqualsOperatorNode for string, list, and hash lvalues
+            QoreValue& v = r[i->a];
+            const QoreValue& nr = r[i->b];
+            qore_type_t vt = v.getType();
+            if (vt == NT_NOTHING) {
+               const QoreTypeInfo* ti = reinterpret_cast<const QoreTypeInfo*>(i->x.p);
+               if (!ti->hasDefaultValue()) {
+                  if (!nr.isNothing()) {
+                     QoreValue nv = nr.refSelf();
+                     ti->acceptAssignment("<lvalue>", nv, xsink);
+                     if (*xsink) {
+                        nv.discard(xsink);
+                        goto error;
+                     }
+                     bc_set(v, nv, xsink);
+                  }
+                  break;
+               }
+               bc_set(v, ti->getDefaultValue(), xsink);
+               vt = v.getType();
+            }
+            if (vt == NT_LIST) {
+               QoreListNode* l = reinterpret_cast<QoreListNode*>(bc_unique(v, xsink));
+               if (nr.getType() == NT_LIST)
+                  l->merge(nr.get<const QoreListNode>());
+               else
+                  l->push(nr.getReferencedValue());
+            }
+            else if (vt == NT_HASH) {
+               if (nr.getType() == NT_HASH)
+                  reinterpret_cast<QoreHashNode*>(bc_unique(v, xsink))->merge(nr.get<const QoreHashNode>(), xsink);
+               else if (nr.getType() == NT_OBJECT)
+                  qore_object_private::get(*nr.get<const QoreObject>())->mergeDataToHash(reinterpret_cast<QoreHashNode*>(bc_unique(v, xsink)), xsink);
+            }
+            else if (vt == NT_STRING) {
+               if (!nr.isNullOrNothing()) {
+                  QoreStringValueHelper str(nr);
+                  reinterpret_cast<QoreStringNode*>(bc_unique(v, xsink))->concat(*str, xsink);
+               }
+            }
+            if (*xsink)
+               goto error;
+            break;
+         }
+
+         case BC_HGET: BC_DO_VALUE(QoreHashObjectDereferenceOperatorNode::doHashObjectDereference);
+         case BC_HSET: {
+            QoreStringValueHelper key(r[i->b], QCS_DEFAULT, xsink);
+            if (*xsink)
+               goto error;
+            QoreValue& v = r[i->a];
+            QoreHashNode* h;
+            if (v.getType() == NT_HASH)
+               h = reinterpret_cast<QoreHashNode*>(bc_unique(v, xsink));
+            else
+               bc_set(v, h = new QoreHashNode, xsink);
+            h->setKeyValue(key->getBuffer(), r[i->c].getReferencedValue(), xsink);
+            if (*xsink)
+               goto error;
+            break;
+         }
+         case BC_SQB: BC_DO_VALUE(QoreSquareBracketsOperatorNode::doSquareBrackets);
+         case BC_LIST: {
+            QoreListNode* l = new QoreListNode;
+            for (unsigned li = 0; li < i->c; ++li)
+               l->push(r[args[i->b + li]].getReferencedValue());
+            bc_set(r[i->a], l, xsink);
+            break;
+         }
+         case BC_HASH: {
+            ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+            for (unsigned hi = 0; hi < i->c; ++hi) {
+               QoreStringValueHelper key(r[args[i->b + hi * 2]]);
+               h->setKeyValue(key->getBuffer(), r[args[i->b + hi * 2 + 1]].getReferencedValue(), xsink);
+               if (*xsink)
+                  goto error;
+            }
+            bc_set(r[i->a], h.release(), xsink);
+            break;
+         }
+         case BC_ELEMENTS: {
+            int64 rv = QoreElementsOperatorNode::getElements(r[i->b], xsink);
+            if (*xsink)
+               goto error;
+            bc_set_int(r[i->a], rv);
+            break;
+         }
+
+         case BC_CALL: {
+            const FunctionCallNode* fc = reinterpret_cast<const FunctionCallNode*>(i->x.p);
+            ReferenceHolder<QoreValueList> al(i->c ? new QoreValueList : 0, xsink);
+            for (unsigned ai = 0; ai < i->c; ++ai) {
+               QoreValue av = r[args[i->b + ai]].refSelf();
+               av.sanitize();
+               al->push(av);
+            }
+            const QoreFunction* f = fc->getFunction();
+            const AbstractQoreFunctionVariant* variant = fc->getVariant();
+            QoreValue rv;
+            {
+               CodeEvaluationHelper ceh(xsink, f, variant, f->getName(), *al);
+               if (!*xsink)
+                  rv = variant->evalFunction(f->getName(), ceh, xsink);
+            }
+            if (*xsink) {
+               rv.discard(xsink);
+               goto error;
+            }
+            bc_set(r[i->a], rv, xsink);
+            break;
+         }
+
+         case BC_FE_NEXT: {
+            const QoreValue& lv = r[i->b];
+            int64& idx = r[i->c].v.i;
+            if (lv.getType() == NT_LIST) {
+               const QoreListNode* l = lv.get<const QoreListNode>();
+               if ((size_t)idx < l->size()) {
+                  QoreValue nv(l->get_referenced_entry(idx++));
+                  if (i->x.p) {
+                     reinterpret_cast<const QoreTypeInfo*>(i->x.p)->acceptAssignment("<foreach lvalue assignment>", nv, xsink);
+                     if (*xsink) {
+                        nv.discard(xsink);
+                        goto error;
+                     }
+                  }
+                  bc_set(r[i->a], nv, xsink);
+                  i += 2;
+                  continue;
+               }
+            }
+            break;
+         }
+
+         case BC_RET: {
+            QoreValue rv = i->c ? bc_take(r[i->a]) : r[i->a].refSelf();
+            rv.sanitize();
+            returnTypeInfo->acceptAssignment("<return statement>", rv, xsink);
+            if (*xsink) {
+               rv.discard(xsink);
+               goto error;
+            }
+            return rv;
+         }
+         case BC_RETN: {
+            // the implicit return at the end of the function is checked by the caller
+            if (!i->c) {
+               QoreValue rv;
+               returnTypeInfo->acceptAssignment("<return statement>", rv, xsink);
+               if (*xsink) {
+                  rv.discard(xsink);
+                  goto error;
+               }
+            }
+            return QoreValue();
+         }
+      }
+      ++i;
+   }
+
+ error:
+   return QoreValue();
+}
+
+QoreValue QoreBytecode::exec(const QoreValueList* a, ExceptionSink* xsink) const {
+#ifdef QORE_MANAGE_STACK
+   if (check_stack(xsink))
+      return QoreValue();
+#endif
+
+   // the location is restored when the function returns
+   QoreProgramLocation loc = get_runtime_location();
+   QoreProgramBlockParseOptionHelper bh(po);
+
+   // registers are initialized to NOTHING
+   unsigned n = kinds.size();
+   QoreValue local_regs[QORE_BC_LOCAL_REGS];
+   std::unique_ptr<QoreValue[]> heap_regs;
+   QoreValue* r = local_regs;
+   if (n > QORE_BC_LOCAL_REGS) {
+      heap_regs.reset(new QoreValue[n]);
+      r = heap_regs.get();
+   }
+
+   unsigned nargs = a ? a->size() : 0;
+   for (unsigned i = 0; i < nparams && i < nargs; ++i) {
+      const QoreValue v = a->retrieveEntry(i);
+      switch (kinds[i]) {
+         case BK_INT: bc_set_int(r[i], v.getAsBigInt()); break;
+         case BK_FLOAT: bc_set_float(r[i], v.getAsFloat()); break;
+         case BK_BOOL: bc_set_bool(r[i], v.getAsBool()); break;
+         default: r[i] = v.refSelf(); break;
+      }
+   }
+
+   QoreValue rv = run(r, xsink);
+
+   for (unsigned i = n; i; --i) {
+      if (kinds[i - 1] == BK_VALUE)
+         r[i - 1].discard(xsink);
+   }
+
+   update_runtime_location(loc);
+   return rv;
+}
@@ -36,6 +36,7 @@
 #include "qore/intern/qore_program_private.h"
 #include "qore/intern/ql_crypto.h"
 #include "qore/intern/QoreObjectIntern.h"
+#include "qore/intern/QoreHashNodeIntern.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -44,6 +45,9 @@
 // global class ID sequence
 DLLLOCAL Sequence classIDSeq(1);
 
+// inline cache generation
+DLLLOCAL std::atomic<unsigned> qore_inline_cache_gen(0);
+
 AbstractQoreClassUserData::~AbstractQoreClassUserData() {
 }
 
@@ -501,6 +505,7 @@ qore_class_private::qore_class_private(QoreClass* n_cls, const char* nme, int64
      memberNotification(0),
      classID(classIDSeq.next()),
      methodID(classID),
+     serial(classID),
      sys(false),
      initialized(false),
      parse_init_called(false),
@@ -516,6 +521,7 @@ qore_class_private::qore_class_private(QoreClass* n_cls, const char* nme, int64
      pub(false),
      final(false),
      inject(false),
+     committed(false),
      domain(dom),
      num_methods(0),
      num_user_methods(0),
@@ -527,7 +533,8 @@ qore_class_private::qore_class_private(QoreClass* n_cls, const char* nme, int64
      ptr(0),
      mud(0),
      new_copy(0),
-     spgm(0) {
+     spgm(0),
+     member_shape(0) {
    assert(methodID == classID);
 
    if (nme)
@@ -557,6 +564,7 @@ qore_class_private::qore_class_private(const qore_class_private& old, QoreClass*
      memberNotification(0),
      classID(old.classID),
      methodID(old.methodID),
+     serial(classIDSeq.next()),
      sys(old.sys),
      initialized(true),
      parse_init_called(false),
@@ -571,6 +579,7 @@ qore_class_private::qore_class_private(const qore_class_private& old, QoreClass*
      pub(false), // the public flag must be explicitly set if necessary after this constructor
      final(old.final),
      inject(old.inject),
+     committed(old.committed),
      domain(old.domain),
      num_methods(old.num_methods),
      num_user_methods(old.num_user_methods),
@@ -583,7 +592,8 @@ qore_class_private::qore_class_private(const qore_class_private& old, QoreClass*
      ptr(old.ptr),
      mud(old.mud ? old.mud->copy() : 0),
      new_copy(0),
-     spgm(old.spgm ? old.spgm->programRefSelf() : 0) {
+     spgm(old.spgm ? old.spgm->programRefSelf() : 0),
+     member_shape(0) {
    QORE_TRACE("qore_class_private::qore_class_private(const qore_class_private& old)");
    printd(5, "qore_class_private::qore_class_private() this: %p creating copy of '%s' ID:%d cls: %p old: %p\n", this, name.c_str(), classID, cls, old.cls);
 
@@ -667,6 +677,10 @@ qore_class_private::~qore_class_private() {
 
    if (mud)
       mud->doDeref();
+
+   QoreHashShape* s = member_shape.load(std::memory_order_relaxed);
+   if (s)
+      s->deref();
 }
 
 const QoreMethod* qore_class_private::doParseMethodAccess(const QoreMethod* m, const qore_class_private* class_ctx) {
@@ -1079,6 +1093,9 @@ QoreObject* qore_class_private::execConstructor(const AbstractQoreFunctionVarian
       return 0;
    }
 
+   // share the member layout with other objects of the class if possible
+   qore_object_private::get(*self)->adoptMemberShape(*this);
+
    printd(5, "qore_class_private::execConstructor() this: %p %s::constructor() returning o: %p\n", this, name.c_str(), self);
    return self;
 }
@@ -1152,6 +1169,9 @@ QoreObject* qore_class_private::execConstructor(const AbstractQoreFunctionVarian
       return 0;
    }
 
+   // share the member layout with other objects of the class if possible
+   qore_object_private::get(*self)->adoptMemberShape(*this);
+
    printd(5, "qore_class_private::execConstructor() this: %p %s::constructor() returning o: %p\n", this, name.c_str(), self);
    return self;
 }
@@ -1257,6 +1277,10 @@ void qore_class_private::parseCommit() {
       }
 
       has_new_user_changes = false;
+
+      // new methods or members in a class that may already be in use can change the methods resolved at call sites
+      if (committed)
+         qore_inline_cache_gen.fetch_add(1, std::memory_order_release);
    }
 #ifdef DEBUG
    else {
@@ -1278,6 +1302,8 @@ void qore_class_private::parseCommit() {
    // running parseCommit())
    if (!has_public_memdecl && (scl ? scl->parseHasPublicMembersInHierarchy() : false))
       has_public_memdecl = true;
+
+   committed = true;
 }
 
 void qore_class_private::parseCommitRuntimeInit(ExceptionSink* xsink) {
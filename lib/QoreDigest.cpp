@@ -0,0 +1,181 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreDigest.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <string.h>
+
+#include "qore/Qore.h"
+#include "qore/intern/QoreDigest.h"
+
+// passes data through unchanged while adding it to a digest
+class DigestTransform : public Transform {
+public:
+   DigestTransform(QoreDigest* d) : d(d) {
+      d->ref();
+   }
+
+   std::pair<int64, int64> apply(const void* src, int64 srcLen, void* dst, int64 dstLen, ExceptionSink* xsink) override {
+      if (!src)
+         return std::make_pair(0, 0);
+
+      int64 len = srcLen < dstLen ? srcLen : dstLen;
+      memcpy(dst, src, len);
+      if (d->update(src, len, xsink))
+         return std::make_pair(0, 0);
+      return std::make_pair(len, len);
+   }
+
+protected:
+   virtual ~DigestTransform() {
+      d->deref();
+   }
+
+private:
+   QoreDigest* d;
+};
+
+QoreDigest::QoreDigest(const char* n_alg, ExceptionSink* xsink) : alg(n_alg), md(EVP_get_digestbyname(n_alg)), hmac(false), pkey(0), ctx(0), done(false) {
+   if (!md) {
+      xsink->raiseException(getErr(), "unknown digest algorithm '%s'", n_alg);
+      return;
+   }
+
+   init(xsink);
+}
+
+QoreDigest::QoreDigest(const char* n_alg, const void* n_key, size_t key_len, ExceptionSink* xsink) : alg(n_alg), md(EVP_get_digestbyname(n_alg)), hmac(true), pkey(0), ctx(0), done(false) {
+   if (!md) {
+      xsink->raiseException(getErr(), "unknown digest algorithm '%s'", n_alg);
+      return;
+   }
+
+   // HMAC pads the key with zeros to the block size, so an empty key is equivalent to a single zero byte, which is
+   // used instead because some OpenSSL versions reject empty MAC keys
+   if (key_len)
+      key.assign((const char*)n_key, key_len);
+   else
+      key.assign(1, '\0');
+   if (initKey(xsink))
+      return;
+
+   init(xsink);
+}
+
+QoreDigest::QoreDigest(const QoreDigest& old, ExceptionSink* xsink) : alg(old.alg), md(old.md), hmac(old.hmac), key(old.key), pkey(0), ctx(0), done(false) {
+   if (hmac && initKey(xsink))
+      return;
+
+   // the state can be changed by an update in another thread, so it's only read with the lock held
+   AutoLocker al(old.m);
+   done = old.done;
+   ctx = EVP_MD_CTX_create();
+   if (!EVP_MD_CTX_copy_ex(ctx, old.ctx))
+      xsink->raiseException(getErr(), "error copying %s context", alg.c_str());
+}
+
+QoreDigest::~QoreDigest() {
+   if (ctx)
+      EVP_MD_CTX_destroy(ctx);
+   if (pkey)
+      EVP_PKEY_free(pkey);
+}
+
+int QoreDigest::initKey(ExceptionSink* xsink) {
+   pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, 0, (const unsigned char*)key.data(), (int)key.size());
+   if (!pkey) {
+      xsink->raiseException(getErr(), "error initializing HMAC key for algorithm '%s'", alg.c_str());
+      return -1;
+   }
+   return 0;
+}
+
+int QoreDigest::init(ExceptionSink* xsink) {
+   if (ctx)
+      EVP_MD_CTX_destroy(ctx);
+   ctx = EVP_MD_CTX_create();
+   done = false;
+
+   if (hmac ? !EVP_DigestSignInit(ctx, 0, md, 0, pkey) : !EVP_DigestInit_ex(ctx, md, 0)) {
+      xsink->raiseException(getErr(), "error initializing %s context", alg.c_str());
+      return -1;
+   }
+   return 0;
+}
+
+int QoreDigest::update(const void* ptr, size_t len, ExceptionSink* xsink) {
+   AutoLocker al(m);
+   if (done) {
+      xsink->raiseException(getErr(), "cannot update the %s digest after it has been finalized; call reset() to start a new calculation", alg.c_str());
+      return -1;
+   }
+
+   if (hmac ? !EVP_DigestSignUpdate(ctx, ptr, len) : !EVP_DigestUpdate(ctx, ptr, len)) {
+      xsink->raiseException(getErr(), "error calculating %s digest", alg.c_str());
+      return -1;
+   }
+   return 0;
+}
+
+BinaryNode* QoreDigest::finalize(ExceptionSink* xsink) {
+   AutoLocker al(m);
+   if (done) {
+      xsink->raiseException(getErr(), "the %s digest has already been finalized; call reset() to start a new calculation", alg.c_str());
+      return 0;
+   }
+
+   unsigned char buf[EVP_MAX_MD_SIZE];
+   size_t len = sizeof(buf);
+   int rc;
+   if (hmac)
+      rc = EVP_DigestSignFinal(ctx, buf, &len);
+   else {
+      unsigned md_len;
+      rc = EVP_DigestFinal_ex(ctx, buf, &md_len);
+      len = md_len;
+   }
+   done = true;
+   if (!rc) {
+      xsink->raiseException(getErr(), "error calculating %s digest", alg.c_str());
+      return 0;
+   }
+
+   BinaryNode* b = new BinaryNode;
+   b->append(buf, len);
+   return b;
+}
+
+int QoreDigest::reset(ExceptionSink* xsink) {
+   AutoLocker al(m);
+   return init(xsink);
+}
+
+Transform* QoreDigest::getTransform() {
+   return new DigestTransform(this);
+}
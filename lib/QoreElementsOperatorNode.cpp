@@ -50,13 +50,17 @@ QoreValue QoreElementsOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSi
    if (*xsink)
       return QoreValue();
 
-   switch (v->getType()) {
-      case NT_LIST: return v->get<const QoreListNode>()->size();
+   return getElements(*v, xsink);
+}
+
+int64 QoreElementsOperatorNode::getElements(QoreValue v, ExceptionSink* xsink) {
+   switch (v.getType()) {
+      case NT_LIST: return v.get<const QoreListNode>()->size();
       // return the number of characters in a string (not bytes)
-      case NT_STRING: return v->get<const QoreStringNode>()->length();
-      case NT_HASH: return v->get<const QoreHashNode>()->size();
-      case NT_OBJECT: return v->get<const QoreObject>()->size(xsink);
-      case NT_BINARY: return v->get<const BinaryNode>()->size();
+      case NT_STRING: return v.get<const QoreStringNode>()->length();
+      case NT_HASH: return v.get<const QoreHashNode>()->size();
+      case NT_OBJECT: return v.get<const QoreObject>()->size(xsink);
+      case NT_BINARY: return v.get<const BinaryNode>()->size();
    }
 
    return 0;
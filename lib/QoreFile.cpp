@@ -220,11 +220,7 @@ int QoreFile::sync() {
 }
 
 void QoreFile::makeSpecial(int sfd) {
-   priv->is_open = true;
-   priv->filename.clear();
-   priv->charset = QCS_DEFAULT;
-   priv->special_file = true;
-   priv->fd = sfd;
+   priv->makeSpecial(sfd);
 }
 
 int QoreFile::open(const char *fn, int flags, int mode, const QoreEncoding *cs) {
@@ -286,12 +282,7 @@ int QoreFile::readUntil(const char* bytes, QoreString& str, bool incl_bytes) {
 }
 
 qore_size_t QoreFile::setPos(qore_size_t pos) {
-   AutoLocker al(priv->m);
-
-   if (!priv->is_open)
-      return -1;
-
-   return lseek(priv->fd, pos, SEEK_SET);
+   return priv->setPos(pos);
 }
 
 // FIXME: deleteme
@@ -494,6 +485,10 @@ BinaryNode *QoreFile::readBinary(qore_offset_t size, ExceptionSink *xsink) {
       if (priv->check_read_open(xsink))
 	 return 0;
 
+      // mapped files return slices of the mapping
+      if (priv->mapping)
+         return priv->readSlice(size);
+
       buf = priv->readBlock(size, -1, "readBinary", xsink);
    }
    if (!buf)
@@ -534,6 +529,10 @@ BinaryNode *QoreFile::readBinary(qore_offset_t size, int timeout_ms, ExceptionSi
       if (priv->check_read_open(xsink))
 	 return 0;
 
+      // mapped files return slices of the mapping
+      if (priv->mapping)
+         return priv->readSlice(size);
+
       buf = priv->readBlock(size, timeout_ms, "readBinary", xsink);
    }
    if (!buf)
@@ -547,7 +546,15 @@ qore_size_t QoreFile::read(void *ptr, qore_size_t limit, int timeout_ms, Excepti
       xsink->raiseException("FILE-READ-TIMEOUT-ERROR", "timeout limit exceeded (%d ms) reading file", timeout_ms);
       return 0;
    }
-   qore_offset_t rc = priv->read(ptr, limit);
+   qore_offset_t rc;
+   {
+      AutoLocker al(priv->m);
+
+      if (priv->check_read_open(xsink))
+         return 0;
+
+      rc = priv->read(ptr, limit);
+   }
    if (rc < 0) {
       xsink->raiseErrnoException("FILE-READ-ERROR", errno, "error reading file");
       return 0;
@@ -801,7 +808,19 @@ bool QoreFile::isDataAvailable(int timeout_ms, ExceptionSink *xsink) const {
 }
 
 int QoreFile::getFD() const {
-   return priv->fd;
+   return priv->getFD();
+}
+
+int QoreFile::map(int advice, ExceptionSink* xsink) {
+   return priv->map(advice, xsink);
+}
+
+void QoreFile::unmap() {
+   priv->unmap();
+}
+
+bool QoreFile::isMapped() const {
+   return priv->isMapped();
 }
 
 #ifdef HAVE_TERMIOS_H
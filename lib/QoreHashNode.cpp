@@ -50,6 +50,39 @@
 
 static const char* qore_hash_type_name = "hash";
 
+QoreHashShape::QoreHashShape(const qore_hash_private& h) {
+   if (h.shape) {
+      keys = h.shape->keys;
+      hashes = h.shape->hashes;
+   }
+   else {
+      keys.reserve(h.len);
+      hashes.reserve(h.len);
+      for (qhlist_t::const_iterator i = h.member_list.begin(), e = h.member_list.end(); i != e; ++i) {
+         if (!*i)
+            continue;
+         keys.push_back((*i)->key);
+         hashes.push_back((*i)->hash);
+      }
+   }
+
+   if (keys.size() <= QORE_HASH_LINEAR_MAX)
+      return;
+
+   // keep the load factor at or below 3/4
+   unsigned cap = QORE_HASH_LINEAR_MAX * 4;
+   while (keys.size() * 4 > cap * 3)
+      cap <<= 1;
+   index = (unsigned*)calloc(cap, sizeof(unsigned));
+   index_mask = cap - 1;
+   for (unsigned i = 0, e = keys.size(); i < e; ++i) {
+      unsigned slot = hashes[i] & index_mask;
+      while (index[slot])
+         slot = (slot + 1) & index_mask;
+      index[slot] = i + 1;
+   }
+}
+
 QoreHashNode::QoreHashNode(bool ne) : AbstractQoreNode(NT_HASH, !ne, ne), priv(new qore_hash_private) {
 }
 
@@ -60,6 +93,14 @@ QoreHashNode::~QoreHashNode() {
    delete priv;
 }
 
+void* QoreHashNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void QoreHashNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
 AbstractQoreNode* QoreHashNode::realCopy() const {
    return copy();
 }
@@ -243,6 +284,10 @@ void QoreHashNode::merge(const class QoreHashNode* h, ExceptionSink* xsink) {
    priv->merge(*h->priv, xsink);
 }
 
+QoreHashNode* QoreHashNode::copyShape() const {
+   return priv->copyShape();
+}
+
 // returns the same order
 QoreHashNode* QoreHashNode::copy() const {
    return priv->copy();
@@ -290,34 +335,30 @@ AbstractQoreNode* QoreHashNode::evalKeyValue(const QoreString* key, ExceptionSin
    if (*xsink)
       return 0;
 
-   hm_hm_t::const_iterator i = priv->hm.find(k->getBuffer());
+   AbstractQoreNode** vp = priv->findValuePtr(k->getBuffer());
 
-   if (i != priv->hm.end() && (*i->second)->node)
-      return (*i->second)->node->refSelf();
+   if (vp && *vp)
+      return (*vp)->refSelf();
 
    return 0;
 }
 
 AbstractQoreNode* QoreHashNode::getReferencedKeyValue(const char* key) const {
-   assert(key);
-
-   hm_hm_t::const_iterator i = priv->hm.find(key);
+   AbstractQoreNode** vp = priv->findValuePtr(key);
 
-   if (i != priv->hm.end() && (*i->second)->node)
-      return (*i->second)->node->refSelf();
+   if (vp && *vp)
+      return (*vp)->refSelf();
 
    return 0;
 }
 
 AbstractQoreNode* QoreHashNode::getReferencedKeyValue(const char* key, bool &exists) const {
-   assert(key);
+   AbstractQoreNode** vp = priv->findValuePtr(key);
 
-   hm_hm_t::const_iterator i = priv->hm.find(key);
-
-   if (i != priv->hm.end()) {
+   if (vp) {
       exists = true;
-      if ((*i->second)->node)
-	 return (*i->second)->node->refSelf();
+      if (*vp)
+	 return (*vp)->refSelf();
 
       return 0;
    }
@@ -326,14 +367,9 @@ AbstractQoreNode* QoreHashNode::getReferencedKeyValue(const char* key, bool &exi
 }
 
 AbstractQoreNode* QoreHashNode::getKeyValue(const char* key) {
-   assert(key);
-
-   hm_hm_t::const_iterator i = priv->hm.find(key);
+   AbstractQoreNode** vp = priv->findValuePtr(key);
 
-   if (i != priv->hm.end())
-      return (*i->second)->node;
-
-   return 0;
+   return vp ? *vp : 0;
 }
 
 const AbstractQoreNode* QoreHashNode::getKeyValue(const char* key) const {
@@ -341,13 +377,11 @@ const AbstractQoreNode* QoreHashNode::getKeyValue(const char* key) const {
 }
 
 AbstractQoreNode* QoreHashNode::getKeyValueExistence(const char* key, bool &exists) {
-   assert(key);
+   AbstractQoreNode** vp = priv->findValuePtr(key);
 
-   hm_hm_t::const_iterator i = priv->hm.find(key);
-
-   if (i != priv->hm.end()) {
+   if (vp) {
       exists = true;
-      return (*i->second)->node;
+      return *vp;
    }
 
    exists = false;
@@ -366,11 +400,11 @@ bool QoreHashNode::compareSoft(const QoreHashNode* h, ExceptionSink* xsink) cons
 
    ConstHashIterator hi(this);
    while (hi.next()) {
-      hm_hm_t::const_iterator j = h->priv->hm.find(hi.getKey());
-      if (j == h->priv->hm.end())
+      AbstractQoreNode** vp = h->priv->findValuePtr(hi.getKey());
+      if (!vp)
          return 1;
 
-      if (q_compare_soft(hi.getValue(), (*j->second)->node, xsink))
+      if (q_compare_soft(hi.getValue(), *vp, xsink))
          return 1;
    }
    return 0;
@@ -384,11 +418,11 @@ bool QoreHashNode::compareHard(const QoreHashNode* h, ExceptionSink* xsink) cons
 
    ConstHashIterator hi(this);
    while (hi.next()) {
-      hm_hm_t::const_iterator j = h->priv->hm.find(hi.getKey());
-      if (j == h->priv->hm.end())
+      AbstractQoreNode** vp = h->priv->findValuePtr(hi.getKey());
+      if (!vp)
          return 1;
 
-      if (::compareHard(hi.getValue(), (*j->second)->node, xsink))
+      if (::compareHard(hi.getValue(), *vp, xsink))
          return 1;
    }
    return 0;
@@ -396,12 +430,7 @@ bool QoreHashNode::compareHard(const QoreHashNode* h, ExceptionSink* xsink) cons
 
 // deprecated
 AbstractQoreNode** QoreHashNode::getExistingValuePtr(const char* key) {
-   hm_hm_t::const_iterator i = priv->hm.find(key);
-
-   if (i != priv->hm.end())
-      return &(*i->second)->node;
-
-   return 0;
+   return priv->findValuePtr(key);
 }
 
 bool QoreHashNode::derefImpl(ExceptionSink* xsink) {
@@ -562,54 +591,113 @@ bool QoreHashNode::getAsBoolImpl() const {
 
 class qhi_priv {
 public:
-   qhlist_t::iterator i;
+   // the current member of a normal hash; iteration continues from the member's position, which is kept up to date when the hash is compacted
+   HashMember* i;
+   // the current position in a hash with a shared key layout
+   unsigned spos;
    bool val;
 
-   DLLLOCAL qhi_priv() : val(false) {
+   DLLLOCAL qhi_priv() : i(0), spos(0), val(false) {
    }
 
-   DLLLOCAL qhi_priv(const qhi_priv& old) : i(old.i), val(old.val) {
+   DLLLOCAL qhi_priv(const qhi_priv& old) : i(old.i), spos(old.spos), val(old.val) {
    }
 
    DLLLOCAL bool valid() const {
       return val;
    }
 
-   DLLLOCAL bool next(qhlist_t& ml) {
-      //printd(0, "qhi_priv::next() this: %p val: %d\n", this, val);
-      if (!val) {
-	 if (ml.begin() != ml.end()) {
-	    i = ml.begin();
-	    val = true;
-	 }
+   // maps the current position to a member if the hash lost its shared key layout while being iterated
+   DLLLOCAL void sync(const qore_hash_private& h) {
+      if (val && !i && !h.shape) {
+         assert(spos < h.member_list.size());
+         i = h.member_list[spos];
       }
-      else {
-	 ++i;
-	 if (i == ml.end())
-	    val = false;
+   }
+
+   DLLLOCAL bool next(const qore_hash_private& h) {
+      //printd(0, "qhi_priv::next() this: %p val: %d\n", this, val);
+      if (h.shape) {
+         if (!val) {
+            spos = 0;
+            val = h.len ? true : false;
+         }
+         else if (++spos == h.len)
+            val = false;
+         return val;
       }
+
+      sync(h);
+      i = val ? h.nextMember(i->pos + 1) : h.firstMember();
+      val = i ? true : false;
       return val;
    }
 
-   DLLLOCAL bool prev(qhlist_t& ml) {
-      if (!val) {
-	 if (ml.begin() != ml.end()) {
-	    i = ml.end();
-	    --i;
-	    val = true;
-	 }
-      }
-      else {
-	 if (i == ml.begin())
-	    val = false;
-	 else
-	    --i;
+   DLLLOCAL bool prev(const qore_hash_private& h) {
+      if (h.shape) {
+         if (!val) {
+            spos = h.len - 1;
+            val = h.len ? true : false;
+         }
+         else if (!spos)
+            val = false;
+         else
+            --spos;
+         return val;
       }
+
+      sync(h);
+      i = val ? h.prevMember(i->pos) : h.lastMember();
+      val = i ? true : false;
       return val;
    }
 
+   DLLLOCAL bool first(const qore_hash_private& h) {
+      if (!val)
+         return false;
+      if (h.shape)
+         return !spos;
+      sync(h);
+      return !h.prevMember(i->pos);
+   }
+
+   DLLLOCAL bool last(const qore_hash_private& h) {
+      if (!val)
+         return false;
+      if (h.shape)
+         return spos == h.len - 1;
+      sync(h);
+      return !h.nextMember(i->pos + 1);
+   }
+
+   DLLLOCAL const char* getKey(const qore_hash_private& h) {
+      assert(val);
+      if (h.shape)
+         return h.shape->keys[spos].c_str();
+      sync(h);
+      return i->key.c_str();
+   }
+
+   DLLLOCAL AbstractQoreNode** getValuePtr(const qore_hash_private& h) {
+      assert(val);
+      if (h.shape)
+         return &h.shape_values[spos];
+      sync(h);
+      return &i->node;
+   }
+
+   // returns the current member, converting a hash with a shared key layout to a normal hash first
+   DLLLOCAL HashMember* getMember(qore_hash_private& h) {
+      assert(val);
+      if (h.shape)
+         h.unshape();
+      sync(h);
+      return i;
+   }
+
    DLLLOCAL void reset() {
       val = false;
+      i = 0;
    }
 };
 
@@ -628,49 +716,49 @@ QoreHashNode* HashIterator::getHash() const {
 }
 
 AbstractQoreNode* HashIterator::getReferencedValue() const {
-   return !priv->valid() || !(*(priv->i))->node ? 0 : (*(priv->i))->node->refSelf();
+   if (!priv->valid())
+      return 0;
+
+   AbstractQoreNode* n = *priv->getValuePtr(*h->priv);
+   return n ? n->refSelf() : 0;
 }
 
 QoreString* HashIterator::getKeyString() const {
-   return !priv->valid() ? 0 : new QoreString((*(priv->i))->key);
+   return !priv->valid() ? 0 : new QoreString(priv->getKey(*h->priv));
 }
 
 bool HashIterator::next() {
-   return h ? priv->next(h->priv->member_list) : false;
+   return h ? priv->next(*h->priv) : false;
 }
 
 bool HashIterator::prev() {
-   return h ? priv->prev(h->priv->member_list) : false;
+   return h ? priv->prev(*h->priv) : false;
 }
 
 const char* HashIterator::getKey() const {
    if (!priv->valid())
       return 0;
 
-   return (*(priv->i))->key.c_str();
+   return priv->getKey(*h->priv);
 }
 
 AbstractQoreNode* HashIterator::getValue() const {
    if (!priv->valid())
       return 0;
 
-   return (*(priv->i))->node;
+   return *priv->getValuePtr(*h->priv);
 }
 
 AbstractQoreNode* HashIterator::takeValueAndDelete() {
    if (!priv->valid())
       return 0;
 
-   AbstractQoreNode* rv = (*(priv->i))->node;
-   (*(priv->i))->node = 0;
+   HashMember* ni = priv->getMember(*h->priv);
+   AbstractQoreNode* rv = ni->node;
+   ni->node = 0;
 
-   qhlist_t::iterator ni = priv->i;
-   priv->prev(h->priv->member_list);
+   priv->prev(*h->priv);
 
-   // remove key from map before deleting hash member with key pointer
-   hm_hm_t::iterator i = h->priv->hm.find((*ni)->key.c_str());
-   assert(i != h->priv->hm.end());
-   h->priv->hm.erase(i);
    h->priv->internDeleteKey(ni);
 
    return rv;
@@ -680,15 +768,12 @@ void HashIterator::deleteKey(ExceptionSink* xsink) {
    if (!priv->valid())
       return;
 
-   discard((*(priv->i))->node, xsink);
-   (*(priv->i))->node = 0;
+   HashMember* ni = priv->getMember(*h->priv);
+   discard(ni->node, xsink);
+   ni->node = 0;
 
-   qhlist_t::iterator ni = priv->i;
-   priv->prev(h->priv->member_list);
+   priv->prev(*h->priv);
 
-   hm_hm_t::iterator i = h->priv->hm.find((*ni)->key.c_str());
-   assert(i != h->priv->hm.end());
-   h->priv->hm.erase(i);
    h->priv->internDeleteKey(ni);
 }
 
@@ -697,23 +782,15 @@ AbstractQoreNode** HashIterator::getValuePtr() const {
    if (!priv->valid())
       return 0;
 
-   return &((*(priv->i))->node);
+   return priv->getValuePtr(*h->priv);
 }
 
 bool HashIterator::last() const {
-   if (!priv->valid())
-      return false;
-
-   qhlist_t::const_iterator ni = priv->i;
-   ++ni;
-   return ni == h->priv->member_list.end() ? true : false;
+   return priv->last(*h->priv);
 }
 
 bool HashIterator::first() const {
-   if (!priv->valid())
-      return false;
-
-   return priv->i == h->priv->member_list.begin();
+   return priv->first(*h->priv);
 }
 
 bool HashIterator::empty() const {
@@ -767,48 +844,44 @@ const QoreHashNode* ConstHashIterator::getHash() const {
 }
 
 AbstractQoreNode* ConstHashIterator::getReferencedValue() const {
-   return !priv->valid() || !(*(priv->i))->node ? 0 : (*(priv->i))->node->refSelf();
+   if (!priv->valid())
+      return 0;
+
+   AbstractQoreNode* n = *priv->getValuePtr(*h->priv);
+   return n ? n->refSelf() : 0;
 }
 
 QoreString* ConstHashIterator::getKeyString() const {
-   return !priv->valid() ? 0 : new QoreString((*(priv->i))->key);
+   return !priv->valid() ? 0 : new QoreString(priv->getKey(*h->priv));
 }
 
 bool ConstHashIterator::next() {
-   return h ? priv->next(h->priv->member_list) : false;
+   return h ? priv->next(*h->priv) : false;
 }
 
 bool ConstHashIterator::prev() {
-   return h ? priv->prev(h->priv->member_list) : false;
+   return h ? priv->prev(*h->priv) : false;
 }
 
 const char* ConstHashIterator::getKey() const {
    if (!priv->valid())
       return 0;
-   return (*(priv->i))->key.c_str();
+   return priv->getKey(*h->priv);
 }
 
 const AbstractQoreNode* ConstHashIterator::getValue() const {
    if (!priv->valid())
       return 0;
 
-   return (*(priv->i))->node;
+   return *priv->getValuePtr(*h->priv);
 }
 
 bool ConstHashIterator::last() const {
-   if (!priv->valid())
-      return false;
-
-   qhlist_t::const_iterator ni = priv->i;
-   ++ni;
-   return ni == h->priv->member_list.end() ? true : false;
+   return priv->last(*h->priv);
 }
 
 bool ConstHashIterator::first() const {
-   if (!priv->valid())
-      return false;
-
-   return priv->i == h->priv->member_list.begin();
+   return priv->first(*h->priv);
 }
 
 bool ConstHashIterator::empty() const {
@@ -848,42 +921,42 @@ bool ReverseConstHashIterator::prev() {
    return ConstHashIterator::next();
 }
 
-hash_assignment_priv::hash_assignment_priv(qore_hash_private& n_h, const char* key, bool must_already_exist, qore_object_private* obj) : h(n_h), om(must_already_exist ? h.findMember(key) : h.findCreateMember(key)), o(obj) {
+hash_assignment_priv::hash_assignment_priv(qore_hash_private& n_h, const char* key, bool must_already_exist, qore_object_private* obj) : h(n_h), vp(must_already_exist ? h.findValuePtr(key) : h.findCreateValuePtr(key)), o(obj) {
 }
 
-hash_assignment_priv::hash_assignment_priv(QoreHashNode& n_h, const char* key, bool must_already_exist) : h(*n_h.priv), om(must_already_exist ? h.findMember(key) : h.findCreateMember(key)) {
+hash_assignment_priv::hash_assignment_priv(QoreHashNode& n_h, const char* key, bool must_already_exist) : h(*n_h.priv), vp(must_already_exist ? h.findValuePtr(key) : h.findCreateValuePtr(key)) {
 }
 
-hash_assignment_priv::hash_assignment_priv(QoreHashNode& n_h, const std::string& key, bool must_already_exist) : h(*n_h.priv), om(must_already_exist ? h.findMember(key.c_str()) : h.findCreateMember(key.c_str())) {
+hash_assignment_priv::hash_assignment_priv(QoreHashNode& n_h, const std::string& key, bool must_already_exist) : h(*n_h.priv), vp(must_already_exist ? h.findValuePtr(key.c_str()) : h.findCreateValuePtr(key.c_str())) {
 }
 
-hash_assignment_priv::hash_assignment_priv(ExceptionSink* xsink, QoreHashNode& n_h, const QoreString& key, bool must_already_exist) : h(*n_h.priv), om(0) {
+hash_assignment_priv::hash_assignment_priv(ExceptionSink* xsink, QoreHashNode& n_h, const QoreString& key, bool must_already_exist) : h(*n_h.priv), vp(0) {
    TempEncodingHelper k(key, QCS_DEFAULT, xsink);
    if (*xsink)
       return;
 
-   om = must_already_exist ? h.findMember(k->getBuffer()) : h.findCreateMember(k->getBuffer());
+   vp = must_already_exist ? h.findValuePtr(k->getBuffer()) : h.findCreateValuePtr(k->getBuffer());
 }
 
-hash_assignment_priv::hash_assignment_priv(ExceptionSink* xsink, QoreHashNode& n_h, const QoreString* key, bool must_already_exist) : h(*n_h.priv), om(0) {
+hash_assignment_priv::hash_assignment_priv(ExceptionSink* xsink, QoreHashNode& n_h, const QoreString* key, bool must_already_exist) : h(*n_h.priv), vp(0) {
    TempEncodingHelper k(key, QCS_DEFAULT, xsink);
    if (*xsink)
       return;
 
-   om = must_already_exist ? h.findMember(k->getBuffer()) : h.findCreateMember(k->getBuffer());
+   vp = must_already_exist ? h.findValuePtr(k->getBuffer()) : h.findCreateValuePtr(k->getBuffer());
 }
 
 void hash_assignment_priv::reassign(const char* key, bool must_already_exist) {
-   om = must_already_exist ? h.findMember(key) : h.findCreateMember(key);
+   vp = must_already_exist ? h.findValuePtr(key) : h.findCreateValuePtr(key);
 }
 
 AbstractQoreNode* hash_assignment_priv::swapImpl(AbstractQoreNode* v) {
-   assert(om);
+   assert(vp);
    // before we can entirely get rid of QoreNothingNode, try to convert pointers to NOTHING to 0
    if (v == &Nothing)
       v = 0;
-   AbstractQoreNode* old = om->node;
-   om->node = v;
+   AbstractQoreNode* old = *vp;
+   *vp = v;
 
    bool before = needs_scan(old);
    bool after = needs_scan(v);
@@ -915,7 +988,7 @@ void hash_assignment_priv::assign(AbstractQoreNode* v, ExceptionSink* xsink) {
 }
 
 AbstractQoreNode* hash_assignment_priv::getValueImpl() const {
-   return om->node;
+   return *vp;
 }
 
 HashAssignmentHelper::HashAssignmentHelper(QoreHashNode& h, const char* key, bool must_already_exist) : priv(new hash_assignment_priv(*h.priv, key, must_already_exist)) {
@@ -940,7 +1013,7 @@ HashAssignmentHelper::HashAssignmentHelper(ExceptionSink* xsink, QoreHashNode& h
    priv = new hash_assignment_priv(*h.priv, k->getBuffer(), must_already_exist);
 }
 
-HashAssignmentHelper::HashAssignmentHelper(HashIterator &hi) : priv(new hash_assignment_priv(*hi.h->priv, *(hi.priv->i))) {
+HashAssignmentHelper::HashAssignmentHelper(HashIterator &hi) : priv(new hash_assignment_priv(*hi.h->priv, hi.priv->getValuePtr(*hi.h->priv))) {
 }
 
 HashAssignmentHelper::~HashAssignmentHelper() {
@@ -124,24 +124,28 @@ QoreValue QoreHashObjectDereferenceOperatorNode::evalValueImpl(bool& needs_deref
    if (*xsink)
       return QoreValue();
 
-   if (lh->getType() == NT_HASH) {
-      const QoreHashNode* h = lh->get<const QoreHashNode>();
+   return doHashObjectDereference(*lh, *rh, xsink);
+}
+
+QoreValue QoreHashObjectDereferenceOperatorNode::doHashObjectDereference(QoreValue lh, QoreValue rh, ExceptionSink* xsink) {
+   if (lh.getType() == NT_HASH) {
+      const QoreHashNode* h = lh.get<const QoreHashNode>();
 
-      if (rh->getType() == NT_LIST)
-	 return h->getSlice(rh->get<const QoreListNode>(), xsink);
+      if (rh.getType() == NT_LIST)
+	 return h->getSlice(rh.get<const QoreListNode>(), xsink);
 
-      QoreStringNodeValueHelper key(*rh);
+      QoreStringNodeValueHelper key(rh);
       return h->evalKeyValue(*key, xsink);
    }
-   if (lh->getType() != NT_OBJECT)
+   if (lh.getType() != NT_OBJECT)
       return QoreValue();
 
-   QoreObject* o = const_cast<QoreObject*>(lh->get<const QoreObject>());
+   QoreObject* o = const_cast<QoreObject*>(lh.get<const QoreObject>());
 
-   if (rh->getType() == NT_LIST)
-      return o->getSlice(rh->get<const QoreListNode>(), xsink);
+   if (rh.getType() == NT_LIST)
+      return o->getSlice(rh.get<const QoreListNode>(), xsink);
 
-   QoreStringNodeValueHelper key(*rh);
+   QoreStringNodeValueHelper key(rh);
    ValueHolder rv(o->evalMember(*key, xsink), xsink);
    return *xsink ? QoreValue() : rv.release();
 }
@@ -385,6 +385,33 @@ const qore_option_s qore_option_list_l[] = {
      true
 #else
      false
+#endif
+   },
+   { QORE_OPT_FUNC_MMAP,
+     "HAVE_MMAP",
+     QO_FUNCTION,
+#ifdef Q_HAVE_MMAP
+     true
+#else
+     false
+#endif
+   },
+   { QORE_OPT_ZSTD,
+     "HAVE_ZSTD",
+     QO_ALGORITHM,
+#ifdef HAVE_ZSTD
+     true
+#else
+     false
+#endif
+   },
+   { QORE_OPT_LZ4,
+     "HAVE_LZ4",
+     QO_ALGORITHM,
+#ifdef HAVE_LZ4
+     true
+#else
+     false
 #endif
    },
 };
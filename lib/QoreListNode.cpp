@@ -112,6 +112,14 @@ QoreListNode::~QoreListNode() {
    delete priv;
 }
 
+void* QoreListNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void QoreListNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
 AbstractQoreNode* QoreListNode::realCopy() const {
    return copy();
 }
@@ -40,33 +40,37 @@ QoreValue QoreMinusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    if (*xsink)
       return QoreValue();
 
-   qore_type_t lt = lh->getType();
-   qore_type_t rt = rh->getType();
+   return doMinus(*lh, *rh, xsink);
+}
+
+QoreValue QoreMinusOperatorNode::doMinus(QoreValue lh, QoreValue rh, ExceptionSink* xsink) {
+   qore_type_t lt = lh.getType();
+   qore_type_t rt = rh.getType();
 
    if (lt == NT_DATE || rt == NT_DATE) {
-      DateTimeNodeValueHelper l(*lh);
-      DateTimeValueHelper r(*rh);
+      DateTimeNodeValueHelper l(lh);
+      DateTimeValueHelper r(rh);
       return l->subtractBy(*r);
    }
 
    if (lt == NT_NUMBER || rt == NT_NUMBER) {
-      QoreNumberNodeHelper l(*lh);
-      QoreNumberNodeHelper r(*rh);
+      QoreNumberNodeHelper l(lh);
+      QoreNumberNodeHelper r(rh);
       return l->doMinus(**r);
    }
 
    if (lt == NT_FLOAT || rt == NT_FLOAT) {
-      return lh->getAsFloat() - rh->getAsFloat();
+      return lh.getAsFloat() - rh.getAsFloat();
    }
 
    if (lt == NT_INT || rt == NT_INT) {
-      return lh->getAsBigInt() - rh->getAsBigInt();
+      return lh.getAsBigInt() - rh.getAsBigInt();
    }
 
    if (lt == NT_HASH) {
       if (rt == NT_LIST) {
-	 ReferenceHolder<QoreHashNode> nh(lh->get<const QoreHashNode>()->copy(), xsink);
-	 ConstListIterator li(rh->get<const QoreListNode>());
+	 ReferenceHolder<QoreHashNode> nh(lh.get<const QoreHashNode>()->copy(), xsink);
+	 ConstListIterator li(rh.get<const QoreListNode>());
 	 while (li.next()) {
 	    QoreStringValueHelper val(li.getValue());
 
@@ -77,8 +81,8 @@ QoreValue QoreMinusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
 	 return nh.release();
       }
       if (rt == NT_STRING) {
-	 ReferenceHolder<QoreHashNode> nh(lh->get<const QoreHashNode>()->copy(), xsink);
-	 nh->removeKey(rh->get<const QoreStringNode>(), xsink);
+	 ReferenceHolder<QoreHashNode> nh(lh.get<const QoreHashNode>()->copy(), xsink);
+	 nh->removeKey(rh.get<const QoreStringNode>(), xsink);
 	 if (*xsink)
 	    return QoreValue();
 	 return nh.release();
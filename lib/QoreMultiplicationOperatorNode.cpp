@@ -40,21 +40,25 @@ QoreValue QoreMultiplicationOperatorNode::evalValueImpl(bool& needs_deref, Excep
    if (*xsink)
       return QoreValue();
 
-   qore_type_t lt = lh->getType();
-   qore_type_t rt = rh->getType();
+   return doMultiplication(*lh, *rh, xsink);
+}
+
+QoreValue QoreMultiplicationOperatorNode::doMultiplication(QoreValue lh, QoreValue rh, ExceptionSink* xsink) {
+   qore_type_t lt = lh.getType();
+   qore_type_t rt = rh.getType();
 
    if (lt == NT_NUMBER || rt == NT_NUMBER) {
-      QoreNumberNodeHelper l(*lh);
-      QoreNumberNodeHelper r(*rh);
+      QoreNumberNodeHelper l(lh);
+      QoreNumberNodeHelper r(rh);
       return l->doMultiply(**r);
    }
 
    if (lt == NT_FLOAT || rt == NT_FLOAT) {
-      return lh->getAsFloat() * rh->getAsFloat();
+      return lh.getAsFloat() * rh.getAsFloat();
    }
 
    if (lt == NT_INT || rt == NT_INT) {
-      return lh->getAsBigInt() * rh->getAsBigInt();
+      return lh.getAsBigInt() * rh.getAsBigInt();
    }
 
    return QoreValue();
@@ -46,6 +46,7 @@
 
 // include files for default object classes
 #include "qore/intern/QC_Socket.h"
+#include "qore/intern/QoreSocketPoller.h"
 #include "qore/intern/QC_SSLCertificate.h"
 #include "qore/intern/QC_SSLPrivateKey.h"
 #include "qore/intern/QC_Program.h"
@@ -143,6 +144,8 @@ DLLLOCAL QoreClass* initBufferedStreamReaderClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initTransformClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initTransformInputStreamClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initTransformOutputStreamClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initDigestClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initHmacClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initStdoutOutputStreamClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initStderrOutputStreamClass(QoreNamespace& ns);
 
@@ -808,6 +811,8 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
    qns.addSystemClass(initTransformClass(qns));
    qns.addSystemClass(initTransformInputStreamClass(qns));
    qns.addSystemClass(initTransformOutputStreamClass(qns));
+   qns.addSystemClass(initDigestClass(qns));
+   qns.addSystemClass(initHmacClass(qns));
    qns.addSystemClass(initBinaryInputStreamClass(qns));
    qns.addSystemClass(initStringInputStreamClass(qns));
    qns.addSystemClass(initFileInputStreamClass(qns));
@@ -830,6 +835,7 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
    qns.addSystemClass(initSSLCertificateClass(qns));
    qns.addSystemClass(initSSLPrivateKeyClass(qns));
    qns.addSystemClass(initSocketClass(qns));
+   qns.addSystemClass(initSocketPollerClass(qns));
    qns.addSystemClass(initProgramClass(qns));
 
    qns.addSystemClass(initTermIOSClass(qns));
@@ -32,27 +32,77 @@
 #include <qore/Qore.h>
 #include "qore/intern/qore_number_private.h"
 
+const int64 qore_pow10[QORE_NUM_SMALL_MAX_SCALE + 1] = {
+   1ll, 10ll, 100ll, 1000ll, 10000ll, 100000ll, 1000000ll, 10000000ll, 100000000ll, 1000000000ll, 10000000000ll,
+   100000000000ll, 1000000000000ll, 10000000000000ll, 100000000000000ll, 1000000000000000ll, 10000000000000000ll,
+   100000000000000000ll, 1000000000000000000ll,
+};
+
 void qore_number_private::getAsString(QoreString& str, bool round) const {
+   if (small && round && getSmallString(str))
+      return;
+
+   QoreMpfrValueHelper v(*this);
+   getMpfrString(*v, str, round);
+}
+
+bool qore_number_private::getSmallString(QoreString& str) const {
+   assert(small);
+   // the digits of the absolute value padded with leading zeros to have at least one digit before the decimal point
+   char buf[QORE_NUM_SMALL_MAX_SCALE + 22];
+   int len = ::snprintf(buf, sizeof buf, "%0*lld", (int)scale + 1, mant < 0 ? -mant : mant);
+   assert(len > scale);
+
+   int ilen = len - scale;
+   int flen = scale;
+   // trim trailing zeros after the decimal point
+   while (flen && buf[ilen + flen - 1] == '0')
+      --flen;
+
+   // values with long sequences of 0 or 9 digits after the decimal point are subject to the rounding heuristic
+   char lc = 0;
+   int cnt = 0;
+   for (int i = ilen; i < ilen + flen; ++i) {
+      if ((buf[i] == '0' || buf[i] == '9') && buf[i] == lc) {
+         if (++cnt >= QORE_MPFR_ROUND_THRESHOLD)
+            return false;
+         continue;
+      }
+      lc = buf[i];
+      cnt = 1;
+   }
+
+   if (mant < 0)
+      str.concat('-');
+   str.concat(buf, ilen);
+   if (flen) {
+      str.concat('.');
+      str.concat(buf + ilen, flen);
+   }
+   return true;
+}
+
+void qore_number_private::getMpfrString(mpfr_srcptr x, QoreString& str, bool round) {
    // first check for zero
-   if (zero()) {
+   if (mpfr_zero_p(x)) {
       str.concat("0");
       return;
    }
 
    mpfr_exp_t exp;
 
-   char* buf = mpfr_get_str(0, &exp, 10, 0, num, QORE_MPFR_RND);
+   char* buf = mpfr_get_str(0, &exp, 10, 0, x, QORE_MPFR_RND);
    if (!buf) {
       numError(str);
       return;
    }
    ON_BLOCK_EXIT(mpfr_free_str, buf);
 
-   //printd(5, "qore_number_private::getAsString(round: %d) this: %p buf: '%s'\n", round, this, buf);
+   //printd(5, "qore_number_private::getMpfrString(round: %d) buf: '%s'\n", round, buf);
 
    // if it's a regular number, then format accordingly
-   if (number()) {
-      int sgn = sign();
+   if (mpfr_number_p(x)) {
+      int sgn = mpfr_sgn(x);
       qore_size_t len = str.size() + (sgn < 0 ? 1 : 0);
       //printd(5, "qore_number_private::getAsString() this: %p '%s' exp " QLLD " len: " QLLD "\n", this, buf, exp, len);
 
@@ -431,6 +481,14 @@ QoreNumberNode::~QoreNumberNode() {
    delete priv;
 }
 
+void* QoreNumberNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void QoreNumberNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
 // get the value of the type in a string context (default implementation = del = false and returns NullString)
 // if del is true, then the returned QoreString * should be deleted, if false, then it must not be
 // use the QoreStringValueHelper class (defined in QoreStringNode.h) instead of using this function directly
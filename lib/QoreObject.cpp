@@ -177,9 +177,8 @@ void qore_object_private::merge(qore_object_private& o, AutoVLock& vl, Exception
       mergeIntern(xsink, *new_data, check_recursive, holder, class_ctx, *new_internal_data);
    }
 
-   if (check_recursive) {
-      RSetHelper orsh(*this);
-   }
+   if (check_recursive)
+      scanRSet();
 }
 
 void qore_object_private::merge(const QoreHashNode* h, AutoVLock& vl, ExceptionSink* xsink) {
@@ -204,9 +203,8 @@ void qore_object_private::merge(const QoreHashNode* h, AutoVLock& vl, ExceptionS
       mergeIntern(xsink, h, check_recursive, holder, class_ctx);
    }
 
-   if (check_recursive) {
-      RSetHelper orsh(*this);
-   }
+   if (check_recursive)
+      scanRSet();
 }
 
 void qore_object_private::mergeIntern(ExceptionSink* xsink, const QoreHashNode* h, bool& check_recursive, ReferenceHolder<QoreListNode>& holder, const qore_class_private* class_ctx, const QoreHashNode* new_internal_data) {
@@ -474,15 +472,16 @@ int qore_object_private::getLValue(const char* key, LValueHelper& lvh, const qor
 
    //printd(5, "qore_object_private::getLValue() this: %p %s::%s type %s for_remove: %d int: %d odata: %p\n", this, theclass->getName(), key, mti->getName(), for_remove, internal_member, odata);
 
-   HashMember* m;
    if (for_remove) {
-      m = odata->priv->findMember(key);
+      HashMember* m = odata->priv->findMember(key);
       if (!m)
          return -1;
+      lvh.setPtr(m->node);
+      return 0;
    }
-   else
-      m = odata->priv->findCreateMember(key);
-   lvh.setPtr(m->node);
+
+   // keeps the shared member layout if the member already exists
+   lvh.setPtr(*odata->priv->findCreateValuePtr(key));
    return 0;
 }
 
@@ -507,6 +506,88 @@ AbstractQoreNode* qore_object_private::getReferencedMemberNoMethod(const char* m
    return rv;
 }
 
+AbstractQoreNode* qore_object_private::getReferencedMemberNoMethod(const char* mem, MemberSlotCache& cache, ExceptionSink* xsink) const {
+   const qore_class_private* cls = qore_class_private::get(*theclass);
+   InlineCacheKey k(cls, runtime_get_class());
+
+   // if the object has the member layout cached for the class and class context, then the member is read by position
+   const MemberSlotEntry* e = cache.find(k);
+   if (e) {
+      QoreSafeVarRWReadLocker sl(rml);
+
+      if (status != OS_DELETED && data && data->priv->shape == e->shape) {
+         AbstractQoreNode* rv = data->priv->shape_values[e->idx];
+         return rv ? rv->refSelf() : 0;
+      }
+   }
+
+   const qore_class_private* class_ctx = k.ctx;
+   if (class_ctx && !qore_class_private::runtimeCheckPrivateClassAccess(*theclass, class_ctx))
+      class_ctx = 0;
+
+   // internal members are stored separately and are not cached
+   if ((class_ctx && class_ctx->runtimeIsMemberInternal(mem)) || e || !cache.canAdd())
+      return getReferencedMemberNoMethod(mem, xsink);
+
+   QoreHashShape* shape = 0;
+   int idx = -1;
+   AbstractQoreNode* rv = 0;
+   {
+      QoreSafeVarRWReadLocker sl(rml);
+
+      if (status == OS_DELETED) {
+         makeAccessDeletedObjectException(xsink, mem, theclass->getName());
+         return 0;
+      }
+
+      if (data) {
+         shape = data->priv->shape;
+         if (shape) {
+            size_t klen = strlen(mem);
+            idx = shape->find(mem, klen, qore_hash_private::hashKey(mem, klen));
+            if (idx >= 0)
+               shape->ref();
+         }
+
+         rv = data->getReferencedKeyValue(mem);
+      }
+   }
+
+   if (idx >= 0)
+      cache.add(new MemberSlotEntry(k, shape, idx));
+
+   return rv;
+}
+
+void qore_object_private::adoptMemberShape(const qore_class_private& cls) {
+   QoreSafeVarRWWriteLocker sl(rml);
+
+   if (status == OS_DELETED || !data || !data->priv->len)
+      return;
+
+   // the layout of the first object constructed is used for the class
+   QoreHashShape* s = cls.member_shape.load(std::memory_order_acquire);
+   if (!s) {
+      if (data->priv->shape)
+         return;
+      s = new QoreHashShape(*data->priv);
+      QoreHashShape* old = 0;
+      if (!cls.member_shape.compare_exchange_strong(old, s, std::memory_order_acq_rel)) {
+         s->deref();
+         s = old;
+      }
+   }
+
+   data->priv->adoptShape(s);
+}
+
+MemberSlotEntry::MemberSlotEntry(const InlineCacheKey& k, QoreHashShape* s, unsigned i) : InlineCacheKey(k), shape(s), idx(i) {
+}
+
+MemberSlotEntry::~MemberSlotEntry() {
+   shape->deref();
+}
+
 void qore_object_private::setValue(const char* key, AbstractQoreNode* val, ExceptionSink* xsink) {
    // get the current class context
    const qore_class_private* class_ctx = runtime_get_class();
@@ -558,7 +639,7 @@ void qore_object_private::setValueIntern(const qore_class_private* class_ctx, co
 
    // scan object if necessary
    if (before || after)
-      RSetHelper rsh(*this);
+      scanRSet();
 }
 
 // helper function for QoreObject::evalBuiltinMethodWithPrivateData() variations
@@ -671,6 +752,9 @@ void qore_object_private::customDeref(bool do_scan, ExceptionSink* xsink) {
                }
             }
             if (recalc) {
+               // let the background collector recalculate the rset if enabled; it releases its reference when done
+               if (QCC.deferScan() && QCC.queue(*this))
+                  return;
                // recalculate rset
                RSetHelper rsh(*this);
                continue;
@@ -680,6 +764,7 @@ void qore_object_private::customDeref(bool do_scan, ExceptionSink* xsink) {
 
             qodh.willDelete();
             rrf = true;
+            QCC.cycleFreed();
             break;
          }
       }
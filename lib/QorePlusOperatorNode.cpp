@@ -41,36 +41,40 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    if (*xsink)
       return QoreValue();
 
-   qore_type_t lt = lh->getType();
-   qore_type_t rt = rh->getType();
+   return doPlus(*lh, *rh, xsink);
+}
+
+QoreValue QorePlusOperatorNode::doPlus(QoreValue lh, QoreValue rh, ExceptionSink* xsink) {
+   qore_type_t lt = lh.getType();
+   qore_type_t rt = rh.getType();
 
    if (lt == NT_LIST) {
-      const QoreListNode* l = lh->get<const QoreListNode>();
+      const QoreListNode* l = lh.get<const QoreListNode>();
       QoreListNode* rv = l->copy();
       if (rt == NT_LIST)
-	 rv->merge(rh->get<const QoreListNode>());
+	 rv->merge(rh.get<const QoreListNode>());
       else
-	 rv->push(rh->getReferencedValue());
+	 rv->push(rh.getReferencedValue());
       //printd(5, "QorePlusOperatorNode::evalValueImpl() returning list=%p size=%d\n", rv, rv->size());
       return rv;
    }
 
    if (rt == NT_LIST) {
-      const QoreListNode* r = rh->get<const QoreListNode>();
+      const QoreListNode* r = rh.get<const QoreListNode>();
 
       QoreListNode* rv = new QoreListNode;
-      rv->push(lh->getReferencedValue());
+      rv->push(lh.getReferencedValue());
       rv->merge(r);
       return rv;
    }
 
    if (lt == NT_STRING) {
-      QoreStringNodeHolder str(new QoreStringNode(*lh->get<const QoreStringNode>()));
+      QoreStringNodeHolder str(new QoreStringNode(*lh.get<const QoreStringNode>()));
 
       if (rt == NT_STRING)
-	 str->concat(rh->get<const QoreStringNode>(), xsink);
+	 str->concat(rh.get<const QoreStringNode>(), xsink);
       else {
-	 QoreStringValueHelper r(*rh, str->getEncoding(), xsink);
+	 QoreStringValueHelper r(rh, str->getEncoding(), xsink);
 	 if (*xsink)
 	    return QoreValue();
 	 str->concat(*r, xsink);
@@ -79,8 +83,8 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    }
 
    if (rt == NT_STRING) {
-      const QoreStringNode* r = rh->get<const QoreStringNode>();
-      QoreStringNodeValueHelper strval(*lh, r->getEncoding(), xsink);
+      const QoreStringNode* r = rh.get<const QoreStringNode>();
+      QoreStringNodeValueHelper strval(lh, r->getEncoding(), xsink);
       if (*xsink)
          return QoreValue();
       SimpleRefHolder<QoreStringNode> str(strval->is_unique() ? strval.getReferencedValue() : new QoreStringNode(*strval));
@@ -95,29 +99,29 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    }
 
    if (lt == NT_DATE || rt == NT_DATE) {
-      DateTimeNodeValueHelper l(*lh);
-      DateTimeValueHelper r(*rh);
+      DateTimeNodeValueHelper l(lh);
+      DateTimeValueHelper r(rh);
       return l->add(*r);
    }
 
    if (lt == NT_NUMBER || rt == NT_NUMBER) {
-      QoreNumberNodeHelper l(*lh);
-      QoreNumberNodeHelper r(*rh);
+      QoreNumberNodeHelper l(lh);
+      QoreNumberNodeHelper r(rh);
       return l->doPlus(**r);
    }
 
    if (lt == NT_FLOAT || rt == NT_FLOAT) {
-      return lh->getAsFloat() + rh->getAsFloat();
+      return lh.getAsFloat() + rh.getAsFloat();
    }
 
    if (lt == NT_INT || rt == NT_INT) {
-      return lh->getAsBigInt() + rh->getAsBigInt();
+      return lh.getAsBigInt() + rh.getAsBigInt();
    }
 
    if (lt == NT_HASH) {
-      const QoreHashNode* l = lh->get<const QoreHashNode>();
+      const QoreHashNode* l = lh.get<const QoreHashNode>();
       if (rt == NT_HASH) {
-	 const QoreHashNode* r = rh->get<const QoreHashNode>();
+	 const QoreHashNode* r = rh.get<const QoreHashNode>();
 	 ReferenceHolder<QoreHashNode> rv(l->copy(), xsink);
 	 rv->merge(r, xsink);
 	 if (*xsink)
@@ -125,7 +129,7 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
 	 return rv.release();
       }
       if (rt == NT_OBJECT) {
-	 QoreObject* r = rh->get<QoreObject>();
+	 QoreObject* r = rh.get<QoreObject>();
 	 ReferenceHolder<QoreHashNode> rv(l->copy(), xsink);
 	 qore_object_private::get(*r)->mergeDataToHash(*rv, xsink);
 	 if (*xsink)
@@ -137,10 +141,10 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    }
 
    if (lt == NT_OBJECT) {
-      QoreObject* l = lh->get<QoreObject>();
+      QoreObject* l = lh.get<QoreObject>();
       if (rt != NT_HASH)
 	 return l->refSelf();
-      const QoreHashNode* r = rh->get<const QoreHashNode>();
+      const QoreHashNode* r = rh.get<const QoreHashNode>();
 
       ReferenceHolder<QoreHashNode> h(qore_object_private::get(*l)->getRuntimeMemberHash(xsink), xsink);
       if (*xsink)
@@ -154,20 +158,20 @@ QoreValue QorePlusOperatorNode::evalValueImpl(bool& needs_deref, ExceptionSink*
    }
 
    if (rt == NT_HASH || rt == NT_OBJECT) {
-      return rh->getReferencedValue();
+      return rh.refSelf();
    }
 
    if (lt == NT_BINARY) {
       if (rt != NT_BINARY)
-	 return lh->getReferencedValue();
+	 return lh.getReferencedValue();
 
-      BinaryNode* rv = lh->get<const BinaryNode>()->copy();
-      rv->append(rh->get<const BinaryNode>());
+      BinaryNode* rv = lh.get<const BinaryNode>()->copy();
+      rv->append(rh.get<const BinaryNode>());
       return rv;
    }
 
    if (rt == NT_BINARY) {
-      return rh->getReferencedValue();
+      return rh.refSelf();
    }
 
    return QoreValue();
@@ -129,6 +129,7 @@ ParseOptionMaps::ParseOptionMaps() {
       doMap(PO_BROKEN_LIST_PARSING, "PO_BROKEN_LIST_PARSING");
       doMap(PO_BROKEN_LOGIC_PRECEDENCE, "PO_BROKEN_LOGIC_PRECEDENCE");
       doMap(PO_BROKEN_LOOP_STATEMENT, "PO_BROKEN_LOOP_STATEMENT");
+      doMap(PO_BYTECODE, "PO_BYTECODE");
 }
 
 QoreHashNode* ParseOptionMaps::getCodeToStringMap() const {
@@ -350,6 +351,9 @@ void qore_program_private::waitForTerminationAndClear(ExceptionSink* xsink) {
    }
 
    if (clr) {
+      // run any deferred cycle scans in this thread while the program's data is destroyed
+      QoreCycleCollectorSyncHelper gcsh(xsink, pgm);
+
       // purge thread resources before clearing pgm
       purge_pgm_thread_resources(pgm, xsink);
 
@@ -657,6 +661,9 @@ void qore_program_private::del(ExceptionSink* xsink) {
    if (thr_init)
       thr_init->deref(xsink);
 
+   // run any deferred cycle scans in this thread while the program's data is destroyed
+   QoreCycleCollectorSyncHelper gcsh(xsink, pgm);
+
    if (base_object) {
       deleteThreadData(xsink);
 
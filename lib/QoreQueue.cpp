@@ -34,6 +34,9 @@
 
 #include <sys/time.h>
 #include <errno.h>
+#include <sched.h>
+
+#include <new>
 
 void Queue::deref(ExceptionSink* xsink) {
    if (ROdereference()) {
@@ -44,6 +47,7 @@ void Queue::deref(ExceptionSink* xsink) {
 
 void qore_queue_private::destructor(ExceptionSink* xsink) {
    AutoLocker al(&l);
+   disableFast();
    if (read_waiting) {
       xsink->raiseException("QUEUE-ERROR", "Queue deleted while there %s %d waiting thread%s for reading", read_waiting == 1 ? "is" : "are", read_waiting, read_waiting == 1 ? "" : "s");
       read_cond.broadcast();
@@ -62,19 +66,104 @@ void qore_queue_private::destructor(ExceptionSink* xsink) {
 }
 
 void qore_queue_private::clearIntern(ExceptionSink* xsink) {
-   while (head) {
-      printd(5, "qore_queue_private::clearIntern() this: %p deleting %p (node %p type %s)\n", this, head, head->node, get_node_type(head->node));
-      QoreQueueNode* w = head->next;
-      head->del(xsink);
-      head = w;
+   for (int i = 0; i < len; ++i) {
+      AbstractQoreNode* n = at(i);
+      printd(5, "qore_queue_private::clearIntern() this: %p deleting %p type %s\n", this, n, get_node_type(n));
+      if (n)
+         n->deref(xsink);
+   }
+   free(buf);
+   buf = 0;
+   cap = 0;
+   first = 0;
+}
+
+bool qore_queue_private::fastPush(AbstractQoreNode* v) {
+   unsigned pos = ftail.load(std::memory_order_relaxed);
+   while (true) {
+      fast_cell& c = fbuf[pos & (QQ_FAST_CAPACITY - 1)];
+      int dif = (int)(c.seq.load(std::memory_order_acquire) - pos);
+      if (!dif) {
+         if (ftail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            c.val = v;
+            c.seq.store(pos + 1, std::memory_order_release);
+            return true;
+         }
+      }
+      // the ring is full
+      else if (dif < 0)
+         return false;
+      else
+         pos = ftail.load(std::memory_order_relaxed);
+   }
+}
+
+bool qore_queue_private::fastShift(AbstractQoreNode*& v) {
+   unsigned pos = fhead.load(std::memory_order_relaxed);
+   while (true) {
+      fast_cell& c = fbuf[pos & (QQ_FAST_CAPACITY - 1)];
+      int dif = (int)(c.seq.load(std::memory_order_acquire) - (pos + 1));
+      if (!dif) {
+         if (fhead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            v = c.val;
+            c.seq.store(pos + QQ_FAST_CAPACITY, std::memory_order_release);
+            return true;
+         }
+      }
+      // the ring is empty
+      else if (dif < 0)
+         return false;
+      else
+         pos = fhead.load(std::memory_order_relaxed);
    }
-   head = 0;
-   tail = 0;
+}
+
+void qore_queue_private::disableFast() {
+   // the lock-free ring is only enabled and disabled in the lock, so it's empty if it's disabled
+   if (!fast)
+      return;
+
+   // a lock-free operation first registers itself in factive and then checks the flag, so after the flag is cleared,
+   // no new operations can start; the operations in progress never block and are waited for here
+   fast = false;
+   while (factive)
+      sched_yield();
+
+   // the locked ring is empty while the lock-free ring is enabled, so the order of the elements is retained
+   assert(!len);
+   AbstractQoreNode* v;
+   while (fastShift(v))
+      pushNode(v);
+}
+
+void qore_queue_private::enableFast() {
+   if (fast || len || max != -1 || read_waiting || write_waiting || !err.empty())
+      return;
+
+   if (!fbuf) {
+      fbuf = (fast_cell*)malloc(sizeof(fast_cell) * QQ_FAST_CAPACITY);
+      for (unsigned i = 0; i < QQ_FAST_CAPACITY; ++i)
+         new (&fbuf[i].seq) std::atomic<unsigned>(fhead + i);
+   }
+   fast = true;
+}
+
+void qore_queue_private::resize(unsigned n_cap) {
+   assert(n_cap >= (unsigned)len);
+   assert(!(n_cap & (n_cap - 1)));
+   AbstractQoreNode** nbuf = (AbstractQoreNode**)malloc(sizeof(AbstractQoreNode*) * n_cap);
+   // copy the elements in order to the start of the new buffer
+   for (int i = 0; i < len; ++i)
+      nbuf[i] = at(i);
+   free(buf);
+   buf = nbuf;
+   cap = n_cap;
+   first = 0;
 }
 
 int qore_queue_private::waitReadIntern(ExceptionSink *xsink, int timeout_ms) {
    // if there is no data, then wait for condition variable
-   while (!head) {
+   while (!len) {
       if (!err.empty()) {
          xsink->raiseException(err.c_str(), desc->stringRefSelf());
          return QW_ERROR;
@@ -147,23 +236,15 @@ int qore_queue_private::waitWriteIntern(ExceptionSink *xsink, int timeout_ms) {
 }
 
 void qore_queue_private::pushNode(AbstractQoreNode* v) {
-   if (!head) {
-      head = new QoreQueueNode(v, 0, 0);
-      tail = head;
-   }
-   else {
-      QoreQueueNode* qn = new QoreQueueNode(v, tail, 0);
-      tail->next = qn;
-      tail = qn;
-   }
-   ++len;
+   grow();
+   at(len++) = v;
 
-   //printd(5, "qore_queue_private::pushNode(%p '%s') this: %p head: %p (%p) tail: %p (%p) read_waiting: %d len: %d\n", v, get_type_name(v), this, head, head->node, tail, tail->node, read_waiting, len);
+   //printd(5, "qore_queue_private::pushNode(%p '%s') this: %p read_waiting: %d len: %d\n", v, get_type_name(v), this, read_waiting, len);
 }
 
 void qore_queue_private::pushIntern(AbstractQoreNode* v) {
    pushNode(v);
-   //printd(5, "qore_queue_private::push_internal(%p) this: %p head: %p (%p) tail: %p (%p) waiting: %d len: %d\n", v, this, head, head->node, tail, tail->node, waiting, len);
+   //printd(5, "qore_queue_private::push_internal(%p) this: %p waiting: %d len: %d\n", v, this, waiting, len);
 
    // signal waiting thread to wakeup and process event
    if (read_waiting)
@@ -171,24 +252,34 @@ void qore_queue_private::pushIntern(AbstractQoreNode* v) {
 }
 
 void qore_queue_private::insertIntern(AbstractQoreNode* v) {
-   if (!head) {
-      head = new QoreQueueNode(v, 0, 0);
-      tail = head;
-   }
-   else {
-      QoreQueueNode* qn = new QoreQueueNode(v, 0, head);
-      head->prev = qn;
-      head = qn;
-   }
+   grow();
+   first = (first - 1) & (cap - 1);
+   buf[first] = v;
    len++;
 
-   //printd(5, "qore_queue_private::insertIntern(%p) this: %p head: %p (%p) tail: %p (%p) waiting: %d len: %d\n", v, this, head, head->node, tail, tail->node, waiting, len);
+   //printd(5, "qore_queue_private::insertIntern(%p) this: %p waiting: %d len: %d\n", v, this, waiting, len);
 
    // signal waiting thread to wakeup and process event
    if (read_waiting)
       read_cond.signal();
 }
 
+AbstractQoreNode* qore_queue_private::shiftIntern() {
+   assert(len > 0);
+   AbstractQoreNode* rv = buf[first];
+   first = (first + 1) & (cap - 1);
+   --len;
+   shrink();
+   return rv;
+}
+
+AbstractQoreNode* qore_queue_private::popIntern() {
+   assert(len > 0);
+   AbstractQoreNode* rv = at(--len);
+   shrink();
+   return rv;
+}
+
 int qore_queue_private::checkWriteIntern(ExceptionSink* xsink, bool always_error) {
    if (len == Queue_Deleted) {
       if (always_error)
@@ -207,6 +298,8 @@ void qore_queue_private::pushAndTakeRef(AbstractQoreNode* n) {
    if (len == Queue_Deleted || !err.empty())
       return;
 
+   disableFast();
+
    assert(max == -1);
 
    printd(5, "qore_queue_private::pushAndTakeRef(%p) this: %p\n", n, this);
@@ -214,14 +307,29 @@ void qore_queue_private::pushAndTakeRef(AbstractQoreNode* n) {
    pushIntern(n);
 }
 
+// push() and shift() first try the lock-free ring, which is enabled while an unbounded queue has no waiting threads,
+// no error, and no elements in the locked ring; a full or empty lock-free ring, and all other operations, take the
+// lock and move the elements of the lock-free ring to the locked ring first, which then handles waiting, timeouts,
+// errors and the maximum size as before
 void qore_queue_private::push(ExceptionSink* xsink, AbstractQoreNode* n, int timeout_ms, bool& to) {
    to = false;
+
+   if (fast.load(std::memory_order_relaxed)) {
+      ++factive;
+      bool rc = fast && fastPush(n);
+      --factive;
+      if (rc)
+         return;
+   }
+
    ReferenceHolder<> holder(n, xsink);
 
    AutoLocker al(&l);
    if (checkWriteIntern(xsink))
       return;
 
+   disableFast();
+
    {
       int rc = waitWriteIntern(xsink, timeout_ms);
       if (rc == QW_TIMEOUT)
@@ -241,6 +349,8 @@ void qore_queue_private::insert(ExceptionSink* xsink, AbstractQoreNode* n, int t
    if (checkWriteIntern(xsink))
       return;
 
+   disableFast();
+
    {
       int rc = waitWriteIntern(xsink, timeout_ms);
       if (rc == QW_TIMEOUT)
@@ -254,13 +364,25 @@ void qore_queue_private::insert(ExceptionSink* xsink, AbstractQoreNode* n, int t
 
 AbstractQoreNode* qore_queue_private::shift(ExceptionSink* xsink, int timeout_ms, bool& to) {
    to = false;
+
+   if (fast.load(std::memory_order_relaxed)) {
+      ++factive;
+      AbstractQoreNode* rv;
+      bool rc = fast && fastShift(rv);
+      --factive;
+      if (rc)
+         return rv;
+   }
+
    SafeLocker sl(&l);
 
    if (checkWriteIntern(xsink, true))
       return 0;
 
+   disableFast();
+
 #ifdef DEBUG
-   //if (!head) printd(5, "qore_queue_private::shift(timeout_ms: %d) WAITING this: %p head: %p tail: %p waiting: %d len: %d\n", timeout_ms, this, head, tail, waiting, len);
+   //if (!len) printd(5, "qore_queue_private::shift(timeout_ms: %d) WAITING this: %p waiting: %d len: %d\n", timeout_ms, this, waiting, len);
 #endif
 
    {
@@ -271,21 +393,15 @@ AbstractQoreNode* qore_queue_private::shift(ExceptionSink* xsink, int timeout_ms
          return 0;
    }
 
-   //printd(5, "qore_queue_private::shift() GOT DATA this: %p head: %p (rv: %p '%s') tail: %p (%p) write_waiting: %d len: %d\n", this, head, head->node, get_type_name(head->node), tail, tail->node, write_waiting, len);
-
-   QoreQueueNode* n = head;
-   head = head->next;
-   if (!head)
-      tail = 0;
-   else
-      head->prev = 0;
+   //printd(5, "qore_queue_private::shift() GOT DATA this: %p write_waiting: %d len: %d\n", this, write_waiting, len);
 
-   len--;
+   AbstractQoreNode* rv = shiftIntern();
    if (write_waiting)
       write_cond.signal();
+   else
+      enableFast();
 
-   sl.unlock();
-   return n->takeAndDel();
+   return rv;
 }
 
 AbstractQoreNode* qore_queue_private::pop(ExceptionSink* xsink, int timeout_ms, bool& to) {
@@ -295,6 +411,8 @@ AbstractQoreNode* qore_queue_private::pop(ExceptionSink* xsink, int timeout_ms,
    if (checkWriteIntern(xsink, true))
       return 0;
 
+   disableFast();
+
    {
       int rc = waitReadIntern(xsink, timeout_ms);
       if (rc == QW_TIMEOUT)
@@ -303,19 +421,89 @@ AbstractQoreNode* qore_queue_private::pop(ExceptionSink* xsink, int timeout_ms,
          return 0;
    }
 
-   QoreQueueNode* n = tail;
-   tail = tail->prev;
-   if (!tail)
-      head = 0;
-   else
-      tail->next = 0;
-
-   len--;
+   AbstractQoreNode* rv = popIntern();
    if (write_waiting)
       write_cond.signal();
+   else
+      enableFast();
+
+   return rv;
+}
+
+int qore_queue_private::pushList(ExceptionSink* xsink, const QoreListNode* lst, int timeout_ms, bool& to) {
+   to = false;
+   int size = (int)lst->size();
+   int i = 0;
+
+   AutoLocker al(&l);
+   if (checkWriteIntern(xsink))
+      return 0;
+
+   disableFast();
+
+   while (i < size) {
+      int rc = waitWriteIntern(xsink, timeout_ms);
+      if (rc == QW_TIMEOUT)
+         to = true;
+      if (rc)
+         break;
+
+      // queue as many elements as possible with the lock held
+      int n = size - i;
+      if (max > 0 && n > (max - len))
+         n = max - len;
+      for (int e = i + n; i < e; ++i) {
+         const AbstractQoreNode* v = lst->retrieve_entry(i);
+         pushNode(v ? v->refSelf() : 0);
+      }
+
+      if (read_waiting) {
+         if (n == 1)
+            read_cond.signal();
+         else
+            read_cond.broadcast();
+      }
+   }
+
+   return i;
+}
+
+QoreListNode* qore_queue_private::shiftN(ExceptionSink* xsink, int n, int timeout_ms, bool& to) {
+   assert(n > 0);
+   to = false;
+   SafeLocker sl(&l);
+
+   if (checkWriteIntern(xsink, true))
+      return 0;
+
+   disableFast();
+
+   {
+      int rc = waitReadIntern(xsink, timeout_ms);
+      if (rc == QW_TIMEOUT)
+         to = true;
+      if (rc)
+         return 0;
+   }
+
+   if (n > len)
+      n = len;
+
+   ReferenceHolder<QoreListNode> rv(new QoreListNode, xsink);
+   for (int i = 0; i < n; ++i)
+      rv->push(shiftIntern());
+
+   if (write_waiting) {
+      if (n == 1)
+         write_cond.signal();
+      else
+         write_cond.broadcast();
+   }
+   else
+      enableFast();
 
    sl.unlock();
-   return n->takeAndDel();
+   return rv.release();
 }
 
 void qore_queue_private::clear(ExceptionSink* xsink) {
@@ -324,9 +512,11 @@ void qore_queue_private::clear(ExceptionSink* xsink) {
    if (checkWriteIntern(xsink))
       return;
 
+   disableFast();
+
    if (read_waiting) {
       // the queue must be empty
-      assert(!head);
+      assert(!len);
       return;
    }
 
@@ -335,6 +525,8 @@ void qore_queue_private::clear(ExceptionSink* xsink) {
 
    if (write_waiting)
       write_cond.signal();
+   else
+      enableFast();
 }
 
 void qore_queue_private::setError(const char* n_err, const QoreStringNode* n_desc, ExceptionSink* xsink) {
@@ -342,6 +534,8 @@ void qore_queue_private::setError(const char* n_err, const QoreStringNode* n_des
    if (len == Queue_Deleted)
       return;
 
+   disableFast();
+
    err = n_err;
    if (desc)
       desc->deref();
@@ -367,6 +561,7 @@ void qore_queue_private::clearError() {
       desc->deref();
       desc = 0;
    }
+   enableFast();
 }
 
 QoreQueue::QoreQueue(int n_max) : priv(new qore_queue_private(n_max)) {
@@ -434,6 +629,22 @@ AbstractQoreNode* QoreQueue::pop(ExceptionSink* xsink, int timeout_ms, bool* to)
    return rv;
 }
 
+int QoreQueue::pushList(ExceptionSink* xsink, const QoreListNode* l, int timeout_ms, bool* to) {
+   bool timeout;
+   int rv = priv->pushList(xsink, l, timeout_ms, timeout);
+   if (to)
+      *to = timeout;
+   return rv;
+}
+
+QoreListNode* QoreQueue::shiftN(ExceptionSink* xsink, int n, int timeout_ms, bool* to) {
+   bool timeout;
+   QoreListNode* rv = priv->shiftN(xsink, n, timeout_ms, timeout);
+   if (to)
+      *to = timeout;
+   return rv;
+}
+
 bool QoreQueue::empty() const {
    return priv->empty();
 }
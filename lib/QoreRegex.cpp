@@ -56,8 +56,7 @@ QoreRegex::QoreRegex(const QoreString& s, int64 opts, ExceptionSink* xsink) {
 }
 
 QoreRegex::~QoreRegex() {
-   if (p)
-      pcre_free(p);
+   freePattern();
    if (str)
       delete str;
 }
@@ -67,9 +66,6 @@ void QoreRegex::concat(char c) {
 }
 
 void QoreRegex::parseRT(const QoreString* pattern, ExceptionSink* xsink) {
-   const char* err;
-   int eo;
-
    // convert to UTF-8 if necessary
    TempEncodingHelper t(pattern, QCS_UTF8, xsink);
    if (*xsink)
@@ -77,11 +73,7 @@ void QoreRegex::parseRT(const QoreString* pattern, ExceptionSink* xsink) {
 
    //printd(5, "QoreRegex::parseRT(%s) this=%p\n", t->getBuffer(), this);
 
-   p = pcre_compile(t->getBuffer(), options, &err, &eo, 0);
-   if (err) {
-      //printd(5, "QoreRegex::parse() error parsing '%s': %s", t->getBuffer(), (char* )err);
-      xsink->raiseException("REGEX-COMPILATION-ERROR", (char* )err);
-   }
+   compile(t->getBuffer(), xsink);
 }
 
 void QoreRegex::parse() {
@@ -120,7 +112,7 @@ bool QoreRegex::exec(const char* str, size_t len) const {
       std::vector<int> ovc(vsize, 0);
       int* ovector = &ovc[0];
 #endif
-      rc = pcre_exec(p, 0, str, len, 0, 0, ovector, vsize);
+      rc = execIntern(str, len, 0, ovector, vsize);
       if (!rc) {
 	 // rc == 0 means not enough space was available in ovector
 	 printd(0, "QoreRegex::exec() ovector too small: vsize: %d -> %d (max: %d)\n", vsize, vsize << 1, OVECMAX);
@@ -158,7 +150,7 @@ QoreListNode* QoreRegex::extractSubstrings(const QoreString* target, ExceptionSi
       std::vector<int> ovc(vsize, 0);
       int* ovector = &ovc[0];
 #endif
-      int rc = pcre_exec(p, 0, t->getBuffer(), t->strlen(), offset, 0, ovector, vsize);
+      int rc = execIntern(t->getBuffer(), t->strlen(), offset, ovector, vsize);
       //printd(5, "QoreRegex::exec(%s) =~ /xxx/ = %d (global: %d)\n", t->getBuffer() + offset, rc, global);
 
       if (!rc) {
@@ -206,6 +198,7 @@ QoreListNode* QoreRegex::extractSubstrings(const QoreString* target, ExceptionSi
 
 void QoreRegex::init(int64 opt) {
    p = 0;
+   extra = 0;
    options = (int)opt;
    global = opt & QRE_GLOBAL ? true : false;
 }
@@ -32,6 +32,90 @@
 
 #include <qore/Qore.h>
 #include "qore/intern/QoreRegexBase.h"
+#include "qore/intern/QoreThreadLocalObject.h"
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+// initial and maximum size of the per-thread JIT stacks
+#define QORE_PCRE_JIT_STACK_START (32 * 1024)
+#define QORE_PCRE_JIT_STACK_MAX (1024 * 1024)
+
+// allocates and frees the per-thread JIT stacks
+struct QorePcreJitStackTraits {
+   DLLLOCAL static pcre_jit_stack* create() {
+      // if 0 is returned, the machine stack is used
+      return pcre_jit_stack_alloc(QORE_PCRE_JIT_STACK_START, QORE_PCRE_JIT_STACK_MAX);
+   }
+
+   DLLLOCAL static void destroy(pcre_jit_stack* s) {
+      pcre_jit_stack_free(s);
+   }
+};
+
+// JIT-compiled patterns are shared between threads, but each thread needs its own JIT stack; stacks are allocated on demand
+// and freed when the thread terminates
+class QorePcreJit {
+public:
+   bool available;
+
+   DLLLOCAL QorePcreJit() {
+      int rc = 0;
+      available = !pcre_config(PCRE_CONFIG_JIT, &rc) && rc;
+   }
+
+   // called by pcre_exec() to get the JIT stack for the current thread
+   DLLLOCAL static pcre_jit_stack* get_stack(void* data) {
+      return ((QorePcreJit*)data)->stack.get();
+   }
+
+private:
+   QoreThreadLocalObject<pcre_jit_stack, QorePcreJitStackTraits> stack;
+};
+
+static QorePcreJit qore_pcre_jit;
+#endif
+
+bool QoreRegexBase::jitAvailable() {
+#ifdef PCRE_STUDY_JIT_COMPILE
+   return qore_pcre_jit.available;
+#else
+   return false;
+#endif
+}
+
+int QoreRegexBase::compile(const char* pattern, ExceptionSink* xsink) {
+   const char* err = 0;
+   int eo;
+   p = pcre_compile(pattern, options, &err, &eo, 0);
+   if (!p) {
+      xsink->raiseException("REGEX-COMPILATION-ERROR", (char*)err);
+      return -1;
+   }
+
+   // study the pattern for faster matching; errors here are not fatal, the pattern is then matched without study data
+#ifdef PCRE_STUDY_JIT_COMPILE
+   extra = pcre_study(p, qore_pcre_jit.available ? PCRE_STUDY_JIT_COMPILE : 0, &err);
+   if (extra && qore_pcre_jit.available)
+      pcre_assign_jit_stack(extra, QorePcreJit::get_stack, &qore_pcre_jit);
+#else
+   extra = pcre_study(p, 0, &err);
+#endif
+   return 0;
+}
+
+void QoreRegexBase::freePattern() {
+   if (extra) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+      pcre_free_study(extra);
+#else
+      pcre_free(extra);
+#endif
+      extra = 0;
+   }
+   if (p) {
+      pcre_free(p);
+      p = 0;
+   }
+}
 
 void QoreRegexBase::setCaseInsensitive() {
    options |= PCRE_CASELESS;
@@ -0,0 +1,140 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreRegexCache.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include "qore/intern/QoreRegexCache.h"
+
+QoreRegexCache QRC;
+
+void QoreRegexCache::getKey(std::string& key, char type, const QoreString& pattern, int64 options) {
+   const char* enc = pattern.getEncoding()->getCode();
+   size_t elen = strlen(enc);
+   key.reserve(1 + sizeof(options) + elen + 1 + pattern.size());
+   key.push_back(type);
+   key.append((const char*)&options, sizeof(options));
+   key.append(enc, elen + 1);
+   key.append(pattern.getBuffer(), pattern.size());
+}
+
+QoreRegexCache::Entry* QoreRegexCache::find(const std::string& key) {
+   emap_t::iterator i = emap.find(key);
+   if (i == emap.end())
+      return 0;
+   if (i->second != elist.begin())
+      elist.splice(elist.begin(), elist, i->second);
+   return &*i->second;
+}
+
+void QoreRegexCache::add(const Entry& e) {
+   elist.push_front(e);
+   emap[e.key] = elist.begin();
+   while (elist.size() > max) {
+      Entry& le = elist.back();
+      emap.erase(le.key);
+      le.deref();
+      elist.pop_back();
+   }
+}
+
+QoreRegex* QoreRegexCache::getRegex(const QoreString& pattern, int64 options, ExceptionSink* xsink) {
+   std::string key;
+   getKey(key, 'r', pattern, options);
+
+   {
+      AutoLocker al(m);
+      Entry* e = find(key);
+      if (e) {
+         ++hits;
+         return e->re->refSelf();
+      }
+      ++misses;
+   }
+
+   // compile the pattern without holding the lock
+   SimpleRefHolder<QoreRegex> re(new QoreRegex(pattern, options, xsink));
+   if (*xsink)
+      return 0;
+
+   AutoLocker al(m);
+   // another thread may have added the same pattern in the meantime
+   Entry* e = find(key);
+   if (e)
+      return e->re->refSelf();
+   add(Entry(key, re->refSelf()));
+   return re.release();
+}
+
+QoreRegexSubst* QoreRegexCache::getRegexSubst(const QoreString& pattern, int64 options, ExceptionSink* xsink) {
+   std::string key;
+   getKey(key, 's', pattern, options);
+
+   {
+      AutoLocker al(m);
+      Entry* e = find(key);
+      if (e) {
+         ++hits;
+         return e->rs->refSelf();
+      }
+      ++misses;
+   }
+
+   SimpleRefHolder<QoreRegexSubst> rs(new QoreRegexSubst(&pattern, (int)(options & 0xffffffff), xsink));
+   if (*xsink)
+      return 0;
+   if (options & QRE_GLOBAL)
+      rs->setGlobal();
+
+   AutoLocker al(m);
+   Entry* e = find(key);
+   if (e)
+      return e->rs->refSelf();
+   add(Entry(key, rs->refSelf()));
+   return rs.release();
+}
+
+QoreHashNode* QoreRegexCache::getInfo() const {
+   QoreHashNode* h = new QoreHashNode;
+   AutoLocker al(m);
+   h->setKeyValue("size", new QoreBigIntNode(elist.size()), 0);
+   h->setKeyValue("max", new QoreBigIntNode(max), 0);
+   h->setKeyValue("hits", new QoreBigIntNode(hits), 0);
+   h->setKeyValue("misses", new QoreBigIntNode(misses), 0);
+   h->setKeyValue("jit", get_bool_node(QoreRegexBase::jitAvailable()), 0);
+   return h;
+}
+
+void QoreRegexCache::clear() {
+   AutoLocker al(m);
+   for (elist_t::iterator i = elist.begin(), e = elist.end(); i != e; ++i)
+      i->deref();
+   elist.clear();
+   emap.clear();
+}
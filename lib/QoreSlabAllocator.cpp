@@ -0,0 +1,513 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreSlabAllocator.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, sro
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include "qore/intern/QoreSlabAllocator.h"
+
+#include <atomic>
+#include <new>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// all state of the allocator is statically initialized and is never destroyed, because objects are allocated and
+// freed during static initialization and destruction in any order
+
+// the size of the chunk header; objects start after the header
+#define QORE_SLAB_HEADER 64
+// the number of chunks allocated from the system at once
+#define QORE_SLAB_BLOCK_CHUNKS 16
+// the chunk registry has one bitmap of 2^16 chunks for each 4GB of address space up to 2^48
+#define QORE_SLAB_REGISTRY_SIZE (1 << 16)
+#define QORE_SLAB_REGISTRY_WORDS ((1 << (32 - QORE_SLAB_CHUNK_SHIFT)) / 64)
+
+class SlabThreadCache;
+
+struct SlabFreeObject {
+   SlabFreeObject* next;
+};
+
+// header at the start of each chunk
+struct SlabChunk {
+   // the cache of the thread that allocates from the chunk; only changes while no objects are allocated from it
+   SlabThreadCache* owner;
+   // objects freed by the owner; only accessed by the owner
+   SlabFreeObject* free;
+   // objects from here up to end have never been allocated
+   char* bump;
+   char* end;
+   // links in the owner's list of chunks with free objects or in the list of free chunks
+   SlabChunk* prev;
+   SlabChunk* next;
+   // the number of objects allocated from the chunk
+   unsigned used;
+   unsigned short size;
+   unsigned char cls;
+   // true if the chunk is in the owner's list of chunks with free objects
+   bool avail;
+
+   DLLLOCAL void init(SlabThreadCache* o, unsigned c) {
+      owner = o;
+      free = 0;
+      cls = c;
+      size = (c + 1) << QORE_SLAB_CLASS_SHIFT;
+      bump = (char*)this + QORE_SLAB_HEADER;
+      end = (char*)this + QORE_SLAB_CHUNK_SIZE - ((QORE_SLAB_CHUNK_SIZE - QORE_SLAB_HEADER) % size);
+      used = 0;
+      avail = false;
+   }
+
+   DLLLOCAL void* take() {
+      if (free) {
+         void* p = free;
+         free = free->next;
+         ++used;
+         return p;
+      }
+      if (bump < end) {
+         void* p = bump;
+         bump += size;
+         ++used;
+         return p;
+      }
+      return 0;
+   }
+
+   DLLLOCAL void put(void* p) {
+      assert(used);
+      SlabFreeObject* o = (SlabFreeObject*)p;
+      o->next = free;
+      free = o;
+      --used;
+   }
+};
+
+static_assert(sizeof(SlabChunk) <= QORE_SLAB_HEADER, "the chunk header does not fit in QORE_SLAB_HEADER bytes");
+
+static SlabChunk* slab_chunk(void* p) {
+   return (SlabChunk*)((uintptr_t)p & ~(uintptr_t)(QORE_SLAB_CHUNK_SIZE - 1));
+}
+
+// counters are only updated by the owning thread, but are read by other threads for statistics
+static void slab_inc(std::atomic<int64>& v, int64 n = 1) {
+   v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct SlabClassStats {
+   std::atomic<int64> allocs;
+   std::atomic<int64> frees;
+   std::atomic<int64> remote_frees;
+   std::atomic<int64> chunks;
+};
+
+static void slab_release_chunk(SlabChunk* c);
+static SlabChunk* slab_get_chunk(SlabThreadCache* owner, unsigned cls);
+
+// the allocation state of a thread; caches are never deleted but are reused by new threads when their thread
+// terminates, so that objects can always be returned to the owner of their chunk
+class SlabThreadCache {
+public:
+   // objects freed in other threads; pushed by any thread and taken by the owner
+   std::atomic<SlabFreeObject*> remote;
+   // chunks with free objects for each size class; allocations are made from the first chunk
+   SlabChunk* avail[QORE_SLAB_CLASSES];
+   SlabClassStats stats[QORE_SLAB_CLASSES];
+   // link in the list of all caches
+   SlabThreadCache* next_cache;
+   // link in the list of idle caches
+   SlabThreadCache* next_idle;
+   // true if the cache is assigned to a thread
+   bool active;
+
+   DLLLOCAL SlabThreadCache() : remote(0), next_cache(0), next_idle(0), active(false) {
+      for (unsigned i = 0; i < QORE_SLAB_CLASSES; ++i) {
+         avail[i] = 0;
+         stats[i].allocs.store(0, std::memory_order_relaxed);
+         stats[i].frees.store(0, std::memory_order_relaxed);
+         stats[i].remote_frees.store(0, std::memory_order_relaxed);
+         stats[i].chunks.store(0, std::memory_order_relaxed);
+      }
+   }
+
+   DLLLOCAL void* alloc(unsigned cls) {
+      while (SlabChunk* c = avail[cls]) {
+         void* p = c->take();
+         if (p) {
+            slab_inc(stats[cls].allocs);
+            return p;
+         }
+         // the chunk is full
+         unlink(c);
+      }
+      return allocSlow(cls);
+   }
+
+   // frees an object allocated from a chunk owned by this cache in the owning thread
+   DLLLOCAL void freeLocal(SlabChunk* c, void* p) {
+      slab_inc(stats[c->cls].frees);
+      put(c, p);
+   }
+
+   // called by any thread to return an object to the owner of its chunk
+   DLLLOCAL void freeRemote(void* p) {
+      SlabFreeObject* o = (SlabFreeObject*)p;
+      o->next = remote.load(std::memory_order_relaxed);
+      while (!remote.compare_exchange_weak(o->next, o, std::memory_order_release, std::memory_order_relaxed))
+         ;
+   }
+
+   // called when the owning thread terminates; releases all free chunks
+   DLLLOCAL void release() {
+      drainRemote();
+      for (unsigned i = 0; i < QORE_SLAB_CLASSES; ++i) {
+         SlabChunk* c = avail[i];
+         while (c) {
+            SlabChunk* next = c->next;
+            if (!c->used)
+               releaseChunk(c);
+            c = next;
+         }
+      }
+   }
+
+private:
+   DLLLOCAL void* allocSlow(unsigned cls) {
+      drainRemote();
+      if (!avail[cls]) {
+         SlabChunk* c = slab_get_chunk(this, cls);
+         if (!c)
+            return 0;
+         slab_inc(stats[cls].chunks);
+         link(c);
+      }
+      void* p = avail[cls]->take();
+      assert(p);
+      slab_inc(stats[cls].allocs);
+      return p;
+   }
+
+   DLLLOCAL void drainRemote() {
+      if (!remote.load(std::memory_order_relaxed))
+         return;
+      SlabFreeObject* o = remote.exchange(0, std::memory_order_acquire);
+      while (o) {
+         SlabFreeObject* next = o->next;
+         SlabChunk* c = slab_chunk(o);
+         assert(c->owner == this);
+         slab_inc(stats[c->cls].remote_frees);
+         put(c, o);
+         o = next;
+      }
+   }
+
+   DLLLOCAL void put(SlabChunk* c, void* p) {
+      c->put(p);
+      if (!c->avail)
+         link(c);
+      // keep the first chunk of each class to avoid releasing and getting a chunk repeatedly
+      else if (!c->used && c != avail[c->cls])
+         releaseChunk(c);
+   }
+
+   DLLLOCAL void releaseChunk(SlabChunk* c) {
+      unlink(c);
+      slab_inc(stats[c->cls].chunks, -1);
+      slab_release_chunk(c);
+   }
+
+   DLLLOCAL void link(SlabChunk* c) {
+      assert(!c->avail);
+      SlabChunk*& head = avail[c->cls];
+      c->prev = 0;
+      c->next = head;
+      if (head)
+         head->prev = c;
+      head = c;
+      c->avail = true;
+   }
+
+   DLLLOCAL void unlink(SlabChunk* c) {
+      assert(c->avail);
+      if (c->prev)
+         c->prev->next = c->next;
+      else
+         avail[c->cls] = c->next;
+      if (c->next)
+         c->next->prev = c->prev;
+      c->avail = false;
+   }
+};
+
+// protects the free chunk list and the cache lists
+static pthread_mutex_t slab_lock = PTHREAD_MUTEX_INITIALIZER;
+// the key for the current thread's cache
+static pthread_key_t slab_key;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+// 1 = enabled, -1 = disabled, 0 = not yet initialized
+static std::atomic<int> slab_state(0);
+
+static SlabChunk* slab_free_chunks;
+static int64 slab_chunk_count;
+static int64 slab_free_chunk_count;
+static SlabThreadCache* slab_caches;
+static SlabThreadCache* slab_idle_caches;
+static int slab_active_caches;
+
+// one bitmap for each 4GB of address space marking addresses in chunks; bitmaps are never freed and bits are never
+// cleared, because chunks are never returned to the system
+static std::atomic<std::atomic<uint64_t>*> slab_registry[QORE_SLAB_REGISTRY_SIZE];
+
+class SlabLockHelper {
+public:
+   DLLLOCAL SlabLockHelper() {
+      pthread_mutex_lock(&slab_lock);
+   }
+
+   DLLLOCAL ~SlabLockHelper() {
+      pthread_mutex_unlock(&slab_lock);
+   }
+};
+
+static bool slab_registered(void* p) {
+   uint64_t a = (uint64_t)(uintptr_t)p;
+   if ((a >> 32) >= QORE_SLAB_REGISTRY_SIZE)
+      return false;
+   std::atomic<uint64_t>* map = slab_registry[a >> 32].load(std::memory_order_acquire);
+   if (!map)
+      return false;
+   unsigned i = (unsigned)((a & 0xffffffff) >> QORE_SLAB_CHUNK_SHIFT);
+   return map[i / 64].load(std::memory_order_relaxed) & ((uint64_t)1 << (i % 64));
+}
+
+// called with the lock held; returns false if the chunk is at an address that cannot be registered
+static bool slab_register(void* p) {
+   uint64_t a = (uint64_t)(uintptr_t)p;
+   if ((a >> 32) >= QORE_SLAB_REGISTRY_SIZE)
+      return false;
+   std::atomic<uint64_t>* map = slab_registry[a >> 32].load(std::memory_order_relaxed);
+   if (!map) {
+      map = new (std::nothrow) std::atomic<uint64_t>[QORE_SLAB_REGISTRY_WORDS];
+      if (!map)
+         return false;
+      for (unsigned i = 0; i < QORE_SLAB_REGISTRY_WORDS; ++i)
+         map[i].store(0, std::memory_order_relaxed);
+      slab_registry[a >> 32].store(map, std::memory_order_release);
+   }
+   unsigned i = (unsigned)((a & 0xffffffff) >> QORE_SLAB_CHUNK_SHIFT);
+   map[i / 64].fetch_or((uint64_t)1 << (i % 64), std::memory_order_relaxed);
+   return true;
+}
+
+// called with the lock held; allocates a block of chunks from the system
+static void slab_new_block() {
+   char* b = (char*)malloc((QORE_SLAB_BLOCK_CHUNKS + 1) * QORE_SLAB_CHUNK_SIZE);
+   if (!b)
+      return;
+   b = (char*)(((uintptr_t)b + QORE_SLAB_CHUNK_SIZE - 1) & ~(uintptr_t)(QORE_SLAB_CHUNK_SIZE - 1));
+   for (unsigned i = 0; i < QORE_SLAB_BLOCK_CHUNKS; ++i) {
+      SlabChunk* c = (SlabChunk*)(b + i * QORE_SLAB_CHUNK_SIZE);
+      if (!slab_register(c))
+         continue;
+      c->next = slab_free_chunks;
+      slab_free_chunks = c;
+      ++slab_chunk_count;
+      ++slab_free_chunk_count;
+   }
+}
+
+static SlabChunk* slab_get_chunk(SlabThreadCache* owner, unsigned cls) {
+   SlabChunk* c;
+   {
+      SlabLockHelper lh;
+      if (!slab_free_chunks) {
+         slab_new_block();
+         if (!slab_free_chunks)
+            return 0;
+      }
+      c = slab_free_chunks;
+      slab_free_chunks = c->next;
+      --slab_free_chunk_count;
+   }
+   c->init(owner, cls);
+   return c;
+}
+
+static void slab_release_chunk(SlabChunk* c) {
+   SlabLockHelper lh;
+   c->owner = 0;
+   c->next = slab_free_chunks;
+   slab_free_chunks = c;
+   ++slab_free_chunk_count;
+}
+
+static void slab_thread_exit(void* p) {
+   SlabThreadCache* tc = (SlabThreadCache*)p;
+   tc->release();
+   SlabLockHelper lh;
+   tc->active = false;
+   tc->next_idle = slab_idle_caches;
+   slab_idle_caches = tc;
+   --slab_active_caches;
+}
+
+static void slab_init() {
+   if (getenv("QORE_NO_SLAB_ALLOCATOR") || pthread_key_create(&slab_key, slab_thread_exit)) {
+      slab_state.store(-1, std::memory_order_release);
+      return;
+   }
+   slab_state.store(1, std::memory_order_release);
+}
+
+// returns the current thread's cache without creating it
+static SlabThreadCache* slab_peek_cache() {
+   return slab_state.load(std::memory_order_acquire) > 0 ? (SlabThreadCache*)pthread_getspecific(slab_key) : 0;
+}
+
+// returns the current thread's cache or 0 if the allocator is disabled
+static SlabThreadCache* slab_get_cache() {
+   int state = slab_state.load(std::memory_order_acquire);
+   if (state > 0) {
+      SlabThreadCache* tc = (SlabThreadCache*)pthread_getspecific(slab_key);
+      if (tc)
+         return tc;
+   }
+   else if (state < 0)
+      return 0;
+   else {
+      pthread_once(&slab_once, slab_init);
+      if (slab_state.load(std::memory_order_acquire) < 0)
+         return 0;
+   }
+
+   SlabThreadCache* tc;
+   {
+      SlabLockHelper lh;
+      if (slab_idle_caches) {
+         tc = slab_idle_caches;
+         slab_idle_caches = tc->next_idle;
+      }
+      else {
+         tc = new (std::nothrow) SlabThreadCache;
+         if (!tc)
+            return 0;
+         tc->next_cache = slab_caches;
+         slab_caches = tc;
+      }
+      tc->active = true;
+      ++slab_active_caches;
+   }
+   pthread_setspecific(slab_key, tc);
+   return tc;
+}
+
+void* qore_slab_alloc(size_t size) {
+   if (size && size <= QORE_SLAB_MAX_SIZE) {
+      SlabThreadCache* tc = slab_get_cache();
+      if (tc) {
+         void* p = tc->alloc((unsigned)((size - 1) >> QORE_SLAB_CLASS_SHIFT));
+         if (p)
+            return p;
+      }
+   }
+   return ::operator new(size);
+}
+
+void qore_slab_free(void* p) {
+   if (!p)
+      return;
+   if (!slab_registered(p)) {
+      ::operator delete(p);
+      return;
+   }
+   SlabChunk* c = slab_chunk(p);
+   SlabThreadCache* tc = slab_peek_cache();
+   if (c->owner == tc)
+      tc->freeLocal(c, p);
+   else
+      c->owner->freeRemote(p);
+}
+
+QoreHashNode* qore_slab_get_stats() {
+   int64 allocs[QORE_SLAB_CLASSES], frees[QORE_SLAB_CLASSES], remote_frees[QORE_SLAB_CLASSES],
+      chunks[QORE_SLAB_CLASSES];
+   for (unsigned i = 0; i < QORE_SLAB_CLASSES; ++i)
+      allocs[i] = frees[i] = remote_frees[i] = chunks[i] = 0;
+
+   int64 chunk_count, free_chunk_count;
+   int threads, caches = 0;
+   {
+      SlabLockHelper lh;
+      chunk_count = slab_chunk_count;
+      free_chunk_count = slab_free_chunk_count;
+      threads = slab_active_caches;
+      for (SlabThreadCache* tc = slab_caches; tc; tc = tc->next_cache) {
+         ++caches;
+         for (unsigned i = 0; i < QORE_SLAB_CLASSES; ++i) {
+            allocs[i] += tc->stats[i].allocs.load(std::memory_order_relaxed);
+            frees[i] += tc->stats[i].frees.load(std::memory_order_relaxed);
+            remote_frees[i] += tc->stats[i].remote_frees.load(std::memory_order_relaxed);
+            chunks[i] += tc->stats[i].chunks.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("enabled", get_bool_node(slab_state.load(std::memory_order_acquire) > 0), 0);
+   h->setKeyValue("chunk_size", new QoreBigIntNode(QORE_SLAB_CHUNK_SIZE), 0);
+   h->setKeyValue("max_size", new QoreBigIntNode(QORE_SLAB_MAX_SIZE), 0);
+   h->setKeyValue("chunks", new QoreBigIntNode(chunk_count), 0);
+   h->setKeyValue("free_chunks", new QoreBigIntNode(free_chunk_count), 0);
+   h->setKeyValue("threads", new QoreBigIntNode(threads), 0);
+   h->setKeyValue("caches", new QoreBigIntNode(caches), 0);
+
+   int64 t_allocs = 0, t_frees = 0, t_remote_frees = 0;
+   QoreListNode* l = new QoreListNode;
+   for (unsigned i = 0; i < QORE_SLAB_CLASSES; ++i) {
+      QoreHashNode* ch = new QoreHashNode;
+      ch->setKeyValue("size", new QoreBigIntNode((i + 1) << QORE_SLAB_CLASS_SHIFT), 0);
+      ch->setKeyValue("chunks", new QoreBigIntNode(chunks[i]), 0);
+      ch->setKeyValue("allocs", new QoreBigIntNode(allocs[i]), 0);
+      ch->setKeyValue("frees", new QoreBigIntNode(frees[i]), 0);
+      ch->setKeyValue("remote_frees", new QoreBigIntNode(remote_frees[i]), 0);
+      ch->setKeyValue("in_use", new QoreBigIntNode(allocs[i] - frees[i] - remote_frees[i]), 0);
+      l->push(ch);
+      t_allocs += allocs[i];
+      t_frees += frees[i];
+      t_remote_frees += remote_frees[i];
+   }
+   h->setKeyValue("allocs", new QoreBigIntNode(t_allocs), 0);
+   h->setKeyValue("frees", new QoreBigIntNode(t_frees), 0);
+   h->setKeyValue("remote_frees", new QoreBigIntNode(t_remote_frees), 0);
+   h->setKeyValue("in_use", new QoreBigIntNode(t_allocs - t_frees - t_remote_frees), 0);
+   h->setKeyValue("classes", l, 0);
+   return h;
+}
@@ -431,6 +431,10 @@ const char* SSLSocketHelper::getCipherName() const {
    return SSL_get_cipher_name(ssl);
 }
 
+bool SSLSocketHelper::pending() const {
+   return SSL_pending(ssl) > 0;
+}
+
 const char* SSLSocketHelper::getCipherVersion() const {
    return SSL_get_cipher_version(ssl);
 }
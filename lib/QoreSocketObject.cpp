@@ -457,6 +457,11 @@ bool QoreSocketObject::isOpen() const {
    return priv->socket->isOpen();
 }
 
+bool QoreSocketObject::hasBufferedData() const {
+   AutoLocker al(priv->m);
+   return priv->socket->priv->hasBufferedData();
+}
+
 int QoreSocketObject::connectINETSSL(const char* host, int port, int timeout_ms, ExceptionSink* xsink) {
    AutoLocker al(priv->m);
    return priv->socket->connectINETSSL(host, port, timeout_ms,
@@ -0,0 +1,549 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreSocketPoller.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2016 Qore Technologies, s.r.o.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/QoreSocketObject.h>
+#include "qore/intern/QoreSocketPoller.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <unistd.h>
+
+#ifdef QORE_SOCKET_POLLER_EPOLL
+#ifdef EPOLLRDHUP
+#define QSP_EPOLL_HANGUP (EPOLLHUP | EPOLLRDHUP)
+#else
+#define QSP_EPOLL_HANGUP EPOLLHUP
+#endif
+
+static uint32_t qsp_to_epoll(int events) {
+   uint32_t rv = 0;
+   if (events & SP_READ)
+      rv |= EPOLLIN;
+   if (events & SP_WRITE)
+      rv |= EPOLLOUT;
+   if (events & SP_EDGE)
+      rv |= EPOLLET;
+   if (events & SP_ONESHOT)
+      rv |= EPOLLONESHOT;
+#ifdef EPOLLRDHUP
+   rv |= EPOLLRDHUP;
+#endif
+   return rv;
+}
+
+static int qsp_from_epoll(uint32_t events) {
+   int rv = 0;
+   if (events & EPOLLIN)
+      rv |= SP_READ;
+   if (events & EPOLLOUT)
+      rv |= SP_WRITE;
+   if (events & EPOLLERR)
+      rv |= SP_ERROR;
+   if (events & QSP_EPOLL_HANGUP)
+      rv |= SP_HANGUP;
+   return rv;
+}
+#endif
+
+#ifdef QORE_SOCKET_POLLER_POLL
+#ifdef POLLRDHUP
+#define QSP_POLL_HANGUP (POLLHUP | POLLRDHUP)
+#else
+#define QSP_POLL_HANGUP POLLHUP
+#endif
+
+static short qsp_to_poll(int events) {
+   short rv = 0;
+   if (events & SP_READ)
+      rv |= POLLIN;
+   if (events & SP_WRITE)
+      rv |= POLLOUT;
+#ifdef POLLRDHUP
+   rv |= POLLRDHUP;
+#endif
+   return rv;
+}
+
+static int qsp_from_poll(short events) {
+   int rv = 0;
+   if (events & POLLIN)
+      rv |= SP_READ;
+   if (events & POLLOUT)
+      rv |= SP_WRITE;
+   if (events & (POLLERR | POLLNVAL))
+      rv |= SP_ERROR;
+   if (events & QSP_POLL_HANGUP)
+      rv |= SP_HANGUP;
+   return rv;
+}
+#endif
+
+static int qsp_check_events(int events, const char* meth, ExceptionSink* xsink) {
+   if (events & ~(SP_EVENTS | SP_FLAGS)) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::%s(): invalid event mask %d", meth, events);
+      return -1;
+   }
+   if (!(events & SP_EVENTS)) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::%s(): event mask %d does not include SP_READ or SP_WRITE", meth, events);
+      return -1;
+   }
+   return 0;
+}
+
+QoreSocketPoller::QoreSocketPoller(ExceptionSink* xsink) : next_id(1)
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   , epfd(-1)
+#endif
+{
+   wfd[0] = wfd[1] = -1;
+#if !defined QORE_SOCKET_POLLER_EPOLL && !defined QORE_SOCKET_POLLER_POLL
+   xsink->raiseException("SOCKETPOLLER-ERROR", "this class is not supported on this platform");
+#else
+   if (pipe(wfd)) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "failed to create wakeup pipe");
+      wfd[0] = wfd[1] = -1;
+      return;
+   }
+   for (int i = 0; i < 2; ++i) {
+      fcntl(wfd[i], F_SETFL, fcntl(wfd[i], F_GETFL) | O_NONBLOCK);
+      fcntl(wfd[i], F_SETFD, FD_CLOEXEC);
+   }
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   epfd = epoll_create1(EPOLL_CLOEXEC);
+   if (epfd == -1) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "epoll_create1() failed");
+      return;
+   }
+   epoll_event ev;
+   ev.events = EPOLLIN;
+   ev.data.u64 = 0;
+   if (epoll_ctl(epfd, EPOLL_CTL_ADD, wfd[0], &ev))
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "failed to register wakeup pipe");
+#endif
+#endif
+}
+
+QoreSocketPoller::~QoreSocketPoller() {
+   assert(omap.empty());
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   if (epfd != -1)
+      close(epfd);
+#endif
+   if (wfd[0] != -1) {
+      close(wfd[0]);
+      close(wfd[1]);
+   }
+}
+
+void QoreSocketPoller::deref(ExceptionSink* xsink) {
+   if (ROdereference()) {
+      clear(xsink);
+      delete this;
+   }
+}
+
+const char* QoreSocketPoller::getBackend() {
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   return "epoll";
+#elif defined QORE_SOCKET_POLLER_POLL
+   return "poll";
+#else
+   return "none";
+#endif
+}
+
+int QoreSocketPoller::addIntern(Entry* e, ExceptionSink* xsink) {
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   epoll_event ev;
+   ev.events = qsp_to_epoll(e->events);
+   ev.data.u64 = e->id;
+   if (epoll_ctl(epfd, EPOLL_CTL_ADD, e->fd, &ev)) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "failed to register socket descriptor %d", e->fd);
+      return -1;
+   }
+#endif
+   return 0;
+}
+
+int QoreSocketPoller::modifyIntern(Entry* e, ExceptionSink* xsink) {
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   epoll_event ev;
+   ev.events = qsp_to_epoll(e->events);
+   ev.data.u64 = e->id;
+   if (epoll_ctl(epfd, EPOLL_CTL_MOD, e->fd, &ev)) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "failed to modify registration for socket descriptor %d", e->fd);
+      return -1;
+   }
+#endif
+   return 0;
+}
+
+void QoreSocketPoller::removeIntern(Entry* e, QoreSocketObject* s) {
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   // a closed descriptor has already been removed from the epoll set by the kernel, and its number may have been
+   // reused by another registered socket, so the descriptor is only removed if the socket still owns it
+   if (s && s->getSocket() == e->fd) {
+      epoll_event ev;
+      epoll_ctl(epfd, EPOLL_CTL_DEL, e->fd, &ev);
+   }
+#endif
+   omap.erase(e->obj);
+   imap.erase(e->id);
+   ready.erase(e->id);
+   reported.erase(e->id);
+}
+
+void QoreSocketPoller::release(elist_t& el, ExceptionSink* xsink) {
+   for (elist_t::iterator i = el.begin(), e = el.end(); i != e; ++i) {
+      (*i)->obj->deref(xsink);
+      (*i)->sock->deref(xsink);
+      (*i)->data.discard(xsink);
+      delete *i;
+   }
+}
+
+int QoreSocketPoller::add(const QoreObject* obj, QoreSocketObject* s, int events, const QoreValue data, ExceptionSink* xsink) {
+   if (qsp_check_events(events, "add", xsink))
+      return -1;
+
+   int fd = s->getSocket();
+   if (fd < 0) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::add(): the Socket is not open");
+      return -1;
+   }
+   // must be checked without the poller lock held, as the socket lock is held during blocking socket I/O
+   bool buffered = (events & SP_READ) && s->hasBufferedData();
+
+   AutoLocker al(m);
+   if (omap.find(obj) != omap.end()) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::add(): the Socket (descriptor %d) is already registered", fd);
+      return -1;
+   }
+
+   std::unique_ptr<Entry> e(new Entry(next_id, 0, 0, QoreValue(), fd, events));
+   if (addIntern(e.get(), xsink))
+      return -1;
+   ++next_id;
+
+   e->obj = static_cast<QoreObject*>(obj->refSelf());
+   s->ref();
+   e->sock = s;
+   e->data = data.refSelf();
+   omap[obj] = e.get();
+   imap[e->id] = e.get();
+   if (buffered)
+      ready.insert(e->id);
+   e.release();
+   return 0;
+}
+
+int QoreSocketPoller::modify(const QoreObject* obj, QoreSocketObject* s, int events, ExceptionSink* xsink) {
+   if (qsp_check_events(events, "modify", xsink))
+      return -1;
+
+   int fd = s->getSocket();
+   if (fd < 0) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::modify(): the Socket is not open");
+      return -1;
+   }
+   bool buffered = (events & SP_READ) && s->hasBufferedData();
+
+   AutoLocker al(m);
+   omap_t::iterator i = omap.find(obj);
+   if (i == omap.end()) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::modify(): the Socket (descriptor %d) is not registered", fd);
+      return -1;
+   }
+
+   Entry* e = i->second;
+   int old_events = e->events;
+   e->events = events;
+   if (fd != e->fd) {
+      // the socket has been closed and reopened since it was registered
+      int old_fd = e->fd;
+      e->fd = fd;
+      if (addIntern(e, xsink)) {
+         e->fd = old_fd;
+         e->events = old_events;
+         return -1;
+      }
+   }
+   else if (modifyIntern(e, xsink)) {
+      e->events = old_events;
+      return -1;
+   }
+   e->armed = true;
+
+   if (buffered)
+      ready.insert(e->id);
+   else
+      ready.erase(e->id);
+   return 0;
+}
+
+bool QoreSocketPoller::remove(const QoreObject* obj, QoreSocketObject* s, ExceptionSink* xsink) {
+   elist_t el;
+   {
+      AutoLocker al(m);
+      omap_t::iterator i = omap.find(obj);
+      if (i == omap.end())
+         return false;
+      el.push_back(i->second);
+      removeIntern(i->second, s);
+   }
+   release(el, xsink);
+   return true;
+}
+
+void QoreSocketPoller::clear(ExceptionSink* xsink) {
+   elist_t el;
+   {
+      AutoLocker al(m);
+      for (omap_t::iterator i = omap.begin(), e = omap.end(); i != e; ++i)
+         el.push_back(i->second);
+#ifdef QORE_SOCKET_POLLER_EPOLL
+      // the epoll descriptor is recreated instead of removing each socket, as we cannot check descriptor ownership here
+      if (!el.empty()) {
+         int nfd = epoll_create1(EPOLL_CLOEXEC);
+         epoll_event ev;
+         ev.events = EPOLLIN;
+         ev.data.u64 = 0;
+         if (nfd != -1 && !epoll_ctl(nfd, EPOLL_CTL_ADD, wfd[0], &ev)) {
+            close(epfd);
+            epfd = nfd;
+         }
+         else {
+            if (nfd != -1)
+               close(nfd);
+            for (elist_t::iterator i = el.begin(), e = el.end(); i != e; ++i)
+               epoll_ctl(epfd, EPOLL_CTL_DEL, (*i)->fd, &ev);
+         }
+      }
+#endif
+      omap.clear();
+      imap.clear();
+      ready.clear();
+      reported.clear();
+   }
+   release(el, xsink);
+}
+
+bool QoreSocketPoller::isRegistered(const QoreObject* obj) const {
+   AutoLocker al(m);
+   return omap.find(obj) != omap.end();
+}
+
+size_t QoreSocketPoller::size() const {
+   AutoLocker al(m);
+   return omap.size();
+}
+
+void QoreSocketPoller::wakeup() {
+   if (wfd[1] != -1) {
+      char c = 0;
+      // if the pipe is full, a wakeup is already pending
+      if (write(wfd[1], &c, 1)) {}
+   }
+}
+
+void QoreSocketPoller::drainWakeup() {
+   char buf[64];
+   while (read(wfd[0], buf, sizeof buf) > 0) {}
+}
+
+void QoreSocketPoller::addResult(QoreListNode& l, Entry* e, int events) {
+   if (e->events & SP_ONESHOT) {
+      if (!e->armed)
+         return;
+      e->armed = false;
+#ifdef QORE_SOCKET_POLLER_EPOLL
+      // disarm the kernel registration if the event was reported from the user-space ready set
+      epoll_event ev;
+      ev.events = 0;
+      ev.data.u64 = e->id;
+      epoll_ctl(epfd, EPOLL_CTL_MOD, e->fd, &ev);
+#endif
+   }
+
+   if ((events & SP_READ) && !(e->events & (SP_EDGE | SP_ONESHOT)))
+      reported.insert(e->id);
+
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("socket", e->obj->refSelf(), 0);
+   h->setKeyValue("events", new QoreBigIntNode(events), 0);
+   h->setKeyValue("data", e->data.getReferencedValue(), 0);
+   l.push(h);
+}
+
+void QoreSocketPoller::checkReported(ExceptionSink* xsink) {
+   typedef std::vector<std::pair<int64, QoreSocketObject*> > slist_t;
+   slist_t sl;
+   {
+      AutoLocker al(m);
+      if (reported.empty())
+         return;
+      for (std::set<int64>::iterator i = reported.begin(), e = reported.end(); i != e; ++i) {
+         imap_t::iterator ii = imap.find(*i);
+         if (ii == imap.end() || !(ii->second->events & SP_READ))
+            continue;
+         ii->second->sock->ref();
+         sl.push_back(std::make_pair(*i, ii->second->sock));
+      }
+      reported.clear();
+   }
+
+   // the socket lock is held during blocking socket I/O, so the sockets are checked without the poller lock held
+   std::vector<int64> bl;
+   for (slist_t::iterator i = sl.begin(), e = sl.end(); i != e; ++i) {
+      if (i->second->hasBufferedData())
+         bl.push_back(i->first);
+      i->second->deref(xsink);
+   }
+
+   if (bl.empty())
+      return;
+   AutoLocker al(m);
+   for (std::vector<int64>::iterator i = bl.begin(), e = bl.end(); i != e; ++i) {
+      // the socket may have been removed in the meantime
+      if (imap.find(*i) != imap.end())
+         ready.insert(*i);
+   }
+}
+
+QoreListNode* QoreSocketPoller::wait(int timeout_ms, int max, ExceptionSink* xsink) {
+   if (max <= 0) {
+      xsink->raiseException("SOCKETPOLLER-ERROR", "SocketPoller::wait(): the maximum number of events must be greater than zero; got %d", max);
+      return 0;
+   }
+
+   // a socket reported readable by the last call may still have data buffered in user space after a partial read
+   checkReported(xsink);
+
+   ReferenceHolder<QoreListNode> rv(new QoreListNode, xsink);
+
+#ifdef QORE_SOCKET_POLLER_EPOLL
+   {
+      AutoLocker al(m);
+      if (!ready.empty())
+         timeout_ms = 0;
+   }
+
+   std::vector<epoll_event> ev(max);
+   int rc;
+   while (true) {
+      rc = epoll_wait(epfd, &ev[0], max, timeout_ms);
+      if (rc == -1 && errno == EINTR)
+         continue;
+      break;
+   }
+   if (rc < 0) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "epoll_wait() failed");
+      return 0;
+   }
+
+   AutoLocker al(m);
+   for (int i = 0; i < rc; ++i) {
+      if (!ev[i].data.u64) {
+         drainWakeup();
+         continue;
+      }
+      imap_t::iterator ii = imap.find(ev[i].data.u64);
+      // the socket has been removed in the meantime
+      if (ii == imap.end())
+         continue;
+      int events = qsp_from_epoll(ev[i].events);
+      if (ready.erase(ii->first))
+         events |= SP_READ;
+      addResult(**rv, ii->second, events);
+   }
+#else
+   std::vector<pollfd> fds;
+   std::vector<int64> ids;
+   {
+      AutoLocker al(m);
+      if (!ready.empty())
+         timeout_ms = 0;
+      fds.reserve(imap.size() + 1);
+      ids.reserve(imap.size() + 1);
+      pollfd wp = {wfd[0], POLLIN, 0};
+      fds.push_back(wp);
+      ids.push_back(0);
+      for (imap_t::iterator i = imap.begin(), e = imap.end(); i != e; ++i) {
+         if (!i->second->armed)
+            continue;
+         pollfd p = {i->second->fd, qsp_to_poll(i->second->events), 0};
+         fds.push_back(p);
+         ids.push_back(i->first);
+      }
+   }
+
+   int rc;
+   while (true) {
+      rc = poll(&fds[0], fds.size(), timeout_ms);
+      if (rc == -1 && errno == EINTR)
+         continue;
+      break;
+   }
+   if (rc < 0) {
+      xsink->raiseErrnoException("SOCKETPOLLER-ERROR", errno, "poll() failed");
+      return 0;
+   }
+
+   AutoLocker al(m);
+   if (fds[0].revents)
+      drainWakeup();
+   for (size_t i = 1; i < fds.size() && (int)(*rv)->size() < max; ++i) {
+      if (!fds[i].revents)
+         continue;
+      imap_t::iterator ii = imap.find(ids[i]);
+      // the socket has been removed or its descriptor has changed in the meantime
+      if (ii == imap.end() || ii->second->fd != fds[i].fd)
+         continue;
+      int events = qsp_from_poll(fds[i].revents);
+      if (ready.erase(ii->first))
+         events |= SP_READ;
+      addResult(**rv, ii->second, events);
+   }
+#endif
+
+   // report registrations with buffered data that were not reported above
+   while (!ready.empty() && (int)(*rv)->size() < max) {
+      std::set<int64>::iterator i = ready.begin();
+      imap_t::iterator ii = imap.find(*i);
+      ready.erase(i);
+      if (ii != imap.end())
+         addResult(**rv, ii->second, SP_READ);
+   }
+
+   return rv.release();
+}
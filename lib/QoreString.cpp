@@ -43,6 +43,7 @@
 
 #include <set>
 #include <memory>
+#include <algorithm>
 #include <string>
 #include <map>
 
@@ -595,12 +596,15 @@ int qore_string_private::convert_encoding_intern(const char* src, qore_size_t sr
    // now convert value
    qore_size_t al = src_len + STR_CLASS_BLOCK;
    targ.allocate(al + 1);
+   size_t ilen = src_len;
+   char* ib = (char*)src;
+   // output bytes converted so far
+   qore_size_t ol = 0;
    while (true) {
-      size_t ilen = src_len;
-      size_t olen = al;
-      char* ib = (char*)src;
-      char* ob = targ.priv->buf;
+      size_t olen = al - ol;
+      char* ob = targ.priv->buf + ol;
       size_t rc = c.iconv(&ib, &ilen, &ob, &olen);
+      ol = al - olen;
       if (rc == (size_t)-1) {
          switch (errno) {
             case EINVAL:
@@ -609,7 +613,8 @@ int qore_string_private::convert_encoding_intern(const char* src, qore_size_t sr
                targ.clear();
                return -1;
             case E2BIG:
-               al += STR_CLASS_BLOCK;
+               // continue the conversion where it stopped with a buffer enlarged by at least the remaining input
+               al += ilen + STR_CLASS_BLOCK;
                targ.allocate(al + 1);
                break;
             default: {
@@ -620,8 +625,8 @@ int qore_string_private::convert_encoding_intern(const char* src, qore_size_t sr
          }
       } else {
          // terminate string
-         targ.priv->buf[al - olen] = '\0';
-         targ.priv->len = al - olen;
+         targ.priv->buf[ol] = '\0';
+         targ.priv->len = ol;
          break;
       }
    }
@@ -847,6 +852,89 @@ int qore_string_private::concat(const QoreString* str, ExceptionSink* xsink) {
    return 0;
 }
 
+qore_size_t qore_string_char_index::getByteOffset(qore_size_t c) const {
+   assert(valid);
+   if (c >= clen)
+      return len;
+   if (width)
+      return c * width;
+   qore_size_t b = cp[c / STR_CHAR_INDEX_STEP];
+   c %= STR_CHAR_INDEX_STEP;
+   if (c) {
+      bool invalid;
+      b += enc->getByteLen(buf + b, buf + len, c, invalid);
+      assert(!invalid);
+   }
+   return b;
+}
+
+qore_size_t qore_string_char_index::getCharPos(qore_size_t b) const {
+   assert(valid);
+   assert(b <= len);
+   if (width)
+      return b / width;
+   // find the last checkpoint at or before the byte offset
+   qore_size_t i = std::upper_bound(cp.begin(), cp.end(), b) - cp.begin() - 1;
+   qore_size_t c = i * STR_CHAR_INDEX_STEP;
+   if (cp[i] != b) {
+      bool invalid;
+      c += enc->getCharPos(buf + cp[i], buf + b, invalid);
+      assert(!invalid);
+   }
+   return c;
+}
+
+qore_string_char_index* qore_string_char_index::build(const char* buf, qore_size_t len, const QoreEncoding* enc) {
+   std::unique_ptr<qore_string_char_index> ci(new qore_string_char_index(buf, len, enc));
+
+   const char* end = buf + len;
+   qore_size_t b = 0;
+   while (b < len) {
+      ci->cp.push_back(b);
+      bool invalid;
+      qore_size_t bl = enc->getByteLen(buf + b, end, STR_CHAR_INDEX_STEP, invalid);
+      // strings with invalid characters or embedded nulls are not indexed
+      if (invalid || !bl)
+         return ci.release();
+      // get the number of characters in the last block
+      if (b + bl == len) {
+         ci->clen += enc->getCharPos(buf + b, end, invalid);
+         if (invalid)
+            return ci.release();
+      }
+      else
+         ci->clen += STR_CHAR_INDEX_STEP;
+      b += bl;
+   }
+
+   // checkpoints are not needed if all characters have the minimum width
+   if (len == ci->clen * enc->getMinCharWidth()) {
+      ci->width = enc->getMinCharWidth();
+      std::vector<qore_size_t>().swap(ci->cp);
+   }
+   ci->valid = true;
+   return ci.release();
+}
+
+const qore_string_char_index* qore_string_private::getCharIndex() const {
+   if (len < STR_CHAR_INDEX_MIN || !getEncoding()->isMultiByte())
+      return 0;
+
+   qore_string_char_index* ci = cidx.load(std::memory_order_acquire);
+   if (!ci) {
+      if (cscan.load(std::memory_order_relaxed) < len)
+         return 0;
+      qore_string_char_index* nci = qore_string_char_index::build(buf, len, getEncoding());
+      // another thread may have installed an index in the meantime
+      if (cidx.compare_exchange_strong(ci, nci, std::memory_order_acq_rel))
+         ci = nci;
+      else
+         delete nci;
+   }
+
+   return ci->valid && ci->matches(buf, len, getEncoding()) ? ci : 0;
+}
+
 int qore_string_private::concatUnicode(unsigned code) {
    if (getEncoding() == QCS_UTF8) {
       concatUTF8FromUnicode(code);
@@ -1223,6 +1311,7 @@ bool QoreString::equalPartialPath(const QoreString& str, ExceptionSink* xsink) c
 }
 
 void QoreString::terminate(qore_size_t size) {
+   priv->invalidateCharIndex();
    if (size > priv->len)
       priv->check_char(size);
    priv->len = size;
@@ -1230,6 +1319,7 @@ void QoreString::terminate(qore_size_t size) {
 }
 
 void QoreString::reserve(qore_size_t size) {
+   priv->invalidateCharIndex();
    // leave room for the terminator char '\0'
    ++size;
    if (size > priv->len)
@@ -1237,6 +1327,7 @@ void QoreString::reserve(qore_size_t size) {
 }
 
 void QoreString::take(char* str) {
+   priv->invalidateCharIndex();
    if (priv->buf)
       free(priv->buf);
    priv->buf = str;
@@ -1251,11 +1342,13 @@ void QoreString::take(char* str) {
 }
 
 void QoreString::take(char* str, const QoreEncoding* new_qorecharset) {
+   priv->invalidateCharIndex();
    take(str);
    priv->charset = new_qorecharset;
 }
 
 void QoreString::take(char* str, qore_size_t size) {
+   priv->invalidateCharIndex();
    if (priv->buf)
       free(priv->buf);
    priv->buf = str;
@@ -1264,6 +1357,7 @@ void QoreString::take(char* str, qore_size_t size) {
 }
 
 void QoreString::take(char* str, qore_size_t size, const QoreEncoding* enc) {
+   priv->invalidateCharIndex();
    if (priv->buf)
       free(priv->buf);
    priv->buf = str;
@@ -1274,6 +1368,7 @@ void QoreString::take(char* str, qore_size_t size, const QoreEncoding* enc) {
 }
 
 void QoreString::takeAndTerminate(char* str, qore_size_t size) {
+   priv->invalidateCharIndex();
    if (priv->buf)
       free(priv->buf);
    priv->buf = str;
@@ -1284,6 +1379,7 @@ void QoreString::takeAndTerminate(char* str, qore_size_t size) {
 }
 
 void QoreString::takeAndTerminate(char* str, qore_size_t size, const QoreEncoding* enc) {
+   priv->invalidateCharIndex();
    takeAndTerminate(str, size);
    priv->charset = enc;
 }
@@ -1291,6 +1387,7 @@ void QoreString::takeAndTerminate(char* str, qore_size_t size, const QoreEncodin
 // NOTE: could be dangerous if we refer to the priv->buffer after this
 // call and it's NULL (the only way the priv->buffer can become NULL)
 char* QoreString::giveBuffer() {
+   priv->invalidateCharIndex();
    char* rv = priv->buf;
    priv->buf = 0;
    priv->len = 0;
@@ -1302,6 +1399,7 @@ char* QoreString::giveBuffer() {
 }
 
 void QoreString::clear() {
+   priv->invalidateCharIndex();
    if (priv->allocated) {
       priv->len = 0;
       priv->buf[0] = '\0';
@@ -1309,6 +1407,7 @@ void QoreString::clear() {
 }
 
 void QoreString::reset() {
+   priv->invalidateCharIndex();
    char* b = giveBuffer();
    if (b)
       free(b);
@@ -1317,6 +1416,7 @@ void QoreString::reset() {
 }
 
 void QoreString::set(const char* str, const QoreEncoding* new_qorecharset) {
+   priv->invalidateCharIndex();
    priv->len = 0;
    priv->charset = new_qorecharset;
    if (!str) {
@@ -1328,6 +1428,7 @@ void QoreString::set(const char* str, const QoreEncoding* new_qorecharset) {
 }
 
 void QoreString::set(const QoreString* str) {
+   priv->invalidateCharIndex();
    priv->len = str->priv->len;
    priv->charset = str->priv->getEncoding();
    allocate(str->priv->len + 1);
@@ -1340,6 +1441,7 @@ void QoreString::set(const QoreString& str) {
 }
 
 void QoreString::set(const std::string& str, const QoreEncoding* ne) {
+   priv->invalidateCharIndex();
    priv->len = str.size();
    priv->charset = ne;
    allocate(priv->len + 1);
@@ -1348,6 +1450,7 @@ void QoreString::set(const std::string& str, const QoreEncoding* ne) {
 }
 
 void QoreString::set(char* nbuf, size_t nlen, size_t nallocated, const QoreEncoding* enc) {
+   priv->invalidateCharIndex();
    if (priv->buf)
       free(priv->buf);
 
@@ -1363,6 +1466,7 @@ void QoreString::set(char* nbuf, size_t nlen, size_t nallocated, const QoreEncod
 }
 
 void QoreString::setEncoding(const QoreEncoding* new_encoding) {
+   priv->invalidateCharIndex();
    priv->charset = new_encoding;
 }
 
@@ -1414,6 +1518,7 @@ void QoreString::replace(qore_size_t offset, qore_size_t dlen, const QoreString*
 }
 
 void QoreString::replaceChar(qore_size_t offset, char c) {
+   priv->invalidateCharIndex();
    if (priv->len <= offset)
       return;
 
@@ -1652,6 +1757,7 @@ void QoreString::concatBase64(const char* bbuf, qore_size_t size) {
 #define DO_HEX_CHAR(b) ((b) + (((b) > 9) ? 87 : 48))
 
 void QoreString::concatHex(const char* binbuf, qore_size_t size) {
+   priv->invalidateCharIndex();
    //printf("priv->buf=%p, size=" QSD "\n", binbuf, size);
    if (!size)
       return;
@@ -1668,14 +1774,17 @@ void QoreString::concatHex(const char* binbuf, qore_size_t size) {
 }
 
 int QoreString::concatEncode(ExceptionSink* xsink, const QoreString& str, unsigned code) {
+   priv->invalidateCharIndex();
    return priv->concatEncode(xsink, str, code);
 }
 
 int QoreString::concatDecode(ExceptionSink* xsink, const QoreString& str, unsigned code) {
+   priv->invalidateCharIndex();
    return priv->concatDecode(xsink, str, code);
 }
 
 void QoreString::concatAndHTMLEncode(const QoreString* str, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    priv->concatEncode(xsink, str, CE_HTML);
 }
 
@@ -1715,6 +1824,7 @@ void QoreString::concatAndHTMLDecode(const char* str) {
 
 // FIXME: this is slow, each concatenated character gets terminated as well
 void QoreString::concatAndHTMLDecode(const char* str, size_t slen) {
+   priv->invalidateCharIndex();
    if (!slen)
       return;
 
@@ -1792,6 +1902,7 @@ void QoreString::concatDecodeUrl(const char* url) {
 
 // assume encoding according to http://tools.ietf.org/html/rfc3986#section-2.1
 int QoreString::concatDecodeUrl(const QoreString& url_str, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    TempEncodingHelper str(url_str, priv->getEncoding(), xsink);
    if (*xsink)
       return -1;
@@ -1839,6 +1950,7 @@ int QoreString::concatEncodeUrl(ExceptionSink* xsink, const QoreString& url, boo
 }
 
 int QoreString::concatEncodeUriRequest(ExceptionSink* xsink, const QoreString& url) {
+   priv->invalidateCharIndex();
    if (!url.size())
       return 0;
 
@@ -1850,6 +1962,7 @@ int QoreString::concatEncodeUriRequest(ExceptionSink* xsink, const QoreString& u
 }
 
 int QoreString::concatDecodeUriRequest(const QoreString& url_str, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    TempEncodingHelper str(url_str, priv->getEncoding(), xsink);
    if (*xsink)
       return -1;
@@ -1859,14 +1972,17 @@ int QoreString::concatDecodeUriRequest(const QoreString& url_str, ExceptionSink*
 
 // return 0 for success
 int QoreString::vsprintf(const char* fmt, va_list args) {
+   priv->invalidateCharIndex();
    return priv->vsprintf(fmt, args);
 }
 
 void QoreString::concat(const char* str) {
+   priv->invalidateCharIndex();
    priv->concat(str);
 }
 
 void QoreString::concat(const std::string& str) {
+   priv->invalidateCharIndex();
    priv->check_char(priv->len + str.size());
    memcpy(priv->buf + priv->len, str.c_str(), str.size());
    priv->len += str.size();
@@ -1874,6 +1990,7 @@ void QoreString::concat(const std::string& str) {
 }
 
 void QoreString::concat(const char* str, qore_size_t size) {
+   priv->invalidateCharIndex();
    priv->check_char(priv->len + size);
    memcpy(priv->buf + priv->len, str, size);
    priv->len += size;
@@ -1881,6 +1998,7 @@ void QoreString::concat(const char* str, qore_size_t size) {
 }
 
 void QoreString::concat(const QoreString* str) {
+   priv->invalidateCharIndex();
    if (str)
       priv->concat(str->priv);
 }
@@ -1900,10 +2018,12 @@ void QoreString::concat(const QoreString* str, qore_size_t size) {
 */
 
 void QoreString::concat(const QoreString* str, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    priv->concat(str, xsink);
 }
 
 void QoreString::concat(const QoreString* str, qore_size_t size, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    // if it's not a null string
    if (str && str->priv->len) {
       TempEncodingHelper cstr(str, priv->getEncoding(), xsink);
@@ -1912,7 +2032,7 @@ void QoreString::concat(const QoreString* str, qore_size_t size, ExceptionSink*
 
       // adjust size for number of characters if this is a multi-byte character set
       if (priv->getEncoding()->isMultiByte()) {
-	 size = priv->getEncoding()->getByteLen(cstr->priv->buf, cstr->priv->buf + cstr->priv->len, size, xsink);
+	 size = cstr->priv->getCharByteLen(0, size, xsink);
 	 if (*xsink)
 	    return;
       }
@@ -1927,6 +2047,7 @@ void QoreString::concat(const QoreString* str, qore_size_t size, ExceptionSink*
 }
 
 int QoreString::concat(const QoreString& str, qore_offset_t pos, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    if (str.empty())
       return 0;
 
@@ -1938,6 +2059,7 @@ int QoreString::concat(const QoreString& str, qore_offset_t pos, ExceptionSink*
 }
 
 int QoreString::concat(const QoreString& str, qore_offset_t pos, qore_offset_t len, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    if (str.empty() || !len)
       return 0;
 
@@ -1949,10 +2071,12 @@ int QoreString::concat(const QoreString& str, qore_offset_t pos, qore_offset_t l
 }
 
 void QoreString::concat(char c) {
+   priv->invalidateCharIndex();
    priv->concat(c);
 }
 
 int QoreString::vsnprintf(size_t size, const char* fmt, va_list args) {
+   priv->invalidateCharIndex();
    // ensure minimum space is free
    if ((priv->allocated - priv->len) < (unsigned)size) {
       priv->allocated += (size + STR_CLASS_EXTRA);
@@ -2037,9 +2161,8 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, qore_offset
    printd(5, "QoreString::substr_complex(offset=" QSD ", length=" QSD ") string=\"%s\" (this=%p priv->len=" QSD ")\n",
 	  offset, length, priv->buf, this, priv->len);
 
-   char* pend = priv->buf + priv->len;
    if (offset < 0) {
-      int clength = priv->getEncoding()->getLength(priv->buf, pend, xsink);
+      int clength = priv->getCharLength(xsink);
       if (*xsink)
 	 return -1;
 
@@ -2049,7 +2172,7 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, qore_offset
 	 return -1;
    }
 
-   qore_size_t start = priv->getEncoding()->getByteLen(priv->buf, pend, offset, xsink);
+   qore_size_t start = priv->getCharByteLen(0, offset, xsink);
    if (*xsink)
       return -1;
 
@@ -2057,14 +2180,14 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, qore_offset
       return -1;
 
    if (length < 0) {
-      length = priv->getEncoding()->getLength(priv->buf + start, pend, xsink) + length;
+      length = priv->getCharLength(xsink, start) + length;
       if (*xsink)
 	 return -1;
 
       if (length < 0)
 	 length = 0;
    }
-   qore_size_t end = priv->getEncoding()->getByteLen(priv->buf + start, pend, length, xsink);
+   qore_size_t end = priv->getCharByteLen(start, length, xsink);
    if (*xsink)
       return -1;
 
@@ -2074,9 +2197,8 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, qore_offset
 
 int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, ExceptionSink* xsink) const {
    //printd(5, "QoreString::substr_complex(offset=" QSD ") string=\"%s\" (this=%p priv->len=" QSD ")\n", offset, priv->buf, this, priv->len);
-   char* pend = priv->buf + priv->len;
    if (offset < 0) {
-      qore_size_t clength = priv->getEncoding()->getLength(priv->buf, pend, xsink);
+      qore_size_t clength = priv->getCharLength(xsink);
       if (*xsink)
 	 return -1;
 
@@ -2088,7 +2210,7 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, ExceptionSi
       }
    }
 
-   qore_size_t start = priv->getEncoding()->getByteLen(priv->buf, pend, offset, xsink);
+   qore_size_t start = priv->getCharByteLen(0, offset, xsink);
    if (*xsink)
       return -1;
 
@@ -2104,6 +2226,7 @@ int QoreString::substr_complex(QoreString* ns, qore_offset_t offset, ExceptionSi
 }
 
 void QoreString::splice_simple(qore_size_t offset, qore_size_t num, QoreString* extract) {
+   priv->invalidateCharIndex();
    //printd(5, "splice_intern(offset=" QSD ", num=" QSD ", priv->len=" QSD ")\n", offset, num, priv->len);
    qore_size_t end;
    if (num > (priv->len - offset)) {
@@ -2128,6 +2251,7 @@ void QoreString::splice_simple(qore_size_t offset, qore_size_t num, QoreString*
 }
 
 void QoreString::splice_simple(qore_size_t offset, qore_size_t num, const char* str, qore_size_t str_len, QoreString* extract) {
+   priv->invalidateCharIndex();
    //printd(5, "splice_intern(offset=" QSD ", num=" QSD ", priv->len=" QSD ")\n", offset, num, priv->len);
 
    qore_size_t end;
@@ -2151,7 +2275,7 @@ void QoreString::splice_simple(qore_size_t offset, qore_size_t num, const char*
          memmove(priv->buf + (end - num + str_len), priv->buf + end, sizeof(char) * (ol - end));
    }
    else if (num > str_len) // make list smaller
-      memmove(priv->buf + offset + str_len, priv->buf + offset + num, sizeof(char) * (priv->len - offset - str_len));
+      memmove(priv->buf + offset + str_len, priv->buf + offset + num, sizeof(char) * (priv->len - offset - num));
 
    memcpy(priv->buf + offset, str, str_len);
 
@@ -2163,7 +2287,7 @@ void QoreString::splice_simple(qore_size_t offset, qore_size_t num, const char*
 
 void QoreString::splice_complex(qore_offset_t offset, ExceptionSink* xsink, QoreString* extract) {
    // get length in chars
-   qore_size_t clen = priv->getEncoding()->getLength(priv->buf, priv->buf + priv->len, xsink);
+   qore_size_t clen = priv->getCharLength(xsink);
    if (*xsink)
       return;
 
@@ -2177,7 +2301,7 @@ void QoreString::splice_complex(qore_offset_t offset, ExceptionSink* xsink, Qore
       return;
 
    // calculate byte offset
-   qore_size_t n_offset = offset ? priv->getEncoding()->getByteLen(priv->buf, priv->buf + priv->len, offset, xsink) : 0;
+   qore_size_t n_offset = priv->getCharByteLen(0, offset, xsink);
    if (*xsink)
       return;
 
@@ -2185,6 +2309,7 @@ void QoreString::splice_complex(qore_offset_t offset, ExceptionSink* xsink, Qore
    if (extract && n_offset < priv->len)
       extract->concat(priv->buf + n_offset);
 
+   priv->invalidateCharIndex();
    // truncate string at offset
    priv->len = n_offset;
    priv->buf[priv->len] = '\0';
@@ -2194,7 +2319,7 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, Excepti
    //printd(5, "splice_complex(offset=" QSD ", num=" QSD ", priv->len=" QSD ")\n", offset, num, priv->len);
 
    // get length in chars
-   qore_size_t clen = priv->getEncoding()->getLength(priv->buf, priv->buf + priv->len, xsink);
+   qore_size_t clen = priv->getCharLength(xsink);
    if (*xsink)
       return;
 
@@ -2221,15 +2346,15 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, Excepti
       end = offset + num;
 
    // get character positions
-   offset = priv->getEncoding()->getByteLen(priv->buf, priv->buf + priv->len, offset, xsink);
+   offset = priv->getCharByteLen(0, offset, xsink);
    if (*xsink)
       return;
 
-   end = priv->getEncoding()->getByteLen(priv->buf, priv->buf + priv->len, end, xsink);
+   end = priv->getCharByteLen(0, end, xsink);
    if (*xsink)
       return;
 
-   num = priv->getEncoding()->getByteLen(priv->buf + offset, priv->buf + priv->len, num, xsink);
+   num = priv->getCharByteLen(offset, num, xsink);
    if (*xsink)
       return;
 
@@ -2237,6 +2362,7 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, Excepti
    if (extract && num)
       extract->concat(priv->buf + offset, num);
 
+   priv->invalidateCharIndex();
    // move down entries if necessary
    if (end != priv->len)
       memmove(priv->buf + offset, priv->buf + end, sizeof(char) * (priv->len - end));
@@ -2250,7 +2376,7 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, Excepti
 
 void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, const QoreString* str, ExceptionSink* xsink, QoreString* extract) {
    // get length in chars
-   qore_size_t clen = priv->getEncoding()->getLength(priv->buf, priv->buf + priv->len, xsink);
+   qore_size_t clen = priv->getCharLength(xsink);
    if (*xsink)
       return;
 
@@ -2279,16 +2405,15 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, const Q
       end = offset + num;
 
    // get character positions
-   char* endp = priv->buf + priv->len;
-   offset = priv->getEncoding()->getByteLen(priv->buf, endp, offset, xsink);
+   offset = priv->getCharByteLen(0, offset, xsink);
    if (*xsink)
       return;
 
-   end = priv->getEncoding()->getByteLen(priv->buf, endp, end, xsink);
+   end = priv->getCharByteLen(0, end, xsink);
    if (*xsink)
       return;
 
-   num = priv->getEncoding()->getByteLen(priv->buf + offset, endp, num, xsink);
+   num = priv->getCharByteLen(offset, num, xsink);
    if (*xsink)
       return;
 
@@ -2296,6 +2421,7 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, const Q
    if (extract && num)
       extract->concat(priv->buf + offset, num);
 
+   priv->invalidateCharIndex();
    //printd(5, "offset=" QSD ", end=" QSD ", num=" QSD "\n", offset, end, num);
    // get number of entries to insert
    if (str->priv->len > (qore_size_t)num) { // make bigger
@@ -2307,7 +2433,7 @@ void QoreString::splice_complex(qore_offset_t offset, qore_offset_t num, const Q
          memmove(priv->buf + (end - num + str->priv->len), priv->buf + end, ol - end);
    }
    else if ((qore_size_t)num > str->priv->len) // make string smaller
-      memmove(priv->buf + offset + str->priv->len, priv->buf + offset + num, sizeof(char) * (priv->len - offset - str->priv->len));
+      memmove(priv->buf + offset + str->priv->len, priv->buf + offset + num, sizeof(char) * (priv->len - offset - num));
 
    memcpy(priv->buf + offset, str->priv->buf, str->priv->len);
 
@@ -2336,6 +2462,7 @@ int QoreString::compareSoft(const QoreString* str, ExceptionSink* xsink) const {
 }
 
 void QoreString::concatEscape(const char* str, char c, char esc_char) {
+   priv->invalidateCharIndex();
    // if it's not a null string
    if (str) {
       qore_size_t i = 0;
@@ -2359,6 +2486,7 @@ void QoreString::concatEscape(const char* str, char c, char esc_char) {
 }
 
 void QoreString::concatEscape(const QoreString* str, char c, char esc_char, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    // if it's not a null string
    if (str && str->priv->len) {
       TempEncodingHelper cstr(str, priv->getEncoding(), xsink);
@@ -2399,7 +2527,7 @@ QoreString* QoreString::substr(qore_offset_t offset, qore_offset_t length, Excep
 qore_size_t QoreString::length() const {
    if (priv->getEncoding()->isMultiByte() && priv->buf) {
       bool invalid;
-      return priv->getEncoding()->getLength(priv->buf, priv->buf + priv->len, invalid);
+      return priv->getCharLength(invalid);
    }
    return priv->len;
 }
@@ -2421,6 +2549,7 @@ void QoreString::concatHex(const BinaryNode *b) {
 }
 
 void QoreString::concatHex(const QoreString* str) {
+   priv->invalidateCharIndex();
    concatHex(str->priv->buf, str->priv->len);
 }
 
@@ -2465,6 +2594,7 @@ BinaryNode *QoreString::parseHex(ExceptionSink* xsink) const {
 }
 
 void QoreString::allocate(unsigned requested_size) {
+   priv->invalidateCharIndex();
    priv->allocate(requested_size);
 }
 
@@ -2477,6 +2607,7 @@ QoreString* QoreString::copy() const {
 }
 
 void QoreString::tolwr() {
+   priv->invalidateCharIndex();
    char* c = priv->buf;
    while (*c) {
       *c = ::tolower(*c);
@@ -2485,6 +2616,7 @@ void QoreString::tolwr() {
 }
 
 void QoreString::toupr() {
+   priv->invalidateCharIndex();
    char* c = priv->buf;
    while (*c) {
       *c = ::toupper(*c);
@@ -2514,6 +2646,7 @@ const char* QoreString::c_str() const {
 }
 
 void QoreString::addch(char c, unsigned times) {
+   priv->invalidateCharIndex();
    priv->check_char(priv->len + times); // more data will follow the padding
    memset(priv->buf + priv->len, c, times);
    priv->len += times;
@@ -2521,6 +2654,7 @@ void QoreString::addch(char c, unsigned times) {
 }
 
 int QoreString::insertch(char c, qore_size_t pos, unsigned times) {
+   priv->invalidateCharIndex();
    //printd(5, "QoreString::insertch(c: %c pos: " QLLD " times: %d) this: %p\n", c, pos, times, this);
    if (pos > priv->len || !times)
       return -1;
@@ -2535,6 +2669,7 @@ int QoreString::insertch(char c, qore_size_t pos, unsigned times) {
 }
 
 int QoreString::insert(const char* str, qore_size_t pos) {
+   priv->invalidateCharIndex();
    if (pos > priv->len)
       return -1;
 
@@ -2550,14 +2685,17 @@ int QoreString::insert(const char* str, qore_size_t pos) {
 }
 
 int QoreString::concatUnicode(unsigned code, ExceptionSink* xsink) {
+   priv->invalidateCharIndex();
    return priv->concatUnicode(code, xsink);
 }
 
 int QoreString::concatUnicode(unsigned code) {
+   priv->invalidateCharIndex();
    return priv->concatUnicode(code);
 }
 
 void QoreString::concatUTF8FromUnicode(unsigned code) {
+   priv->invalidateCharIndex();
    priv->concatUTF8FromUnicode(code);
 }
 
@@ -2565,7 +2703,7 @@ unsigned int QoreString::getUnicodePointFromUTF8(qore_offset_t offset) const {
    // get length in chars
    bool invalid;
    char* endp = priv->buf + priv->len;
-   qore_size_t clen = priv->getEncoding()->getLength(priv->buf, endp, invalid);
+   qore_size_t clen = priv->getCharLength(invalid);
    if (invalid)
       return 0;
 
@@ -2580,7 +2718,7 @@ unsigned int QoreString::getUnicodePointFromUTF8(qore_offset_t offset) const {
 
    // calculate byte offset
    if (offset) {
-      offset = priv->getEncoding()->getByteLen(priv->buf, endp, offset, invalid);
+      offset = priv->getCharByteLen(0, offset, invalid);
       if (invalid)
 	 return 0;
    }
@@ -2599,7 +2737,7 @@ unsigned int QoreString::getUnicodePoint(qore_offset_t offset, ExceptionSink* xs
 	 if (offset < 0)
 	    offset = 0;
       }
-      qore_size_t bl = priv->getEncoding()->getByteLen(priv->buf, priv->buf + priv->len, offset, xsink);
+      qore_size_t bl = priv->getCharByteLen(0, offset, xsink);
       if (*xsink)
 	 return 0;
 
@@ -2623,6 +2761,7 @@ QoreString* QoreString::reverse() const {
 
 // remove trailing char
 void QoreString::trim_trailing(char c) {
+   priv->invalidateCharIndex();
    if (!priv->len)
       return;
 
@@ -2641,6 +2780,7 @@ void QoreString::trim_single_trailing(char c) {
 
 // remove leading char
 void QoreString::trim_leading(char c) {
+   priv->invalidateCharIndex();
    if (!priv->len)
       return;
 
@@ -2656,6 +2796,7 @@ void QoreString::trim_leading(char c) {
 
 // remove single leading char
 void QoreString::trim_single_leading(char c) {
+   priv->invalidateCharIndex();
    if (priv->len && priv->buf[0] == c) {
       memmove(priv->buf, priv->buf + 1, priv->len);
       priv->len -= 1;
@@ -2670,6 +2811,7 @@ void QoreString::trim(char c) {
 
 // remove trailing chars
 void QoreString::trim_trailing(const char* chars) {
+   priv->invalidateCharIndex();
    if (!priv->len)
       return;
 
@@ -2686,6 +2828,7 @@ void QoreString::trim_trailing(const char* chars) {
 
 // remove leading char
 void QoreString::trim_leading(const char* chars) {
+   priv->invalidateCharIndex();
    if (!priv->len)
       return;
 
@@ -2802,6 +2945,7 @@ void QoreString::prepend(const char* str) {
 }
 
 void QoreString::prepend(const char* str, qore_size_t size) {
+   priv->invalidateCharIndex();
    priv->check_char(priv->len + size + 1);
    // move memory forward
    memmove((char*)priv->buf + size, priv->buf, priv->len + 1);
@@ -56,6 +56,14 @@ QoreStringNode::~QoreStringNode() {
    //sset.del(this);
 }
 
+void* QoreStringNode::operator new(size_t size) {
+   return qore_slab_alloc(size);
+}
+
+void QoreStringNode::operator delete(void* p) {
+   qore_slab_free(p);
+}
+
 QoreStringNode::QoreStringNode(const char *str, const QoreEncoding *enc) : SimpleValueQoreNode(NT_STRING), QoreString(str, enc) {
    //sset.add(this);
 }
@@ -32,6 +32,7 @@
 #include <qore/Qore.h>
 #include "qore/intern/QoreTimeZoneManager.h"
 #include "qore/intern/qore_date_private.h"
+#include "qore/intern/QoreThreadLocalObject.h"
 
 #include <stdio.h>
 #include <time.h>
@@ -49,13 +50,15 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include <memory>
 #include <map>
+#include <algorithm>
 
 #define QB(x) ((x) ? "true" : "false")
 
-QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink *xsink) : AbstractQoreZoneInfo(n_name), first_pos(-1), valid(false), std_abbr(0) {
+QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink *xsink) : AbstractQoreZoneInfo(n_name), valid(false), std_abbr(0) {
    printd(5, "QoreZoneInfo::QoreZoneInfo() this: %p root: %s name: %s\n", this, root.getBuffer(), name.c_str());
 
    std::string fn = root.getBuffer();
@@ -87,7 +90,7 @@ QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink
    unsigned tzh_ttisutccnt,  // The number of UTC/local indicators stored in the file
       tzh_ttisstdcnt,        // The number of standard/wall indicators stored in the file
       tzh_leapcnt,           // The number of leap seconds for which data is stored in the file
-      tzh_timecnt,           // The number of "QoreDSTTransition times" for which data is stored in the file
+      tzh_timecnt,           // The number of "transition times" for which data is stored in the file
       tzh_typecnt,           // The number of "local time types" for which data is stored in the file (must not be zero)
       tzh_charcnt;           // The number of characters of "timezone abbreviation strings" stored in the file
 
@@ -117,28 +120,28 @@ QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink
       return;
    }
 
-   QoreDSTTransitions.resize(tzh_timecnt);
+   trans_time.resize(tzh_timecnt);
 
-   // read in QoreDSTTransition time values
+   // read in transition time values
    for (unsigned i = 0; i < tzh_timecnt; ++i) {
-      if (f.readi4(&QoreDSTTransitions[i].time, xsink))
+      if (f.readi4(&trans_time[i], xsink))
 	 return;
 
-      if (first_pos == -1 && QoreDSTTransitions[i].time >= 0)
-         first_pos = i;
-      //printd(5, "QoreZoneInfo::QoreZoneInfo() trans_time[%d]: %u\n", i, QoreDSTTransitions[i].time);
+      if (i && trans_time[i] < trans_time[i - 1]) {
+	 xsink->raiseException("TZINFO-ERROR", "%s: transition time %d (%d) is less than the previous transition time (%d)", fn.c_str(), i, trans_time[i], trans_time[i - 1]);
+	 return;
+      }
+      //printd(5, "QoreZoneInfo::QoreZoneInfo() trans_time[%d]: %u\n", i, trans_time[i]);
    }
 
-   // for QoreDSTTransition type pointers
-   std::vector<unsigned char> trans_type;
    trans_type.resize(tzh_timecnt);
 
-   // read in QoreDSTTransition type array
+   // read in transition type array
    for (unsigned i = 0; i < tzh_timecnt; ++i) {
       if (f.readu1(&trans_type[i], xsink))
 	 return;
       if (trans_type[i] >= tzh_typecnt) {
-	 xsink->raiseException("TZINFO-ERROR", "QoreDSTTransition type index %d (%d) is greater than tzh_typecnt (%d)", i, trans_type[i], tzh_typecnt);
+	 xsink->raiseException("TZINFO-ERROR", "transition type index %d (%d) is greater than tzh_typecnt (%d)", i, trans_type[i], tzh_typecnt);
 	 return;
       }
       //printd(5, "QoreZoneInfo::QoreZoneInfo() trans_type[%d]: %d\n", i, trans_type[i]);
@@ -172,26 +175,21 @@ QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink
       ai.push_back(c);
    }
 
-   // set QoreDSTTransition pointers and remove invalid bands
+   // remove invalid bands
    {
-      dst_transition_vec_t::iterator di = QoreDSTTransitions.begin();
+      unsigned j = 0;
       for (unsigned i = 0; i < tzh_timecnt; ++i) {
-         QoreDSTTransition& t = *di;
-         t.trans = &tti[trans_type[i]];
-         if (di != QoreDSTTransitions.begin()) {
-            dst_transition_vec_t::iterator prev = di;
-            --prev;
-            if (t.trans->utcoff == prev->trans->utcoff) {
-               // invalid transition found
-               printd(1, "QoreZoneInfo::QoreZoneInfo() skipping invalid transition [%d] at %d\n", i, t.time);
-               QoreDSTTransitions.erase(di);
-               di = prev;
-               if ((int)i < first_pos)
-                 --first_pos;
-            }
+         if (j && tti[trans_type[i]].utcoff == tti[trans_type[j - 1]].utcoff) {
+            // invalid transition found
+            printd(1, "QoreZoneInfo::QoreZoneInfo() skipping invalid transition [%d] at %d\n", i, trans_time[i]);
+            continue;
          }
-         ++di;
+         trans_time[j] = trans_time[i];
+         trans_type[j] = trans_type[i];
+         ++j;
       }
+      trans_time.resize(j);
+      trans_type.resize(j);
    }
 
    // read in abbreviation list
@@ -254,15 +252,15 @@ QoreZoneInfo::QoreZoneInfo(QoreString &root, std::string &n_name, ExceptionSink
    }
 
 #if 0
-   for (unsigned i = 0, e = QoreDSTTransitions.size(); i < e; ++i) {
-      DateTime d((int64)QoreDSTTransitions[i].time);
+   for (unsigned i = 0, e = trans_time.size(); i < e; ++i) {
+      DateTime d((int64)trans_time[i]);
       str.clear();
       d.format(str, "Dy Mon DD YYYY HH:mm:SS");
-      QoreTransitionInfo &trans = *QoreDSTTransitions[i].trans;
+      QoreTransitionInfo &trans = tti[trans_type[i]];
       DateTime local(d.getEpochSeconds() + trans.utcoff);
       QoreString lstr;
       local.format(lstr, "Dy Mon DD YYYY HH:mm:SS");
-      printd(0, "QoreZoneInfo::QoreZoneInfo() trans[%3d] time: %d %s UTC = %s %s isdst: %d isstd: %d isutc: %d utcoff: %d\n", i, QoreDSTTransitions[i].time, str.getBuffer(), lstr.getBuffer(), trans.abbr.c_str(), trans.isdst, trans.isstd, trans.isutc, trans.utcoff);
+      printd(0, "QoreZoneInfo::QoreZoneInfo() trans[%3d] time: %d %s UTC = %s %s isdst: %d isstd: %d isutc: %d utcoff: %d\n", i, trans_time[i], str.getBuffer(), lstr.getBuffer(), trans.abbr.c_str(), trans.isdst, trans.isstd, trans.isutc, trans.utcoff);
    }
 #endif
 
@@ -275,6 +273,20 @@ int QoreTimeZoneManager::process(const char *fn) {
    return processIntern(fn, &xsink);
 }
 
+const char *QoreTimeZoneManager::getRegionKey(const char *fn) const {
+#ifdef _Q_WINDOWS
+   return fn;
+#else
+   return !strncmp(root.getBuffer(), fn, root.strlen()) ? fn + root.strlen() + 1 : fn;
+#endif
+}
+
+const AbstractQoreZoneInfo *QoreTimeZoneManager::findRegion(const char *fn) const {
+   QoreAutoRWReadLocker al(rwl);
+   tzmap_t::const_iterator i = tzmap.find(getRegionKey(fn));
+   return i == tzmap.end() ? 0 : i->second;
+}
+
 const AbstractQoreZoneInfo *QoreTimeZoneManager::processFile(const char *fn, bool use_path, ExceptionSink *xsink) {
 #ifdef _Q_WINDOWS
    tzmap_t::iterator i = tzmap.find(fn);
@@ -308,7 +320,7 @@ const AbstractQoreZoneInfo *QoreTimeZoneManager::processFile(const char *fn, boo
 
    return rv;
 #else
-   std::string name = !strncmp(root.getBuffer(), fn, root.strlen()) ? fn + root.strlen() + 1 : fn;
+   std::string name = getRegionKey(fn);
    tzmap_t::iterator i = tzmap.find(name);
    if (i != tzmap.end())
       return i->second;
@@ -343,49 +355,94 @@ int QoreTimeZoneManager::processIntern(const char *fn, ExceptionSink *xsink) {
    return processFile(fn, false, xsink) ? 0 : -1;
 }
 
+// per-thread cache of the last transition interval found for each zone; most date conversions in a thread
+// use the same few zones and fall in the same transition interval as the previous conversion
+class QoreZoneCache {
+public:
+   DLLLOCAL QoreZoneCache() {
+      memset(entry, 0, sizeof entry);
+   }
+
+   DLLLOCAL bool find(const QoreZoneInfo *zone, int64 epoch_offset, const QoreTransitionInfo *&info) const {
+      const QoreZoneCacheEntry &e = entry[slot(zone)];
+      if (e.zone != zone || epoch_offset < e.start || epoch_offset >= e.end)
+         return false;
+      info = e.info;
+      return true;
+   }
+
+   DLLLOCAL void set(const QoreZoneInfo *zone, int64 start, int64 end, const QoreTransitionInfo *info) {
+      QoreZoneCacheEntry &e = entry[slot(zone)];
+      e.zone = zone;
+      e.start = start;
+      e.end = end;
+      e.info = info;
+   }
+
+private:
+   enum { ZONE_CACHE_SIZE = 8 };
+
+   struct QoreZoneCacheEntry {
+      const QoreZoneInfo *zone;
+      int64 start, end;
+      const QoreTransitionInfo *info;
+   };
+
+   QoreZoneCacheEntry entry[ZONE_CACHE_SIZE];
+
+   DLLLOCAL static unsigned slot(const QoreZoneInfo *zone) {
+      return ((size_t)zone / sizeof(QoreZoneInfo)) % ZONE_CACHE_SIZE;
+   }
+};
+
+static QoreThreadLocalObject<QoreZoneCache> qore_zone_cache;
+
+const QoreTransitionInfo *QoreZoneInfo::findTransition(int64 epoch_offset, int64 &start, int64 &end) const {
+   // find the first transition after the given time
+   std::vector<int>::const_iterator i = std::upper_bound(trans_time.begin(), trans_time.end(), epoch_offset);
+
+   // before the first transition or after the last one, the time zone is unknown
+   if (i == trans_time.begin()) {
+      start = -LLONG_MAX - 1;
+      end = i == trans_time.end() ? LLONG_MAX : *i;
+      return 0;
+   }
+   if (i == trans_time.end()) {
+      start = trans_time.back();
+      end = LLONG_MAX;
+      return 0;
+   }
+
+   end = *i;
+   --i;
+   start = *i;
+   return &tti[trans_type[i - trans_time.begin()]];
+}
+
 int QoreZoneInfo::getUTCOffsetImpl(int64 epoch_offset, bool &is_dst, const char *&zone_name) const {
-   //printf("QoreZoneInfo::getUTCOffsetImpl() epoch_offset: %lld first_pos: %d time: %lld\n", epoch_offset, first_pos, first_pos > 0 ? QoreDSTTransitions[first_pos - 1].time : -1ll);
-   unsigned i = 0;
-   if (first_pos > 0 && epoch_offset >= QoreDSTTransitions[first_pos - 1].time) {
-      i = first_pos - 1;
-      unsigned end = QoreDSTTransitions.size() - 1;
-      while (i < end) {
-         if (QoreDSTTransitions[i].time <= epoch_offset && QoreDSTTransitions[i + 1].time > epoch_offset) {
-            zone_name = QoreDSTTransitions[i].trans->abbr.c_str();
-            is_dst = QoreDSTTransitions[i].trans->isdst;
-
-            //printf("QoreZoneInfo::getUTCOffsetImpl(epoch: %lld) tt[<=]: %d tt[>]: %d zone_name: %s is_dst: %d utcoff: %d\n", epoch_offset, QoreDSTTransitions[i].time, QoreDSTTransitions[i + 1].time, zone_name, is_dst, QoreDSTTransitions[i].trans->utcoff);
-            return QoreDSTTransitions[i].trans->utcoff;
-         }
-         ++i;
-      }
+   const QoreTransitionInfo *info;
+   QoreZoneCache *zc = qore_zone_cache.get();
+   if (!zc || !zc->find(this, epoch_offset, info)) {
+      int64 start, end;
+      info = findTransition(epoch_offset, start, end);
+      if (zc)
+         zc->set(this, start, end, info);
+   }
+
+   if (!info) {
       // not found, time zone unknown
       is_dst = false;
       zone_name = std_abbr;
 
       //printf("QoreZoneInfo::getUTCOffsetImpl(epoch: %lld) NOT FOUND zone_name: %s is_dst: %d utcoff: %d\n", epoch_offset, zone_name, is_dst, utcoff);
-
       return utcoff;
    }
 
-   i = first_pos + 1;
-   while (i > 0) {
-      if (QoreDSTTransitions[i].time > epoch_offset && QoreDSTTransitions[i - 1].time <= epoch_offset) {
-         zone_name = QoreDSTTransitions[i].trans->abbr.c_str();
-         is_dst = QoreDSTTransitions[i].trans->isdst;
-
-         //printf("QoreZoneInfo::getUTCOffsetImpl(epoch: %lld) i: %d tt[<=]: %d tt[>]: %d zone_name: %s is_dst: %d utcoff: %d\n", epoch_offset, i, QoreDSTTransitions[i].time, QoreDSTTransitions[i + 1].time, zone_name, is_dst, QoreDSTTransitions[i].trans->utcoff);
-         return QoreDSTTransitions[i].trans->utcoff;
-      }
-      --i;
-   }
-   // not found, time zone unknown
-   is_dst = false;
-   zone_name = std_abbr;
-
-   //printf("QoreZoneInfo::getUTCOffsetImpl(epoch: %lld) NOT FOUND zone_name: %s is_dst: %d utcoff: %d\n", epoch_offset, zone_name, is_dst, utcoff);
+   zone_name = info->abbr.c_str();
+   is_dst = info->isdst;
 
-   return utcoff;
+   //printf("QoreZoneInfo::getUTCOffsetImpl(epoch: %lld) zone_name: %s is_dst: %d utcoff: %d\n", epoch_offset, zone_name, is_dst, info->utcoff);
+   return info->utcoff;
 }
 
 // format: S00[[:]00[[:]00]] (S is + or -)
@@ -1508,12 +1565,21 @@ int QoreTimeZoneManager::readAll(ExceptionSink *xsink) {
 }
 
 const AbstractQoreZoneInfo *QoreTimeZoneManager::findLoadRegion(const char *name, ExceptionSink *xsink) {
+   // regions are only loaded once, so look for a loaded region with the read lock first
+   const AbstractQoreZoneInfo *rv = findRegion(name);
+   if (rv)
+      return rv;
+
    QoreAutoRWWriteLocker al(rwl);
    // find or load region
    return processFile(name, false, xsink);
 }
 
 const AbstractQoreZoneInfo *QoreTimeZoneManager::findLoadRegionFromPath(const char *name, ExceptionSink *xsink) {
+   const AbstractQoreZoneInfo *rv = findRegion(name);
+   if (rv)
+      return rv;
+
    QoreAutoRWWriteLocker al(rwl);
    // find or load region
    return processFile(name, true, xsink);
@@ -40,6 +40,13 @@ bool RObject::scanCheck(RSetHelper& rsh, AbstractQoreNode* n) {
    return rsh.checkIntern(n);
 }
 
+void RObject::scanRSet() {
+   if (QCC.deferScan() && QCC.queue(*this))
+      return;
+
+   RSetHelper rsh(*this);
+}
+
 void RObject::setRSet(RSet* rs, int rcnt) {
    assert(rml.checkRSectionExclusive());
    printd(QRO_LVL, "RObject::setRSet() this: %p %s rs: %p rcnt: %d\n", this, getName(), rs, rcnt);
@@ -613,6 +620,20 @@ public:
    }
 };
 
+// records the time taken for a recursive reference scan
+class RScanTimer {
+public:
+   DLLLOCAL RScanTimer() : start(q_clock_getmicros()) {
+   }
+
+   DLLLOCAL ~RScanTimer() {
+      QCC.scanDone(q_clock_getmicros() - start);
+   }
+
+private:
+   int64 start;
+};
+
 RSetHelper::RSetHelper(RObject& obj) : fomap_size(0) {
 #ifdef DEBUG
    lcnt = 0;
@@ -622,6 +643,7 @@ RSetHelper::RSetHelper(RObject& obj) : fomap_size(0) {
 
    printd(QRO_LVL, "RSetHelper::RSetHelper() this: %p (%p %s) ENTER\n", this, &obj, obj.getName());
 
+   RScanTimer rst;
    RScanHelper rsh(obj);
 
    while (true) {
@@ -736,3 +758,204 @@ void RSetHelper::rollback() {
    sched_yield();
 #endif
 }
+
+QoreCycleCollector QCC;
+
+static void qcc_thread(ExceptionSink* xsink, void* arg) {
+   QCC.run(xsink);
+}
+
+bool QoreCycleCollector::queue(RObject& obj) {
+   AutoLocker al(l);
+   if (obj.rqueued)
+      return true;
+
+   // the collector may have been disabled since deferScan() was called; no scans are made at all if garbage
+   // collection is disabled
+   if (!deferred.load() || q_disable_gc)
+      return false;
+
+   if (!running) {
+      ExceptionSink xsink;
+      if (q_start_thread(&xsink, qcc_thread) == -1) {
+         // the scan is made in the current thread if the collector thread cannot be started
+         xsink.clear();
+         return false;
+      }
+      running = true;
+   }
+
+   if (!obj.scanRef())
+      return false;
+
+   // objects that do not know their Program are assigned to the Program of the current thread
+   QoreProgram* pgm = obj.getOwnerProgram();
+   if (!pgm)
+      pgm = getProgram();
+
+   obj.rqueued = true;
+   q.push_back({&obj, pgm});
+   roots_queued.fetch_add(1, std::memory_order_relaxed);
+
+   if (waiting && (int)q.size() >= trigger)
+      cond.broadcast();
+   return true;
+}
+
+void QoreCycleCollector::take(rqueue_t& batch, QoreProgram* pgm) {
+   assert(batch.empty());
+   if (!pgm)
+      batch.swap(q);
+   else {
+      rqueue_t::iterator qe = q.begin();
+      for (rqueue_t::iterator i = q.begin(), e = q.end(); i != e; ++i) {
+         if (i->pgm == pgm)
+            batch.push_back(*i);
+         else
+            *qe++ = *i;
+      }
+      q.erase(qe, q.end());
+   }
+   if (batch.empty())
+      return;
+
+   for (rqueue_t::iterator i = batch.begin(), e = batch.end(); i != e; ++i)
+      i->obj->rqueued = false;
+   batches.fetch_add(1, std::memory_order_relaxed);
+}
+
+void QoreCycleCollector::process(rqueue_t& batch, ExceptionSink* xsink) {
+   for (rqueue_t::iterator i = batch.begin(), e = batch.end(); i != e; ++i) {
+      {
+         RSetHelper rsh(*i->obj);
+      }
+      // releasing the collector's reference collects the object if only recursive references remain
+      i->obj->scanDeref(xsink);
+   }
+   roots_scanned.fetch_add(batch.size(), std::memory_order_relaxed);
+   batch.clear();
+}
+
+void QoreCycleCollector::run(ExceptionSink* xsink) {
+   csync.set(this);
+   printd(5, "QoreCycleCollector::run() TID %d started\n", gettid());
+
+   rqueue_t batch;
+   SafeLocker sl(l);
+   while (true) {
+      if (q.empty() || (deferred.load() && (int)q.size() < trigger)) {
+         waiting = true;
+         int rc = cond.wait2(&l, interval);
+         waiting = false;
+         // exit if no objects have been queued in the last interval
+         if (q.empty()) {
+            if (rc || !deferred.load())
+               break;
+            continue;
+         }
+      }
+
+      take(batch);
+      // Program teardown waits for batches containing the Program's objects
+      for (rqueue_t::iterator i = batch.begin(), e = batch.end(); i != e; ++i) {
+         if (i->pgm)
+            active_pgms.insert(i->pgm);
+      }
+      sl.unlock();
+      process(batch, xsink);
+      // report exceptions raised in destructors
+      xsink->handleExceptions();
+      sl.lock();
+      if (!active_pgms.empty()) {
+         active_pgms.clear();
+         cond.broadcast();
+      }
+   }
+
+   running = false;
+   // wake up any thread waiting in del()
+   cond.broadcast();
+   sl.unlock();
+
+   printd(5, "QoreCycleCollector::run() TID %d stopped\n", gettid());
+   csync.set(0);
+}
+
+void QoreCycleCollector::flush(ExceptionSink* xsink, QoreProgram* pgm) {
+   // scans in the current thread must be synchronous while processing the queue
+   void* old = csync.get();
+   if (!old)
+      csync.set(&q);
+
+   rqueue_t batch;
+   while (true) {
+      {
+         AutoLocker al(l);
+         // the collector thread cannot wait for its own batch
+         if (pgm && old != this) {
+            while (active_pgms.find(pgm) != active_pgms.end())
+               cond.wait(&l);
+         }
+         take(batch, pgm);
+         if (batch.empty())
+            break;
+      }
+      process(batch, xsink);
+   }
+
+   if (!old)
+      csync.set(0);
+}
+
+void QoreCycleCollector::set(bool enable, int n_trigger, int64 n_interval, ExceptionSink* xsink) {
+   assert(n_trigger > 0);
+   assert(n_interval > 0);
+   {
+      AutoLocker al(l);
+      trigger = n_trigger;
+      interval = n_interval;
+      deferred.store(enable);
+      if (waiting)
+         cond.broadcast();
+   }
+
+   if (!enable)
+      flush(xsink);
+}
+
+void QoreCycleCollector::del() {
+   {
+      SafeLocker sl(l);
+      deferred.store(false);
+      if (waiting)
+         cond.broadcast();
+      // wait for the collector thread to exit
+      while (running)
+         cond.wait(&l);
+   }
+
+   ExceptionSink xsink;
+   flush(&xsink);
+   xsink.handleExceptions();
+}
+
+QoreHashNode* QoreCycleCollector::getStats() {
+   QoreHashNode* h = new QoreHashNode;
+   {
+      AutoLocker al(l);
+      h->setKeyValue("deferred", get_bool_node(deferred.load()), 0);
+      h->setKeyValue("trigger", new QoreBigIntNode(trigger), 0);
+      h->setKeyValue("interval", new QoreBigIntNode(interval), 0);
+      h->setKeyValue("running", get_bool_node(running), 0);
+      h->setKeyValue("queued", new QoreBigIntNode(q.size()), 0);
+   }
+   h->setKeyValue("roots_queued", new QoreBigIntNode(roots_queued.load()), 0);
+   h->setKeyValue("roots_scanned", new QoreBigIntNode(roots_scanned.load()), 0);
+   h->setKeyValue("batches", new QoreBigIntNode(batches.load()), 0);
+   h->setKeyValue("scans", new QoreBigIntNode(scans.load()), 0);
+   h->setKeyValue("scan_time_us", new QoreBigIntNode(scan_us.load()), 0);
+   h->setKeyValue("background_scans", new QoreBigIntNode(bg_scans.load()), 0);
+   h->setKeyValue("background_scan_time_us", new QoreBigIntNode(bg_scan_us.load()), 0);
+   h->setKeyValue("cycles_freed", new QoreBigIntNode(cycles_freed.load()), 0);
+   return h;
+}
@@ -58,7 +58,7 @@ AbstractQoreNode* ParseReferenceNode::doPartialEval(AbstractQoreNode* n, QoreObj
 
       if (v->getType() == VT_LOCAL_TS) {
          const char* name = v->ref.id->getName();
-         ClosureVarValue* cvv = thread_find_closure_var(name);
+         ClosureVarValue* cvv = v->ref.id->getClosureVar();
          //printd(5, "ParseReferenceNode::doPartialEval() this: %p '%s' cvv: %p\n", this, name, cvv);
 	 lvalue_id = cvv;
          return new VarRefImmediateNode(strdup(name), cvv, v->ref.id->getTypeInfo());
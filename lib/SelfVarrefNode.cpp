@@ -29,6 +29,8 @@
 */
 
 #include <qore/Qore.h>
+#include "qore/intern/QoreClassIntern.h"
+#include "qore/intern/QoreObjectIntern.h"
 
 // get string representation (for %n and %N), foff is for multi-line formatting offset, -1 = no line breaks
 // the ExceptionSink is only needed for QoreObject where a method may be executed
@@ -54,7 +56,7 @@ const char *SelfVarrefNode::getTypeName() const {
 
 QoreValue SelfVarrefNode::evalValueImpl(bool &needs_deref, ExceptionSink *xsink) const {
    assert(runtime_get_stack_object());
-   return runtime_get_stack_object()->getReferencedMemberNoMethod(str, xsink);
+   return qore_object_private::get(*runtime_get_stack_object())->getReferencedMemberNoMethod(str, cache, xsink);
 }
 
 char *SelfVarrefNode::takeString() {
@@ -151,7 +151,7 @@ public:
    }
 };
 
-VariableBlockHelper::VariableBlockHelper() {
+VariableBlockHelper::VariableBlockHelper() : fenv(thread_set_lvar_frame_parse_env(0)) {
    new VNode(0);
    //printd(5, "VariableBlockHelper::VariableBlockHelper() this=%p pushed %p\n", this, 0);
 }
@@ -160,6 +160,7 @@ VariableBlockHelper::~VariableBlockHelper() {
    std::unique_ptr<VNode> vnode(getVStack());
    assert(vnode.get());
    updateVStack(vnode->next);
+   thread_set_lvar_frame_parse_env(fenv);
    //printd(5, "VariableBlockHelper::~VariableBlockHelper() this=%p got %p\n", this, vnode->lvar);
 }
 
@@ -308,6 +309,13 @@ LocalVar* push_local_var(const char* name, const QoreProgramLocation& loc, const
       }
    }
 
+   // register the variable for a slot in the frame of the user code being parsed
+   if (!top_level) {
+      LocalVarFrameParseEnvironment* fenv = thread_get_lvar_frame_parse_env();
+      if (fenv && fenv->getParseProgram() == pgm)
+         fenv->add(lv);
+   }
+
    //printd(5, "push_local_var(): pushing var %s\n", name);
    new VNode(lv, &loc, n_refs, top_level);
    return lv;
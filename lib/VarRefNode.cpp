@@ -94,7 +94,7 @@ QoreValue VarRefNode::evalValueImpl(bool& needs_deref, ExceptionSink* xsink) con
    }
    else if (type == VT_LOCAL_TS) {
       printd(5, "VarRefNode::evalImpl() this: %p local thread-safe var %p (%s)\n", this, ref.id, ref.id->getName());
-      ClosureVarValue *val = thread_find_closure_var(ref.id->getName());
+      ClosureVarValue *val = ref.id->getClosureVar();
       v = val->evalValue(needs_deref, xsink);
    }
    else if (type == VT_IMMEDIATE)
@@ -192,7 +192,7 @@ int VarRefNode::getLValue(LValueHelper& lvh, bool for_remove) const {
    if (type == VT_CLOSURE)
       return thread_get_runtime_closure_var(ref.id)->getLValue(lvh, for_remove);
    if (type == VT_LOCAL_TS)
-      return thread_find_closure_var(ref.id->getName())->getLValue(lvh, for_remove);
+      return ref.id->getClosureVar()->getLValue(lvh, for_remove);
    if (type == VT_IMMEDIATE)
       return ref.cvv->getLValue(lvh, for_remove);
    assert(type == VT_GLOBAL);
@@ -205,7 +205,7 @@ DLLLOCAL void VarRefNode::remove(LValueRemoveHelper& lvrh) {
    if (type == VT_CLOSURE)
       return thread_get_runtime_closure_var(ref.id)->remove(lvrh);
    if (type == VT_LOCAL_TS)
-      return thread_find_closure_var(ref.id->getName())->remove(lvrh);
+      return ref.id->getClosureVar()->remove(lvrh);
    if (type == VT_IMMEDIATE)
       return ref.cvv->remove(lvrh);
    assert(type == VT_GLOBAL);
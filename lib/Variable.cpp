@@ -263,7 +263,7 @@ LValueHelper::~LValueHelper() {
    if (robj) {
       // recalculate recursive references for objects if necessary
       if (obj_chg)
-         RSetHelper rsh(*robj);
+         robj->scanRSet();
       if (obj_ref)
          robj->tDeref();
    }
@@ -1342,11 +1342,16 @@ void ClosureVarValue::deref(ExceptionSink* xsink) {
                   break;
                assert(rc == -1);
             }
+            // let the background collector recalculate the references if enabled
+            if (QCC.deferScan() && QCC.queue(*this))
+               break;
             // need to recalculate references
             RSetHelper rsh(*this);
          }
-         if (do_del)
+         if (do_del) {
             qodh.willDelete();
+            QCC.cycleFreed();
+         }
       }
    }
 
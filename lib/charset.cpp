@@ -29,14 +29,23 @@
 */
 
 #include <qore/Qore.h>
+#include "qore/intern/IconvHelper.h"
+#include "qore/intern/QoreThreadLocalObject.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <iconv.h>
+#include <stdint.h>
 
 #include <map>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QORE_UTF8_X86 1
+#include <immintrin.h>
+#endif
 
 const QoreEncoding* QCS_DEFAULT, *QCS_USASCII, *QCS_UTF8,
    *QCS_UTF16, *QCS_UTF16BE, *QCS_UTF16LE,
@@ -531,8 +540,153 @@ qore_offset_t q_UTF8_get_char_len(const char* p, qore_size_t len) {
    return 1;
 }
 
+// bit masks describing a 64-byte block of UTF-8 input; bit n corresponds to byte n of the block
+struct qore_utf8_block {
+   uint64_t nul,   // 0x00 bytes
+      hi,          // bytes >= 0x80
+      lead,        // bytes >= 0xc0: the start of a character of at least 2 bytes
+      lead3,       // bytes >= 0xe0: the start of a character of at least 3 bytes
+      lead4;       // bytes >= 0xf0: the start of a 4-byte character
+};
+
+typedef void (*q_utf8_block_t)(const char* p, qore_utf8_block& b);
+
+static void utf8_block_scalar(const char* p, qore_utf8_block& b) {
+   b.nul = b.hi = b.lead = b.lead3 = b.lead4 = 0;
+   for (unsigned i = 0; i < 64; ++i) {
+      unsigned char c = (unsigned char)p[i];
+      uint64_t bit = (uint64_t)1 << i;
+      if (!c)
+         b.nul |= bit;
+      else if (c & 0x80) {
+         b.hi |= bit;
+         if (c >= 0xc0) {
+            b.lead |= bit;
+            if (c >= 0xe0) {
+               b.lead3 |= bit;
+               if (c >= 0xf0)
+                  b.lead4 |= bit;
+            }
+         }
+      }
+   }
+}
+
+#ifdef QORE_UTF8_X86
+// the signed byte comparisons are true for 0x00 - 0x7f and for the given lead bytes; the high bit mask removes the former
+__attribute__((target("sse2")))
+static void utf8_block_sse2(const char* p, qore_utf8_block& b) {
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i c0 = _mm_set1_epi8((char)0xbf);
+   const __m128i e0 = _mm_set1_epi8((char)0xdf);
+   const __m128i f0 = _mm_set1_epi8((char)0xef);
+   b.nul = b.hi = b.lead = b.lead3 = b.lead4 = 0;
+   for (unsigned i = 0; i < 64; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+      uint64_t hi = (unsigned)_mm_movemask_epi8(v);
+      b.nul |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) << i;
+      b.hi |= hi << i;
+      b.lead |= ((unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(v, c0)) & hi) << i;
+      b.lead3 |= ((unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(v, e0)) & hi) << i;
+      b.lead4 |= ((unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(v, f0)) & hi) << i;
+   }
+}
+
+__attribute__((target("avx2")))
+static void utf8_block_avx2(const char* p, qore_utf8_block& b) {
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i c0 = _mm256_set1_epi8((char)0xbf);
+   const __m256i e0 = _mm256_set1_epi8((char)0xdf);
+   const __m256i f0 = _mm256_set1_epi8((char)0xef);
+   b.nul = b.hi = b.lead = b.lead3 = b.lead4 = 0;
+   for (unsigned i = 0; i < 64; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+      uint64_t hi = (uint32_t)_mm256_movemask_epi8(v);
+      b.nul |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)) << i;
+      b.hi |= hi << i;
+      b.lead |= ((uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, c0)) & hi) << i;
+      b.lead3 |= ((uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, e0)) & hi) << i;
+      b.lead4 |= ((uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, f0)) & hi) << i;
+   }
+}
+#endif
+
+static void utf8_block_select(const char* p, qore_utf8_block& b);
+
+// the block kernel is selected according to the CPU's capabilities on first use; threads racing on the first use
+// all store the same kernel
+static std::atomic<q_utf8_block_t> utf8_block(utf8_block_select);
+
+static void utf8_block_select(const char* p, qore_utf8_block& b) {
+   q_utf8_block_t f = utf8_block_scalar;
+#ifdef QORE_UTF8_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      f = utf8_block_avx2;
+   else if (__builtin_cpu_supports("sse2"))
+      f = utf8_block_sse2;
+#endif
+   utf8_block.store(f, std::memory_order_relaxed);
+   f(p, b);
+}
+
+static inline unsigned q_popcount64(uint64_t v) {
+#ifdef __GNUC__
+   return __builtin_popcountll(v);
+#else
+   unsigned c = 0;
+   for (; v; v &= v - 1)
+      ++c;
+   return c;
+#endif
+}
+
+static inline unsigned q_highbit64(uint64_t v) {
+   assert(v);
+#ifdef __GNUC__
+   return 63 - __builtin_clzll(v);
+#else
+   unsigned i = 0;
+   while (v >>= 1)
+      ++i;
+   return i;
+#endif
+}
+
+// counts characters in whole 64-byte blocks from p as long as each block holds well-formed UTF-8 (without NUL bytes if
+// stop_nul is set) and fewer than max characters would be counted; p is left at the start of a character and the caller
+// continues with the byte-wise decoder from there, so the results for invalid input are unchanged
+static qore_size_t utf8_count_blocks(const char*& p, const char* end, qore_size_t max, bool stop_nul) {
+   qore_size_t c = 0;
+   // continuation bytes expected at the start of the next block, and the lead bytes of the last block processed
+   uint64_t carry = 0, last_lead = 0;
+   const char* bp = p;
+   while (end - bp >= 64) {
+      qore_utf8_block b;
+      utf8_block.load(std::memory_order_relaxed)(bp, b);
+      uint64_t cont = b.hi & ~b.lead;
+      // every lead byte must be followed by exactly the number of continuation bytes it announces
+      if (((b.lead << 1) | (b.lead3 << 2) | (b.lead4 << 3) | carry) != cont || (stop_nul && b.nul))
+         break;
+      qore_size_t n = 64 - q_popcount64(cont);
+      if (n >= max - c)
+         break;
+      c += n;
+      carry = (b.lead >> 63) | (b.lead3 >> 62) | (b.lead4 >> 61);
+      last_lead = b.lead;
+      bp += 64;
+   }
+   if (carry) {
+      // back up to the start of the character that continues past the last block processed
+      p = bp - 64 + q_highbit64(last_lead);
+      return c - 1;
+   }
+   p = bp;
+   return c;
+}
+
 static qore_size_t UTF8_getLength(const char* p, const char* end, bool& invalid) {
-   qore_size_t i = 0;
+   qore_size_t i = utf8_count_blocks(p, end, (qore_size_t)-1, true);
    while (*p) {
       qore_offset_t l = q_UTF8_get_char_len(p, end - p);
       if (l <= 0) {
@@ -548,7 +702,9 @@ static qore_size_t UTF8_getLength(const char* p, const char* end, bool& invalid)
 }
 
 static qore_size_t UTF8_getByteLen(const char* p, const char* end, qore_size_t l, bool& invalid) {
-   qore_size_t b = 0;
+   const char* start = p;
+   l -= utf8_count_blocks(p, end, l, true);
+   qore_size_t b = p - start;
    while (*p && l) {
       qore_offset_t bl = q_UTF8_get_char_len(p, end - p);
       if (bl <= 0) {
@@ -564,7 +720,7 @@ static qore_size_t UTF8_getByteLen(const char* p, const char* end, qore_size_t l
 }
 
 static qore_size_t UTF8_getCharPos(const char* p, const char* end, bool& invalid) {
-   qore_size_t i = 0;
+   qore_size_t i = utf8_count_blocks(p, end, (qore_size_t)-1, false);
    while (p < end) {
       qore_offset_t l = q_UTF8_get_char_len(p, end - p);
       if (l <= 0) {
@@ -727,3 +883,323 @@ qore_offset_t q_get_char_len(const QoreEncoding* enc, const char* p, qore_size_t
    }
    return rc;
 }
+
+// returns the number of leading bytes < 0x80 in the given buffer
+static size_t q_ascii_run(const unsigned char* p, size_t len) {
+   size_t i = 0;
+   while (len - i >= 64) {
+      qore_utf8_block b;
+      utf8_block.load(std::memory_order_relaxed)((const char*)p + i, b);
+      if (b.hi) {
+#ifdef __GNUC__
+         return i + __builtin_ctzll(b.hi);
+#else
+         break;
+#endif
+      }
+      i += 64;
+   }
+   while (i < len && p[i] < 0x80)
+      ++i;
+   return i;
+}
+
+// decodes one UTF-8 character with the same restrictions as iconv (no overlong forms, surrogates or code points above
+// 0x10ffff); returns the byte length of the character or 0 if the input is invalid or incomplete
+static unsigned q_utf8_decode(const unsigned char* p, size_t len, unsigned& cp) {
+   unsigned char c = *p;
+   if (c < 0x80) {
+      cp = c;
+      return 1;
+   }
+   if (c < 0xc2)
+      return 0;
+   if (c < 0xe0) {
+      if (len < 2 || (p[1] & 0xc0) != 0x80)
+         return 0;
+      cp = ((c & 0x1f) << 6) | (p[1] & 0x3f);
+      return 2;
+   }
+   if (c < 0xf0) {
+      if (len < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80)
+         return 0;
+      cp = ((c & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+      return cp >= 0x800 && (cp < 0xd800 || cp > 0xdfff) ? 3 : 0;
+   }
+   if (c < 0xf5) {
+      if (len < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 || (p[3] & 0xc0) != 0x80)
+         return 0;
+      cp = ((c & 0x07) << 18) | ((p[1] & 0x3f) << 12) | ((p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+      return cp >= 0x10000 && cp <= 0x10ffff ? 4 : 0;
+   }
+   return 0;
+}
+
+static unsigned char* q_utf8_encode(unsigned char* o, unsigned cp) {
+   if (cp < 0x80)
+      *o++ = cp;
+   else if (cp < 0x800) {
+      *o++ = 0xc0 | (cp >> 6);
+      *o++ = 0x80 | (cp & 0x3f);
+   }
+   else if (cp < 0x10000) {
+      *o++ = 0xe0 | (cp >> 12);
+      *o++ = 0x80 | ((cp >> 6) & 0x3f);
+      *o++ = 0x80 | (cp & 0x3f);
+   }
+   else {
+      *o++ = 0xf0 | (cp >> 18);
+      *o++ = 0x80 | ((cp >> 12) & 0x3f);
+      *o++ = 0x80 | ((cp >> 6) & 0x3f);
+      *o++ = 0x80 | (cp & 0x3f);
+   }
+   return o;
+}
+
+static inline void q_put_utf16(unsigned char* o, unsigned u, bool be) {
+   if (be) {
+      o[0] = u >> 8;
+      o[1] = u & 0xff;
+   }
+   else {
+      o[0] = u & 0xff;
+      o[1] = u >> 8;
+   }
+}
+
+qore_fast_conversion_e q_get_fast_conversion(const QoreEncoding* to, const QoreEncoding* from) {
+   if (from == QCS_UTF8) {
+      if (to == QCS_ISO_8859_1)
+         return QFC_UTF8_TO_ISO88591;
+      if (to == QCS_USASCII)
+         return QFC_UTF8_TO_USASCII;
+      if (to == QCS_UTF16LE)
+         return QFC_UTF8_TO_UTF16LE;
+      if (to == QCS_UTF16BE)
+         return QFC_UTF8_TO_UTF16BE;
+   }
+   else if (to == QCS_UTF8) {
+      if (from == QCS_ISO_8859_1)
+         return QFC_ISO88591_TO_UTF8;
+      if (from == QCS_USASCII)
+         return QFC_USASCII_TO_UTF8;
+      if (from == QCS_UTF16LE)
+         return QFC_UTF16LE_TO_UTF8;
+      if (from == QCS_UTF16BE)
+         return QFC_UTF16BE_TO_UTF8;
+   }
+   // "UTF-16" is not handled here, because iconv writes a byte order mark when converting to it
+   return QFC_NONE;
+}
+
+int q_fast_convert(qore_fast_conversion_e type, char** inbuf, size_t* inavail, char** outbuf, size_t* outavail) {
+   assert(type != QFC_NONE);
+   const unsigned char* i = (const unsigned char*)*inbuf;
+   const unsigned char* ie = i + *inavail;
+   unsigned char* o = (unsigned char*)*outbuf;
+   unsigned char* oe = o + *outavail;
+   int rc = 0;
+
+   if (type == QFC_UTF16LE_TO_UTF8 || type == QFC_UTF16BE_TO_UTF8) {
+      bool be = type == QFC_UTF16BE_TO_UTF8;
+      while (i < ie) {
+         if (ie - i < 2) {
+            rc = -1;
+            break;
+         }
+         unsigned cp = be ? ((i[0] << 8) | i[1]) : ((i[1] << 8) | i[0]);
+         unsigned l = 2;
+         if (cp >= 0xd800 && cp <= 0xdfff) {
+            // only complete surrogate pairs are converted here
+            if (cp > 0xdbff || ie - i < 4) {
+               rc = -1;
+               break;
+            }
+            unsigned cp2 = be ? ((i[2] << 8) | i[3]) : ((i[3] << 8) | i[2]);
+            if (cp2 < 0xdc00 || cp2 > 0xdfff) {
+               rc = -1;
+               break;
+            }
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (cp2 - 0xdc00);
+            l = 4;
+         }
+         unsigned ol = cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+         if ((size_t)(oe - o) < ol) {
+            rc = E2BIG;
+            break;
+         }
+         o = q_utf8_encode(o, cp);
+         i += l;
+      }
+   }
+   else {
+      bool utf16 = type == QFC_UTF8_TO_UTF16LE || type == QFC_UTF8_TO_UTF16BE;
+      bool be = type == QFC_UTF8_TO_UTF16BE;
+      while (i < ie) {
+         // copy runs of ASCII characters, which are the same in all encodings handled here
+         size_t run = q_ascii_run(i, ie - i);
+         if (run) {
+            if (utf16) {
+               size_t n = QORE_MIN(run, (size_t)(oe - o) / 2);
+               for (size_t j = 0; j < n; ++j, o += 2)
+                  q_put_utf16(o, i[j], be);
+               i += n;
+               if (n < run) {
+                  rc = E2BIG;
+                  break;
+               }
+            }
+            else {
+               size_t n = QORE_MIN(run, (size_t)(oe - o));
+               memcpy(o, i, n);
+               o += n;
+               i += n;
+               if (n < run) {
+                  rc = E2BIG;
+                  break;
+               }
+            }
+            if (i == ie)
+               break;
+         }
+
+         if (type == QFC_ISO88591_TO_UTF8) {
+            if (oe - o < 2) {
+               rc = E2BIG;
+               break;
+            }
+            o = q_utf8_encode(o, *i);
+            ++i;
+            continue;
+         }
+         if (type == QFC_USASCII_TO_UTF8 || type == QFC_UTF8_TO_USASCII) {
+            rc = -1;
+            break;
+         }
+
+         unsigned cp;
+         unsigned l = q_utf8_decode(i, ie - i, cp);
+         if (!l) {
+            rc = -1;
+            break;
+         }
+         if (type == QFC_UTF8_TO_ISO88591) {
+            // characters that cannot be represented are left to iconv, which may transliterate them
+            if (cp > 0xff) {
+               rc = -1;
+               break;
+            }
+            if (o == oe) {
+               rc = E2BIG;
+               break;
+            }
+            *o++ = cp;
+         }
+         else {
+            assert(utf16);
+            if (cp < 0x10000) {
+               if (oe - o < 2) {
+                  rc = E2BIG;
+                  break;
+               }
+               q_put_utf16(o, cp, be);
+               o += 2;
+            }
+            else {
+               if (oe - o < 4) {
+                  rc = E2BIG;
+                  break;
+               }
+               cp -= 0x10000;
+               q_put_utf16(o, 0xd800 + (cp >> 10), be);
+               q_put_utf16(o + 2, 0xdc00 + (cp & 0x3ff), be);
+               o += 4;
+            }
+         }
+         i += l;
+      }
+   }
+
+   *inavail -= (const char*)i - *inbuf;
+   *inbuf = (char*)i;
+   *outavail -= (char*)o - *outbuf;
+   *outbuf = (char*)o;
+   return rc;
+}
+
+#define QORE_ICONV_CACHE_SIZE 4
+
+// iconv descriptors kept open by a thread for reuse; descriptors are removed from the cache while in use
+class QoreIconvCache {
+public:
+   DLLLOCAL QoreIconvCache() : n(0) {
+   }
+
+   DLLLOCAL ~QoreIconvCache() {
+      for (unsigned i = 0; i < n; ++i)
+         iconv_close(e[i].c);
+   }
+
+   DLLLOCAL iconv_t get(const QoreEncoding* to, const QoreEncoding* from) {
+      for (unsigned i = 0; i < n; ++i) {
+         if (e[i].to == to && e[i].from == from) {
+            iconv_t c = e[i].c;
+            memmove(e + i, e + i + 1, sizeof(entry) * (n - i - 1));
+            --n;
+            return c;
+         }
+      }
+      return (iconv_t)-1;
+   }
+
+   // the most recently returned descriptor is stored first; the least recently used one is closed if the cache is full
+   DLLLOCAL void put(const QoreEncoding* to, const QoreEncoding* from, iconv_t c) {
+      if (n == QORE_ICONV_CACHE_SIZE)
+         iconv_close(e[--n].c);
+      memmove(e + 1, e, sizeof(entry) * n);
+      e[0].to = to;
+      e[0].from = from;
+      e[0].c = c;
+      ++n;
+   }
+
+private:
+   struct entry {
+      const QoreEncoding* to;
+      const QoreEncoding* from;
+      iconv_t c;
+   };
+
+   entry e[QORE_ICONV_CACHE_SIZE];
+   unsigned n;
+};
+
+// each thread's cache is created on demand and freed when the thread terminates
+static QoreThreadLocalObject<QoreIconvCache> qore_iconv_cache;
+
+iconv_t q_iconv_get(const QoreEncoding* to, const QoreEncoding* from) {
+   QoreIconvCache* ic = qore_iconv_cache.get();
+   iconv_t c = ic ? ic->get(to, from) : (iconv_t)-1;
+   if (c != (iconv_t)-1) {
+      // reset the conversion state
+      iconv(c, 0, 0, 0, 0);
+      return c;
+   }
+
+#ifdef NEED_ICONV_TRANSLIT
+   QoreString to_code(to->getCode());
+   to_code.concat("//TRANSLIT");
+   return iconv_open(to_code.getBuffer(), from->getCode());
+#else
+   return iconv_open(to->getCode(), from->getCode());
+#endif
+}
+
+void q_iconv_put(const QoreEncoding* to, const QoreEncoding* from, iconv_t c) {
+   QoreIconvCache* ic = qore_iconv_cache.get();
+   // the cache is not available during static initialization and destruction
+   if (ic)
+      ic->put(to, from, c);
+   else
+      iconv_close(c);
+}
@@ -35,6 +35,8 @@
 
 #include "qore/intern/QoreSignal.h"
 #include "qore/intern/ModuleInfo.h"
+#include "qore/intern/QoreRegexCache.h"
+#include "qore/intern/RSet.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -139,6 +141,9 @@ void qore_init(qore_license_t license, const char *def_charset, bool show_module
    // create default type values
    init_qore_types();
 
+   // register the builtin "loopback" DBI driver
+   init_loopback_dbi();
+
    // init module subsystem
    QMM.init(show_module_errors);
 
@@ -175,6 +180,9 @@ void qore_cleanup() {
       purge_thread_resources(&xsink);
    }
 
+   // stop the deferred cycle collector and run any pending scans
+   QCC.del();
+
    // first delete all user modules
    QMM.delUser();
 
@@ -197,6 +205,12 @@ void qore_cleanup() {
    // now free memory (like ARGV, QORE_ARGV, ENV, etc)
    delete_global_variables();
 
+   // free cached regular expressions
+   QRC.clear();
+
+   // free loopback DBI driver tables
+   delete_loopback_dbi_data();
+
    // delete pseudo-methods
    pseudo_classes_del();
 
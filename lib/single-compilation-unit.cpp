@@ -58,6 +58,7 @@
 #include "QoreImplicitArgumentNode.cpp"
 #include "QoreImplicitElementNode.cpp"
 #include "Function.cpp"
+#include "QoreBytecode.cpp"
 #include "BuiltinFunctionList.cpp"
 #include "GlobalVariableList.cpp"
 #include "FunctionList.cpp"
@@ -98,6 +99,7 @@
 #include "QoreFile.cpp"
 #include "QoreDir.cpp"
 #include "QoreSocket.cpp"
+#include "QoreSocketPoller.cpp"
 #include "DateTime.cpp"
 #include "QoreLib.cpp"
 #include "QoreTimeZoneManager.cpp"
@@ -125,6 +127,7 @@
 #endif
 #include "Datasource.cpp"
 #include "DatasourcePool.cpp"
+#include "LoopbackDBI.cpp"
 #include "ManagedDatasource.cpp"
 #include "SQLStatement.cpp"
 #include "QoreSQLStatement.cpp"
@@ -141,6 +144,7 @@
 #include "QoreQueueHelper.cpp"
 #include "QoreRegex.cpp"
 #include "QoreRegexBase.cpp"
+#include "QoreRegexCache.cpp"
 #include "QoreRegexSubst.cpp"
 #include "QoreTransliteration.cpp"
 #include "Sequence.cpp"
@@ -236,6 +240,7 @@
 #include "FunctionalOperator.cpp"
 #include "StreamPipe.cpp"
 #include "CompressionTransforms.cpp"
+#include "QoreDigest.cpp"
 #include "ql_thread.cpp"
 #include "ql_time.cpp"
 #include "ql_lib.cpp"
@@ -256,6 +261,7 @@
 #include "qc_errno.cpp"
 #include "qc_qore.cpp"
 #include "QC_Socket.cpp"
+#include "QC_SocketPoller.cpp"
 #include "QC_Program.cpp"
 #include "QC_ReadOnlyFile.cpp"
 #include "QC_File.cpp"
@@ -333,6 +339,8 @@
 #include "QC_Transform.cpp"
 #include "QC_TransformInputStream.cpp"
 #include "QC_TransformOutputStream.cpp"
+#include "QC_Digest.cpp"
+#include "QC_Hmac.cpp"
 #include "QC_StdoutOutputStream.cpp"
 #include "QC_StderrOutputStream.cpp"
 
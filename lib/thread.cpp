@@ -291,6 +291,9 @@ public:
    // current parsing closure environment
    ClosureParseEnvironment* closure_parse_env;
 
+   // current parsing local variable frame environment
+   LocalVarFrameParseEnvironment* lvar_frame_parse_env;
+
    // current runtime closure environment
    const QoreClosureBase* closure_rt_env;
 
@@ -337,6 +340,9 @@ public:
    // user to track the current user module context
    const char* user_module_context_name;
 
+   // number of times the module manager lock is held by this thread while loading modules
+   int module_lock_count;
+
    // AbstractQoreModule* with boolean ptr in bit 0
    uintptr_t qmi;
 
@@ -349,9 +355,9 @@ public:
       parseClass(0), catchException(0), trlist(new ThreadResourceList), current_code(0),
       current_obj(0), current_class(0),
       current_pgm(p), current_ns(0), current_implicit_arg(0), tlpd(0), tpd(new ThreadProgramData(this)),
-      closure_parse_env(0), closure_rt_env(0),
+      closure_parse_env(0), lvar_frame_parse_env(0), closure_rt_env(0),
       returnTypeInfo(0), parse_return_type_info(0), element(0), global_vnode(0), pcs(0),
-      qmc(0), qmd(0), user_module_context_name(0), qmi(0), foreign(n_foreign) {
+      qmc(0), qmd(0), user_module_context_name(0), module_lock_count(0), qmi(0), foreign(n_foreign) {
 
 #ifdef QORE_MANAGE_STACK
 
@@ -801,27 +807,27 @@ void thread_ref_remove(const lvalue_ref* r) {
    td->ref_set.erase(r);
 }
 
-LocalVarValue* thread_instantiate_lvar() {
-   return thread_data.get()->tlpd->lvstack.instantiate();
+LocalVarValue* thread_instantiate_lvar(int slot) {
+   return thread_data.get()->tlpd->lvstack.instantiate(slot);
 }
 
-void thread_uninstantiate_lvar(ExceptionSink* xsink) {
+void thread_uninstantiate_lvar(int slot, ExceptionSink* xsink) {
    ThreadData* td = thread_data.get();
-   td->tlpd->lvstack.uninstantiate(xsink);
+   td->tlpd->lvstack.uninstantiate(slot, xsink);
 }
 
-void thread_uninstantiate_self() {
+void thread_uninstantiate_self(int slot) {
    ThreadData* td = thread_data.get();
-   td->tlpd->lvstack.uninstantiateSelf();
+   td->tlpd->lvstack.uninstantiateSelf(slot);
 }
 
-LocalVarValue* thread_find_lvar(const char* id) {
+LocalVarValue* thread_find_lvar(const char* id, int slot) {
    ThreadData* td = thread_data.get();
-   return td->tlpd->lvstack.find(id);
+   return td->tlpd->lvstack.find(id, slot);
 }
 
-ClosureVarValue* thread_instantiate_closure_var(const char* n_id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
-   return thread_data.get()->tlpd->cvstack.instantiate(n_id, typeInfo, nval);
+ClosureVarValue* thread_instantiate_closure_var(const char* n_id, const QoreTypeInfo* typeInfo, QoreValue& nval, int slot) {
+   return thread_data.get()->tlpd->cvstack.instantiate(n_id, typeInfo, nval, slot);
 }
 
 void thread_instantiate_closure_var(ClosureVarValue* cvar) {
@@ -832,8 +838,24 @@ void thread_uninstantiate_closure_var(ExceptionSink* xsink) {
    thread_data.get()->tlpd->cvstack.uninstantiate(xsink);
 }
 
-ClosureVarValue* thread_find_closure_var(const char* id) {
-   return thread_data.get()->tlpd->cvstack.find(id);
+void thread_uninstantiate_closure_var(int slot, ExceptionSink* xsink) {
+   thread_data.get()->tlpd->cvstack.uninstantiate(slot, xsink);
+}
+
+ClosureVarValue* thread_find_closure_var(const char* id, int slot) {
+   return thread_data.get()->tlpd->cvstack.find(id, slot);
+}
+
+void thread_enter_lvar_frame(unsigned lvars, unsigned cvars) {
+   ThreadLocalProgramData* tlpd = thread_data.get()->tlpd;
+   tlpd->lvstack.enterFrame(lvars);
+   tlpd->cvstack.enterFrame(cvars);
+}
+
+void thread_exit_lvar_frame() {
+   ThreadLocalProgramData* tlpd = thread_data.get()->tlpd;
+   tlpd->lvstack.exitFrame();
+   tlpd->cvstack.exitFrame();
 }
 
 const QoreClosureBase* thread_set_runtime_closure_env(const QoreClosureBase* current) {
@@ -859,6 +881,17 @@ ClosureParseEnvironment* thread_get_closure_parse_env() {
    return thread_data.get()->closure_parse_env;
 }
 
+LocalVarFrameParseEnvironment* thread_set_lvar_frame_parse_env(LocalVarFrameParseEnvironment* fenv) {
+   ThreadData* td = thread_data.get();
+   LocalVarFrameParseEnvironment* rv = td->lvar_frame_parse_env;
+   td->lvar_frame_parse_env = fenv;
+   return rv;
+}
+
+LocalVarFrameParseEnvironment* thread_get_lvar_frame_parse_env() {
+   return thread_data.get()->lvar_frame_parse_env;
+}
+
 void parse_push_name(const char* name) {
    ThreadData* td = thread_data.get();
    td->pushName(name);
@@ -1280,6 +1313,25 @@ const char* get_user_module_context_name() {
    return thread_data.get()->user_module_context_name;
 }
 
+void inc_module_lock_count() {
+   ThreadData* td = thread_data.get();
+   if (td)
+      ++td->module_lock_count;
+}
+
+void dec_module_lock_count() {
+   ThreadData* td = thread_data.get();
+   if (td) {
+      assert(td->module_lock_count > 0);
+      --td->module_lock_count;
+   }
+}
+
+int get_module_lock_count() {
+   ThreadData* td = thread_data.get();
+   return td ? td->module_lock_count : 0;
+}
+
 void ModuleContextNamespaceList::clear() {
    for (mcnl_t::iterator i = begin(), e = end(); i != e; ++i)
       delete (*i).nns;